@@ -59,6 +59,24 @@ DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix()
 	return projectionMatrix;
 }
 
+DirectX::BoundingFrustum Camera::GetFrustum()
+{
+	// Build the frustum in view space, then move it into world space
+	BoundingFrustum frustum(XMLoadFloat4x4(&projectionMatrix));
+	frustum.Transform(frustum, XMMatrixInverse(0, XMLoadFloat4x4(&viewMatrix)));
+	return frustum;
+}
+
+float Camera::GetNearClip()
+{
+	return clipNear;
+}
+
+float Camera::GetFarClip()
+{
+	return clipFar;
+}
+
 void Camera::SetAspect(float _aspect)
 {
 	aspect = _aspect;
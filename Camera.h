@@ -2,6 +2,7 @@
 
 #include "Transform.h"
 #include <memory>
+#include <DirectXCollision.h>
 
 class Camera
 {
@@ -16,6 +17,9 @@ public:
 	Transform*			GetTransform();
 	DirectX::XMFLOAT4X4 GetViewMatrix();
 	DirectX::XMFLOAT4X4 GetProjectionMatrix();
+	DirectX::BoundingFrustum GetFrustum();
+	float				GetNearClip();
+	float				GetFarClip();
 
 	void				SetAspect(float _aspect);
 	void				SetFOV(float _fov);
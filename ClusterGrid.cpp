@@ -0,0 +1,374 @@
+#include "ClusterGrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+static_assert(CLUSTER_COUNT_X % 4 == 0, "Cluster rows are tested four boxes at a time");
+
+ClusterGrid::ClusterGrid()
+{
+	stats = {};
+	workCount = 0;
+	nextWork = 0;
+	finishedWork = 0;
+	stopping = false;
+	boxMinX.resize(CLUSTER_COUNT);
+	boxMinY.resize(CLUSTER_COUNT);
+	boxMinZ.resize(CLUSTER_COUNT);
+	boxMaxX.resize(CLUSTER_COUNT);
+	boxMaxY.resize(CLUSTER_COUNT);
+	boxMaxZ.resize(CLUSTER_COUNT);
+	ranges.resize(CLUSTER_COUNT);
+
+	// Something sensible until the real projection arrives
+	XMFLOAT4X4 projection = {};
+	projection._11 = 1;
+	projection._22 = 1;
+	SetProjection(projection, 0.1f, 100.0f);
+}
+
+ClusterGrid::~ClusterGrid()
+{
+	{
+		std::lock_guard<std::mutex> lock(workMutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ClusterGrid::SetProjection(const XMFLOAT4X4& _projection, float _nearClip, float _farClip)
+{
+	nearClip = _nearClip;
+	farClip = _farClip;
+
+	// Half the view's width and height at a depth of 1
+	float tanX = 1.0f / _projection._11;
+	float tanY = 1.0f / _projection._22;
+
+	float logRange = logf(farClip / nearClip);
+	sliceScale = CLUSTER_COUNT_Z / logRange;
+	sliceBias = -CLUSTER_COUNT_Z * logf(nearClip) / logRange;
+	for (int s = 0; s <= CLUSTER_COUNT_Z; s++)
+	{
+		sliceDepths[s] = nearClip * powf(farClip / nearClip, (float)s / CLUSTER_COUNT_Z);
+	}
+	sliceDepths[CLUSTER_COUNT_Z] = farClip;
+
+	for (int s = 0; s < CLUSTER_COUNT_Z; s++)
+	{
+		float nearDepth = sliceDepths[s];
+		float farDepth = sliceDepths[s + 1];
+
+		// A tile's sides spread out with depth, so its box spans the near and far ends of the slice
+		for (int x = 0; x < CLUSTER_COUNT_X; x++)
+		{
+			float left = (-1.0f + 2.0f * x / CLUSTER_COUNT_X) * tanX;
+			float right = (-1.0f + 2.0f * (x + 1) / CLUSTER_COUNT_X) * tanX;
+			columnMin[s][x] = std::min(left * nearDepth, left * farDepth);
+			columnMax[s][x] = std::max(right * nearDepth, right * farDepth);
+		}
+		for (int y = 0; y < CLUSTER_COUNT_Y; y++)
+		{
+			float top = (1.0f - 2.0f * y / CLUSTER_COUNT_Y) * tanY;
+			float bottom = (1.0f - 2.0f * (y + 1) / CLUSTER_COUNT_Y) * tanY;
+			rowMin[s][y] = std::min(bottom * nearDepth, bottom * farDepth);
+			rowMax[s][y] = std::max(top * nearDepth, top * farDepth);
+		}
+
+		for (int y = 0; y < CLUSTER_COUNT_Y; y++)
+		{
+			for (int x = 0; x < CLUSTER_COUNT_X; x++)
+			{
+				unsigned int c = (s * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X + x;
+				boxMinX[c] = columnMin[s][x];
+				boxMaxX[c] = columnMax[s][x];
+				boxMinY[c] = rowMin[s][y];
+				boxMaxY[c] = rowMax[s][y];
+				boxMinZ[c] = nearDepth;
+				boxMaxZ[c] = farDepth;
+			}
+		}
+	}
+}
+
+void ClusterGrid::Assign(const XMFLOAT4X4& _view, const std::vector<Light>& _lights, unsigned int _threads)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// Give each thread a decent share, since waking one isn't free
+	unsigned int lightCount = (unsigned int)_lights.size();
+	unsigned int jobCount = std::min(std::max(_threads, 1u), std::max(lightCount / CLUSTER_LIGHTS_PER_THREAD, 1u));
+	jobs.resize(jobCount);
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		jobs[j].firstLight = (unsigned int)((uint64_t)lightCount * j / jobCount);
+		jobs[j].lightCount = (unsigned int)((uint64_t)lightCount * (j + 1) / jobCount) - jobs[j].firstLight;
+	}
+
+	RunJobs(jobCount, [&](unsigned int _job) { BinLights(_view, _lights, jobs[_job]); });
+	Gather(jobCount);
+
+	stats = {};
+	for (unsigned int j = 0; j < jobCount; j++)
+	{
+		stats.visibleLights += jobs[j].visibleLights;
+		stats.clusterTests += jobs[j].clusterTests;
+	}
+	for (auto& light : _lights)
+	{
+		if (light.Type != LIGHT_TYPE_DIRECTIONAL) stats.lights++;
+	}
+	stats.references = (unsigned int)lightIndices.size();
+	stats.threads = jobCount;
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.milliseconds = elapsed.count();
+}
+
+void ClusterGrid::AssignBruteForce(const XMFLOAT4X4& _view, const std::vector<Light>& _lights)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	stats = {};
+
+	std::vector<ViewLight> viewLights;
+	for (unsigned int i = 0; i < _lights.size(); i++)
+	{
+		ViewLight viewLight;
+		if (ToViewLight(_view, _lights[i], i, viewLight)) viewLights.push_back(viewLight);
+	}
+
+	std::vector<bool> visible(viewLights.size(), false);
+	lightIndices.clear();
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		ranges[c].offset = (unsigned int)lightIndices.size();
+		for (unsigned int l = 0; l < viewLights.size(); l++)
+		{
+			if (!Touches(viewLights[l], c)) continue;
+			lightIndices.push_back(viewLights[l].index);
+			visible[l] = true;
+		}
+		ranges[c].count = (unsigned int)lightIndices.size() - ranges[c].offset;
+	}
+
+	stats.lights = (unsigned int)viewLights.size();
+	stats.visibleLights = (unsigned int)std::count(visible.begin(), visible.end(), true);
+	stats.references = (unsigned int)lightIndices.size();
+	stats.clusterTests = (unsigned int)viewLights.size() * CLUSTER_COUNT;
+	stats.threads = 1;
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.milliseconds = elapsed.count();
+}
+
+const std::vector<ClusterRange>& ClusterGrid::GetRanges()
+{
+	return ranges;
+}
+
+const std::vector<unsigned int>& ClusterGrid::GetLightIndices()
+{
+	return lightIndices;
+}
+
+ClusterStats ClusterGrid::GetStats()
+{
+	return stats;
+}
+
+float ClusterGrid::GetSliceScale()
+{
+	return sliceScale;
+}
+
+float ClusterGrid::GetSliceBias()
+{
+	return sliceBias;
+}
+
+#pragma region Internal Binning
+bool ClusterGrid::ToViewLight(const XMFLOAT4X4& _view, const Light& _light, unsigned int _index, ViewLight& _viewLight)
+{
+	// Directional lights reach every cluster, so they're left to the per-object lists
+	if (_light.Type == LIGHT_TYPE_DIRECTIONAL) return false;
+
+	const XMFLOAT3& p = _light.Position;
+	_viewLight.center = XMFLOAT3(
+		p.x * _view._11 + p.y * _view._21 + p.z * _view._31 + _view._41,
+		p.x * _view._12 + p.y * _view._22 + p.z * _view._32 + _view._42,
+		p.x * _view._13 + p.y * _view._23 + p.z * _view._33 + _view._43);
+	_viewLight.radius = _light.Range;
+	_viewLight.index = _index;
+	return true;
+}
+
+bool ClusterGrid::Touches(const ViewLight& _light, unsigned int _cluster)
+{
+	// Same arithmetic, in the same order, as the SSE version in BinLights
+	float dx = std::max(boxMinX[_cluster] - _light.center.x, 0.0f) + std::max(_light.center.x - boxMaxX[_cluster], 0.0f);
+	float dy = std::max(boxMinY[_cluster] - _light.center.y, 0.0f) + std::max(_light.center.y - boxMaxY[_cluster], 0.0f);
+	float dz = std::max(boxMinZ[_cluster] - _light.center.z, 0.0f) + std::max(_light.center.z - boxMaxZ[_cluster], 0.0f);
+	return dx * dx + dy * dy + dz * dz <= _light.radius * _light.radius;
+}
+
+void ClusterGrid::BinLights(const XMFLOAT4X4& _view, const std::vector<Light>& _lights, BinJob& _job)
+{
+	_job.references.clear();
+	_job.counts.assign(CLUSTER_COUNT, 0);
+	_job.visibleLights = 0;
+	_job.clusterTests = 0;
+
+	const __m128 zero = _mm_setzero_ps();
+	for (unsigned int i = _job.firstLight; i < _job.firstLight + _job.lightCount; i++)
+	{
+		ViewLight light;
+		if (!ToViewLight(_view, _lights[i], i, light)) continue;
+
+		float nearest = light.center.z - light.radius;
+		float furthest = light.center.z + light.radius;
+		if (furthest < nearClip || nearest > farClip) continue;
+
+		// The log spacing narrows the slices down, give or take one either side for rounding
+		int firstSlice = nearest <= nearClip ? 0 : (int)floorf(logf(nearest) * sliceScale + sliceBias) - 1;
+		int lastSlice = (int)floorf(logf(furthest) * sliceScale + sliceBias) + 1;
+		firstSlice = std::max(firstSlice, 0);
+		lastSlice = std::min(lastSlice, CLUSTER_COUNT_Z - 1);
+
+		__m128 centerX = _mm_set1_ps(light.center.x);
+		__m128 centerY = _mm_set1_ps(light.center.y);
+		__m128 centerZ = _mm_set1_ps(light.center.z);
+		__m128 radiusSquared = _mm_set1_ps(light.radius * light.radius);
+		size_t referencesBefore = _job.references.size();
+
+		for (int s = firstSlice; s <= lastSlice; s++)
+		{
+			if (sliceDepths[s] > furthest || sliceDepths[s + 1] < nearest) continue;
+
+			// Columns and rows whose boxes overlap the light's bounds; box extents only grow along each
+			int firstColumn = 0;
+			while (firstColumn < CLUSTER_COUNT_X && columnMax[s][firstColumn] < light.center.x - light.radius) firstColumn++;
+			int lastColumn = CLUSTER_COUNT_X - 1;
+			while (lastColumn >= firstColumn && columnMin[s][lastColumn] > light.center.x + light.radius) lastColumn--;
+			int firstRow = 0;
+			while (firstRow < CLUSTER_COUNT_Y && rowMin[s][firstRow] > light.center.y + light.radius) firstRow++;
+			int lastRow = CLUSTER_COUNT_Y - 1;
+			while (lastRow >= firstRow && rowMax[s][lastRow] < light.center.y - light.radius) lastRow--;
+			if (firstColumn > lastColumn) continue;
+
+			for (int y = firstRow; y <= lastRow; y++)
+			{
+				unsigned int row = (s * CLUSTER_COUNT_Y + y) * CLUSTER_COUNT_X;
+				for (int x = firstColumn & ~3; x <= lastColumn; x += 4)
+				{
+					// Distance from the sphere's center to four boxes at once
+					unsigned int c = row + x;
+					__m128 dx = _mm_add_ps(
+						_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boxMinX[c]), centerX), zero),
+						_mm_max_ps(_mm_sub_ps(centerX, _mm_loadu_ps(&boxMaxX[c])), zero));
+					__m128 dy = _mm_add_ps(
+						_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boxMinY[c]), centerY), zero),
+						_mm_max_ps(_mm_sub_ps(centerY, _mm_loadu_ps(&boxMaxY[c])), zero));
+					__m128 dz = _mm_add_ps(
+						_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&boxMinZ[c]), centerZ), zero),
+						_mm_max_ps(_mm_sub_ps(centerZ, _mm_loadu_ps(&boxMaxZ[c])), zero));
+					__m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int hits = _mm_movemask_ps(_mm_cmple_ps(distanceSquared, radiusSquared));
+					_job.clusterTests += 4;
+
+					for (int b = 0; b < 4; b++)
+					{
+						if (!(hits & (1 << b))) continue;
+						_job.references.push_back(((uint64_t)(c + b) << 32) | i);
+						_job.counts[c + b]++;
+					}
+				}
+			}
+		}
+
+		if (_job.references.size() > referencesBefore) _job.visibleLights++;
+	}
+}
+
+void ClusterGrid::Gather(unsigned int _jobCount)
+{
+	// Each cluster's run holds the first job's lights, then the second's and so on, so lights stay in order
+	unsigned int total = 0;
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		ranges[c].offset = total;
+		for (unsigned int j = 0; j < _jobCount; j++)
+		{
+			// Each job's count becomes where its part of the run starts
+			unsigned int count = jobs[j].counts[c];
+			jobs[j].counts[c] = total;
+			total += count;
+		}
+		ranges[c].count = total - ranges[c].offset;
+	}
+
+	lightIndices.resize(total);
+	RunJobs(_jobCount, [&](unsigned int _job)
+		{
+			BinJob& job = jobs[_job];
+			for (uint64_t reference : job.references)
+			{
+				lightIndices[job.counts[reference >> 32]++] = (unsigned int)reference;
+			}
+		});
+}
+
+void ClusterGrid::RunJobs(unsigned int _count, std::function<void(unsigned int)> _job)
+{
+	// The caller is one of the threads, so the pool only ever needs one fewer
+	while (workers.size() + 1 < _count)
+	{
+		workers.push_back(std::thread(&ClusterGrid::Work, this));
+	}
+
+	std::unique_lock<std::mutex> lock(workMutex);
+	work = _job;
+	workCount = _count;
+	nextWork = 0;
+	finishedWork = 0;
+	if (_count > 1) workReady.notify_all();
+
+	// Take jobs alongside the pool until none are left, then wait for the ones still running
+	while (nextWork < workCount)
+	{
+		unsigned int job = nextWork++;
+		lock.unlock();
+		_job(job);
+		lock.lock();
+		finishedWork++;
+	}
+	workDone.wait(lock, [this] { return finishedWork == workCount; });
+	workCount = 0;
+	nextWork = 0;
+	work = nullptr;
+}
+
+void ClusterGrid::Work()
+{
+	std::unique_lock<std::mutex> lock(workMutex);
+	while (true)
+	{
+		workReady.wait(lock, [this] { return stopping || nextWork < workCount; });
+		if (stopping) return;
+
+		unsigned int job = nextWork++;
+		lock.unlock();
+		work(job);
+		lock.lock();
+		if (++finishedWork == workCount) workDone.notify_one();
+	}
+}
+#pragma endregion
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Lights.h"
+
+// Screen tiles across and down, and exponential depth slices
+// - These should match Clusters.hlsli
+constexpr auto CLUSTER_COUNT_X = 16;
+constexpr auto CLUSTER_COUNT_Y = 9;
+constexpr auto CLUSTER_COUNT_Z = 24;
+constexpr auto CLUSTER_COUNT = CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z;
+
+// Below this many lights, binning stays on the calling thread
+constexpr auto CLUSTER_LIGHTS_PER_THREAD = 256;
+
+// Where one cluster's lights sit in the light index list
+struct ClusterRange
+{
+	unsigned int							offset;
+	unsigned int							count;
+};
+
+struct ClusterStats
+{
+	unsigned int							lights;				// Point and spot lights considered
+	unsigned int							visibleLights;		// Of those, lights reaching at least one cluster
+	unsigned int							references;			// Entries in the light index list
+	unsigned int							clusterTests;		// Sphere/box tests run
+	unsigned int							threads;
+	double									milliseconds;
+};
+
+// --------------------------------------------------------
+// Splits the view frustum into a grid of clusters and bins
+// point and spot lights into them
+//
+// Clusters are CLUSTER_COUNT_X x CLUSTER_COUNT_Y screen tiles
+// by CLUSTER_COUNT_Z depth slices, spaced exponentially from
+// the near to the far clip so they stay roughly cube-shaped.
+// Each gets a view-space bounding box, and a light lands in
+// every cluster whose box its range sphere touches.
+//
+// The result is a list of light indices (into the vector given
+// to Assign) grouped by cluster, plus each cluster's offset and
+// count into it; within a cluster, lights keep their order.
+// Cluster c = (slice * CLUSTER_COUNT_Y + row) * CLUSTER_COUNT_X
+// + column, with row 0 at the top of the screen.
+//
+// Lights are split across threads, each of which narrows every
+// light down to the clusters its bounds could reach and then
+// tests four boxes at a time with SSE. The calling thread takes
+// a share too; the others are started the first time they're
+// needed and then sleep between calls until the grid goes away.
+// Nothing here knows about D3D; LightClusters uploads the results.
+// --------------------------------------------------------
+class ClusterGrid
+{
+public:
+	ClusterGrid();
+	~ClusterGrid();
+
+											/// <summary>
+											/// Rebuilds the cluster boxes for a projection
+											/// </summary>
+											/// <param name="_projection">A left-handed perspective projection matrix</param>
+											/// <param name="_nearClip">The near clip distance the projection was made with</param>
+											/// <param name="_farClip">The far clip distance the projection was made with</param>
+	void									SetProjection(const DirectX::XMFLOAT4X4& _projection, float _nearClip, float _farClip);
+											/// <summary>
+											/// Bins lights into the clusters (directional lights are skipped)
+											/// </summary>
+											/// <param name="_view">The view matrix</param>
+											/// <param name="_lights">The lights to bin</param>
+											/// <param name="_threads">The most threads to split the lights across</param>
+	void									Assign(const DirectX::XMFLOAT4X4& _view, const std::vector<Light>& _lights, unsigned int _threads);
+											/// <summary>
+											/// Bins lights by testing every light against every cluster, for checking Assign against
+											/// </summary>
+	void									AssignBruteForce(const DirectX::XMFLOAT4X4& _view, const std::vector<Light>& _lights);
+
+	const std::vector<ClusterRange>&		GetRanges();
+	const std::vector<unsigned int>&		GetLightIndices();
+	ClusterStats							GetStats();
+
+											/// <summary>
+											/// Gets the terms turning a view depth into a slice: floor(log(depth) * scale + bias)
+											/// </summary>
+	float									GetSliceScale();
+	float									GetSliceBias();
+
+private:
+	// A light's range sphere in view space
+	struct ViewLight
+	{
+		DirectX::XMFLOAT3					center;
+		float								radius;
+		unsigned int						index;
+	};
+
+	// One thread's share of the binning
+	struct BinJob
+	{
+		unsigned int						firstLight;
+		unsigned int						lightCount;
+		std::vector<uint64_t>				references;		// (cluster << 32) | light, in light order
+		std::vector<unsigned int>			counts;			// References per cluster
+		unsigned int						visibleLights;
+		unsigned int						clusterTests;
+	};
+
+	static bool								ToViewLight(const DirectX::XMFLOAT4X4& _view, const Light& _light, unsigned int _index, ViewLight& _viewLight);
+	bool									Touches(const ViewLight& _light, unsigned int _cluster);
+	void									BinLights(const DirectX::XMFLOAT4X4& _view, const std::vector<Light>& _lights, BinJob& _job);
+	void									Gather(unsigned int _jobCount);
+											/// <summary>
+											/// Runs jobs 0 to _count - 1 across the calling thread and the pool, returning once all are done
+											/// </summary>
+	void									RunJobs(unsigned int _count, std::function<void(unsigned int)> _job);
+	void									Work();
+
+	float									nearClip;
+	float									farClip;
+	float									sliceScale;
+	float									sliceBias;
+	float									sliceDepths[CLUSTER_COUNT_Z + 1];
+
+	// Per slice, the x extents of each column's boxes and the y extents of each row's
+	float									columnMin[CLUSTER_COUNT_Z][CLUSTER_COUNT_X];
+	float									columnMax[CLUSTER_COUNT_Z][CLUSTER_COUNT_X];
+	float									rowMin[CLUSTER_COUNT_Z][CLUSTER_COUNT_Y];
+	float									rowMax[CLUSTER_COUNT_Z][CLUSTER_COUNT_Y];
+
+	// Cluster boxes, one array per bound so four neighbouring boxes load at once
+	std::vector<float>						boxMinX, boxMinY, boxMinZ;
+	std::vector<float>						boxMaxX, boxMaxY, boxMaxZ;
+
+	std::vector<BinJob>						jobs;
+
+	// The pool: workers sleep on workReady until a call hands out jobs, and the caller waits on workDone
+	std::vector<std::thread>				workers;
+	std::mutex								workMutex;
+	std::condition_variable					workReady;
+	std::condition_variable					workDone;
+	std::function<void(unsigned int)>		work;
+	unsigned int							workCount;
+	unsigned int							nextWork;
+	unsigned int							finishedWork;
+	bool									stopping;
+	std::vector<ClusterRange>				ranges;
+	std::vector<unsigned int>				lightIndices;
+	ClusterStats							stats;
+};
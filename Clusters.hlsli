@@ -0,0 +1,41 @@
+#ifndef __SHADER_CLUSTERS__
+#define __SHADER_CLUSTERS__
+
+#include "Defines.hlsli"
+#include "ConstantBuffers.hlsli"
+
+// Clustered lighting (see ClusterGrid.h): the view frustum is split into screen tiles
+// and exponential depth slices, and each cluster lists the point lights reaching it
+// - These should match ClusterGrid.h and LightClusters.h
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+
+StructuredBuffer<uint2> ClusterRanges		: register(t20); // Offset and count into ClusterLightIndices, per cluster
+StructuredBuffer<uint> ClusterLightIndices	: register(t21);
+StructuredBuffer<Light> ClusterLights		: register(t22);
+
+// Gets the offset and count of the lights in a pixel's cluster (none while clustering is off)
+uint2 getClusterRange(float4 screenPosition, float3 worldPosition)
+{
+	if (clusterSliceScale <= 0)
+		return uint2(0, 0);
+
+	float depth = mul(view, float4(worldPosition, 1)).z;
+	int slice = (int)floor(log(depth) * clusterSliceScale + clusterSliceBias);
+	if (slice < 0 || slice >= CLUSTER_COUNT_Z)
+		return uint2(0, 0);
+
+	uint2 tile = min((uint2)(screenPosition.xy * clusterTileScale), uint2(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1));
+	return ClusterRanges[(slice * CLUSTER_COUNT_Y + tile.y) * CLUSTER_COUNT_X + tile.x];
+}
+
+// Gets a light by its place in the combined list: the object's own lights, then its cluster's
+Light getLight(uint index, uint2 clusterRange)
+{
+	if (index < (uint)lightCount)
+		return lights[index];
+	return ClusterLights[ClusterLightIndices[clusterRange.x + index - (uint)lightCount]];
+}
+
+#endif
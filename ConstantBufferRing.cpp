@@ -0,0 +1,281 @@
+#include "ConstantBufferRing.h"
+
+#include <cstring>
+
+#pragma region Ring Allocator
+RingAllocator::RingAllocator(unsigned int _capacity, unsigned int _alignment)
+{
+	alignment = _alignment;
+	capacity = (_capacity / _alignment) * _alignment;
+	head = 0;
+	tail = 0;
+	used = 0;
+	frameBytes = 0;
+	ResetStats();
+}
+
+RingAllocator::~RingAllocator()
+{
+}
+
+bool RingAllocator::Allocate(unsigned int _size, unsigned int& _offset)
+{
+	unsigned int size = ((_size + alignment - 1) / alignment) * alignment;
+
+	// Nothing in flight at all, so start over from the beginning
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	unsigned int taken = 0;
+	if (used < capacity && head >= tail)
+	{
+		// Free space runs from the head to the end, then from the start to the tail
+		if (head + size <= capacity)
+		{
+			_offset = head;
+			taken = size;
+		}
+		else if (size <= tail)
+		{
+			// Skip the unusable end of the ring; it's freed along with this frame
+			_offset = 0;
+			taken = (capacity - head) + size;
+			stats.wraps++;
+		}
+	}
+	else if (used < capacity && head + size <= tail)
+	{
+		// Free space runs from the head up to the tail
+		_offset = head;
+		taken = size;
+	}
+
+	if (taken == 0)
+	{
+		stats.stalls++;
+		return false;
+	}
+
+	head = _offset + size;
+	if (head == capacity) head = 0;
+	used += taken;
+	frameBytes += taken;
+
+	stats.allocations++;
+	stats.allocatedBytes += size;
+	if (used > stats.peakUsed) stats.peakUsed = used;
+	return true;
+}
+
+void RingAllocator::EndFrame(uint64_t _fence)
+{
+	if (frameBytes == 0) return;
+
+	Frame frame = {};
+	frame.fence = _fence;
+	frame.end = head;
+	frame.bytes = frameBytes;
+	frames.push_back(frame);
+	frameBytes = 0;
+}
+
+bool RingAllocator::Retire(uint64_t _completedFence)
+{
+	bool freed = false;
+	while (!frames.empty() && frames.front().fence <= _completedFence)
+	{
+		tail = frames.front().end;
+		used -= frames.front().bytes;
+		frames.pop_front();
+		freed = true;
+	}
+	return freed;
+}
+
+void RingAllocator::Reset()
+{
+	frames.clear();
+	head = 0;
+	tail = 0;
+	used = 0;
+	frameBytes = 0;
+}
+
+unsigned int RingAllocator::GetUsed()
+{
+	return used;
+}
+
+unsigned int RingAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+unsigned int RingAllocator::GetFramesInFlight()
+{
+	return (unsigned int)frames.size();
+}
+
+RingStats RingAllocator::GetStats()
+{
+	RingStats current = stats;
+	current.used = used;
+	current.capacity = capacity;
+	return current;
+}
+
+void RingAllocator::ResetStats()
+{
+	stats = {};
+}
+#pragma endregion
+
+#pragma region Constant Buffer Ring
+ConstantBufferRing::ConstantBufferRing(
+	Microsoft::WRL::ComPtr<ID3D11Device>		_device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	_context,
+	unsigned int								_capacity)
+	: allocator(_capacity, RING_ALIGNMENT)
+{
+	context = _context;
+	discardNext = true;
+	generation = 0;
+	nextFence = 1;
+	completedFence = 0;
+	waits = 0;
+	discards = 0;
+
+	// Binding by offset needs the 11.1 runtime and driver support; without it the ring stays unused
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	supported = options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+	if (!supported) return;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = allocator.GetCapacity();
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	_device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (int i = 0; i < RING_FRAMES_IN_FLIGHT; i++)
+	{
+		_device->CreateQuery(&queryDesc, fenceQueries[i].GetAddressOf());
+	}
+}
+
+ConstantBufferRing::~ConstantBufferRing()
+{
+}
+
+bool ConstantBufferRing::IsSupported()
+{
+	return supported;
+}
+
+bool ConstantBufferRing::Upload(const void* _data, unsigned int _size, UINT& _firstConstant, UINT& _numConstants)
+{
+	if (!supported) return false;
+
+	unsigned int offset = 0;
+	if (!allocator.Allocate(_size, offset))
+	{
+		// Frames that finished since the last check may have made room
+		PollFences();
+		if (!allocator.Allocate(_size, offset))
+		{
+			// Still full of in-flight data: let the driver rename the buffer rather than wait on the GPU
+			allocator.Reset();
+			if (!allocator.Allocate(_size, offset)) return false;
+			discardNext = true;
+			discards++;
+		}
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	D3D11_MAP mapType = discardNext ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (FAILED(context->Map(buffer.Get(), 0, mapType, 0, &mapped))) return false;
+	memcpy((unsigned char*)mapped.pData + offset, _data, _size);
+	context->Unmap(buffer.Get(), 0);
+
+	// Everything uploaded before a discard now lives in memory the next draws won't see
+	if (discardNext)
+	{
+		discardNext = false;
+		generation++;
+	}
+
+	_firstConstant = offset / 16;
+	_numConstants = ((_size + RING_ALIGNMENT - 1) / RING_ALIGNMENT) * (RING_ALIGNMENT / 16);
+	return true;
+}
+
+void ConstantBufferRing::EndFrame()
+{
+	if (!supported) return;
+
+	// The query for this frame last fenced the frame RING_FRAMES_IN_FLIGHT ago, which has to finish before it's reused
+	if (nextFence > RING_FRAMES_IN_FLIGHT && completedFence < nextFence - RING_FRAMES_IN_FLIGHT)
+	{
+		// Rather than wait on the GPU (or spin forever on a removed device, which never answers S_OK),
+		// leave everything in flight behind: the next upload discards, so the driver renames the buffer
+		if (context->GetData(fenceQueries[nextFence % RING_FRAMES_IN_FLIGHT].Get(), 0, 0, 0) != S_OK)
+		{
+			waits++;
+			allocator.Reset();
+			discardNext = true;
+		}
+		completedFence = nextFence - RING_FRAMES_IN_FLIGHT;
+	}
+
+	context->End(fenceQueries[nextFence % RING_FRAMES_IN_FLIGHT].Get());
+	allocator.EndFrame(nextFence);
+	nextFence++;
+
+	// Uploads from this frame will be reclaimed eventually, so nothing may keep using them
+	generation++;
+	PollFences();
+}
+
+ID3D11Buffer* ConstantBufferRing::GetBuffer()
+{
+	return buffer.Get();
+}
+
+unsigned int ConstantBufferRing::GetGeneration()
+{
+	return generation;
+}
+
+RingStats ConstantBufferRing::GetStats()
+{
+	RingStats stats = allocator.GetStats();
+	stats.stalls += waits;
+	stats.discards = discards;
+	return stats;
+}
+
+void ConstantBufferRing::ResetStats()
+{
+	allocator.ResetStats();
+	waits = 0;
+	discards = 0;
+}
+
+void ConstantBufferRing::PollFences()
+{
+	// Fences complete in order, so stop at the first one that hasn't
+	while (completedFence + 1 < nextFence)
+	{
+		uint64_t fence = completedFence + 1;
+		if (context->GetData(fenceQueries[fence % RING_FRAMES_IN_FLIGHT].Get(), 0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) break;
+		completedFence = fence;
+	}
+	allocator.Retire(completedFence);
+}
+#pragma endregion
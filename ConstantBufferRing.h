@@ -0,0 +1,150 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <deque>
+
+// How many frames the GPU may still be working on while the CPU records the next
+constexpr auto RING_FRAMES_IN_FLIGHT = 3;
+
+// Constant buffer offsets are in 16-byte constants and must be multiples of 16 of them
+constexpr auto RING_ALIGNMENT = 256;
+
+struct RingStats
+{
+	unsigned int							allocations;
+	size_t									allocatedBytes;
+	unsigned int							stalls;			// Allocations that found the ring full of in-flight data
+	unsigned int							wraps;			// Times the head went back to the start of the ring
+	unsigned int							discards;		// Times the whole ring was thrown away to make room
+	unsigned int							used;			// Bytes currently in flight
+	unsigned int							peakUsed;
+	unsigned int							capacity;
+};
+
+// --------------------------------------------------------
+// The bookkeeping half of a ring buffer, with nothing to do
+// with the GPU: hands out aligned offsets, tags each frame's
+// allocations with a fence value and frees them once that
+// fence is known to have completed.
+//
+// Allocate fails (and counts a stall) rather than hand out
+// space an unfinished frame may still be reading; the caller
+// decides whether to wait or throw the contents away.
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	RingAllocator(unsigned int _capacity, unsigned int _alignment);
+	~RingAllocator();
+
+											/// <summary>
+											/// Reserves space in the ring for the current frame
+											/// </summary>
+											/// <param name="_size">The number of bytes needed (rounded up to the alignment)</param>
+											/// <param name="_offset">Receives the offset of the space</param>
+											/// <returns>False if there isn't enough space that isn't still in flight</returns>
+	bool									Allocate(unsigned int _size, unsigned int& _offset);
+											/// <summary>
+											/// Closes the current frame, so everything allocated since the last call is freed once the fence completes
+											/// </summary>
+											/// <param name="_fence">The fence value signalled when the GPU finishes the frame (must increase every frame)</param>
+	void									EndFrame(uint64_t _fence);
+											/// <summary>
+											/// Frees the space of every closed frame whose fence is at or below the completed value
+											/// </summary>
+											/// <param name="_completedFence">The last fence value the GPU is known to have finished</param>
+											/// <returns>Whether any space was freed</returns>
+	bool									Retire(uint64_t _completedFence);
+											/// <summary>
+											/// Forgets every allocation (for when the memory behind the ring has been replaced)
+											/// </summary>
+	void									Reset();
+
+	unsigned int							GetUsed();
+	unsigned int							GetCapacity();
+	unsigned int							GetFramesInFlight();
+	RingStats								GetStats();
+	void									ResetStats();
+
+private:
+	struct Frame
+	{
+		uint64_t							fence;
+		unsigned int						end;
+		unsigned int						bytes;
+	};
+
+	unsigned int							capacity;
+	unsigned int							alignment;
+	unsigned int							head;
+	unsigned int							tail;
+	unsigned int							used;
+	unsigned int							frameBytes;
+	std::deque<Frame>						frames;
+
+	RingStats								stats;
+};
+
+// --------------------------------------------------------
+// A large dynamic constant buffer that per-draw constants
+// are sub-allocated from and bound by offset (D3D 11.1).
+//
+// Space is written with NO_OVERWRITE maps and reclaimed as
+// event queries report frames finished.  If the ring fills
+// up with frames still in flight, the buffer is mapped with
+// DISCARD instead, which lets the driver hand back fresh
+// memory rather than making the CPU wait.
+//
+// Anything uploaded before a discard or before the end of a
+// frame may be overwritten afterwards, so callers compare
+// GetGeneration() against the one they uploaded in.
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(
+		Microsoft::WRL::ComPtr<ID3D11Device>			_device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext>		_context,
+		unsigned int									_capacity);
+	~ConstantBufferRing();
+
+											/// <summary>
+											/// Whether the device can bind constant buffers by offset (otherwise the ring must not be used)
+											/// </summary>
+	bool									IsSupported();
+											/// <summary>
+											/// Copies constants into the ring
+											/// </summary>
+											/// <param name="_data">The constants to copy</param>
+											/// <param name="_size">The size of the constants in bytes</param>
+											/// <param name="_firstConstant">Receives the first 16-byte constant to bind from</param>
+											/// <param name="_numConstants">Receives the number of 16-byte constants to bind</param>
+											/// <returns>False if the data couldn't be uploaded</returns>
+	bool									Upload(const void* _data, unsigned int _size, UINT& _firstConstant, UINT& _numConstants);
+											/// <summary>
+											/// Fences off everything uploaded this frame and reclaims space from frames the GPU has finished
+											/// </summary>
+	void									EndFrame();
+
+	ID3D11Buffer*							GetBuffer();
+	unsigned int							GetGeneration();
+	RingStats								GetStats();
+	void									ResetStats();
+
+private:
+	void									PollFences();
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>	buffer;
+	Microsoft::WRL::ComPtr<ID3D11Query>		fenceQueries[RING_FRAMES_IN_FLIGHT];
+	RingAllocator							allocator;
+	bool									supported;
+	bool									discardNext;
+	unsigned int							generation;
+	uint64_t								nextFence;
+	uint64_t								completedFence;
+	unsigned int							waits;
+	unsigned int							discards;
+};
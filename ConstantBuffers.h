@@ -0,0 +1,42 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include "LightLOD.h"
+#include "Lights.h"
+#include "ShadowCascades.h"
+
+// Names of the frequency-split constant buffers (see ConstantBuffers.hlsli)
+constexpr auto CBUFFER_PERFRAME = "PerFrame";
+constexpr auto CBUFFER_PERMATERIAL = "PerMaterial";
+constexpr auto CBUFFER_PEROBJECT = "PerObject";
+constexpr auto CBUFFER_PEROBJECTLIGHTS = "PerObjectLights";
+
+// Per-frame shader data, uploaded once per frame and shared by every shader
+// - This should match the PerFrame cbuffer in ConstantBuffers.hlsli
+struct PerFrameData
+{
+	DirectX::XMFLOAT4X4	view;
+	DirectX::XMFLOAT4X4	projection;
+	DirectX::XMFLOAT3	cameraPosition;
+	float				cameraPadding;
+	DirectX::XMFLOAT3	ambient;
+	float				padding;
+	DirectX::XMFLOAT2	clusterTileScale;	// Clusters per pixel, across and down
+	float				clusterSliceScale;	// 0 while clustered lighting is off
+	float				clusterSliceBias;
+	DirectX::XMFLOAT4X4	shadowViewProjection[SHADOW_CASCADE_COUNT];
+	float				shadowSplits[SHADOW_CASCADE_COUNT];	// View depth each cascade ends at
+	float				shadowTexelSize;	// Shadow map texel size in UVs, or 0 while shadows are off
+	DirectX::XMFLOAT3	shadowPadding;
+};
+
+// Per-object light list, chosen each frame from the lights that reach the object,
+// with the lights that didn't make the list projected into SH irradiance
+// - This should match the PerObjectLights cbuffer in ConstantBuffers.hlsli
+struct ObjectLightData
+{
+	float				lightCount;
+	DirectX::XMFLOAT3	padding;
+	Light				lights[MAX_OBJECT_LIGHTS];
+	DirectX::XMFLOAT4	irradiance[SH_COEFFICIENTS];
+};
@@ -0,0 +1,55 @@
+#ifndef __SHADER_CONSTANT_BUFFERS__
+#define __SHADER_CONSTANT_BUFFERS__
+
+#include "Defines.hlsli"
+
+#define MAX_OBJECT_LIGHTS 8
+
+// Constant buffers are split by how often they change:
+// - b0: per-frame data, uploaded once per frame and shared by every shader
+// - b1: per-material data, declared by each pixel shader (uploaded only when the material changes)
+// - b2: per-object data, uploaded for every draw
+// - b3: per-object light list, uploaded for every draw whose lights differ from the last one
+
+// - This should match PerFrameData in ConstantBuffers.h
+cbuffer PerFrame : register(b0)
+{
+	matrix view;
+	matrix projection;
+
+	float3 cameraPosition;
+	float cameraPadding;
+
+	float3 ambient;
+	float framePadding;
+
+	// Clustered lighting (see Clusters.hlsli); a slice scale of 0 turns it off
+	float2 clusterTileScale;
+	float clusterSliceScale;
+	float clusterSliceBias;
+
+	// Cascaded shadow maps (see Shadows.hlsli); a texel size of 0 turns them off
+	matrix shadowViewProjection[SHADOW_CASCADE_COUNT];
+	float4 shadowSplits;
+	float shadowTexelSize;
+	float3 shadowPadding;
+}
+
+cbuffer PerObject : register(b2)
+{
+	matrix world;
+	matrix worldInvTranspose;
+}
+
+// The lights reaching the object being drawn, most important first, and the rest as SH irradiance
+// - This should match ObjectLightData in ConstantBuffers.h
+cbuffer PerObjectLights : register(b3)
+{
+	float lightCount;
+	float3 objectLightsPadding;
+
+	Light lights[MAX_OBJECT_LIGHTS];
+	float4 lightIrradiance[SH_COEFFICIENTS];
+}
+
+#endif
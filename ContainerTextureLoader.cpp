@@ -0,0 +1,140 @@
+#include "ContainerTextureLoader.h"
+#include "MappedFile.h"
+#include "PathEncoding.h"
+
+#include <vector>
+
+namespace
+{
+	bool MapContainer(const std::wstring& _path, MappedFile& _file, TextureContainerLayout& _layout)
+	{
+		return _file.Open(WidePathToUTF8(_path)) && TextureContainer::Parse(_file.GetData(), _file.GetSize(), _layout);
+	}
+}
+
+std::wstring ContainerTextureLoader::FindContainer(const std::wstring& _imagePath)
+{
+	size_t slash = _imagePath.find_last_of(L"/\\");
+	size_t dot = _imagePath.find_last_of(L'.');
+	std::wstring stem = dot != std::wstring::npos && (slash == std::wstring::npos || dot > slash) ? _imagePath.substr(0, dot) : _imagePath;
+
+	const wchar_t* extensions[] = { L".dds", L".ktx2" };
+	for (const wchar_t* extension : extensions)
+	{
+		std::wstring path = stem + extension;
+		DWORD attributes = GetFileAttributesW(path.c_str());
+		if (attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY)) return path;
+	}
+	return std::wstring();
+}
+
+bool ContainerTextureLoader::Load(ID3D11Device* _device, const std::wstring& _path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& _shaderResourceView, unsigned long long* _bytes)
+{
+	MappedFile file;
+	TextureContainerLayout layout;
+	if (!MapContainer(_path, file, layout)) return false;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(layout.subresources.size());
+	unsigned long long bytes = 0;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		const TextureSubresource& subresource = layout.subresources[i];
+		data[i].pSysMem = file.GetData() + subresource.offset;
+		data[i].SysMemPitch = subresource.rowPitch;
+		data[i].SysMemSlicePitch = subresource.slicePitch;
+		bytes += subresource.size;
+	}
+
+	if (!Create(_device, layout, data.data(), _shaderResourceView)) return false;
+	if (_bytes) *_bytes = bytes;
+	return true;
+}
+
+bool ContainerTextureLoader::LoadCubemap(ID3D11Device* _device, const std::wstring _facePaths[6], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& _shaderResourceView)
+{
+	MappedFile files[6];
+	TextureContainerLayout faces[6];
+	for (int i = 0; i < 6; i++)
+	{
+		std::wstring path = FindContainer(_facePaths[i]);
+		if (path.empty() || !MapContainer(path, files[i], faces[i])) return false;
+		if (faces[i].arraySize != 1) return false;
+		if (i > 0 && (faces[i].format != faces[0].format || faces[i].width != faces[0].width || faces[i].height != faces[0].height || faces[i].mipCount != faces[0].mipCount)) return false;
+	}
+
+	// Each face's mips become one slice of the cube, still read from its own file
+	TextureContainerLayout cube = faces[0];
+	cube.arraySize = 6;
+	cube.cubemap = true;
+	if (cube.width != cube.height) return false;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data((size_t)6 * cube.mipCount);
+	for (int face = 0; face < 6; face++)
+	{
+		for (unsigned int mip = 0; mip < cube.mipCount; mip++)
+		{
+			const TextureSubresource& subresource = faces[face].subresources[mip];
+			D3D11_SUBRESOURCE_DATA& subresourceData = data[(size_t)face * cube.mipCount + mip];
+			subresourceData.pSysMem = files[face].GetData() + subresource.offset;
+			subresourceData.SysMemPitch = subresource.rowPitch;
+			subresourceData.SysMemSlicePitch = subresource.slicePitch;
+		}
+	}
+	return Create(_device, cube, data.data(), _shaderResourceView);
+}
+
+bool ContainerTextureLoader::Create(ID3D11Device* _device, const TextureContainerLayout& _layout, const D3D11_SUBRESOURCE_DATA* _data, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& _shaderResourceView)
+{
+	// Block compressed textures have to start at a multiple of the block size
+	unsigned int bytes;
+	bool compressed;
+	TextureContainer::GetFormatInfo(_layout.format, bytes, compressed);
+	if (compressed && (_layout.width % 4 != 0 || _layout.height % 4 != 0)) return false;
+
+	DXGI_FORMAT format = (DXGI_FORMAT)_layout.format;
+	UINT support = 0;
+	UINT needed = _layout.cubemap ? D3D11_FORMAT_SUPPORT_TEXTURECUBE : D3D11_FORMAT_SUPPORT_TEXTURE2D;
+	if (FAILED(_device->CheckFormatSupport(format, &support)) || !(support & needed)) return false;
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = _layout.width;
+	textureDesc.Height = _layout.height;
+	textureDesc.MipLevels = _layout.mipCount;
+	textureDesc.ArraySize = _layout.arraySize;
+	textureDesc.Format = format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.MiscFlags = _layout.cubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(_device->CreateTexture2D(&textureDesc, _data, texture.GetAddressOf()))) return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = format;
+	if (_layout.cubemap && _layout.arraySize == 6)
+	{
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		viewDesc.TextureCube.MipLevels = _layout.mipCount;
+	}
+	else if (_layout.arraySize > 1)
+	{
+		viewDesc.ViewDimension = _layout.cubemap ? D3D11_SRV_DIMENSION_TEXTURECUBEARRAY : D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		if (_layout.cubemap)
+		{
+			viewDesc.TextureCubeArray.MipLevels = _layout.mipCount;
+			viewDesc.TextureCubeArray.NumCubes = _layout.arraySize / 6;
+		}
+		else
+		{
+			viewDesc.Texture2DArray.MipLevels = _layout.mipCount;
+			viewDesc.Texture2DArray.ArraySize = _layout.arraySize;
+		}
+	}
+	else
+	{
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		viewDesc.Texture2D.MipLevels = _layout.mipCount;
+	}
+	return SUCCEEDED(_device->CreateShaderResourceView(texture.Get(), &viewDesc, _shaderResourceView.ReleaseAndGetAddressOf()));
+}
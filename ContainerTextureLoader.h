@@ -0,0 +1,49 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include "TextureContainer.h"
+
+// --------------------------------------------------------
+// Makes textures straight from pre-built .dds/.ktx2 files
+// (block compressed, with their mips), with no decoding
+//
+// The file is memory mapped and its headers read with
+// TextureContainer; each subresource's D3D11_SUBRESOURCE_DATA
+// then points into the mapping, so CreateTexture2D reads the
+// texels from the file's pages and nothing is copied on the
+// way. Containers sit next to the images they replace, with
+// the same name: FindContainer looks for one, and callers fall
+// back to the image when it's missing or can't be loaded.
+// --------------------------------------------------------
+class ContainerTextureLoader
+{
+public:
+											/// <summary>
+											/// Finds a container next to an image: the same path with .dds, then .ktx2, in place of its extension
+											/// </summary>
+											/// <param name="_imagePath">The full path of the image</param>
+											/// <returns>The container's path, or an empty string if there isn't one</returns>
+	static std::wstring						FindContainer(const std::wstring& _imagePath);
+											/// <summary>
+											/// Makes a texture (or texture array, or cube map) from a container
+											/// </summary>
+											/// <param name="_device">The device to make it on</param>
+											/// <param name="_path">The full path of the container</param>
+											/// <param name="_shaderResourceView">Receives a view of the whole texture</param>
+											/// <param name="_bytes">Receives the texture's size in video memory, if not null</param>
+											/// <returns>Whether the file was valid and the device took its format</returns>
+	static bool								Load(ID3D11Device* _device, const std::wstring& _path, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& _shaderResourceView, unsigned long long* _bytes = 0);
+											/// <summary>
+											/// Makes a cube map from six containers, one per face, in +X, -X, +Y, -Y, +Z, -Z order
+											/// </summary>
+											/// <returns>Whether all six were found, valid and alike (format, size and mips)</returns>
+	static bool								LoadCubemap(ID3D11Device* _device, const std::wstring _facePaths[6], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& _shaderResourceView);
+
+private:
+											/// <summary>
+											/// Makes the texture and its view from subresources already in memory
+											/// </summary>
+	static bool								Create(ID3D11Device* _device, const TextureContainerLayout& _layout, const D3D11_SUBRESOURCE_DATA* _data, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& _shaderResourceView);
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+
+// The "DDS " every file starts with
+constexpr auto DDS_MAGIC = 0x20534444u;
+
+// The pixel format's fourCC when a DdsHeaderDX10 follows the header
+constexpr auto DDS_FOURCC_DX10 = 0x30315844u;
+
+// DdsHeader::flags
+constexpr auto DDSD_CAPS = 0x1u;
+constexpr auto DDSD_HEIGHT = 0x2u;
+constexpr auto DDSD_WIDTH = 0x4u;
+constexpr auto DDSD_PIXELFORMAT = 0x1000u;
+constexpr auto DDSD_MIPMAPCOUNT = 0x20000u;
+constexpr auto DDSD_LINEARSIZE = 0x80000u;
+constexpr auto DDSD_DEPTH = 0x800000u;
+
+// DdsPixelFormat::flags
+constexpr auto DDPF_FOURCC = 0x4u;
+constexpr auto DDPF_RGB = 0x40u;
+
+// DdsHeader::caps
+constexpr auto DDSCAPS_COMPLEX = 0x8u;
+constexpr auto DDSCAPS_TEXTURE = 0x1000u;
+constexpr auto DDSCAPS_MIPMAP = 0x400000u;
+
+// DdsHeader::caps2
+constexpr auto DDSCAPS2_CUBEMAP = 0x200u;
+constexpr auto DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00u;
+constexpr auto DDSCAPS2_VOLUME = 0x200000u;
+
+// DdsHeaderDX10::resourceDimension
+constexpr auto DDS_DIMENSION_TEXTURE2D = 3u;
+
+// DdsHeaderDX10::miscFlag
+constexpr auto DDS_RESOURCE_MISC_TEXTURECUBE = 0x4u;
+
+// DXGI_FORMAT values, so files can be written without the D3D headers
+constexpr auto DDS_DXGI_FORMAT_R32G32B32A32_FLOAT = 2u;
+constexpr auto DDS_DXGI_FORMAT_R16G16B16A16_FLOAT = 10u;
+constexpr auto DDS_DXGI_FORMAT_R8G8B8A8_UNORM = 28u;
+constexpr auto DDS_DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29u;
+constexpr auto DDS_DXGI_FORMAT_R8G8_UNORM = 49u;
+constexpr auto DDS_DXGI_FORMAT_R8_UNORM = 61u;
+constexpr auto DDS_DXGI_FORMAT_BC1_UNORM = 71u;
+constexpr auto DDS_DXGI_FORMAT_BC1_UNORM_SRGB = 72u;
+constexpr auto DDS_DXGI_FORMAT_BC2_UNORM = 74u;
+constexpr auto DDS_DXGI_FORMAT_BC2_UNORM_SRGB = 75u;
+constexpr auto DDS_DXGI_FORMAT_BC3_UNORM = 77u;
+constexpr auto DDS_DXGI_FORMAT_BC3_UNORM_SRGB = 78u;
+constexpr auto DDS_DXGI_FORMAT_BC4_UNORM = 80u;
+constexpr auto DDS_DXGI_FORMAT_BC4_SNORM = 81u;
+constexpr auto DDS_DXGI_FORMAT_BC5_UNORM = 83u;
+constexpr auto DDS_DXGI_FORMAT_BC5_SNORM = 84u;
+constexpr auto DDS_DXGI_FORMAT_B8G8R8A8_UNORM = 87u;
+constexpr auto DDS_DXGI_FORMAT_B8G8R8A8_UNORM_SRGB = 91u;
+constexpr auto DDS_DXGI_FORMAT_BC6H_UF16 = 95u;
+constexpr auto DDS_DXGI_FORMAT_BC6H_SF16 = 96u;
+constexpr auto DDS_DXGI_FORMAT_BC7_UNORM = 98u;
+constexpr auto DDS_DXGI_FORMAT_BC7_UNORM_SRGB = 99u;
+
+// The layout of a .dds file, little endian:
+//   u32 DDS_MAGIC, DdsHeader, DdsHeaderDX10 (when the fourCC is DDS_FOURCC_DX10),
+//   then each array slice's mips from largest to smallest
+struct DdsPixelFormat
+{
+	uint32_t								size;				// 32
+	uint32_t								flags;
+	uint32_t								fourCC;
+	uint32_t								rgbBitCount;
+	uint32_t								rBitMask;
+	uint32_t								gBitMask;
+	uint32_t								bBitMask;
+	uint32_t								aBitMask;
+};
+
+struct DdsHeader
+{
+	uint32_t								size;				// 124
+	uint32_t								flags;
+	uint32_t								height;
+	uint32_t								width;
+	uint32_t								pitchOrLinearSize;	// Bytes in the top mip, for compressed formats
+	uint32_t								depth;
+	uint32_t								mipMapCount;
+	uint32_t								reserved1[11];
+	DdsPixelFormat							pixelFormat;
+	uint32_t								caps;
+	uint32_t								caps2;
+	uint32_t								caps3;
+	uint32_t								caps4;
+	uint32_t								reserved2;
+};
+
+struct DdsHeaderDX10
+{
+	uint32_t								dxgiFormat;
+	uint32_t								resourceDimension;
+	uint32_t								miscFlag;
+	uint32_t								arraySize;
+	uint32_t								miscFlags2;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+
+struct DedupStats
+{
+	unsigned int							live;			// Objects the cache holds
+	unsigned int							inUse;			// Of those, objects something besides the cache also holds
+	unsigned int							requests;
+	unsigned int							created;		// Requests that had to create a new object
+};
+
+// --------------------------------------------------------
+// Hands out one shared object per key, creating it the
+// first time the key is asked for.
+//
+// The cache keeps its own reference, so objects outlive
+// their users until Trim() drops the ones nobody else holds.
+// Nothing here knows about D3D: values just need to be
+// copyable, and the in-use test is passed to GetStats/Trim.
+// --------------------------------------------------------
+template <typename TKey, typename TValue>
+class DedupCache
+{
+public:
+	DedupCache()
+	{
+		requests = 0;
+		created = 0;
+	}
+
+											/// <summary>
+											/// Gets the object for a key, creating it if the cache doesn't have one
+											/// </summary>
+											/// <param name="_key">The key identifying the object</param>
+											/// <param name="_create">Makes the object (only called on a miss; empty results aren't cached)</param>
+	TValue									Get(const TKey& _key, std::function<TValue()> _create)
+	{
+		requests++;
+		auto found = entries.find(_key);
+		if (found != entries.end())
+			return found->second;
+
+		TValue value = _create();
+		if (!value)
+			return value;
+
+		created++;
+		entries[_key] = value;
+		return value;
+	}
+
+											/// <summary>
+											/// Releases the cache's reference to every object nothing else holds
+											/// </summary>
+											/// <param name="_inUse">Whether something besides the cache holds an object</param>
+											/// <returns>The number of objects dropped</returns>
+	unsigned int							Trim(std::function<bool(const TValue&)> _inUse)
+	{
+		unsigned int dropped = 0;
+		for (auto entry = entries.begin(); entry != entries.end();)
+		{
+			if (_inUse(entry->second))
+			{
+				++entry;
+				continue;
+			}
+
+			entry = entries.erase(entry);
+			dropped++;
+		}
+		return dropped;
+	}
+
+	void									Clear()
+	{
+		entries.clear();
+	}
+
+	DedupStats								GetStats(std::function<bool(const TValue&)> _inUse)
+	{
+		DedupStats stats = {};
+		stats.live = (unsigned int)entries.size();
+		stats.requests = requests;
+		stats.created = created;
+		for (auto& entry : entries)
+		{
+			if (_inUse(entry.second)) stats.inUse++;
+		}
+		return stats;
+	}
+
+private:
+	std::unordered_map<TKey, TValue>		entries;
+	unsigned int							requests;
+	unsigned int							created;
+};
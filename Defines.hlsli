@@ -2,6 +2,31 @@
 #define __SHADER_DEFINES__
 
 #define MAX_SPECULAR_EXPONENT 256.0f
+#define SH_COEFFICIENTS 9
+#define SHADOW_CASCADE_COUNT 4
+
+#define LIGHT_TYPE_DIRECTIONAL	0
+#define LIGHT_TYPE_POINT		1
+#define LIGHT_TYPE_SPOT			2
+
+// Struct representing light data
+// - This should match Lights.h
+struct Light
+{
+	int		Type;
+	float3	Direction;
+
+	float	Range;
+	float3	Position;
+
+	float	Intensity;
+	float3	Color;
+
+	float	SpotFalloff;
+	float	Shadowed;
+	float	ShadowIndex;
+	float	Padding;
+};
 
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
@@ -6,9 +6,9 @@ Entity::Entity(std::shared_ptr<Material> _material, std::shared_ptr<Mesh> _mesh)
 	mesh = _mesh;
 }
 
-void Entity::Draw(std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _ambient, std::vector<Light> _lights)
+void Entity::Draw(const ObjectLightData& _lights)
 {
-	material->Activate(&transform, _camera, _ambient, _lights);
+	material->Activate(&transform, _lights);
 	mesh->Draw();
 }
 
@@ -27,6 +27,15 @@ std::shared_ptr<Material> Entity::GetMaterial()
 	return material;
 }
 
+DirectX::BoundingSphere Entity::GetBounds()
+{
+	// Transform the mesh's local bounds into world space
+	DirectX::BoundingSphere worldBounds;
+	DirectX::XMFLOAT4X4 world = transform.GetWorldMatrix();
+	mesh->GetBounds().Transform(worldBounds, DirectX::XMLoadFloat4x4(&world));
+	return worldBounds;
+}
+
 void Entity::SetMaterial(std::shared_ptr<Material> _material)
 {
 	material = _material;
@@ -4,6 +4,7 @@
 #include "Transform.h"
 #include "Material.h"
 #include <memory>
+#include <DirectXCollision.h>
 
 class Entity
 {
@@ -12,11 +13,12 @@ public:
 		std::shared_ptr<Material>	_material,
 		std::shared_ptr<Mesh>		_mesh);
 
-	void							Draw(std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _ambient, std::vector<Light> _lights);
+	void							Draw(const ObjectLightData& _lights);
 
 	Transform*						GetTransform();
 	std::shared_ptr<Mesh>			GetMesh();
 	std::shared_ptr<Material>		GetMaterial();
+	DirectX::BoundingSphere			GetBounds();
 
 	void							SetMaterial(std::shared_ptr<Material>	_material);
 
@@ -1,18 +1,29 @@
 #include "Game.h"
 #include "Vertex.h"
 #include "Input.h"
+#include "StateCache.h"
 #include "SimpleShader.h"
 #include <algorithm>
+#include <cfloat>
 
 // Needed for a helper function to read compiled shader files from the hard drive
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 #include <iostream>
+#include <random>
+#include <thread>
 #include "WICTextureLoader.h"
+#include "ContainerTextureLoader.h"
+#include "PathEncoding.h"
+#include "MipGenerator.h"
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// Point lights scattered through the scene by the light stress mode (toggled with L)
+constexpr auto LIGHT_STRESS_COUNT = 1000;
+constexpr auto LIGHT_STRESS_SEED = 1234;
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -36,6 +47,12 @@ Game::Game(HINSTANCE hInstance)
 	printf("Console window created successfully.  Feel free to printf() here.\n");
 #endif
 	camera = std::make_shared<Camera>(0.0f, 5.0f, -15.0f, (float)width / height, 60, 0.01f, 1000.0f, 5.0f);
+	updateScheduler = std::make_shared<UpdateScheduler>(4096, 4096);
+	perFrameData = {};
+	constantBufferBytesLastFrame = 0;
+	sceneLightCount = 0;
+	lightStressMode = false;
+	pointShadowDemo = false;
 }
 
 // --------------------------------------------------------
@@ -49,6 +66,8 @@ Game::~Game()
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object created in Game
+	// - The pipeline cache outlives Game, so its references are dropped here
+	PipelineCache::GetInstance().Clear();
 }
 
 // --------------------------------------------------------
@@ -57,6 +76,20 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// All pipeline binds go through the state cache so redundant ones get dropped
+	// (it takes the 11.1 context too so it can bind constant buffer ranges, which the ring needs)
+	HRESULT hr = context.As(&context1);
+	StateCache::GetInstance().Initialize(context.Get(), SUCCEEDED(hr) ? context1.Get() : 0);
+	PipelineCache::GetInstance().Initialize(device, context);
+	renderQueue = std::make_shared<RenderQueue>();
+	useCoherentSort = true;
+	sortTransparentTriangles = false;
+	lightClusters = std::make_shared<LightClusters>(device, context);
+	useClusteredLighting = false;
+	useLightLOD = true;
+	useShadows = true;
+	textureBudget = TEXTURE_STREAMING_BUDGET;
+
 	LoadShadersAndMaterials();
 	LoadTextures();
 	LoadMeshes();
@@ -65,7 +98,7 @@ void Game::Init()
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	StateCache::GetInstance().IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
 // --------------------------------------------------------
@@ -73,11 +106,32 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShadersAndMaterials()
 {
-	vertexShader = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShader.cso").c_str());
-	pixelShader = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"SimplePixelShader.cso").c_str());
-	vertexShaderPBR = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"SimpleVertexPBR.cso").c_str());
-	pixelShaderPBR = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"SimplePixelPBR.cso").c_str());
-	pixelShaderToon = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"ToonShader.cso").c_str());
+	PipelineCache& pipelineCache = PipelineCache::GetInstance();
+	vertexShader = pipelineCache.GetVertexShader(GetFullPathTo_Wide(L"VertexShader.cso"));
+	pixelShader = pipelineCache.GetPixelShader(GetFullPathTo_Wide(L"SimplePixelShader.cso"));
+	vertexShaderPBR = pipelineCache.GetVertexShader(GetFullPathTo_Wide(L"SimpleVertexPBR.cso"));
+	pixelShaderPBR = pipelineCache.GetPixelShader(GetFullPathTo_Wide(L"SimplePixelPBR.cso"));
+	pixelShaderToon = pipelineCache.GetPixelShader(GetFullPathTo_Wide(L"ToonShader.cso"));
+	shadowMaps = std::make_shared<ShadowMaps>(device, context, pipelineCache.GetVertexShader(GetFullPathTo_Wide(L"ShadowVertexShader.cso")));
+	pointShadowMaps = std::make_shared<PointShadowMaps>(device, context, pipelineCache.GetVertexShader(GetFullPathTo_Wide(L"ShadowVertexShader.cso")));
+
+	// Per-frame data lives in one buffer shared by every shader, uploaded once per frame in Draw
+	D3D11_BUFFER_DESC perFrameDesc = {};
+	perFrameDesc.Usage = D3D11_USAGE_DEFAULT;
+	perFrameDesc.ByteWidth = sizeof(PerFrameData);
+	perFrameDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	device->CreateBuffer(&perFrameDesc, 0, perFrameBuffer.GetAddressOf());
+
+	vertexShader->SetBufferExternal(CBUFFER_PERFRAME);
+	pixelShader->SetBufferExternal(CBUFFER_PERFRAME);
+	vertexShaderPBR->SetBufferExternal(CBUFFER_PERFRAME);
+	pixelShaderPBR->SetBufferExternal(CBUFFER_PERFRAME);
+	pixelShaderToon->SetBufferExternal(CBUFFER_PERFRAME);
+
+	// Per-object data changes every draw, so it can be sub-allocated from a ring where the device allows it
+	constantBufferRing = std::make_shared<ConstantBufferRing>(device, context, 4 * 1024 * 1024);
+	useConstantBufferRing = false;
+	SetConstantBufferRing(true);
 
 	XMFLOAT3 white = XMFLOAT3(1.0f, 1.0f, 1.0f);
 	XMFLOAT3 deepPurple = XMFLOAT3(0.1f, 0.02f, 0.1f);
@@ -106,6 +160,9 @@ void Game::LoadShadersAndMaterials()
 void Game::LoadTextures()
 {
 	#pragma region Sampler Initialization
+	// States come from the pipeline cache, so identical descriptions share one object
+	PipelineCache& pipelineCache = PipelineCache::GetInstance();
+
 	// Sampler description for wrapped texture sampling
 	D3D11_SAMPLER_DESC sampDesc = {};
 	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
@@ -114,7 +171,7 @@ void Game::LoadTextures()
 	sampDesc.Filter = D3D11_FILTER_ANISOTROPIC;
 	sampDesc.MaxAnisotropy = 16;
 	sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	device->CreateSamplerState(&sampDesc, sampler.GetAddressOf());
+	sampler = pipelineCache.GetSamplerState(sampDesc);
 
 	// Blend description for alpha support
 	D3D11_BLEND_DESC blendDesc = {};
@@ -126,20 +183,24 @@ void Game::LoadTextures()
 	blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
 	blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_SRC_ALPHA;
 	blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
-	device->CreateBlendState(&blendDesc, alphaBlendState.GetAddressOf());
+	alphaBlendState = pipelineCache.GetBlendState(blendDesc);
 
 	// Rasterizer description for alpha support/rendering backfaces only
 	D3D11_RASTERIZER_DESC rastDesc = {};
 	rastDesc.DepthClipEnable = true;
 	rastDesc.CullMode = D3D11_CULL_FRONT;
 	rastDesc.FillMode = D3D11_FILL_SOLID;
-	device->CreateRasterizerState(&rastDesc, backfaceRasterState.GetAddressOf());
+	backfaceRasterState = pipelineCache.GetRasterizerState(rastDesc);
+
+	// Both faces at once, for transparent meshes drawn with their triangles sorted
+	rastDesc.CullMode = D3D11_CULL_NONE;
+	noCullRasterState = pipelineCache.GetRasterizerState(rastDesc);
 
 	// Sampler description for clamping
 	sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
 	sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
 	sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-	device->CreateSamplerState(&sampDesc, clampSampler.GetAddressOf());
+	clampSampler = pipelineCache.GetSamplerState(sampDesc);
 	#pragma endregion
 
 	#pragma region Cubemap Setup
@@ -167,64 +228,59 @@ void Game::LoadTextures()
 	#pragma endregion
 
 	#pragma region Material Setup
+	// Textures decode on worker threads; until each one arrives its materials draw with a placeholder
+	textureStreamer = std::make_shared<TextureStreamer>(device, context, textureBudget);
+
 	materials[0]->PushSampler("BasicSampler", sampler);
 	materials[0]->PushTexture(TEXTYPE_REFLECTION, demoCubemap1);
-	materials[0]->hasReflectionMap = true;
-	materials[0]->LoadTexture(L"Assets/Textures/PBR/bronze_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[0]->LoadTexture(L"Assets/Textures/PBR/bronze_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[0]->LoadTexture(L"Assets/Textures/PBR/bronze_roughness.png", TEXTYPE_SPECULAR, device.Get(), context.Get());
+	textureStreamer->Load(materials[0], L"Assets/Textures/PBR/bronze_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[0], L"Assets/Textures/PBR/bronze_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->Load(materials[0], L"Assets/Textures/PBR/bronze_roughness.png", TEXTYPE_SPECULAR);
 	materials[0]->SetNormalIntensity(2.5f);
 	materials[0]->SetTint(DirectX::XMFLOAT3(0.25f, 0.25f, 0.85f));
 
 	materials[1]->PushSampler("BasicSampler", sampler);
-	materials[1]->LoadTexture(L"Assets/Textures/PBR/bronze_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[1]->LoadTexture(L"Assets/Textures/PBR/bronze_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[1]->LoadTexture(L"Assets/Textures/PBR/bronze_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[1]->LoadTexture(L"Assets/Textures/PBR/bronze_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[1], L"Assets/Textures/PBR/bronze_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[1], L"Assets/Textures/PBR/bronze_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[1], 0, L"Assets/Textures/PBR/bronze_roughness.png", L"Assets/Textures/PBR/bronze_metal.png");
 	materials[1]->SetNormalIntensity(2.5f);
 
 	materials[2]->PushSampler("BasicSampler", sampler);
-	materials[2]->LoadTexture(L"Assets/Textures/PBR/cobblestone_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[2]->LoadTexture(L"Assets/Textures/PBR/cobblestone_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[2]->LoadTexture(L"Assets/Textures/PBR/cobblestone_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[2]->LoadTexture(L"Assets/Textures/PBR/cobblestone_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[2], L"Assets/Textures/PBR/cobblestone_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[2], L"Assets/Textures/PBR/cobblestone_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[2], 0, L"Assets/Textures/PBR/cobblestone_roughness.png", L"Assets/Textures/PBR/cobblestone_metal.png");
 
 	materials[3]->PushSampler("BasicSampler", sampler);
-	materials[3]->LoadTexture(L"Assets/Textures/PBR/floor_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[3]->LoadTexture(L"Assets/Textures/PBR/floor_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[3]->LoadTexture(L"Assets/Textures/PBR/floor_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[3]->LoadTexture(L"Assets/Textures/PBR/floor_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[3], L"Assets/Textures/PBR/floor_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[3], L"Assets/Textures/PBR/floor_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[3], 0, L"Assets/Textures/PBR/floor_roughness.png", L"Assets/Textures/PBR/floor_metal.png");
 
 	materials[4]->PushSampler("BasicSampler", sampler);
-	materials[4]->LoadTexture(L"Assets/Textures/PBR/paint_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[4]->LoadTexture(L"Assets/Textures/PBR/paint_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[4]->LoadTexture(L"Assets/Textures/PBR/paint_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[4]->LoadTexture(L"Assets/Textures/PBR/paint_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[4], L"Assets/Textures/PBR/paint_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[4], L"Assets/Textures/PBR/paint_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[4], 0, L"Assets/Textures/PBR/paint_roughness.png", L"Assets/Textures/PBR/paint_metal.png");
 	materials[4]->SetNormalIntensity(0.5f);
 
 	materials[5]->PushSampler("BasicSampler", sampler);
-	materials[5]->LoadTexture(L"Assets/Textures/PBR/rough_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[5]->LoadTexture(L"Assets/Textures/PBR/rough_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[5]->LoadTexture(L"Assets/Textures/PBR/rough_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[5]->LoadTexture(L"Assets/Textures/PBR/rough_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[5], L"Assets/Textures/PBR/rough_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[5], L"Assets/Textures/PBR/rough_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[5], 0, L"Assets/Textures/PBR/rough_roughness.png", L"Assets/Textures/PBR/rough_metal.png");
 	materials[5]->SetNormalIntensity(3.5f);
 
 	materials[6]->PushSampler("BasicSampler", sampler);
-	materials[6]->LoadTexture(L"Assets/Textures/PBR/scratched_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[6]->LoadTexture(L"Assets/Textures/PBR/scratched_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[6]->LoadTexture(L"Assets/Textures/PBR/scratched_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[6]->LoadTexture(L"Assets/Textures/PBR/scratched_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[6], L"Assets/Textures/PBR/scratched_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[6], L"Assets/Textures/PBR/scratched_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[6], 0, L"Assets/Textures/PBR/scratched_roughness.png", L"Assets/Textures/PBR/scratched_metal.png");
 
 	materials[7]->PushSampler("BasicSampler", sampler);
-	materials[7]->LoadTexture(L"Assets/Textures/PBR/wood_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[7]->LoadTexture(L"Assets/Textures/PBR/wood_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[7]->LoadTexture(L"Assets/Textures/PBR/wood_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[7]->LoadTexture(L"Assets/Textures/PBR/wood_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[7], L"Assets/Textures/PBR/wood_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[7], L"Assets/Textures/PBR/wood_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[7], 0, L"Assets/Textures/PBR/wood_roughness.png", L"Assets/Textures/PBR/wood_metal.png");
 	materials[7]->SetNormalIntensity(3.5f);
 
 	materials[8]->PushSampler("BasicSampler", sampler);
-	materials[8]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-floor_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[8]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-floor_specular.png", TEXTYPE_SPECULAR, device.Get(), context.Get());
+	textureStreamer->Load(materials[8], L"Assets/Textures/HQGame/structure-endgame-floor_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[8], L"Assets/Textures/HQGame/structure-endgame-floor_specular.png", TEXTYPE_SPECULAR);
 	// this texture has some weird noise artifacts in the holes of the floor that I probably just never noticed
 	// when I used it in the game I made it for because it was also had Cutoff in Unity. add high cutoff, but not too high for distant mipmaps
 	materials[8]->SetCutoff(0.9f);
@@ -234,38 +290,86 @@ void Game::LoadTextures()
 	materials[9]->PushSampler("BasicSampler", sampler);
 	materials[9]->PushSampler("ClampSampler", clampSampler);
 	materials[9]->SetRoughness(1);
-	materials[9]->LoadTexture(L"Assets/Textures/WithNormals/cushion.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[9]->LoadTexture(L"Assets/Textures/WithNormals/cushion_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[9]->LoadTexture(L"Assets/Textures/WithNormals/cushion_specular.png", TEXTYPE_SPECULAR, device.Get(), context.Get());
+	textureStreamer->Load(materials[9], L"Assets/Textures/WithNormals/cushion.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[9], L"Assets/Textures/WithNormals/cushion_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->Load(materials[9], L"Assets/Textures/WithNormals/cushion_specular.png", TEXTYPE_SPECULAR);
 	materials[9]->SetOutlineThickness(0);
 
 	materials[10]->PushSampler("BasicSampler", sampler);
 	materials[10]->PushSampler("ClampSampler", clampSampler);
-	materials[10]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-deepfloor_emissive.png", TEXTYPE_EMISSIVE, device.Get(), context.Get());
-	materials[10]->LoadTexture(L"Assets/Textures/Ramps/toonRamp3.png", TEXTYPE_RAMPDIFFUSE, device.Get(), context.Get());
-	materials[10]->LoadTexture(L"Assets/Textures/Ramps/toonRampSpecular.png", TEXTYPE_RAMPSPECULAR, device.Get(), context.Get());
+	textureStreamer->Load(materials[10], L"Assets/Textures/HQGame/structure-endgame-deepfloor_emissive.png", TEXTYPE_EMISSIVE);
+	textureStreamer->Load(materials[10], L"Assets/Textures/Ramps/toonRamp3.png", TEXTYPE_RAMPDIFFUSE);
+	textureStreamer->Load(materials[10], L"Assets/Textures/Ramps/toonRampSpecular.png", TEXTYPE_RAMPSPECULAR);
 	materials[10]->SetRimCutoff(0.15f);
 	materials[10]->SetEmitAmount(XMFLOAT3(0.05f, 0.1f, 0.01f));
 
 	materials[11]->PushSampler("BasicSampler", sampler);
-	materials[11]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-deepfloor_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[11]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-deepfloor_specular.png", TEXTYPE_SPECULAR, device.Get(), context.Get());
-	materials[11]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-deepfloor_emissive.png", TEXTYPE_EMISSIVE, device.Get(), context.Get());
+	textureStreamer->Load(materials[11], L"Assets/Textures/HQGame/structure-endgame-deepfloor_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[11], L"Assets/Textures/HQGame/structure-endgame-deepfloor_specular.png", TEXTYPE_SPECULAR);
+	textureStreamer->Load(materials[11], L"Assets/Textures/HQGame/structure-endgame-deepfloor_emissive.png", TEXTYPE_EMISSIVE);
 	materials[11]->SetEmitAmount(XMFLOAT3(0.05f, 0.1f, 0.01f));
 
 	materials[12]->PushSampler("BasicSampler", sampler);
-	materials[12]->LoadTexture(L"Assets/Textures/Transparent/fence_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[12]->LoadTexture(L"Assets/Textures/Transparent/fence_normals.png", TEXTYPE_NORMAL, device.Get(), context.Get());
-	materials[12]->LoadTexture(L"Assets/Textures/Transparent/fence_roughness.png", TEXTYPE_ROUGHNESS, device.Get(), context.Get());
-	materials[12]->LoadTexture(L"Assets/Textures/Transparent/fence_metal.png", TEXTYPE_METALNESS, device.Get(), context.Get());
+	textureStreamer->Load(materials[12], L"Assets/Textures/Transparent/fence_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[12], L"Assets/Textures/Transparent/fence_normals.png", TEXTYPE_NORMAL);
+	textureStreamer->LoadORM(materials[12], 0, L"Assets/Textures/Transparent/fence_roughness.png", L"Assets/Textures/Transparent/fence_metal.png");
 	materials[12]->SetCutoff(0.95f);
 
 	materials[13]->PushSampler("BasicSampler", sampler);
-	materials[13]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-floor_albedo.png", TEXTYPE_ALBEDO, device.Get(), context.Get());
-	materials[13]->LoadTexture(L"Assets/Textures/HQGame/structure-endgame-floor_specular.png", TEXTYPE_SPECULAR, device.Get(), context.Get());
+	textureStreamer->Load(materials[13], L"Assets/Textures/HQGame/structure-endgame-floor_albedo.png", TEXTYPE_ALBEDO);
+	textureStreamer->Load(materials[13], L"Assets/Textures/HQGame/structure-endgame-floor_specular.png", TEXTYPE_SPECULAR);
 	materials[13]->SetAlpha(0.85f);
 	materials[13]->SetCutoff(0.95f);
 	#pragma endregion
+
+	#pragma region Shader Permutations
+	// Standard, toon and PBR materials swap to variants with their texture branches compiled in or out
+	permutationCache = std::make_shared<PermutationCache>(
+		[this](const std::wstring& _source, const ShaderDefines& _defines)
+		{
+			return CompilePixelPermutation(device, context, _source, _defines);
+		});
+	unsigned int standardSource = permutationCache->RegisterSource(L"SimplePixelShader.hlsl",
+		PERMUTATION_ALBEDO | PERMUTATION_NORMAL | PERMUTATION_SPECULAR | PERMUTATION_EMISSIVE | PERMUTATION_REFLECTION);
+	unsigned int toonSource = permutationCache->RegisterSource(L"ToonShader.hlsl",
+		PERMUTATION_ALBEDO | PERMUTATION_NORMAL | PERMUTATION_SPECULAR | PERMUTATION_EMISSIVE | PERMUTATION_RAMPDIFFUSE | PERMUTATION_RAMPSPECULAR);
+	unsigned int pbrSource = permutationCache->RegisterSource(L"SimplePixelPBR.hlsl", PERMUTATION_ORM);
+
+	for (auto& material : materials)
+	{
+		if (material->GetPixelShader() == pixelShader) material->UsePermutations(permutationCache, standardSource);
+		else if (material->GetPixelShader() == pixelShaderToon) material->UsePermutations(permutationCache, toonSource);
+		else if (material->GetPixelShader() == pixelShaderPBR) material->UsePermutations(permutationCache, pbrSource);
+	}
+	#pragma endregion
+}
+
+// --------------------------------------------------------
+// Loads a mesh, or shares the one already made from the same
+// file (however the path is written) or the same contents
+// --------------------------------------------------------
+std::shared_ptr<Mesh> Game::LoadMesh(const char* _path)
+{
+	bool created;
+	unsigned int handle = meshRegistry.Acquire(_path, created);
+	if (!created) return meshRegistry.Get(handle);
+
+	std::string fullPath = GetFullPathTo(_path);
+	std::vector<unsigned char> data;
+	if (ReadResourceFile(fullPath, data))
+	{
+		unsigned int original = meshRegistry.Resolve(handle, HashResourceContent(data.data(), data.size()), data.size(),
+			[&](unsigned int _original) { return ResourceFilesMatch(fullPath, GetFullPathTo(meshRegistry.GetPath(_original))); });
+		if (original != handle) return meshRegistry.Get(original);
+	}
+
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(fullPath.c_str(), device, context);
+	D3D11_BUFFER_DESC vertexDesc = {};
+	D3D11_BUFFER_DESC indexDesc = {};
+	if (*mesh->GetVertexBuffer()) (*mesh->GetVertexBuffer())->GetDesc(&vertexDesc);
+	if (*mesh->GetIndexBuffer()) (*mesh->GetIndexBuffer())->GetDesc(&indexDesc);
+	meshRegistry.Set(handle, mesh, (unsigned long long)vertexDesc.ByteWidth + indexDesc.ByteWidth);
+	return mesh;
 }
 
 // --------------------------------------------------------
@@ -274,49 +378,29 @@ void Game::LoadTextures()
 void Game::LoadMeshes()
 {
 	shapes = {
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/cube.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/cylinder.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/helix.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/sphere.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/torus.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/quad.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/quad_double_sided.obj").c_str(),
-			device, context),
-
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/warped_plane.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/warped_building.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/warped_archway_outer.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/warped_archway_inner.obj").c_str(),
-			device, context),
-		std::make_shared<Mesh>(
-			GetFullPathTo("Assets/Models/warped_monke.obj").c_str(),
-			device, context),
+		LoadMesh("Assets/Models/cube.obj"),
+		LoadMesh("Assets/Models/cylinder.obj"),
+		LoadMesh("Assets/Models/helix.obj"),
+		LoadMesh("Assets/Models/sphere.obj"),
+		LoadMesh("Assets/Models/torus.obj"),
+		LoadMesh("Assets/Models/quad.obj"),
+		LoadMesh("Assets/Models/quad_double_sided.obj"),
+
+		LoadMesh("Assets/Models/warped_plane.obj"),
+		LoadMesh("Assets/Models/warped_building.obj"),
+		LoadMesh("Assets/Models/warped_archway_outer.obj"),
+		LoadMesh("Assets/Models/warped_archway_inner.obj"),
+		LoadMesh("Assets/Models/warped_monke.obj"),
 	};
 
+	std::shared_ptr<SimpleVertexShader> skyboxVertexShader = PipelineCache::GetInstance().GetVertexShader(GetFullPathTo_Wide(L"SkyboxVertexShader.cso"));
+	std::shared_ptr<SimplePixelShader> skyboxPixelShader = PipelineCache::GetInstance().GetPixelShader(GetFullPathTo_Wide(L"SkyboxPixelShader.cso"));
+	skyboxVertexShader->SetBufferExternal(CBUFFER_PERFRAME);
+
 	skybox1 = std::make_shared<Sky>(
 		shapes[0],
-		std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"SkyboxVertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"SkyboxPixelShader.cso").c_str()),
+		skyboxVertexShader,
+		skyboxPixelShader,
 		demoCubemap1,
 		sampler,
 		device
@@ -324,8 +408,8 @@ void Game::LoadMeshes()
 
 	skybox2 = std::make_shared<Sky>(
 		shapes[0],
-		std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"SkyboxVertexShader.cso").c_str()),
-		std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"SkyboxPixelShader.cso").c_str()),
+		skyboxVertexShader,
+		skyboxPixelShader,
 		demoCubemap2,
 		sampler,
 		device
@@ -347,6 +431,18 @@ void Game::LoadScene(int _currentScene)
 		LoadScene2();
 		break;
 	}
+
+	// The first directional light casts the cascaded shadows
+	for (auto& light : lights)
+	{
+		if (light.Type != LIGHT_TYPE_DIRECTIONAL) continue;
+		light.Shadowed = 1.0f;
+		break;
+	}
+
+	// The demo and stress lights go in after whatever the new scene has
+	sceneLightCount = (unsigned int)lights.size();
+	ResetLights();
 }
 
 void Game::LoadScene1()
@@ -414,6 +510,19 @@ void Game::LoadScene1()
 	transpEntities[5]->GetTransform()->SetScale(-90, -90, -90);
 	#pragma endregion
 
+	#pragma region Animation Setup
+	updateScheduler->Clear();
+	for (int i = 1; i < 5; ++i)
+	{
+		updateScheduler->Add(entities[i], [](Entity* _entity, float _deltaTime, float _totalTime)
+		{
+			DirectX::XMFLOAT3 pos = _entity->GetTransform()->GetPosition();
+			_entity->GetTransform()->SetPosition(pos.x, sin(_totalTime / 2) * 0.5f + 1, pos.z);
+			_entity->GetTransform()->SetRotation(0, cos(_totalTime / 4) * 4, 0);
+		});
+	}
+	#pragma endregion
+
 	materials[0]->SwapTexture(TEXTYPE_REFLECTION, demoCubemap1);
 	materials[0]->SetUVScale(DirectX::XMFLOAT2(10, 10));
 	materials[2]->SetUVScale(DirectX::XMFLOAT2(5, 5));
@@ -480,6 +589,17 @@ void Game::LoadScene2()
 	}
 	#pragma endregion
 
+	#pragma region Animation Setup
+	updateScheduler->Clear();
+	for (int i = 0; i < entities.size(); ++i)
+	{
+		updateScheduler->Add(entities[i], [](Entity* _entity, float _deltaTime, float _totalTime)
+		{
+			_entity->GetTransform()->SetRotation(0, sin(_totalTime / 720) * 360, 0);
+		});
+	}
+	#pragma endregion
+
 	materials[0]->SwapTexture(TEXTYPE_REFLECTION, demoCubemap2);
 	materials[0]->SetUVScale(DirectX::XMFLOAT2(1, 1));
 	materials[2]->SetUVScale(DirectX::XMFLOAT2(1, 1));
@@ -488,23 +608,14 @@ void Game::LoadScene2()
 
 void Game::UpdateScene1(float deltaTime, float totalTime)
 {
-	for (int i = 1; i < 5; ++i)
-	{
-		DirectX::XMFLOAT3 pos = entities[i]->GetTransform()->GetPosition();
-		entities[i]->GetTransform()->SetPosition(pos.x, sin(totalTime / 2) * 0.5f + 1, pos.z);
-		entities[i]->GetTransform()->SetRotation(0, cos(totalTime / 4) * 4, 0);
-	}
-
+	// Entity animation is registered with the update scheduler in LoadScene1
 	materials[11]->SetUVOffset(DirectX::XMFLOAT2(0, -tan(totalTime / 4) * 0.15f));
 	materials[11]->SetEmitAmount(DirectX::XMFLOAT3(sin(totalTime / 1) * 0.25f + 0.25f, sin(totalTime / 1) * 0.25f + 0.25f, sin(totalTime / 1) * 0.25f + 0.25f));
 }
 
 void Game::UpdateScene2(float deltaTime, float totalTime)
 {
-	for (int i = 0; i < entities.size(); ++i)
-	{
-		entities[i]->GetTransform()->SetRotation(0, sin(totalTime / 720) * 360, 0);
-	}
+	// Entity animation is registered with the update scheduler in LoadScene2
 }
 
 // --------------------------------------------------------
@@ -533,6 +644,14 @@ void Game::Update(float deltaTime, float totalTime)
 	else if (Input::GetInstance().KeyDown(0x32))
 		LoadScene(1);
 
+	// Feature switches, for comparing the renderer's options as it runs (in release builds too, where the costs are real)
+	UpdateFeatureKeys();
+
+	// Ask for the mips everything on screen needs, then swap in what the loader threads and the budget allow
+	textureStreamer->Request(camera, (float)height, entities);
+	textureStreamer->Request(camera, (float)height, transpEntities);
+	textureStreamer->Update();
+
 	switch (currentScene)
 	{
 	case 0:
@@ -542,10 +661,187 @@ void Game::Update(float deltaTime, float totalTime)
 		UpdateScene2(deltaTime, totalTime);
 		break;
 	}
+	updateScheduler->Update(camera->GetTransform()->GetPosition(), camera->GetFrustum(), totalTime);
 
 	camera->Update(deltaTime);
 }
 
+// --------------------------------------------------------
+// Keys that switch features on and off to compare them,
+// plus P in debug builds, which prints last frame's stats
+// --------------------------------------------------------
+void Game::UpdateFeatureKeys()
+{
+#if defined(DEBUG) || defined(_DEBUG)
+	// Dump how well the render queue is batching last frame's draws, and what every cache is doing
+	if (Input::GetInstance().KeyPress('P'))
+	{
+		PrintStats();
+	}
+#endif
+
+	// Switch per-object data between the ring and each shader's own buffer
+	if (Input::GetInstance().KeyPress('R'))
+	{
+		SetConstantBufferRing(!useConstantBufferRing);
+	}
+
+	// Switch between reusing last frame's draw order and always radix sorting
+	if (Input::GetInstance().KeyPress('T'))
+	{
+		useCoherentSort = !useCoherentSort;
+		renderQueue->SetCoherentSort(useCoherentSort);
+	}
+
+	// Switch transparent entities between two culled draws and one triangle-sorted draw
+	if (Input::GetInstance().KeyPress('Y'))
+	{
+		sortTransparentTriangles = !sortTransparentTriangles;
+	}
+
+	// Switch the light stress mode on or off
+	if (Input::GetInstance().KeyPress('L'))
+	{
+		SetLightStressMode(!lightStressMode);
+	}
+
+	// Switch the two point lights that show off the shadow atlas on or off
+	if (Input::GetInstance().KeyPress('O'))
+	{
+		SetPointShadowDemo(!pointShadowDemo);
+	}
+
+	// Switch point lights between the per-object lists and the cluster grid
+	if (Input::GetInstance().KeyPress('K'))
+	{
+		useClusteredLighting = !useClusteredLighting;
+	}
+
+	// Switch the cascaded shadows on or off
+	if (Input::GetInstance().KeyPress('G'))
+	{
+		useShadows = !useShadows;
+		for (auto& light : lights)
+		{
+			if (light.Type == LIGHT_TYPE_POINT) light.Shadowed = 0.0f;
+		}
+	}
+
+	// Switch the SH term for lights that miss each object's list on or off
+	if (Input::GetInstance().KeyPress('J'))
+	{
+		useLightLOD = !useLightLOD;
+		renderQueue->SetLightLOD(useLightLOD);
+	}
+
+	// Cycle the texture budget through the default, a quarter of it and four times it, to watch mips stream in and out
+	if (Input::GetInstance().KeyPress('B'))
+	{
+		if (textureBudget == TEXTURE_STREAMING_BUDGET) textureBudget = TEXTURE_STREAMING_BUDGET / 4;
+		else if (textureBudget < TEXTURE_STREAMING_BUDGET) textureBudget = TEXTURE_STREAMING_BUDGET * 4;
+		else textureBudget = TEXTURE_STREAMING_BUDGET;
+		textureStreamer->SetBudget(textureBudget);
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Texture budget: %llu MB\n", textureBudget / (1024 * 1024));
+#endif
+	}
+}
+
+#if defined(DEBUG) || defined(_DEBUG)
+// --------------------------------------------------------
+// Prints last frame's stats from the render queue, lights,
+// shadows, caches and texture streaming
+// --------------------------------------------------------
+void Game::PrintStats()
+{
+	RenderQueueStats stats = renderQueue->GetStats();
+	printf("Render queue: %u draws, sorted in %.3fms (%s)\n", stats.draws, stats.sortMilliseconds,
+		stats.coherentSort ? "insertion sort from last frame's order" : "radix sort");
+	printf("  program changes:  %u (unsorted %u)\n", stats.programChanges, stats.unsortedProgramChanges);
+	printf("  material changes: %u (unsorted %u)\n", stats.materialChanges, stats.unsortedMaterialChanges);
+	printf("  mesh changes:     %u (unsorted %u)\n", stats.meshChanges, stats.unsortedMeshChanges);
+	printf("  triangle-sorted draws: %u (%u uploads)\n", stats.sortedDraws, stats.sortedUploads);
+	printf("Light lists: %zu lights, %u objects, %.1f lights reach each on average, %.2f assigned, %u lists full, built in %.3fms\n",
+		lights.size(), stats.lights.objects,
+		stats.lights.objects ? (float)stats.lights.lightsInRange / stats.lights.objects : 0.0f,
+		stats.lights.objects ? (float)stats.lights.lightsAssigned / stats.lights.objects : 0.0f,
+		stats.lights.truncatedLists, stats.lights.milliseconds);
+	if (GetShadowLight())
+	{
+		ShadowStats shadows = shadowMaps->GetStats();
+		printf("Shadow cascades: %u casters, %u/%u/%u/%u drawn per cascade (%u draws instead of %u)\n", shadows.casters,
+			shadows.cascadeCasters[0], shadows.cascadeCasters[1], shadows.cascadeCasters[2], shadows.cascadeCasters[3],
+			shadows.drawnCasters, shadows.casters * SHADOW_CASCADE_COUNT);
+	}
+	if (useShadows)
+	{
+		ShadowAtlasStats atlas = pointShadowMaps->GetStats();
+		printf("Point shadows: %u of %u on-screen point lights, %u faces drawn (%u cached, %u caster draws), %u moved casters\n",
+			atlas.shadowedLights, atlas.candidates, atlas.facesRendered, atlas.facesCached, atlas.casterDraws, atlas.movedCasters);
+		printf("  atlas %.0f%% used, %u new placements, %u evicted, %u with smaller tiles than asked for\n",
+			100.0 * atlas.usedTexels / ((double)SHADOW_ATLAS_RESOLUTION * SHADOW_ATLAS_RESOLUTION), atlas.allocations, atlas.evictions, atlas.downsized);
+	}
+	printf("Light LOD (%s): leftover lights projected into SH in %.3fms\n", useLightLOD ? "on" : "off", stats.lightLODMilliseconds);
+	if (useClusteredLighting)
+	{
+		ClusterStats clusters = lightClusters->GetStats();
+		printf("Light clusters: %u of %u point lights visible, %u references (%.2f per cluster), %u box tests, binned in %.3fms on %u threads\n",
+			clusters.visibleLights, clusters.lights, clusters.references, (float)clusters.references / CLUSTER_COUNT,
+			clusters.clusterTests, clusters.milliseconds, clusters.threads);
+	}
+
+	// Each transparent mesh caches its own triangle orders, so report them once per mesh
+	std::vector<Mesh*> sortedMeshes;
+	for (auto entity : transpEntities)
+	{
+		Mesh* mesh = entity->GetMesh().get();
+		if (std::find(sortedMeshes.begin(), sortedMeshes.end(), mesh) != sortedMeshes.end()) continue;
+		sortedMeshes.push_back(mesh);
+
+		TriangleSortStats sort = mesh->GetTriangleSortStats();
+		printf("  mesh %u triangle orders: %u lookups, %u sorts, %u evictions, %u cached\n",
+			mesh->GetId(), sort.lookups, sort.sorts, sort.evictions, sort.cachedOrders);
+	}
+	printf("State cache: %u binds issued, %u filtered\n", StateCache::GetInstance().GetIssuedCount(), StateCache::GetInstance().GetFilteredCount());
+	printf("Constant buffers: %zu bytes uploaded\n", constantBufferBytesLastFrame);
+
+	RingStats ring = constantBufferRing->GetStats();
+	printf("Constant buffer ring (%s): %u/%u bytes in flight (peak %u), %u allocations, %u stalls, %u wraps, %u discards\n",
+		useConstantBufferRing ? "on" : "off", ring.used, ring.capacity, ring.peakUsed, ring.allocations, ring.stalls, ring.wraps, ring.discards);
+	constantBufferRing->ResetStats();
+
+	PipelineCacheStats pipeline = PipelineCache::GetInstance().GetStats();
+	printf("Pipeline cache (live/requested/created): VS %u/%u/%u, PS %u/%u/%u, samplers %u/%u/%u, blend %u/%u/%u, raster %u/%u/%u, depth %u/%u/%u\n",
+		pipeline.vertexShaders.live, pipeline.vertexShaders.requests, pipeline.vertexShaders.created,
+		pipeline.pixelShaders.live, pipeline.pixelShaders.requests, pipeline.pixelShaders.created,
+		pipeline.samplers.live, pipeline.samplers.requests, pipeline.samplers.created,
+		pipeline.blendStates.live, pipeline.blendStates.requests, pipeline.blendStates.created,
+		pipeline.rasterizerStates.live, pipeline.rasterizerStates.requests, pipeline.rasterizerStates.created,
+		pipeline.depthStencilStates.live, pipeline.depthStencilStates.requests, pipeline.depthStencilStates.created);
+	PermutationStats permutations = permutationCache->GetStats();
+	printf("Shader permutations: %u in use (%u failed) of %u possible, %u lookups (%u hits)\n",
+		permutations.compiled, permutations.failed, permutations.possible, permutations.lookups, permutations.hits);
+
+	// Compare across launches: the first one reflects and writes the sidecars, later ones read them
+	printf("Shader reflection: %u from sidecars, %u reflected, %.3fms\n",
+		ISimpleShader::ReflectionCacheHits, ISimpleShader::ReflectionCacheMisses, ISimpleShader::ReflectionMilliseconds);
+
+	TextureStreamerStats streamer = textureStreamer->GetStats();
+	printf("Texture streaming: %u of %u files in place (%u loads, %u through WIC, %u pre-built, %u ORM packed, %u one-color maps), %.1fms decoding on %u threads, %.1fms making textures, %.1fms start to finish\n",
+		streamer.files - streamer.pending, streamer.files, streamer.requests, streamer.fallbacks, streamer.containers, streamer.packed, streamer.uniform,
+		streamer.decodeMilliseconds, streamer.threads, streamer.uploadMilliseconds, streamer.elapsedMilliseconds);
+	TextureResidencyStats residency = streamer.residency;
+	printf("  mips: %.1f of %.1f MB resident (%.0f%% of budget, %.1f MB wanted), %u/%u visible textures sharp (%u levels short), %u loads, %u evictions, %u rebuilds\n",
+		residency.residentBytes / 1048576.0, residency.budget / 1048576.0, residency.budget > 0 ? 100.0 * residency.residentBytes / residency.budget : 0.0,
+		residency.wantedBytes / 1048576.0, residency.satisfied, residency.requested, residency.mipDeficit, residency.loads, residency.evictions, streamer.rebuilds);
+	ResourceRegistryStats textures = streamer.registry;
+	ResourceRegistryStats meshes = meshRegistry.GetStats();
+	printf("Shared resources: textures %u for %u references (%u by path, %u by contents), %.1f MB held, %.1f MB saved; meshes %u for %u references (%u by path, %u by contents), %.1f MB held, %.1f MB saved\n",
+		textures.live, textures.references, textures.pathHits, textures.contentHits, textures.liveBytes / 1048576.0, textures.savedBytes / 1048576.0,
+		meshes.live, meshes.references, meshes.pathHits, meshes.contentHits, meshes.liveBytes / 1048576.0, meshes.savedBytes / 1048576.0);
+}
+#endif
+
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
 // --------------------------------------------------------
@@ -562,11 +858,66 @@ void Game::Draw(float deltaTime, float totalTime)
 		1.0f,
 		0);
 
-	// Render solid entities first
+	// Count this frame's binds and uploads on their own
+	StateCache::GetInstance().ResetCounters();
+	ISimpleShader::UploadedBytes = 0;
+
+	// Point lights pick up their atlas tiles before anything copies the lights (transparent entities don't cast)
+	if (useShadows)
+	{
+		pointShadowMaps->Render(camera, (float)height, lights, entities);
+		pointShadowMaps->Bind();
+	}
+
+	// With clustered lighting, point lights are found per pixel and only directional lights stay in the per-object lists
+	const std::vector<Light>* objectLights = &lights;
+	if (useClusteredLighting)
+	{
+		lightClusters->Update(camera, lights);
+		lightClusters->Bind();
+
+		directionalLights.clear();
+		for (auto& light : lights)
+		{
+			if (light.Type == LIGHT_TYPE_DIRECTIONAL) directionalLights.push_back(light);
+		}
+		objectLights = &directionalLights;
+	}
+
+	// Shadow casters go into the shadow maps before anything reads them (transparent entities don't cast)
+	Light* shadowLight = GetShadowLight();
+	if (shadowLight)
+	{
+		shadowMaps->Render(camera, shadowLight->Direction, entities);
+		shadowMaps->Bind();
+	}
+
+	// Camera and lighting only change once per frame, so every shader shares one upload of them
+	UploadPerFrameData();
+
+	// Queue everything up and sort by state (and depth) before drawing
+	renderQueue->Begin(camera, *objectLights);
 	for (auto entity : entities)
 	{
-		entity->Draw(camera, ambient, lights);
+		renderQueue->Add(entity, RENDERPASS_OPAQUE);
+	}
+	for (auto entity : transpEntities)
+	{
+		if (sortTransparentTriangles)
+		{
+			// One draw of every triangle, furthest first, blends both sides in order even where the mesh overlaps itself
+			renderQueue->Add(entity, RENDERPASS_TRANSPARENT, noCullRasterState.Get(), true);
+			continue;
+		}
+
+		// Back faces first, then front faces, so both sides blend in the right order
+		renderQueue->Add(entity, RENDERPASS_TRANSPARENT, backfaceRasterState.Get());
+		renderQueue->Add(entity, RENDERPASS_TRANSPARENT);
 	}
+	renderQueue->Sort();
+
+	// Render solid entities first
+	renderQueue->Submit(RENDERPASS_OPAQUE);
 
 	// Draw the skybox after solid entities to avoid overdraw
 	switch (currentScene)
@@ -579,31 +930,16 @@ void Game::Draw(float deltaTime, float totalTime)
 		break;
 	}
 
-	// Sort transparent entities
-	std::sort(transpEntities.begin(), transpEntities.end(), [&](std::shared_ptr<Entity> a, std::shared_ptr<Entity> b) -> bool
-	{
-		XMFLOAT3 positionA = a->GetTransform()->GetPosition();
-		XMFLOAT3 positionB = b->GetTransform()->GetPosition();
-		XMFLOAT3 camPos = camera->GetTransform()->GetPosition();
-
-		// compare distance
-		float aDist = XMVectorGetX(XMVector3Length(XMLoadFloat3(&positionA) - XMLoadFloat3(&camPos)));
-		float bDist = XMVectorGetX(XMVector3Length(XMLoadFloat3(&positionB) - XMLoadFloat3(&camPos)));
-		return aDist > bDist;
-	});
-
-	// Draw transparent entities with proper blendstate
-	context->OMSetBlendState(alphaBlendState.Get(), 0, 0xFFFFFFFF);
-	for (auto entity : transpEntities)
-	{
-		context->RSSetState(backfaceRasterState.Get());
-		entity->Draw(camera, ambient, lights);
-		context->RSSetState(0);
-		entity->Draw(camera, ambient, lights);
-	}
+	// Draw transparent entities (already sorted back-to-front) with proper blendstate
+	StateCache::GetInstance().OMSetBlendState(alphaBlendState.Get(), 0, 0xFFFFFFFF);
+	renderQueue->Submit(RENDERPASS_TRANSPARENT);
 
 	// Reset blendstate after drawing transparent entities
-	context->OMSetBlendState(0, 0, 0xFFFFFFFF);
+	StateCache::GetInstance().OMSetBlendState(0, 0, 0xFFFFFFFF);
+	constantBufferBytesLastFrame = ISimpleShader::UploadedBytes + sizeof(PerFrameData);
+
+	// Fence off this frame's ring allocations so the space comes back once the GPU is done with them
+	constantBufferRing->EndFrame();
 
 	// Present the back buffer (i.e. the final frame) to the user at the end of drawing
 	swapChain->Present(vsync ? 1 : 0, 0);
@@ -613,6 +949,144 @@ void Game::Draw(float deltaTime, float totalTime)
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
 }
 
+// --------------------------------------------------------
+// Uploads the camera, ambient light and shadow cascades
+// shared by every shader, and binds it for both the vertex
+// and pixel stages (other lights go out per object, see
+// RenderQueue)
+// --------------------------------------------------------
+void Game::UploadPerFrameData()
+{
+	perFrameData.view = camera->GetViewMatrix();
+	perFrameData.projection = camera->GetProjectionMatrix();
+	perFrameData.cameraPosition = camera->GetTransform()->GetPosition();
+	perFrameData.ambient = ambient;
+
+	// The shaders skip the cluster lookup while the slice scale is 0
+	perFrameData.clusterTileScale = XMFLOAT2((float)CLUSTER_COUNT_X / width, (float)CLUSTER_COUNT_Y / height);
+	perFrameData.clusterSliceScale = useClusteredLighting ? lightClusters->GetSliceScale() : 0.0f;
+	perFrameData.clusterSliceBias = lightClusters->GetSliceBias();
+
+	// The shaders treat everything as lit while the texel size is 0
+	perFrameData.shadowTexelSize = 0.0f;
+	if (GetShadowLight())
+	{
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+		{
+			const ShadowCascade& cascade = shadowMaps->GetCascade(c);
+			perFrameData.shadowViewProjection[c] = cascade.viewProjection;
+			perFrameData.shadowSplits[c] = cascade.splitFar;
+		}
+		perFrameData.shadowTexelSize = 1.0f / SHADOW_MAP_RESOLUTION;
+	}
+
+	context->UpdateSubresource(perFrameBuffer.Get(), 0, 0, &perFrameData, 0, 0);
+
+	StateCache& cache = StateCache::GetInstance();
+	cache.VSSetConstantBuffer(0, perFrameBuffer.Get());
+	cache.PSSetConstantBuffer(0, perFrameBuffer.Get());
+}
+
+// --------------------------------------------------------
+// Moves the entity shaders' per-object data (and light
+// lists) into or out of the constant buffer ring
+// --------------------------------------------------------
+void Game::SetConstantBufferRing(bool _enabled)
+{
+	// Without an 11.1 context the ring's ranges can't be bound
+	_enabled = _enabled && constantBufferRing->IsSupported() && StateCache::GetInstance().CanBindRanges();
+	ConstantBufferRing* ring = _enabled ? constantBufferRing.get() : 0;
+	vertexShader->SetBufferRing(CBUFFER_PEROBJECT, ring);
+	vertexShaderPBR->SetBufferRing(CBUFFER_PEROBJECT, ring);
+	pixelShader->SetBufferRing(CBUFFER_PEROBJECTLIGHTS, ring);
+	pixelShaderPBR->SetBufferRing(CBUFFER_PEROBJECTLIGHTS, ring);
+	pixelShaderToon->SetBufferRing(CBUFFER_PEROBJECTLIGHTS, ring);
+	useConstantBufferRing = _enabled;
+}
+
+// --------------------------------------------------------
+// Adds (or removes) a thousand point lights scattered
+// through the scene, to see what per-object light lists
+// cost on the CPU and save in shading
+// --------------------------------------------------------
+void Game::SetLightStressMode(bool _enabled)
+{
+	lightStressMode = _enabled;
+	ResetLights();
+}
+
+// --------------------------------------------------------
+// Adds (or removes) two shadowed point lights in scene 1:
+// one among the moving buildings, so its faces redraw, and
+// one that only reaches static geometry, so its stay cached
+// --------------------------------------------------------
+void Game::SetPointShadowDemo(bool _enabled)
+{
+	pointShadowDemo = _enabled;
+	ResetLights();
+}
+
+// --------------------------------------------------------
+// Cuts the lights back to the scene's own, then adds the
+// demo and stress lights that are switched on
+// --------------------------------------------------------
+void Game::ResetLights()
+{
+	lights.resize(sceneLightCount);
+	if (pointShadowDemo && currentScene == 0)
+	{
+		lights.push_back(Light::Point(XMFLOAT3(0, 4, 0), XMFLOAT3(1, 0.6f, 0.3f), 1.0f, 14.0f));
+		lights.push_back(Light::Point(XMFLOAT3(0, 14, 10), XMFLOAT3(0.4f, 0.6f, 1.0f), 1.0f, 10.0f));
+	}
+	if (!lightStressMode || (entities.empty() && transpEntities.empty())) return;
+
+	// Scatter them through the box around everything in the scene
+	XMFLOAT3 minimum = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 maximum = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	std::vector<std::shared_ptr<Entity>> everything = entities;
+	everything.insert(everything.end(), transpEntities.begin(), transpEntities.end());
+	for (auto entity : everything)
+	{
+		BoundingSphere bounds = entity->GetBounds();
+		minimum = XMFLOAT3(
+			(std::min)(minimum.x, bounds.Center.x - bounds.Radius),
+			(std::min)(minimum.y, bounds.Center.y - bounds.Radius),
+			(std::min)(minimum.z, bounds.Center.z - bounds.Radius));
+		maximum = XMFLOAT3(
+			(std::max)(maximum.x, bounds.Center.x + bounds.Radius),
+			(std::max)(maximum.y, bounds.Center.y + bounds.Radius),
+			(std::max)(maximum.z, bounds.Center.z + bounds.Radius));
+	}
+
+	// Same seed every time, so runs can be compared
+	std::mt19937 random(LIGHT_STRESS_SEED);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float size = (std::max)(maximum.x - minimum.x, (std::max)(maximum.y - minimum.y, maximum.z - minimum.z));
+	for (int i = 0; i < LIGHT_STRESS_COUNT; i++)
+	{
+		XMFLOAT3 position = XMFLOAT3(
+			minimum.x + unit(random) * (maximum.x - minimum.x),
+			minimum.y + unit(random) * (maximum.y - minimum.y),
+			minimum.z + unit(random) * (maximum.z - minimum.z));
+		XMFLOAT3 color = XMFLOAT3(unit(random), unit(random), unit(random));
+		lights.push_back(Light::Point(position, color, 0.5f + unit(random), size * (0.02f + 0.06f * unit(random))));
+	}
+}
+
+// --------------------------------------------------------
+// Gets the light the shadow maps are drawn from, if there
+// is one and shadows are on
+// --------------------------------------------------------
+Light* Game::GetShadowLight()
+{
+	if (!useShadows) return 0;
+	for (auto& light : lights)
+	{
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL && light.Shadowed > 0) return &light;
+	}
+	return 0;
+}
+
 // --------------------------------------------------------
 // Loads six individual textures (the six faces of a cube map), then
 // creates a blank cube map and copies each of the six textures to
@@ -644,6 +1118,60 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Game::CreateCubemap(
 //   your own implementation.
 // --------------------------------------------------------
 
+	// Pre-built faces (with their mips) next to the images go straight into the cube map
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> containerSRV;
+	const std::wstring facePaths[6] = {
+		DXCore::GetFullPathTo_Wide(right), DXCore::GetFullPathTo_Wide(left),
+		DXCore::GetFullPathTo_Wide(up), DXCore::GetFullPathTo_Wide(down),
+		DXCore::GetFullPathTo_Wide(front), DXCore::GetFullPathTo_Wide(back) };
+	if (ContainerTextureLoader::LoadCubemap(device.Get(), facePaths, containerSRV)) return containerSRV;
+
+	// Otherwise PNG faces get a whole mip chain here, filtered in linear space and not reaching across face edges,
+	// so the sky and reflections don't shimmer where they're minified
+	std::vector<std::vector<DecodedImage>> faces(6);
+	bool decoded = true;
+	for (int i = 0; i < 6 && decoded; i++)
+	{
+		faces[i].resize(1);
+		decoded = PngDecoder::DecodeFile(WidePathToUTF8(facePaths[i]), faces[i][0]);
+	}
+	MipGenerator mipGenerator(std::thread::hardware_concurrency());
+	if (decoded && faces[0][0].width == faces[0][0].height && mipGenerator.Generate(faces, { MipContent::Color, MipFilter::Kaiser, false }))
+	{
+		unsigned int mipCount = (unsigned int)faces[0].size();
+		D3D11_TEXTURE2D_DESC mipCubeDesc = {};
+		mipCubeDesc.Width = faces[0][0].width;
+		mipCubeDesc.Height = faces[0][0].height;
+		mipCubeDesc.MipLevels = mipCount;
+		mipCubeDesc.ArraySize = 6;
+		mipCubeDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		mipCubeDesc.SampleDesc.Count = 1;
+		mipCubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		mipCubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		mipCubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+		std::vector<D3D11_SUBRESOURCE_DATA> mipData((size_t)6 * mipCount);
+		for (int face = 0; face < 6; face++)
+		{
+			for (unsigned int mip = 0; mip < mipCount; mip++)
+			{
+				mipData[face * mipCount + mip].pSysMem = faces[face][mip].pixels.data();
+				mipData[face * mipCount + mip].SysMemPitch = faces[face][mip].width * 4;
+			}
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC mipSRVDesc = {};
+		mipSRVDesc.Format = mipCubeDesc.Format;
+		mipSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		mipSRVDesc.TextureCube.MipLevels = mipCount;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> mipCubeTexture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mipCubeSRV;
+		if (SUCCEEDED(device->CreateTexture2D(&mipCubeDesc, mipData.data(), mipCubeTexture.GetAddressOf())) &&
+			SUCCEEDED(device->CreateShaderResourceView(mipCubeTexture.Get(), &mipSRVDesc, mipCubeSRV.GetAddressOf())))
+			return mipCubeSRV;
+	}
+
 	// Load the 6 textures into an array.
 	// - We need references to the TEXTURES, not the SHADER RESOURCE VIEWS!
 	// - Specifically NOT generating mipmaps, as we usually don't need them for the sky!
@@ -8,6 +8,17 @@
 #include "Material.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "UpdateScheduler.h"
+#include "RenderQueue.h"
+#include "ConstantBuffers.h"
+#include "ConstantBufferRing.h"
+#include "ShaderPermutations.h"
+#include "PipelineCache.h"
+#include "LightClusters.h"
+#include "PointShadowMaps.h"
+#include "ShadowMaps.h"
+#include "TextureStreamer.h"
+#include "ResourceRegistry.h"
 #include <DirectXMath.h>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
@@ -42,11 +53,22 @@ private:
 	void LoadShadersAndMaterials();
 	void LoadTextures();
 	void LoadMeshes();
+	std::shared_ptr<Mesh> LoadMesh(const char* _path);
 	void LoadScene(int _currentScene);
 	void LoadScene1();
 	void LoadScene2();
 	void UpdateScene1(float deltaTime, float totalTime);
 	void UpdateScene2(float deltaTime, float totalTime);
+	void UploadPerFrameData();
+	void SetConstantBufferRing(bool _enabled);
+	void SetLightStressMode(bool _enabled);
+	void SetPointShadowDemo(bool _enabled);
+	void ResetLights();
+	void UpdateFeatureKeys();
+#if defined(DEBUG) || defined(_DEBUG)
+	void PrintStats();
+#endif
+	Light* GetShadowLight();
 	
 	// Shaders and shader-related constructs
 	std::shared_ptr<SimplePixelShader> pixelShader;
@@ -54,17 +76,38 @@ private:
 	std::shared_ptr<SimplePixelShader> pixelShaderPBR;
 	std::shared_ptr<SimpleVertexShader> vertexShaderPBR;
 	std::shared_ptr<SimplePixelShader> pixelShaderToon;
+	// Variants of the standard and toon pixel shaders, keyed by material features
+	std::shared_ptr<PermutationCache> permutationCache;
 
 	// A2 shapes
 	std::vector<std::shared_ptr<Mesh>> shapes;
+	// Meshes by path and by file contents, so each is only built once
+	ResourceRegistry<std::shared_ptr<Mesh>> meshRegistry;
 	// A4 entities;
 	std::vector<std::shared_ptr<Entity>> entities;
 	// A5 Camera
 	std::shared_ptr<Camera> camera;
 	// A6 Materials
 	std::vector<std::shared_ptr<Material>> materials;
+	// Loads material textures off the main thread and streams their mips under a budget (cycled with B)
+	std::shared_ptr<TextureStreamer> textureStreamer;
+	unsigned long long textureBudget;
 	// A7 Lights
 	std::vector<Light> lights;
+	unsigned int sceneLightCount; // The scene's own lights, ahead of any demo or stress lights
+	bool lightStressMode; // Toggled with L
+	bool pointShadowDemo; // Toggled with O
+	// Point lights binned into view frustum clusters (toggled with K)
+	std::shared_ptr<LightClusters> lightClusters;
+	bool useClusteredLighting;
+	std::vector<Light> directionalLights;
+	// Lights that miss an object's list are projected into SH (toggled with J, error report on H)
+	bool useLightLOD;
+	// Cascaded shadows from the first directional light (toggled with G)
+	std::shared_ptr<ShadowMaps> shadowMaps;
+	bool useShadows;
+	// Point light shadows in a cached atlas (also toggled with G)
+	std::shared_ptr<PointShadowMaps> pointShadowMaps;
 	DirectX::XMFLOAT3 ambient;
 	// A9 Normalmaps & Cubemaps
 	std::shared_ptr<Sky> skybox1;
@@ -75,9 +118,26 @@ private:
 
 	std::vector<std::shared_ptr<Entity>> transpEntities;
 
+	// Time-sliced updates for animated entities
+	std::shared_ptr<UpdateScheduler> updateScheduler;
+	// State-sorted draw submission
+	std::shared_ptr<RenderQueue> renderQueue;
+	bool useCoherentSort; // Toggled with T
+	bool sortTransparentTriangles; // Toggled with Y
+	// Constant data shared by every shader for the whole frame
+	Microsoft::WRL::ComPtr<ID3D11Buffer> perFrameBuffer;
+	PerFrameData perFrameData;
+	size_t constantBufferBytesLastFrame;
+	// Per-draw constants sub-allocated from one big buffer (toggled with R)
+	std::shared_ptr<ConstantBufferRing> constantBufferRing;
+	bool useConstantBufferRing;
+	// The 11.1 interface to the context, for binding constant buffer ranges
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+
 	Microsoft::WRL::ComPtr<ID3D11Buffer> constantBufferVS;
 	Microsoft::WRL::ComPtr<ID3D11BlendState> alphaBlendState;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> backfaceRasterState;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> noCullRasterState;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSampler;
 
 	int currentScene;
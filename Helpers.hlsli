@@ -63,7 +63,10 @@ float getFresnel(float3 normal, float3 view, float specularValue)
 // gets normal: n*TBN, where n = sampled normal map, N = normal vector, T = processed tangent vector (t*N-dot(t,N), B = processed bitangent vector (cross(T,N))
 float3 getNormal(SamplerState normalSampler, Texture2D map, float2 uv, float3 normal, float3 tangent, float intensity)
 {
-	float3 n = map.Sample(normalSampler, uv).rgb * 2 - 1;
+	// z comes from x and y, so two channel (BC5) normal maps read the same as full RGB ones
+	float3 n;
+	n.xy = map.Sample(normalSampler, uv).rg * 2 - 1;
+	n.z = sqrt(saturate(1 - dot(n.xy, n.xy)));
 	float3 T = normalize(tangent - normal * dot(tangent, normal)) * intensity;
 	float3 B = cross(T, normal);
 	float3x3 TBN = float3x3(T, B, normal);
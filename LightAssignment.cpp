@@ -0,0 +1,66 @@
+#include "LightAssignment.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+float GetLightImportance(const Light& _light, XMFLOAT3 _center, float _radius)
+{
+	if (_light.Type == LIGHT_TYPE_DIRECTIONAL)
+		return _light.Intensity;
+
+	// Distance from the light to the nearest point of the bounds (0 when the light is inside them)
+	float dx = _light.Position.x - _center.x;
+	float dy = _light.Position.y - _center.y;
+	float dz = _light.Position.z - _center.z;
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz) - _radius;
+	if (distance < 0) distance = 0;
+	if (distance >= _light.Range) return 0;
+
+	// Same falloff as getAttenuation() in Helpers.hlsli
+	float falloff = 1.0f - (distance * distance) / (_light.Range * _light.Range);
+	return _light.Intensity * falloff * falloff;
+}
+
+unsigned int SelectObjectLights(const std::vector<Light>& _lights, XMFLOAT3 _center, float _radius, unsigned int* _indices, unsigned int _maxLights, LightAssignmentStats* _stats)
+{
+	// The list is kept sorted by importance as lights are found, so a full list only has to beat its last entry
+	float importances[MAX_OBJECT_LIGHTS];
+	if (_maxLights > MAX_OBJECT_LIGHTS) _maxLights = MAX_OBJECT_LIGHTS;
+
+	unsigned int count = 0;
+	unsigned int inRange = 0;
+	for (unsigned int i = 0; i < _lights.size(); i++)
+	{
+		float importance = GetLightImportance(_lights[i], _center, _radius);
+		if (importance <= 0) continue;
+		inRange++;
+
+		if (count == _maxLights)
+		{
+			if (_maxLights == 0 || importance <= importances[count - 1]) continue;
+			count--;
+		}
+
+		unsigned int slot = count;
+		while (slot > 0 && importances[slot - 1] < importance)
+		{
+			importances[slot] = importances[slot - 1];
+			_indices[slot] = _indices[slot - 1];
+			slot--;
+		}
+		importances[slot] = importance;
+		_indices[slot] = i;
+		count++;
+	}
+
+	if (_stats)
+	{
+		_stats->objects++;
+		_stats->lightsTested += (unsigned int)_lights.size();
+		_stats->lightsInRange += inRange;
+		_stats->lightsAssigned += count;
+		if (inRange > count) _stats->truncatedLists++;
+	}
+	return count;
+}
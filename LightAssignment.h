@@ -0,0 +1,50 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+struct LightAssignmentStats
+{
+	unsigned int							objects;
+	unsigned int							lightsTested;
+	unsigned int							lightsInRange;
+	unsigned int							lightsAssigned;
+	unsigned int							truncatedLists;		// Objects reached by more lights than their list could hold
+	double									milliseconds;
+};
+
+// --------------------------------------------------------
+// Picks the lights that reach one object, for its per-object
+// light list
+//
+// Point and spot lights are culled by testing their range
+// sphere against the object's bounding sphere; directional
+// lights reach everything. When more lights reach an object
+// than the list holds, the ones with the highest importance
+// (intensity times attenuation at the nearest point of the
+// bounds) are kept.
+//
+// Nothing here knows about D3D.
+// --------------------------------------------------------
+
+/// <summary>
+/// Gets how much a light matters to an object
+/// </summary>
+/// <param name="_light">The light</param>
+/// <param name="_center">The object's bounding sphere center (world space)</param>
+/// <param name="_radius">The object's bounding sphere radius</param>
+/// <returns>The light's intensity at the nearest point of the bounds, or 0 if it doesn't reach them</returns>
+float GetLightImportance(const Light& _light, DirectX::XMFLOAT3 _center, float _radius);
+
+/// <summary>
+/// Fills a light list with the most important lights reaching an object
+/// </summary>
+/// <param name="_lights">Every light in the scene</param>
+/// <param name="_center">The object's bounding sphere center (world space)</param>
+/// <param name="_radius">The object's bounding sphere radius</param>
+/// <param name="_indices">Receives the chosen lights' indices into _lights, most important first</param>
+/// <param name="_maxLights">How many indices _indices can hold</param>
+/// <param name="_stats">Counters to add this object's results to (optional)</param>
+/// <returns>The number of lights chosen</returns>
+unsigned int SelectObjectLights(const std::vector<Light>& _lights, DirectX::XMFLOAT3 _center, float _radius, unsigned int* _indices, unsigned int _maxLights, LightAssignmentStats* _stats = 0);
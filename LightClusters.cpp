@@ -0,0 +1,104 @@
+#include "LightClusters.h"
+#include "StateCache.h"
+
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+LightClusters::LightClusters(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+{
+	device = _device;
+	context = _context;
+	projection = {};
+	ranges = {};
+	lightIndices = {};
+	lights = {};
+
+	// Leave a core for the driver
+	unsigned int cores = std::thread::hardware_concurrency();
+	threads = cores > 1 ? cores - 1 : 1;
+}
+
+LightClusters::~LightClusters()
+{
+}
+
+void LightClusters::Update(std::shared_ptr<Camera> _camera, const std::vector<Light>& _lights)
+{
+	// The cluster boxes only change with the projection (e.g. on resize)
+	XMFLOAT4X4 currentProjection = _camera->GetProjectionMatrix();
+	if (memcmp(&currentProjection, &projection, sizeof(XMFLOAT4X4)) != 0)
+	{
+		projection = currentProjection;
+		grid.SetProjection(projection, _camera->GetNearClip(), _camera->GetFarClip());
+	}
+
+	grid.Assign(_camera->GetViewMatrix(), _lights, threads);
+
+	const std::vector<ClusterRange>& clusterRanges = grid.GetRanges();
+	const std::vector<unsigned int>& indices = grid.GetLightIndices();
+	Upload(ranges, clusterRanges.data(), (unsigned int)clusterRanges.size(), sizeof(ClusterRange));
+	Upload(lightIndices, indices.data(), (unsigned int)indices.size(), sizeof(unsigned int));
+	Upload(lights, _lights.data(), (unsigned int)_lights.size(), sizeof(Light));
+}
+
+void LightClusters::Bind()
+{
+	StateCache& cache = StateCache::GetInstance();
+	cache.PSSetShaderResource(CLUSTER_RANGES_SLOT, ranges.view.Get());
+	cache.PSSetShaderResource(CLUSTER_LIGHT_INDICES_SLOT, lightIndices.view.Get());
+	cache.PSSetShaderResource(CLUSTER_LIGHTS_SLOT, lights.view.Get());
+}
+
+float LightClusters::GetSliceScale()
+{
+	return grid.GetSliceScale();
+}
+
+float LightClusters::GetSliceBias()
+{
+	return grid.GetSliceBias();
+}
+
+ClusterStats LightClusters::GetStats()
+{
+	return grid.GetStats();
+}
+
+void LightClusters::Upload(StructuredUpload& _upload, const void* _data, unsigned int _count, unsigned int _stride)
+{
+	// Buffers can't be empty, so there's always room for at least one element
+	if (!_upload.buffer || _count > _upload.capacity)
+	{
+		unsigned int capacity = 1;
+		while (capacity < _count) capacity *= 2;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth = capacity * _stride;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = _stride;
+
+		_upload.buffer.Reset();
+		_upload.view.Reset();
+		device->CreateBuffer(&desc, 0, _upload.buffer.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		viewDesc.Buffer.FirstElement = 0;
+		viewDesc.Buffer.NumElements = capacity;
+		device->CreateShaderResourceView(_upload.buffer.Get(), &viewDesc, _upload.view.GetAddressOf());
+		_upload.capacity = capacity;
+	}
+
+	if (_count == 0) return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(_upload.buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) return;
+	memcpy(mapped.pData, _data, (size_t)_count * _stride);
+	context->Unmap(_upload.buffer.Get(), 0);
+}
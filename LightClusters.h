@@ -0,0 +1,69 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "ClusterGrid.h"
+
+// Registers the cluster buffers are bound to
+// - These should match Clusters.hlsli
+constexpr auto CLUSTER_RANGES_SLOT = 20;
+constexpr auto CLUSTER_LIGHT_INDICES_SLOT = 21;
+constexpr auto CLUSTER_LIGHTS_SLOT = 22;
+
+// --------------------------------------------------------
+// Bins the frame's lights into a ClusterGrid and uploads
+// the results as structured buffers for the pixel shaders:
+// each cluster's range, the light index list and the lights
+//
+// The index and light buffers grow to fit and are never
+// shrunk, so a steady scene stops reallocating after a frame.
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	LightClusters(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+	~LightClusters();
+
+											/// <summary>
+											/// Bins and uploads this frame's lights
+											/// </summary>
+											/// <param name="_camera">The camera rendering this frame</param>
+											/// <param name="_lights">The scene's lights (directional lights are skipped)</param>
+	void									Update(std::shared_ptr<Camera> _camera, const std::vector<Light>& _lights);
+											/// <summary>
+											/// Binds the cluster buffers to the pixel shader stage
+											/// </summary>
+	void									Bind();
+
+											/// <summary>
+											/// Gets the terms turning a view depth into a slice: floor(log(depth) * scale + bias)
+											/// </summary>
+	float									GetSliceScale();
+	float									GetSliceBias();
+	ClusterStats							GetStats();
+
+private:
+	// A dynamic structured buffer and its view, recreated when it needs to grow
+	struct StructuredUpload
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer>				buffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	view;
+		unsigned int										capacity;
+	};
+
+	void									Upload(StructuredUpload& _upload, const void* _data, unsigned int _count, unsigned int _stride);
+
+	Microsoft::WRL::ComPtr<ID3D11Device>		device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+
+	ClusterGrid								grid;
+	DirectX::XMFLOAT4X4						projection;
+	unsigned int							threads;
+
+	StructuredUpload						ranges;
+	StructuredUpload						lightIndices;
+	StructuredUpload						lights;
+};
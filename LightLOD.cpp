@@ -0,0 +1,330 @@
+#include "LightLOD.h"
+#include "LightAssignment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+using namespace DirectX;
+
+// Basis constants for L2 real spherical harmonics
+constexpr auto SH_Y0 = 0.282095f;
+constexpr auto SH_Y1 = 0.488603f;
+constexpr auto SH_Y2 = 1.092548f;
+constexpr auto SH_Y20 = 0.315392f;
+constexpr auto SH_Y22 = 0.546274f;
+
+// Each band of a clamped cosine lobe, for turning radiance into irradiance
+constexpr auto SH_COSINE_BAND0 = 3.141593f;
+constexpr auto SH_COSINE_BAND1 = 2.094395f;
+constexpr auto SH_COSINE_BAND2 = 0.785398f;
+
+// Points on the bounds the LOD error is measured at
+constexpr auto LIGHTLOD_ERROR_SAMPLES = 64;
+
+// The material the LOD error is measured with
+constexpr auto LIGHTLOD_ERROR_ROUGHNESS = 0.5f;
+constexpr auto LIGHTLOD_ERROR_F0 = 0.04f;
+
+void ProjectRemainingLights(const std::vector<Light>& _lights, const LightLODObject* _objects, unsigned int _count, SHIrradiance* _irradiance)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 bands[SH_COEFFICIENTS] = {
+		_mm_set1_ps(SH_Y0 * SH_COSINE_BAND0),
+		_mm_set1_ps(SH_Y1 * SH_COSINE_BAND1), _mm_set1_ps(SH_Y1 * SH_COSINE_BAND1), _mm_set1_ps(SH_Y1 * SH_COSINE_BAND1),
+		_mm_set1_ps(SH_Y2 * SH_COSINE_BAND2), _mm_set1_ps(SH_Y2 * SH_COSINE_BAND2), _mm_set1_ps(SH_Y20 * SH_COSINE_BAND2),
+		_mm_set1_ps(SH_Y2 * SH_COSINE_BAND2), _mm_set1_ps(SH_Y22 * SH_COSINE_BAND2),
+	};
+
+	for (unsigned int first = 0; first < _count; first += 4)
+	{
+		// Lay four objects out side by side (a short last group repeats its final object)
+		unsigned int groupSize = std::min(4u, _count - first);
+		alignas(16) float centerX[4], centerY[4], centerZ[4];
+		alignas(16) int exact[MAX_OBJECT_LIGHTS][4];
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			const LightLODObject& object = _objects[first + std::min(k, groupSize - 1)];
+			centerX[k] = object.center.x;
+			centerY[k] = object.center.y;
+			centerZ[k] = object.center.z;
+			for (unsigned int e = 0; e < MAX_OBJECT_LIGHTS; e++)
+			{
+				exact[e][k] = e < object.exactCount ? (int)object.exactIndices[e] : -1;
+			}
+		}
+
+		__m128 sh[SH_COEFFICIENTS][3];
+		for (int c = 0; c < SH_COEFFICIENTS; c++)
+		{
+			sh[c][0] = sh[c][1] = sh[c][2] = zero;
+		}
+
+		for (unsigned int i = 0; i < _lights.size(); i++)
+		{
+			const Light& light = _lights[i];
+			__m128 weight, directionX, directionY, directionZ;
+
+			if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+			{
+				float length = sqrtf(light.Direction.x * light.Direction.x + light.Direction.y * light.Direction.y + light.Direction.z * light.Direction.z);
+				if (length == 0) continue;
+				weight = _mm_set1_ps(light.Intensity);
+				directionX = _mm_set1_ps(light.Direction.x / length);
+				directionY = _mm_set1_ps(light.Direction.y / length);
+				directionZ = _mm_set1_ps(light.Direction.z / length);
+			}
+			else
+			{
+				// Falloff at each object's center: taking it at the nearest point of the bounds
+				// (as GetLightImportance does) overstates the light across the rest of the object
+				__m128 dx = _mm_sub_ps(_mm_set1_ps(light.Position.x), _mm_load_ps(centerX));
+				__m128 dy = _mm_sub_ps(_mm_set1_ps(light.Position.y), _mm_load_ps(centerY));
+				__m128 dz = _mm_sub_ps(_mm_set1_ps(light.Position.z), _mm_load_ps(centerZ));
+				__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+				__m128 range = _mm_set1_ps(light.Range);
+				__m128 falloff = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_div_ps(_mm_mul_ps(distance, distance), _mm_mul_ps(range, range)));
+				weight = _mm_and_ps(_mm_cmplt_ps(distance, range), _mm_mul_ps(_mm_set1_ps(light.Intensity), _mm_mul_ps(falloff, falloff)));
+
+				__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(distance, _mm_set1_ps(1e-6f)));
+				directionX = _mm_mul_ps(dx, inverse);
+				directionY = _mm_mul_ps(dy, inverse);
+				directionZ = _mm_mul_ps(dz, inverse);
+			}
+
+			// Leave out the lights each object already gets exactly
+			__m128i index = _mm_set1_epi32((int)i);
+			__m128i isExact = _mm_setzero_si128();
+			for (unsigned int e = 0; e < MAX_OBJECT_LIGHTS; e++)
+			{
+				isExact = _mm_or_si128(isExact, _mm_cmpeq_epi32(index, _mm_load_si128((const __m128i*)exact[e])));
+			}
+			weight = _mm_andnot_ps(_mm_castsi128_ps(isExact), weight);
+			if (_mm_movemask_ps(_mm_cmpgt_ps(weight, zero)) == 0) continue;
+
+			__m128 basis[SH_COEFFICIENTS] = {
+				_mm_set1_ps(1.0f),
+				directionY,
+				directionZ,
+				directionX,
+				_mm_mul_ps(directionX, directionY),
+				_mm_mul_ps(directionY, directionZ),
+				_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(directionZ, directionZ)), _mm_set1_ps(1.0f)),
+				_mm_mul_ps(directionX, directionZ),
+				_mm_sub_ps(_mm_mul_ps(directionX, directionX), _mm_mul_ps(directionY, directionY)),
+			};
+
+			__m128 red = _mm_set1_ps(light.Color.x);
+			__m128 green = _mm_set1_ps(light.Color.y);
+			__m128 blue = _mm_set1_ps(light.Color.z);
+			for (int c = 0; c < SH_COEFFICIENTS; c++)
+			{
+				__m128 scaled = _mm_mul_ps(_mm_mul_ps(basis[c], bands[c]), weight);
+				sh[c][0] = _mm_add_ps(sh[c][0], _mm_mul_ps(scaled, red));
+				sh[c][1] = _mm_add_ps(sh[c][1], _mm_mul_ps(scaled, green));
+				sh[c][2] = _mm_add_ps(sh[c][2], _mm_mul_ps(scaled, blue));
+			}
+		}
+
+		alignas(16) float channels[SH_COEFFICIENTS][3][4];
+		for (int c = 0; c < SH_COEFFICIENTS; c++)
+		{
+			for (int channel = 0; channel < 3; channel++)
+			{
+				_mm_store_ps(channels[c][channel], sh[c][channel]);
+			}
+		}
+		for (unsigned int k = 0; k < groupSize; k++)
+		{
+			for (int c = 0; c < SH_COEFFICIENTS; c++)
+			{
+				_irradiance[first + k].coefficients[c] = XMFLOAT4(channels[c][0][k], channels[c][1][k], channels[c][2][k], 0);
+			}
+		}
+	}
+}
+
+XMFLOAT3 EvaluateSHIrradiance(const SHIrradiance& _irradiance, XMFLOAT3 _normal)
+{
+	const float x = _normal.x, y = _normal.y, z = _normal.z;
+	const float basis[SH_COEFFICIENTS] = {
+		SH_Y0,
+		SH_Y1 * y, SH_Y1 * z, SH_Y1 * x,
+		SH_Y2 * x * y, SH_Y2 * y * z, SH_Y20 * (3 * z * z - 1), SH_Y2 * x * z, SH_Y22 * (x * x - y * y),
+	};
+
+	// L2 rings a little behind strong lights, so it can dip below zero
+	XMFLOAT3 result = XMFLOAT3(0, 0, 0);
+	for (int c = 0; c < SH_COEFFICIENTS; c++)
+	{
+		result.x += _irradiance.coefficients[c].x * basis[c];
+		result.y += _irradiance.coefficients[c].y * basis[c];
+		result.z += _irradiance.coefficients[c].z * basis[c];
+	}
+	return XMFLOAT3(std::max(result.x, 0.0f), std::max(result.y, 0.0f), std::max(result.z, 0.0f));
+}
+
+#pragma region Shader Math
+// --------------------------------------------------------
+// CPU versions of the Lights.hlsli and LightsPBR.hlsli
+// light functions, for measuring the LOD against
+// --------------------------------------------------------
+static XMFLOAT3 Add(XMFLOAT3 _a, XMFLOAT3 _b) { return XMFLOAT3(_a.x + _b.x, _a.y + _b.y, _a.z + _b.z); }
+static XMFLOAT3 Subtract(XMFLOAT3 _a, XMFLOAT3 _b) { return XMFLOAT3(_a.x - _b.x, _a.y - _b.y, _a.z - _b.z); }
+static XMFLOAT3 Multiply(XMFLOAT3 _a, XMFLOAT3 _b) { return XMFLOAT3(_a.x * _b.x, _a.y * _b.y, _a.z * _b.z); }
+static XMFLOAT3 Scale(XMFLOAT3 _a, float _s) { return XMFLOAT3(_a.x * _s, _a.y * _s, _a.z * _s); }
+static float Dot(XMFLOAT3 _a, XMFLOAT3 _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z; }
+static float Saturate(float _value) { return std::min(std::max(_value, 0.0f), 1.0f); }
+
+static XMFLOAT3 Normalize(XMFLOAT3 _a)
+{
+	float length = sqrtf(Dot(_a, _a));
+	return length > 0 ? Scale(_a, 1.0f / length) : _a;
+}
+
+// Direction towards the light and its attenuation at a point
+static float ToLight(const Light& _light, XMFLOAT3 _position, XMFLOAT3& _direction)
+{
+	if (_light.Type == LIGHT_TYPE_DIRECTIONAL)
+	{
+		_direction = Normalize(_light.Direction);
+		return 1.0f;
+	}
+
+	XMFLOAT3 offset = Subtract(_light.Position, _position);
+	_direction = Normalize(offset);
+	float falloff = Saturate(1.0f - Dot(offset, offset) / (_light.Range * _light.Range));
+	return falloff * falloff;
+}
+
+// calculateDirectionalLight / calculatePointLight (the directional version's flipped normal and direction cancel out)
+static XMFLOAT3 StandardLight(const Light& _light, XMFLOAT3 _normal, XMFLOAT3 _view, XMFLOAT3 _position, XMFLOAT3 _surface, float _roughness, float _specularValue)
+{
+	XMFLOAT3 direction;
+	float attenuation = ToLight(_light, _position, direction);
+	float diffuse = Saturate(Dot(_normal, direction));
+
+	float specular = 0;
+	float exponent = (1.0f - _roughness) * 256.0f;
+	if (exponent > 0.05f && diffuse > 0)
+	{
+		XMFLOAT3 reflection = Subtract(Scale(_normal, 2 * Dot(direction, _normal)), direction);
+		specular = powf(Saturate(Dot(reflection, _view)), exponent) * _specularValue;
+	}
+
+	return Scale(Multiply(Add(Scale(_surface, diffuse), XMFLOAT3(specular, specular, specular)), _light.Color), attenuation * _light.Intensity);
+}
+
+// directionalLightPBR / pointLightPBR
+static XMFLOAT3 PBRLight(const Light& _light, XMFLOAT3 _normal, XMFLOAT3 _view, XMFLOAT3 _position, XMFLOAT3 _albedo, float _roughness, float _metalness, XMFLOAT3 _specularColor)
+{
+	XMFLOAT3 direction;
+	float attenuation = ToLight(_light, _position, direction);
+	float diffuse = Saturate(Dot(_normal, direction));
+
+	// MicrofacetBRDF (left at zero where its denominator would be, since the shader's result there is meaningless)
+	XMFLOAT3 specular = XMFLOAT3(0, 0, 0);
+	float denominator = 4 * std::max(Dot(_normal, _view), Dot(_normal, direction));
+	if (denominator > 0)
+	{
+		XMFLOAT3 half = Normalize(Add(_view, direction));
+		float NdotH = Saturate(Dot(_normal, half));
+		float a = _roughness * _roughness;
+		float a2 = std::max(a * a, 0.0000001f);
+		float denomToSquare = NdotH * NdotH * (a2 - 1) + 1;
+		float D = a2 / (3.14159265359f * denomToSquare * denomToSquare);
+
+		float fresnel = powf(1 - Saturate(Dot(_view, half)), 5);
+		XMFLOAT3 F = Add(_specularColor, Scale(Subtract(XMFLOAT3(1, 1, 1), _specularColor), fresnel));
+
+		float k = (_roughness + 1) * (_roughness + 1) / 8.0f;
+		float NdotV = Saturate(Dot(_normal, _view));
+		float G = (NdotV / (NdotV * (1 - k) + k)) * (diffuse / (diffuse * (1 - k) + k));
+		specular = Scale(F, D * G / denominator);
+	}
+
+	// DiffuseEnergyConserve
+	XMFLOAT3 balanced = XMFLOAT3(
+		diffuse * (1 - Saturate(specular.x)) * (1 - _metalness),
+		diffuse * (1 - Saturate(specular.y)) * (1 - _metalness),
+		diffuse * (1 - Saturate(specular.z)) * (1 - _metalness));
+
+	return Scale(Multiply(Add(Multiply(balanced, _albedo), specular), _light.Color), attenuation * _light.Intensity);
+}
+#pragma endregion
+
+void MeasureLightLODError(const std::vector<Light>& _lights, XMFLOAT3 _center, float _radius, XMFLOAT3 _eye, LightLODError* _errors, unsigned int _errorCount)
+{
+	const XMFLOAT3 white = XMFLOAT3(1, 1, 1);
+	const XMFLOAT3 f0 = XMFLOAT3(LIGHTLOD_ERROR_F0, LIGHTLOD_ERROR_F0, LIGHTLOD_ERROR_F0);
+
+	// Every light, evaluated exactly at each sample, is the reference
+	XMFLOAT3 normals[LIGHTLOD_ERROR_SAMPLES];
+	XMFLOAT3 positions[LIGHTLOD_ERROR_SAMPLES];
+	XMFLOAT3 views[LIGHTLOD_ERROR_SAMPLES];
+	std::vector<XMFLOAT3> standardLight(_lights.size() * LIGHTLOD_ERROR_SAMPLES);
+	std::vector<XMFLOAT3> pbrLight(_lights.size() * LIGHTLOD_ERROR_SAMPLES);
+	XMFLOAT3 standardFull[LIGHTLOD_ERROR_SAMPLES] = {};
+	XMFLOAT3 pbrFull[LIGHTLOD_ERROR_SAMPLES] = {};
+	for (int s = 0; s < LIGHTLOD_ERROR_SAMPLES; s++)
+	{
+		// Fibonacci spiral, for evenly spread normals
+		float z = 1.0f - (2.0f * s + 1.0f) / LIGHTLOD_ERROR_SAMPLES;
+		float ring = sqrtf(1.0f - z * z);
+		float angle = 2.399963f * s;
+		normals[s] = XMFLOAT3(cosf(angle) * ring, sinf(angle) * ring, z);
+		positions[s] = Add(_center, Scale(normals[s], _radius));
+		views[s] = Normalize(Subtract(_eye, positions[s]));
+
+		for (size_t i = 0; i < _lights.size(); i++)
+		{
+			XMFLOAT3& standard = standardLight[i * LIGHTLOD_ERROR_SAMPLES + s];
+			XMFLOAT3& pbr = pbrLight[i * LIGHTLOD_ERROR_SAMPLES + s];
+			standard = StandardLight(_lights[i], normals[s], views[s], positions[s], white, LIGHTLOD_ERROR_ROUGHNESS, 1.0f);
+			pbr = PBRLight(_lights[i], normals[s], views[s], positions[s], white, LIGHTLOD_ERROR_ROUGHNESS, 0.0f, f0);
+			standardFull[s] = Add(standardFull[s], standard);
+			pbrFull[s] = Add(pbrFull[s], pbr);
+		}
+	}
+
+	for (unsigned int e = 0; e < _errorCount; e++)
+	{
+		LightLODObject object = {};
+		object.center = _center;
+		object.exactCount = SelectObjectLights(_lights, _center, _radius, object.exactIndices, std::min(_errors[e].exactLights, (unsigned int)MAX_OBJECT_LIGHTS));
+
+		SHIrradiance irradiance;
+		ProjectRemainingLights(_lights, &object, 1, &irradiance);
+
+		// Squared error sums, in the same order as the LightLODError fields
+		double error[4] = {};
+		double reference[2] = {};
+		for (int s = 0; s < LIGHTLOD_ERROR_SAMPLES; s++)
+		{
+			XMFLOAT3 standard = XMFLOAT3(0, 0, 0);
+			XMFLOAT3 pbr = XMFLOAT3(0, 0, 0);
+			for (unsigned int k = 0; k < object.exactCount; k++)
+			{
+				standard = Add(standard, standardLight[object.exactIndices[k] * LIGHTLOD_ERROR_SAMPLES + s]);
+				pbr = Add(pbr, pbrLight[object.exactIndices[k] * LIGHTLOD_ERROR_SAMPLES + s]);
+			}
+
+			// The shaders add the SH as (ambient + sh) * surface, or sh * albedo * (1 - metalness) for PBR
+			XMFLOAT3 sh = EvaluateSHIrradiance(irradiance, normals[s]);
+			XMFLOAT3 results[4] = { Add(standard, sh), standard, Add(pbr, sh), pbr };
+			XMFLOAT3 references[4] = { standardFull[s], standardFull[s], pbrFull[s], pbrFull[s] };
+			for (int r = 0; r < 4; r++)
+			{
+				XMFLOAT3 difference = Subtract(results[r], references[r]);
+				error[r] += Dot(difference, difference);
+			}
+			reference[0] += Dot(standardFull[s], standardFull[s]);
+			reference[1] += Dot(pbrFull[s], pbrFull[s]);
+		}
+
+		_errors[e].standard = reference[0] > 0 ? (float)sqrt(error[0] / reference[0]) : 0;
+		_errors[e].standardDropped = reference[0] > 0 ? (float)sqrt(error[1] / reference[0]) : 0;
+		_errors[e].pbr = reference[1] > 0 ? (float)sqrt(error[2] / reference[1]) : 0;
+		_errors[e].pbrDropped = reference[1] > 0 ? (float)sqrt(error[3] / reference[1]) : 0;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// L2 spherical harmonics: one band-0, three band-1 and five band-2 coefficients
+// - Should match SH_COEFFICIENTS in Defines.hlsli and getIrradianceSH() in Lights.hlsli
+constexpr auto SH_COEFFICIENTS = 9;
+
+// Irradiance as L2 spherical harmonics, with the cosine lobe already folded in,
+// so evaluating it for a normal gives the light a Lambert surface receives
+// (rgb per coefficient, w unused so it uploads as float4s)
+struct SHIrradiance
+{
+	DirectX::XMFLOAT4						coefficients[SH_COEFFICIENTS];
+};
+
+// One object's share of a projection batch
+struct LightLODObject
+{
+	DirectX::XMFLOAT3						center;			// Bounding sphere center (world space)
+	unsigned int							exactCount;		// Lights the object already gets exactly, which are left out
+	unsigned int							exactIndices[MAX_OBJECT_LIGHTS];
+};
+
+// How far an object's lighting drifts from evaluating every light exactly (relative RMS)
+struct LightLODError
+{
+	unsigned int							exactLights;	// K: lights evaluated exactly
+	float									standard;		// Lights.hlsli math, the rest as SH
+	float									standardDropped;// Lights.hlsli math, the rest left out
+	float									pbr;			// LightsPBR.hlsli math, the rest as SH
+	float									pbrDropped;		// LightsPBR.hlsli math, the rest left out
+};
+
+// --------------------------------------------------------
+// Light LOD: every object gets its most important lights
+// exactly (see SelectObjectLights), and the rest that reach
+// it are folded into an L2 spherical harmonics irradiance
+// term, evaluated alongside ambient
+//
+// Each leftover light becomes a direction and strength as
+// seen from the object's center, so the SH only carries
+// diffuse light. Projection runs over four objects at a
+// time with SSE.
+//
+// Nothing here knows about D3D.
+// --------------------------------------------------------
+
+/// <summary>
+/// Projects every light reaching each object, except its exact ones, into SH irradiance
+/// </summary>
+/// <param name="_lights">Every light in the scene</param>
+/// <param name="_objects">The objects to project for</param>
+/// <param name="_count">The number of objects</param>
+/// <param name="_irradiance">Receives one SH irradiance per object</param>
+void ProjectRemainingLights(const std::vector<Light>& _lights, const LightLODObject* _objects, unsigned int _count, SHIrradiance* _irradiance);
+
+/// <summary>
+/// Evaluates SH irradiance for a normal, as getIrradianceSH() does in the shaders
+/// </summary>
+DirectX::XMFLOAT3 EvaluateSHIrradiance(const SHIrradiance& _irradiance, DirectX::XMFLOAT3 _normal);
+
+/// <summary>
+/// Measures the light LOD's error for one object at a few values of K, on points spread over its bounds
+/// </summary>
+/// <param name="_lights">Every light in the scene</param>
+/// <param name="_center">The object's bounding sphere center (world space)</param>
+/// <param name="_radius">The object's bounding sphere radius</param>
+/// <param name="_eye">Where the object is viewed from, for specular</param>
+/// <param name="_errors">Has exactLights set on the way in (at most MAX_OBJECT_LIGHTS); receives the errors</param>
+/// <param name="_errorCount">The number of entries in _errors</param>
+void MeasureLightLODError(const std::vector<Light>& _lights, DirectX::XMFLOAT3 _center, float _radius, DirectX::XMFLOAT3 _eye, LightLODError* _errors, unsigned int _errorCount);
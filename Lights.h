@@ -6,6 +6,10 @@ constexpr auto LIGHT_TYPE_DIRECTIONAL	= 0;
 constexpr auto LIGHT_TYPE_POINT			= 1;
 constexpr auto LIGHT_TYPE_SPOT			= 2;
 
+// The most lights any one object is lit by
+// - Should match MAX_OBJECT_LIGHTS in ConstantBuffers.hlsli
+constexpr auto MAX_OBJECT_LIGHTS		= 8;
+
 struct Light
 {
 	int					Type;
@@ -15,7 +19,9 @@ struct Light
 	float				Intensity;
 	DirectX::XMFLOAT3	Color;
 	float				SpotFalloff;
-	DirectX::XMFLOAT3	Padding;
+	float				Shadowed;		// 1 for the directional light the cascades are drawn from, and for point lights holding atlas tiles
+	float				ShadowIndex;	// A shadowed point light's slot in the atlas (see PointShadowMaps)
+	float				Padding;
 
 	static Light Directional(DirectX::XMFLOAT3 _direction, DirectX::XMFLOAT3 _color, float _intensity)
 	{
@@ -1,26 +1,7 @@
 #ifndef __SHADER_LIGHTS__
 #define __SHADER_LIGHTS__
 
-#define LIGHT_TYPE_DIRECTIONAL	0
-#define LIGHT_TYPE_POINT		1
-#define LIGHT_TYPE_SPOT			2
-
-// Struct representing light data
-// - This should match Lights.h
-struct Light
-{
-	int		Type;
-	float3	Direction;
-
-	float	Range;
-	float3	Position;
-
-	float	Intensity;
-	float3	Color;
-
-	float	SpotFalloff;
-	float3	Padding;
-};
+#include "Defines.hlsli"
 
 // Gets the specular value for any light
 float calculateSpecular(float3 normal, float3 direction, float3 view, float roughness, float diffuse)
@@ -53,4 +34,20 @@ float3 calculatePointLight(Light light, float3 normal, float3 view, float3 world
 	return (diffuse * surfaceColor + specular) * attenuation * light.Intensity * light.Color;
 }
 
+// Gets the irradiance the object's far and weak lights leave on a normal (see LightLOD.h)
+// - L2 spherical harmonics with the cosine lobe folded in; rings can dip below zero, so clamp
+float3 getIrradianceSH(float4 sh[SH_COEFFICIENTS], float3 normal)
+{
+	float3 irradiance = sh[0].rgb * 0.282095f
+		+ sh[1].rgb * (0.488603f * normal.y)
+		+ sh[2].rgb * (0.488603f * normal.z)
+		+ sh[3].rgb * (0.488603f * normal.x)
+		+ sh[4].rgb * (1.092548f * normal.x * normal.y)
+		+ sh[5].rgb * (1.092548f * normal.y * normal.z)
+		+ sh[6].rgb * (0.315392f * (3.0f * normal.z * normal.z - 1.0f))
+		+ sh[7].rgb * (1.092548f * normal.x * normal.z)
+		+ sh[8].rgb * (0.546274f * (normal.x * normal.x - normal.y * normal.y));
+	return max(irradiance, 0);
+}
+
 #endif
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// --------------------------------------------------------
+// A bounded queue any number of threads can push to and pop
+// from without taking a lock
+//
+// Slots form a ring, each stamped with a sequence number that
+// says whether it's ready to be written or read on the current
+// lap around the ring. A thread claims a slot by moving the
+// head (or tail) past it with a compare-exchange, then stamps
+// it for the other side once it's done with the value, so a
+// slow writer only ever holds up the reader of its own slot.
+//
+// Pushing to a full queue or popping from an empty one fails
+// straight away rather than waiting.
+// --------------------------------------------------------
+template <typename T>
+class LockFreeQueue
+{
+public:
+											/// <summary>
+											/// Makes an empty queue
+											/// </summary>
+											/// <param name="_capacity">The most values it can hold (rounded up to a power of two)</param>
+	LockFreeQueue(size_t _capacity)
+	{
+		capacity = 2;
+		while (capacity < _capacity) capacity <<= 1;
+		mask = capacity - 1;
+
+		slots.reset(new Slot[capacity]);
+		for (size_t i = 0; i < capacity; i++)
+		{
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+											/// <summary>
+											/// Moves a value onto the back of the queue
+											/// </summary>
+											/// <returns>Whether there was room (if not, the value is left alone)</returns>
+	bool Push(T& _value)
+	{
+		size_t position = head.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = slots[position & mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t lap = (ptrdiff_t)sequence - (ptrdiff_t)position;
+			if (lap == 0)
+			{
+				if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					slot.value = std::move(_value);
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lap < 0)
+			{
+				// The slot still holds a value from the last lap that nobody has popped
+				return false;
+			}
+			else
+			{
+				position = head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+											/// <summary>
+											/// Moves the value at the front of the queue out
+											/// </summary>
+											/// <returns>Whether there was anything to pop</returns>
+	bool Pop(T& _value)
+	{
+		size_t position = tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Slot& slot = slots[position & mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t lap = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+			if (lap == 0)
+			{
+				if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					_value = std::move(slot.value);
+					slot.sequence.store(position + capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (lap < 0)
+			{
+				// Nothing has been written to the slot on this lap yet
+				return false;
+			}
+			else
+			{
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	size_t GetCapacity()
+	{
+		return capacity;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t>					sequence;
+		T									value;
+	};
+
+	size_t									capacity;
+	size_t									mask;
+	std::unique_ptr<Slot[]>					slots;
+
+	// Kept on their own cache lines, since producers and consumers hammer them from different cores
+	alignas(64) std::atomic<size_t>			head;
+	alignas(64) std::atomic<size_t>			tail;
+};
@@ -0,0 +1,101 @@
+#include "MappedFile.h"
+#include "PathEncoding.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	file = 0;
+	mapping = 0;
+	descriptor = -1;
+	data = 0;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& _path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileW(UTF8PathToWide(_path).c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+	file = handle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart <= 0 || (unsigned long long)fileSize.QuadPart > (size_t)-1)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA(handle, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	size = (size_t)fileSize.QuadPart;
+#else
+	descriptor = open(_path.c_str(), O_RDONLY);
+	if (descriptor < 0) return false;
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* view = mmap(0, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	data = view == MAP_FAILED ? 0 : (const unsigned char*)view;
+	size = (size_t)status.st_size;
+#endif
+
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+#else
+	if (data) munmap((void*)data, size);
+	if (descriptor >= 0) close(descriptor);
+#endif
+	file = 0;
+	mapping = 0;
+	descriptor = -1;
+	data = 0;
+	size = 0;
+}
+
+const unsigned char* MappedFile::GetData()
+{
+	return data;
+}
+
+size_t MappedFile::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --------------------------------------------------------
+// Maps a whole file into memory read-only, so its bytes can
+// be used where they are instead of being read into a buffer
+//
+// Pages only come in from disk (or the file cache) as they're
+// touched, and the mapping goes when this does. Uses file
+// mappings on Windows and mmap elsewhere.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+											/// <summary>
+											/// Maps a file, unmapping whatever was mapped before
+											/// </summary>
+											/// <param name="_path">The full path of the file in UTF-8</param>
+											/// <returns>Whether the file exists, isn't empty and could be mapped</returns>
+	bool									Open(const std::string& _path);
+	void									Close();
+
+	const unsigned char*					GetData();
+	size_t									GetSize();
+
+private:
+	void*									file;				// Windows handles (the file, then its mapping)
+	void*									mapping;
+	int										descriptor;			// Elsewhere
+	const unsigned char*					data;
+	size_t									size;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile&								operator=(const MappedFile&) = delete;
+};
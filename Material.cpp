@@ -1,4 +1,73 @@
 #include "Material.h"
+#include "StateCache.h"
+#include "ContainerTextureLoader.h"
+
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+// Hands out the ids used to group draws by material
+static unsigned int nextMaterialId = 0;
+
+// Lays named resources out by register from the lowest to the highest one used,
+// leaving null in any register in between that the material doesn't fill
+template <typename T>
+static void BuildSlotTable(
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<T>>&	_resources,
+	std::function<int(const std::string&)>							_getSlot,
+	unsigned int&													_startSlot,
+	std::vector<T*>&												_slots)
+{
+	_slots.clear();
+	_startSlot = 0;
+
+	int first = INT_MAX;
+	int last = -1;
+	for (auto& r : _resources)
+	{
+		int slot = _getSlot(r.first);
+		if (slot < 0) continue;
+		if (slot < first) first = slot;
+		if (slot > last) last = slot;
+	}
+	if (last < 0) return;
+
+	_startSlot = (unsigned int)first;
+	_slots.resize(last - first + 1, 0);
+	for (auto& r : _resources)
+	{
+		int slot = _getSlot(r.first);
+		if (slot >= 0) _slots[slot - first] = r.second.Get();
+	}
+}
+
+// Shader variable names for each of the MATPARAM_{names}, in order
+static const char* materialParamNames[MATPARAM_COUNT] = {
+	"tint",
+	"scale",
+	"offset",
+	"roughness",
+	"alpha",
+	"cutoff",
+	"normalIntensity",
+	"rimCutoff",
+	"outlineThickness",
+	"emitAmount",
+	"outlineTint",
+	"rimTint",
+	"hasAlbedoMap",
+	"hasEmissiveMap",
+	"hasSpecularMap",
+	"hasNormalMap",
+	"hasReflectionMap",
+	"hasRampDiffuse",
+	"hasRampSpecular",
+	"hasOrmMap",
+	"metalness",
+	"occlusion",
+	"specularAmount",
+	"emitColor",
+};
 
 Material::Material(
 	int _mode,
@@ -7,9 +76,15 @@ Material::Material(
 	std::shared_ptr<SimpleVertexShader> _vertexShader,
 	std::shared_ptr<SimplePixelShader> _pixelShader)
 {
+	id = nextMaterialId++;
 	mode = _mode;
 	tint = _tint;
+	albedoColor = DirectX::XMFLOAT3(1, 1, 1);
+	specularAmount = 1;
+	emitColor = DirectX::XMFLOAT3(1, 1, 1);
 	roughness = _roughness;
+	metalness = 0;
+	occlusion = 1;
 	normalIntensity = 1.f;
 	alpha = 1;
 	cutoff = 0;
@@ -25,33 +100,70 @@ Material::Material(
 	hasReflectionMap = false;
 	hasRampDiffuse = false;
 	hasRampSpecular = false;
+	hasOrmMap = false;
 	outlineThickness = 1;
 	rimCutoff = 0.075f;
 	rimTint = DirectX::XMFLOAT3(0.5f, 0.5f, 0.5f);
+	outlineTint = DirectX::XMFLOAT3(0, 0, 0);
+	permutationSource = 0;
+
+	ResolveLayout();
+	ResolveHandles();
+	BuildBindingTables();
 }
 
 Material::~Material()
 {
 }
 
-void Material::Activate(Transform* _transform, std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _ambient, std::vector<Light> _lights)
+void Material::Activate(Transform* _transform, const ObjectLightData& _lights)
+{
+	ActivateShaders();
+	ActivateMaterial();
+	ActivateObject(_transform, _lights);
+}
+
+void Material::ActivateShaders()
+{
+	vertexShader->SetShader();
+	pixelShader->SetShader();
+}
+
+void Material::ActivateMaterial()
 {
-	switch (mode)
+	if (materialBuffer == 0) return;
+
+	// The image is kept up to date by the setters, so activating is at most one upload and a bind
+	if (dirty)
 	{
-	case MATTYPE_PBR:
-		ActivatePBR(_transform, _camera, _ambient, _lights);
-		break;
-	case MATTYPE_TOON:
-		ActivateToon(_transform, _camera, _ambient, _lights);
-		break;
-	case MATTYPE_STANDARD:
-	default:
-		ActivateStandard(_transform, _camera, _ambient, _lights);
-		break;
+		context->UpdateSubresource(materialBuffer.Get(), 0, 0, &materialData[0], 0, 0);
+		ISimpleShader::UploadedBytes += materialData.size();
+		dirty = false;
 	}
+	StateCache::GetInstance().PSSetConstantBuffer(materialBufferSlot, materialBuffer.Get());
+	ActivateResources();
+}
+
+void Material::ActivateObject(Transform* _transform, const ObjectLightData& _lights)
+{
+	vertexShader->SetMatrix4x4(worldHandle, _transform->GetWorldMatrix());
+	vertexShader->SetMatrix4x4(worldInvTransposeHandle, _transform->GetWorldMatrixInverseTranspose());
+	vertexShader->CopyAllBufferData();
+
+	// Lights past the count are never read, so whatever the last object left there can stay
+	unsigned int lightCount = (unsigned int)_lights.lightCount;
+	pixelShader->SetFloat(lightCountHandle, _lights.lightCount);
+	if (lightCount > 0) pixelShader->SetData(lightsHandle, _lights.lights, sizeof(Light) * lightCount);
+	pixelShader->SetData(irradianceHandle, _lights.irradiance, sizeof(_lights.irradiance));
+	pixelShader->CopyAllBufferData();
 }
 
 #pragma region Getters
+unsigned int Material::GetId()
+{
+	return id;
+}
+
 DirectX::XMFLOAT3 Material::GetTint()
 {
 	return tint;
@@ -72,6 +184,16 @@ float Material::GetRoughness()
 	return roughness;
 }
 
+float Material::GetMetalness()
+{
+	return metalness;
+}
+
+float Material::GetOcclusion()
+{
+	return occlusion;
+}
+
 float Material::GetAlpha()
 {
 	return alpha;
@@ -121,22 +243,39 @@ std::shared_ptr<SimplePixelShader> Material::GetPixelShader()
 {
 	return pixelShader;
 }
+
+unsigned int Material::GetFeatureBits()
+{
+	unsigned int features = 0;
+	if (hasAlbedoMap) features |= PERMUTATION_ALBEDO;
+	if (hasNormalMap) features |= PERMUTATION_NORMAL;
+	if (hasSpecularMap) features |= PERMUTATION_SPECULAR;
+	if (hasEmissiveMap) features |= PERMUTATION_EMISSIVE;
+	if (hasReflectionMap) features |= PERMUTATION_REFLECTION;
+	if (hasRampDiffuse) features |= PERMUTATION_RAMPDIFFUSE;
+	if (hasRampSpecular) features |= PERMUTATION_RAMPSPECULAR;
+	if (hasOrmMap) features |= PERMUTATION_ORM;
+	return features;
+}
 #pragma endregion
 
 #pragma region Setters
 void Material::SetTint(DirectX::XMFLOAT3 _tint)
 {
 	tint = _tint;
+	WriteTint();
 }
 
 void Material::SetUVScale(DirectX::XMFLOAT2 _scale)
 {
 	uvScale = _scale;
+	WriteParam(MATPARAM_UVSCALE, &uvScale, sizeof(uvScale));
 }
 
 void Material::SetUVOffset(DirectX::XMFLOAT2 _offset)
 {
 	uvOffset = _offset;
+	WriteParam(MATPARAM_UVOFFSET, &uvOffset, sizeof(uvOffset));
 }
 
 void Material::SetRoughness(float _roughness)
@@ -153,56 +292,105 @@ void Material::SetRoughness(float _roughness)
 	{
 		roughness = _roughness;
 	}
+	WriteParam(MATPARAM_ROUGHNESS, &roughness, sizeof(roughness));
+}
+
+void Material::SetMetalness(float _metalness)
+{
+	if (_metalness > 1)
+	{
+		metalness = 1;
+	}
+	else if (_metalness < 0)
+	{
+		metalness = 0;
+	}
+	else
+	{
+		metalness = _metalness;
+	}
+	WriteParam(MATPARAM_METALNESS, &metalness, sizeof(metalness));
+}
+
+void Material::SetOcclusion(float _occlusion)
+{
+	if (_occlusion > 1)
+	{
+		occlusion = 1;
+	}
+	else if (_occlusion < 0)
+	{
+		occlusion = 0;
+	}
+	else
+	{
+		occlusion = _occlusion;
+	}
+	WriteParam(MATPARAM_OCCLUSION, &occlusion, sizeof(occlusion));
 }
 
 void Material::SetAlpha(float _alpha)
 {
 	alpha = _alpha;
+	WriteParam(MATPARAM_ALPHA, &alpha, sizeof(alpha));
 }
 
 void Material::SetCutoff(float _cutoff)
 {
 	cutoff = _cutoff;
+	WriteParam(MATPARAM_CUTOFF, &cutoff, sizeof(cutoff));
 }
 
 void Material::SetNormalIntensity(float _intensity)
 {
 	normalIntensity = _intensity;
+	WriteParam(MATPARAM_NORMALINTENSITY, &normalIntensity, sizeof(normalIntensity));
 }
 
 void Material::SetRimCutoff(float _cutoff)
 {
 	rimCutoff = _cutoff;
+	WriteParam(MATPARAM_RIMCUTOFF, &rimCutoff, sizeof(rimCutoff));
 }
 
 void Material::SetOutlineThickness(float _thickness)
 {
 	outlineThickness = _thickness;
+	WriteParam(MATPARAM_OUTLINETHICKNESS, &outlineThickness, sizeof(outlineThickness));
 }
 
 void Material::SetEmitAmount(DirectX::XMFLOAT3 _emit)
 {
 	emitAmount = _emit;
+	WriteParam(MATPARAM_EMITAMOUNT, &emitAmount, sizeof(emitAmount));
 }
 
 void Material::SetOutlineTint(DirectX::XMFLOAT3 _tint)
 {
 	outlineTint = _tint;
+	WriteParam(MATPARAM_OUTLINETINT, &outlineTint, sizeof(outlineTint));
 }
 
 void Material::SetRimTint(DirectX::XMFLOAT3 _tint)
 {
 	rimTint = _tint;
+	WriteParam(MATPARAM_RIMTINT, &rimTint, sizeof(rimTint));
 }
 
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> _vertexShader)
 {
 	vertexShader = _vertexShader;
+	ResolveHandles();
 }
 
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> _pixelShader)
 {
 	pixelShader = _pixelShader;
+
+	// The new shader's per-material layout and registers may differ, so lay everything out again
+	ResolveLayout();
+	ResolveHandles();
+	BuildBindingTables();
 }
 #pragma endregion
 
@@ -210,143 +398,238 @@ void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> _pixelShader)
 void Material::LoadTexture(const wchar_t* _path, const char* _type, ID3D11Device* _device, ID3D11DeviceContext* _context)
 {
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
-	DirectX::CreateWICTextureFromFile(_device, _context, DXCore::GetFullPathTo_Wide(_path).c_str(), 0, shaderResourceView.GetAddressOf());
-	PushTexture(_type, shaderResourceView);
+	std::wstring fullPath = DXCore::GetFullPathTo_Wide(_path);
 
-	if (_type == TEXTYPE_ALBEDO) hasAlbedoMap = true;
-	else if (_type == TEXTYPE_EMISSIVE) hasEmissiveMap = true;
-	else if (_type == TEXTYPE_SPECULAR) hasSpecularMap = true;
-	else if (_type == TEXTYPE_NORMAL) hasNormalMap = true;
-	else if (_type == TEXTYPE_REFLECTION) hasReflectionMap = true;
-	else if (_type == TEXTYPE_RAMPDIFFUSE) hasRampDiffuse = true;
-	else if (_type == TEXTYPE_RAMPSPECULAR) hasRampSpecular = true;
+	// A pre-built container next to the image already has its mips (and is usually compressed), so it's preferred
+	std::wstring containerPath = ContainerTextureLoader::FindContainer(fullPath);
+	if (containerPath.empty() || !ContainerTextureLoader::Load(_device, containerPath, shaderResourceView))
+		DirectX::CreateWICTextureFromFile(_device, _context, fullPath.c_str(), 0, shaderResourceView.GetAddressOf());
+	PushTexture(_type, shaderResourceView);
 }
 
 void Material::PushSampler(std::string _name, Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampler)
 {
 	samplers.insert({ _name, _sampler });
+	BuildBindingTables();
 }
 
 void Material::PushTexture(std::string _name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _texture)
 {
 	textures.insert({ _name, _texture });
+	BuildBindingTables();
+
+	if (_name == TEXTYPE_ALBEDO) hasAlbedoMap = true;
+	else if (_name == TEXTYPE_EMISSIVE) hasEmissiveMap = true;
+	else if (_name == TEXTYPE_SPECULAR) hasSpecularMap = true;
+	else if (_name == TEXTYPE_NORMAL) hasNormalMap = true;
+	else if (_name == TEXTYPE_REFLECTION) hasReflectionMap = true;
+	else if (_name == TEXTYPE_RAMPDIFFUSE) hasRampDiffuse = true;
+	else if (_name == TEXTYPE_RAMPSPECULAR) hasRampSpecular = true;
+	else if (_name == TEXTYPE_ORM) hasOrmMap = true;
+	WriteMapFlags();
+
+	if (permutations) ApplyPermutation();
 }
 
 void Material::SwapTexture(std::string _name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _newTexture)
 {
 	textures[_name] = _newTexture;
+	BuildBindingTables();
 }
-#pragma endregion
 
-#pragma region Internal Material Activation
-void Material::ActivateStandard(Transform* _transform, std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _ambient, std::vector<Light> _lights)
+void Material::RemoveTexture(std::string _name)
 {
-	vertexShader->SetMatrix4x4("world", _transform->GetWorldMatrix());
-	vertexShader->SetMatrix4x4("worldInvTranspose", _transform->GetWorldMatrixInverseTranspose());
-	vertexShader->SetMatrix4x4("view", _camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", _camera->GetProjectionMatrix());
-	vertexShader->CopyAllBufferData();
-	vertexShader->SetShader();
+	if (textures.erase(_name) == 0) return;
+	BuildBindingTables();
 
-	pixelShader->SetFloat3("cameraPosition", _camera->GetTransform()->GetPosition());
-	pixelShader->SetFloat("roughness", GetRoughness());
-	pixelShader->SetFloat("normalIntensity", GetNormalIntensity());
-	pixelShader->SetFloat("alpha", GetAlpha());
-	pixelShader->SetFloat("cutoff", GetCutoff());
-	pixelShader->SetFloat2("scale", GetUVScale());
-	pixelShader->SetFloat2("offset", GetUVOffset());
-	pixelShader->SetFloat3("ambient", _ambient);
-	pixelShader->SetFloat3("emitAmount", GetEmitAmount());
-	pixelShader->SetFloat3("tint", GetTint());
-	pixelShader->SetFloat("lightCount", (int)_lights.size());
-	pixelShader->SetInt("hasAlbedoMap", (int)hasAlbedoMap);
-	pixelShader->SetInt("hasEmissiveMap", (int)hasEmissiveMap);
-	pixelShader->SetInt("hasSpecularMap", (int)hasSpecularMap);
-	pixelShader->SetInt("hasNormalMap", (int)hasNormalMap);
-	pixelShader->SetInt("hasReflectionMap", (int)hasReflectionMap);
-	pixelShader->SetData("lights", &_lights[0], sizeof(Light) * (int)_lights.size());
-	pixelShader->CopyAllBufferData();
-	pixelShader->SetShader();
+	if (_name == TEXTYPE_ALBEDO) hasAlbedoMap = false;
+	else if (_name == TEXTYPE_EMISSIVE) hasEmissiveMap = false;
+	else if (_name == TEXTYPE_SPECULAR) hasSpecularMap = false;
+	else if (_name == TEXTYPE_NORMAL) hasNormalMap = false;
+	else if (_name == TEXTYPE_REFLECTION) hasReflectionMap = false;
+	else if (_name == TEXTYPE_RAMPDIFFUSE) hasRampDiffuse = false;
+	else if (_name == TEXTYPE_RAMPSPECULAR) hasRampSpecular = false;
+	else if (_name == TEXTYPE_ORM) hasOrmMap = false;
+	WriteMapFlags();
 
-	for (auto& t : textures)
+	if (permutations) ApplyPermutation();
+}
+
+bool Material::ReplaceTextureWithConstant(std::string _name, const unsigned char _texel[4])
+{
+	if (_name == TEXTYPE_ALBEDO)
 	{
-		pixelShader->SetShaderResourceView(t.first.c_str(), t.second.Get());
+		// Only an opaque one: the shader discards by the map's alpha, which a constant can't stand in for
+		if (_texel[3] != 255 || paramOffsets[MATPARAM_TINT] < 0) return false;
+		albedoColor = DirectX::XMFLOAT3(powf(_texel[0] / 255.f, 2.2f), powf(_texel[1] / 255.f, 2.2f), powf(_texel[2] / 255.f, 2.2f));
+		WriteTint();
 	}
-	for (auto& s : samplers)
+	else if (_name == TEXTYPE_SPECULAR)
 	{
-		pixelShader->SetSamplerState(s.first.c_str(), s.second.Get());
+		if (paramOffsets[MATPARAM_SPECULARAMOUNT] < 0) return false;
+		specularAmount = _texel[0] / 255.f;
+		WriteParam(MATPARAM_SPECULARAMOUNT, &specularAmount, sizeof(specularAmount));
 	}
+	else if (_name == TEXTYPE_EMISSIVE)
+	{
+		if (paramOffsets[MATPARAM_EMITCOLOR] < 0) return false;
+		emitColor = DirectX::XMFLOAT3(_texel[0] / 255.f, _texel[1] / 255.f, _texel[2] / 255.f);
+		WriteParam(MATPARAM_EMITCOLOR, &emitColor, sizeof(emitColor));
+	}
+	else
+	{
+		return false;
+	}
+
+	RemoveTexture(_name);
+	return true;
 }
 
-void Material::ActivatePBR(Transform* _transform, std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _ambient, std::vector<Light> _lights)
+void Material::UsePermutations(std::shared_ptr<PermutationCache> _permutations, unsigned int _sourceId)
 {
-	vertexShader->SetMatrix4x4("world", _transform->GetWorldMatrix());
-	vertexShader->SetMatrix4x4("worldInvTranspose", _transform->GetWorldMatrixInverseTranspose());
-	vertexShader->SetMatrix4x4("view", _camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", _camera->GetProjectionMatrix());
-	vertexShader->CopyAllBufferData();
-	vertexShader->SetShader();
+	// Remember the shader the material was made with, which branches on the map flags and works for any of them
+	if (!permutations) basePixelShader = pixelShader;
 
-	pixelShader->SetFloat2("scale", GetUVScale());
-	pixelShader->SetFloat2("offset", GetUVOffset());
-	pixelShader->SetFloat3("cameraPosition", _camera->GetTransform()->GetPosition());
-	pixelShader->SetFloat("normalIntensity", GetNormalIntensity());
-	pixelShader->SetFloat("lightCount", (int)_lights.size());
-	pixelShader->SetData("lights", &_lights[0], sizeof(Light) * (int)_lights.size());
-	pixelShader->CopyAllBufferData();
-	pixelShader->SetShader();
+	permutations = _permutations;
+	permutationSource = _sourceId;
+	if (permutations)
+		ApplyPermutation();
+	else if (basePixelShader != pixelShader)
+		SetPixelShader(basePixelShader);
+}
+#pragma endregion
+
+#pragma region Internal Material Layout
+void Material::ResolveLayout()
+{
+	materialData.clear();
+	materialBuffer.Reset();
+	dirty = false;
+	for (int i = 0; i < MATPARAM_COUNT; i++)
+	{
+		paramOffsets[i] = -1;
+	}
+
+	const SimpleConstantBuffer* bufferInfo = pixelShader->GetBufferInfo(CBUFFER_PERMATERIAL);
+	if (bufferInfo == 0) return;
 
-	for (auto& t : textures)
+	// The material owns its own copy of the buffer, so the shader shouldn't upload or bind one
+	pixelShader->SetBufferExternal(CBUFFER_PERMATERIAL);
+	materialBuffer = pixelShader->CreateCompatibleBuffer(CBUFFER_PERMATERIAL);
+	materialBufferSlot = bufferInfo->BindIndex;
+	context = pixelShader->GetDeviceContext();
+	materialData.resize(bufferInfo->Size, 0);
+
+	// Look each parameter up once; only the ones in the per-material buffer have a place in the image
+	unsigned int bufferIndex = 0;
+	for (unsigned int b = 0; b < pixelShader->GetBufferCount(); b++)
+	{
+		if (pixelShader->GetBufferInfo(b) == bufferInfo) bufferIndex = b;
+	}
+	for (int i = 0; i < MATPARAM_COUNT; i++)
 	{
-		pixelShader->SetShaderResourceView(t.first.c_str(), t.second.Get());
+		const SimpleShaderVariable* variable = pixelShader->GetVariableInfo(materialParamNames[i]);
+		if (variable != 0 && variable->ConstantBufferIndex == bufferIndex)
+		{
+			paramOffsets[i] = variable->ByteOffset;
+		}
 	}
-	for (auto& s : samplers)
+
+	WriteTint();
+	WriteParam(MATPARAM_UVSCALE, &uvScale, sizeof(uvScale));
+	WriteParam(MATPARAM_UVOFFSET, &uvOffset, sizeof(uvOffset));
+	WriteParam(MATPARAM_ROUGHNESS, &roughness, sizeof(roughness));
+	WriteParam(MATPARAM_METALNESS, &metalness, sizeof(metalness));
+	WriteParam(MATPARAM_OCCLUSION, &occlusion, sizeof(occlusion));
+	WriteParam(MATPARAM_ALPHA, &alpha, sizeof(alpha));
+	WriteParam(MATPARAM_CUTOFF, &cutoff, sizeof(cutoff));
+	WriteParam(MATPARAM_NORMALINTENSITY, &normalIntensity, sizeof(normalIntensity));
+	WriteParam(MATPARAM_RIMCUTOFF, &rimCutoff, sizeof(rimCutoff));
+	WriteParam(MATPARAM_OUTLINETHICKNESS, &outlineThickness, sizeof(outlineThickness));
+	WriteParam(MATPARAM_EMITAMOUNT, &emitAmount, sizeof(emitAmount));
+	WriteParam(MATPARAM_OUTLINETINT, &outlineTint, sizeof(outlineTint));
+	WriteParam(MATPARAM_RIMTINT, &rimTint, sizeof(rimTint));
+	WriteParam(MATPARAM_SPECULARAMOUNT, &specularAmount, sizeof(specularAmount));
+	WriteParam(MATPARAM_EMITCOLOR, &emitColor, sizeof(emitColor));
+	WriteMapFlags();
+	dirty = true;
+}
+
+void Material::WriteParam(int _param, const void* _data, unsigned int _size)
+{
+	// Parameters the shader doesn't use have nowhere to go
+	int offset = paramOffsets[_param];
+	if (offset < 0 || offset + _size > materialData.size()) return;
+
+	memcpy(&materialData[offset], _data, _size);
+	dirty = true;
+}
+
+void Material::WriteMapFlags()
+{
+	// The shaders take the flags as ints
+	int flags[] = {
+		(int)hasAlbedoMap,
+		(int)hasEmissiveMap,
+		(int)hasSpecularMap,
+		(int)hasNormalMap,
+		(int)hasReflectionMap,
+		(int)hasRampDiffuse,
+		(int)hasRampSpecular,
+		(int)hasOrmMap,
+	};
+	for (int i = 0; i < 8; i++)
 	{
-		pixelShader->SetSamplerState(s.first.c_str(), s.second.Get());
+		WriteParam(MATPARAM_HASALBEDOMAP + i, &flags[i], sizeof(int));
 	}
 }
 
-void Material::ActivateToon(Transform* _transform, std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _ambient, std::vector<Light> _lights)
+void Material::WriteTint()
 {
-	vertexShader->SetMatrix4x4("world", _transform->GetWorldMatrix());
-	vertexShader->SetMatrix4x4("worldInvTranspose", _transform->GetWorldMatrixInverseTranspose());
-	vertexShader->SetMatrix4x4("view", _camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", _camera->GetProjectionMatrix());
-	vertexShader->CopyAllBufferData();
-	vertexShader->SetShader();
+	// The shader multiplies the tint by the albedo map's texel, so without a map it gets the product
+	DirectX::XMFLOAT3 surface = DirectX::XMFLOAT3(tint.x * albedoColor.x, tint.y * albedoColor.y, tint.z * albedoColor.z);
+	WriteParam(MATPARAM_TINT, &surface, sizeof(surface));
+}
 
-	pixelShader->SetFloat3("cameraPosition", _camera->GetTransform()->GetPosition());
-	pixelShader->SetFloat("roughness", GetRoughness());
-	pixelShader->SetFloat("normalIntensity", GetNormalIntensity());
-	pixelShader->SetFloat("alpha", GetAlpha());
-	pixelShader->SetFloat("cutoff", GetCutoff());
-	pixelShader->SetFloat2("scale", GetUVScale());
-	pixelShader->SetFloat2("offset", GetUVOffset());
-	pixelShader->SetFloat3("ambient", _ambient);
-	pixelShader->SetFloat3("emitAmount", GetEmitAmount());
-	pixelShader->SetFloat3("tint", GetTint());
-	pixelShader->SetFloat3("rimTint", GetRimTint());
-	pixelShader->SetFloat3("outlineTint", GetOutlineTint());
-	pixelShader->SetFloat("outlineThickness", GetOutlineThickness());
-	pixelShader->SetFloat("rimCutoff", GetRimCutoff());
-	pixelShader->SetFloat("lightCount", (int)_lights.size());
-	pixelShader->SetInt("hasAlbedoMap", (int)hasAlbedoMap);
-	pixelShader->SetInt("hasEmissiveMap", (int)hasEmissiveMap);
-	pixelShader->SetInt("hasSpecularMap", (int)hasSpecularMap);
-	pixelShader->SetInt("hasNormalMap", (int)hasNormalMap);
-	pixelShader->SetInt("hasRampDiffuse", (int)hasRampDiffuse);
-	pixelShader->SetInt("hasRampSpecular", (int)hasRampSpecular);
-	pixelShader->SetData("lights", &_lights[0], sizeof(Light) * (int)_lights.size());
-	pixelShader->CopyAllBufferData();
-	pixelShader->SetShader();
+void Material::ResolveHandles()
+{
+	worldHandle = vertexShader->GetVariableHandle("world");
+	worldInvTransposeHandle = vertexShader->GetVariableHandle("worldInvTranspose");
+	lightCountHandle = pixelShader->GetVariableHandle("lightCount");
+	lightsHandle = pixelShader->GetVariableHandle("lights");
+	irradianceHandle = pixelShader->GetVariableHandle("lightIrradiance");
+}
 
-	for (auto& t : textures)
+void Material::BuildBindingTables()
+{
+	// The maps own the resources; the tables are what actually gets bound each activation
+	BuildSlotTable<ID3D11ShaderResourceView>(textures, [this](const std::string& _name)
 	{
-		pixelShader->SetShaderResourceView(t.first.c_str(), t.second.Get());
-	}
-	for (auto& s : samplers)
+		const SimpleSRV* info = pixelShader->GetShaderResourceViewInfo(_name);
+		return info == 0 ? -1 : (int)info->BindIndex;
+	}, textureStartSlot, textureSlots);
+
+	BuildSlotTable<ID3D11SamplerState>(samplers, [this](const std::string& _name)
 	{
-		pixelShader->SetSamplerState(s.first.c_str(), s.second.Get());
-	}
+		const SimpleSampler* info = pixelShader->GetSamplerInfo(_name);
+		return info == 0 ? -1 : (int)info->BindIndex;
+	}, samplerStartSlot, samplerSlots);
+}
+#pragma endregion
+
+#pragma region Internal Material Activation
+void Material::ApplyPermutation()
+{
+	// If the variant didn't compile, fall back to the original shader
+	std::shared_ptr<SimplePixelShader> variant = permutations->Get(permutationSource, GetFeatureBits());
+	if (!variant) variant = basePixelShader;
+	if (variant != pixelShader) SetPixelShader(variant);
+}
+
+void Material::ActivateResources()
+{
+	StateCache& cache = StateCache::GetInstance();
+	if (!textureSlots.empty()) cache.PSSetShaderResources(textureStartSlot, (UINT)textureSlots.size(), &textureSlots[0]);
+	if (!samplerSlots.empty()) cache.PSSetSamplers(samplerStartSlot, (UINT)samplerSlots.size(), &samplerSlots[0]);
 }
 #pragma endregion
@@ -3,11 +3,14 @@
 #include <DirectXMath.h>
 #include <memory>
 #include <functional>
+#include <vector>
 #include "DXCore.h"
 #include "SimpleShader.h"
 #include "Transform.h"
 #include "Camera.h"
 #include "Lights.h"
+#include "ConstantBuffers.h"
+#include "ShaderPermutations.h"
 #include "WICTextureLoader.h"
 
 constexpr auto TEXTYPE_ALBEDO = "Albedo";
@@ -17,6 +20,7 @@ constexpr auto TEXTYPE_SPECULAR = "Specular";
 constexpr auto TEXTYPE_REFLECTION = "Reflection";
 constexpr auto TEXTYPE_ROUGHNESS = "Roughness";
 constexpr auto TEXTYPE_METALNESS = "Metalness";
+constexpr auto TEXTYPE_ORM = "ORM";
 constexpr auto TEXTYPE_RAMPDIFFUSE = "RampDiffuse";
 constexpr auto TEXTYPE_RAMPSPECULAR = "RampSpecular";
 
@@ -24,6 +28,32 @@ constexpr auto MATTYPE_STANDARD = 0;
 constexpr auto MATTYPE_PBR = 1;
 constexpr auto MATTYPE_TOON = 2;
 
+constexpr auto MATPARAM_TINT = 0;
+constexpr auto MATPARAM_UVSCALE = 1;
+constexpr auto MATPARAM_UVOFFSET = 2;
+constexpr auto MATPARAM_ROUGHNESS = 3;
+constexpr auto MATPARAM_ALPHA = 4;
+constexpr auto MATPARAM_CUTOFF = 5;
+constexpr auto MATPARAM_NORMALINTENSITY = 6;
+constexpr auto MATPARAM_RIMCUTOFF = 7;
+constexpr auto MATPARAM_OUTLINETHICKNESS = 8;
+constexpr auto MATPARAM_EMITAMOUNT = 9;
+constexpr auto MATPARAM_OUTLINETINT = 10;
+constexpr auto MATPARAM_RIMTINT = 11;
+constexpr auto MATPARAM_HASALBEDOMAP = 12;
+constexpr auto MATPARAM_HASEMISSIVEMAP = 13;
+constexpr auto MATPARAM_HASSPECULARMAP = 14;
+constexpr auto MATPARAM_HASNORMALMAP = 15;
+constexpr auto MATPARAM_HASREFLECTIONMAP = 16;
+constexpr auto MATPARAM_HASRAMPDIFFUSE = 17;
+constexpr auto MATPARAM_HASRAMPSPECULAR = 18;
+constexpr auto MATPARAM_HASORMMAP = 19;
+constexpr auto MATPARAM_METALNESS = 20;
+constexpr auto MATPARAM_OCCLUSION = 21;
+constexpr auto MATPARAM_SPECULARAMOUNT = 22;
+constexpr auto MATPARAM_EMITCOLOR = 23;
+constexpr auto MATPARAM_COUNT = 24;
+
 class Material
 {
 public:
@@ -36,22 +66,35 @@ public:
 	~Material();
 
 											/// <summary>
-											/// Prepares a material before drawing a mesh
+											/// Prepares a material before drawing a mesh (per-frame data such as the camera and lights must already be bound)
 											/// </summary>
 											/// <param name="_transform">The transform of the entity that the material is associated with</param>
-											/// <param name="_camera">The camera rendering the entity this material is associated with</param>
-											/// <param name="_ambient">The ambient lighting value</param>
-											/// <param name="_lights">The lights that are affecting this object</param>
-	void									Activate(
-												Transform* _transform,
-												std::shared_ptr<Camera> _camera,
-												DirectX::XMFLOAT3 _ambient,
-												std::vector<Light> _lights);
+											/// <param name="_lights">The lights reaching the entity</param>
+	void									Activate(Transform* _transform, const ObjectLightData& _lights);
+											/// <summary>
+											/// Binds the material's vertex and pixel shaders (only needed when the previous draw used a different pair)
+											/// </summary>
+	void									ActivateShaders();
+											/// <summary>
+											/// Binds the per-material constants, textures and samplers, re-uploading the constants if the material changed since
+											/// (only needed when the previous draw used a different material)
+											/// </summary>
+	void									ActivateMaterial();
+											/// <summary>
+											/// Sets and uploads the per-object shader values
+											/// </summary>
+											/// <param name="_transform">The transform of the entity being drawn</param>
+											/// <param name="_lights">The lights reaching the entity (only the first lightCount are uploaded)</param>
+	void									ActivateObject(Transform* _transform, const ObjectLightData& _lights);
+
+	unsigned int							GetId();
 
 	DirectX::XMFLOAT3						GetTint();
 	DirectX::XMFLOAT2						GetUVScale();
 	DirectX::XMFLOAT2						GetUVOffset();
 	float									GetRoughness();
+	float									GetMetalness();
+	float									GetOcclusion();
 	float									GetAlpha();
 	float									GetCutoff();
 	float									GetNormalIntensity();
@@ -62,11 +105,17 @@ public:
 	DirectX::XMFLOAT3						GetRimTint();
 	std::shared_ptr<SimpleVertexShader>		GetVertexShader();
 	std::shared_ptr<SimplePixelShader>		GetPixelShader();
+											/// <summary>
+											/// Gets the PERMUTATION_{features} the material's textures call for
+											/// </summary>
+	unsigned int							GetFeatureBits();
 
 	void									SetTint(DirectX::XMFLOAT3 _tint);
 	void									SetUVScale(DirectX::XMFLOAT2 _scale);
 	void									SetUVOffset(DirectX::XMFLOAT2 _offset);
 	void									SetRoughness(float _roughness);
+	void									SetMetalness(float _metalness);
+	void									SetOcclusion(float _occlusion);
 	void									SetAlpha(float _alpha);
 	void									SetCutoff(float _cutoff);
 	void									SetNormalIntensity(float _intensity);
@@ -104,7 +153,27 @@ public:
 											/// <param name="_name">The type of texture this is (see TEXTYPE_{types}; should match shader Texture2D buffers)</param>
 											/// <param name="_texture">The texture to swap with</param>
 	void									SwapTexture(std::string _name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _newTexture);
+											/// <summary>
+											/// Takes a texture off the material, clearing its map flag (for maps turned into constants)
+											/// </summary>
+											/// <param name="_name">The type of texture this is (see TEXTYPE_{types})</param>
+	void									RemoveTexture(std::string _name);
+											/// <summary>
+											/// Takes a map of one color off the material and has the shader read that color as a constant instead
+											/// (an opaque albedo map scales the tint; specular and emissive maps have constants of their own)
+											/// </summary>
+											/// <param name="_name">The type of texture this is (see TEXTYPE_{types})</param>
+											/// <param name="_texel">The map's one texel, as RGBA bytes</param>
+											/// <returns>Whether the shader has a constant for it; if not, the map is left as it is</returns>
+	bool									ReplaceTextureWithConstant(std::string _name, const unsigned char _texel[4]);
+											/// <summary>
+											/// Switches the pixel shader to the variant matching the material's features, and keeps it matched as textures are added
+											/// </summary>
+											/// <param name="_permutations">The cache to get variants from (null to go back to the original shader)</param>
+											/// <param name="_sourceId">The cache's id for the shader source the material uses</param>
+	void									UsePermutations(std::shared_ptr<PermutationCache> _permutations, unsigned int _sourceId);
 
+											// Map flags are set by LoadTexture/PushTexture, which also write them into the parameter block
 	bool									hasAlbedoMap;
 	bool									hasEmissiveMap;
 	bool									hasSpecularMap;
@@ -112,26 +181,52 @@ public:
 	bool									hasReflectionMap;
 	bool									hasRampDiffuse;
 	bool									hasRampSpecular;
+	bool									hasOrmMap;
 private:
-	void									ActivateStandard(
-												Transform* _transform,
-												std::shared_ptr<Camera> _camera,
-												DirectX::XMFLOAT3 _ambient,
-												std::vector<Light> _lights);
-	void									ActivatePBR(
-												Transform* _transform,
-												std::shared_ptr<Camera> _camera,
-												DirectX::XMFLOAT3 _ambient,
-												std::vector<Light> _lights);
-	void									ActivateToon(
-												Transform* _transform,
-												std::shared_ptr<Camera> _camera,
-												DirectX::XMFLOAT3 _ambient,
-												std::vector<Light> _lights);
+											/// <summary>
+											/// Looks up where each parameter lives in the pixel shader's per-material buffer and rebuilds the block
+											/// </summary>
+	void									ResolveLayout();
+											/// <summary>
+											/// Copies a parameter into the block if the shader uses it
+											/// </summary>
+											/// <param name="_param">The parameter to write (see MATPARAM_{names})</param>
+											/// <param name="_data">The value to write</param>
+											/// <param name="_size">The size of the value in bytes</param>
+	void									WriteParam(int _param, const void* _data, unsigned int _size);
+	void									WriteMapFlags();
+	void									WriteTint();
+											/// <summary>
+											/// Looks up the vertex shader handles for the per-object matrices
+											/// </summary>
+	void									ResolveHandles();
+											/// <summary>
+											/// Lays the textures and samplers out by the pixel shader's registers, so each set binds in one call
+											/// </summary>
+	void									BuildBindingTables();
+	void									ActivateResources();
+	void									ApplyPermutation();
 
+	unsigned int							id;
+	bool									dirty;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>	materialBuffer;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+	unsigned int							materialBufferSlot;
+	std::vector<unsigned char>				materialData;
+	int										paramOffsets[MATPARAM_COUNT];
+	SimpleShaderHandle						worldHandle;
+	SimpleShaderHandle						worldInvTransposeHandle;
+	SimpleShaderHandle						lightCountHandle;
+	SimpleShaderHandle						lightsHandle;
+	SimpleShaderHandle						irradianceHandle;
 	int										mode;
 	DirectX::XMFLOAT3						tint;
+	DirectX::XMFLOAT3						albedoColor;		// An albedo map's one color, in linear space, which the tint is scaled by once the map is gone
+	float									specularAmount;		// What the shader reads without a specular map
+	DirectX::XMFLOAT3						emitColor;			// What the shader reads without an emissive map
 	float									roughness;
+	float									metalness;
+	float									occlusion;
 	float									alpha;
 	float									cutoff;
 	float									normalIntensity;
@@ -144,7 +239,14 @@ private:
 	DirectX::XMFLOAT2						uvOffset;
 	std::shared_ptr<SimpleVertexShader>		vertexShader;
 	std::shared_ptr<SimplePixelShader>		pixelShader;
+	std::shared_ptr<SimplePixelShader>		basePixelShader;
+	std::shared_ptr<PermutationCache>		permutations;
+	unsigned int							permutationSource;
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>>			samplers;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>	textures;
+	unsigned int							samplerStartSlot;
+	std::vector<ID3D11SamplerState*>		samplerSlots;
+	unsigned int							textureStartSlot;
+	std::vector<ID3D11ShaderResourceView*>	textureSlots;
 };
@@ -1,10 +1,16 @@
 #include "Mesh.h"
+#include "StateCache.h"
 
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
 using namespace DirectX;
 
+// Hands out the ids used to group draws by mesh
+static unsigned int nextMeshId = 0;
+
 Mesh::Mesh(Vertex* _vertices, int _vertexCount, unsigned int* _indices, int _indexCount, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
 {
 	CreateMesh(_vertices, _vertexCount, _indices, _indexCount, _device, _context);
@@ -326,6 +332,8 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 
 void Mesh::CreateMesh(Vertex* _vertices, int _vertexCount, unsigned int* _indices, int _indexCount, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
 {
+	id = nextMeshId++;
+
 	// Create the VERTEX BUFFER description
 	D3D11_BUFFER_DESC vbd = {};
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -361,6 +369,30 @@ void Mesh::CreateMesh(Vertex* _vertices, int _vertexCount, unsigned int* _indice
 	_device->CreateBuffer(&ibd, &initialIndexData, bufferIndex.GetAddressOf());
 
 	deviceContext = _context;
+
+	// Keep a local-space bounding sphere around for culling and distance checks
+	BoundingSphere::CreateFromPoints(bounds, _vertexCount, &_vertices[0].Position, sizeof(Vertex));
+
+	// How stretched the UVs are over the surface, for picking which texture mips the mesh needs on screen
+	double uvArea = 0;
+	double surfaceArea = 0;
+	for (int i = 0; i + 2 < _indexCount; i += 3)
+	{
+		const Vertex& a = _vertices[_indices[i]];
+		const Vertex& b = _vertices[_indices[i + 1]];
+		const Vertex& c = _vertices[_indices[i + 2]];
+		float uvCross = (b.UV.x - a.UV.x) * (c.UV.y - a.UV.y) - (c.UV.x - a.UV.x) * (b.UV.y - a.UV.y);
+		XMFLOAT3 edge1(b.Position.x - a.Position.x, b.Position.y - a.Position.y, b.Position.z - a.Position.z);
+		XMFLOAT3 edge2(c.Position.x - a.Position.x, c.Position.y - a.Position.y, c.Position.z - a.Position.z);
+		XMFLOAT3 cross(edge1.y * edge2.z - edge1.z * edge2.y, edge1.z * edge2.x - edge1.x * edge2.z, edge1.x * edge2.y - edge1.y * edge2.x);
+		uvArea += fabsf(uvCross) * 0.5;
+		surfaceArea += sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z) * 0.5;
+	}
+	uvDensity = surfaceArea > 0 ? (float)sqrt(uvArea / surfaceArea) : 0;
+
+	// Triangle centroids for sorting transparent draws; the sorted index buffer is only made when first needed
+	triangleSorter = std::make_shared<TriangleSorter>(&_vertices[0].Position, (unsigned int)sizeof(Vertex), _indices, (unsigned int)_indexCount);
+	sortedBucket = -1;
 }
 
 Mesh::~Mesh()
@@ -369,14 +401,73 @@ Mesh::~Mesh()
 }
 
 void Mesh::Draw()
+{
+	Bind();
+	DrawIndexed();
+}
+
+void Mesh::Bind()
 {
 	// Set buffers in the input assembler
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	deviceContext->IASetVertexBuffers(0, 1, bufferVertex.GetAddressOf(), &stride, &offset);
-	deviceContext->IASetIndexBuffer(bufferIndex.Get(), DXGI_FORMAT_R32_UINT, 0);
+	StateCache& cache = StateCache::GetInstance();
+	cache.IASetVertexBuffer(0, bufferVertex.Get(), sizeof(Vertex), 0);
+	cache.IASetIndexBuffer(bufferIndex.Get(), DXGI_FORMAT_R32_UINT, 0);
+}
+
+bool Mesh::BindSorted(XMFLOAT3 _viewDirection)
+{
+	int bucket = TriangleSorter::GetBucket(_viewDirection);
+	bool uploaded = false;
+
+	if (!bufferSortedIndex)
+	{
+		D3D11_BUFFER_DESC ibd = {};
+		ibd.Usage = D3D11_USAGE_DYNAMIC;
+		ibd.ByteWidth = sizeof(unsigned int) * countIndex;
+		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		Microsoft::WRL::ComPtr<ID3D11Device> device;
+		deviceContext->GetDevice(device.GetAddressOf());
+		device->CreateBuffer(&ibd, 0, bufferSortedIndex.GetAddressOf());
+	}
+
+	// Entities sharing this mesh from the same bucket reuse what's already in the buffer
+	if (bufferSortedIndex && bucket != sortedBucket)
+	{
+		const std::vector<unsigned int>& sorted = triangleSorter->GetIndices(bucket);
 
-	// Do the actual drawing
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		HRESULT hr = deviceContext->Map(bufferSortedIndex.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+		if (SUCCEEDED(hr))
+		{
+			memcpy(mapped.pData, sorted.data(), sizeof(unsigned int) * sorted.size());
+			deviceContext->Unmap(bufferSortedIndex.Get(), 0);
+			sortedBucket = bucket;
+			uploaded = true;
+		}
+		else
+		{
+			// Whatever the buffer held is gone or was never there
+			sortedBucket = -1;
+		}
+	}
+
+	// Without an order in the buffer, the mesh's own indices are drawn unsorted
+	StateCache& cache = StateCache::GetInstance();
+	cache.IASetVertexBuffer(0, bufferVertex.Get(), sizeof(Vertex), 0);
+	cache.IASetIndexBuffer(sortedBucket == bucket ? bufferSortedIndex.Get() : bufferIndex.Get(), DXGI_FORMAT_R32_UINT, 0);
+	return uploaded;
+}
+
+TriangleSortStats Mesh::GetTriangleSortStats()
+{
+	return triangleSorter->GetStats();
+}
+
+void Mesh::DrawIndexed()
+{
+	// Do the actual drawing, assuming the buffers are already bound
 	deviceContext->DrawIndexed(
 		countIndex, // The number of indices to use (we could draw a subset if we wanted)
 		0,          // Offset to the first index we want to use
@@ -397,3 +488,18 @@ int Mesh::GetIndexCount()
 {
 	return countIndex;
 }
+
+unsigned int Mesh::GetId()
+{
+	return id;
+}
+
+DirectX::BoundingSphere Mesh::GetBounds()
+{
+	return bounds;
+}
+
+float Mesh::GetUVDensity()
+{
+	return uvDensity;
+}
@@ -2,7 +2,10 @@
 
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <DirectXCollision.h>
+#include <memory>
 #include "Vertex.h"
+#include "TriangleSorter.h"
 
 class Mesh
 {
@@ -21,15 +24,33 @@ public:
 	~Mesh();
 
 	void                                            Draw();
+	void                                            Bind();
+	void                                            DrawIndexed();
+	// Binds the vertex buffer with the triangles ordered back-to-front for a local-space
+	// direction towards the camera; returns whether the order had to be uploaded
+	bool                                            BindSorted(DirectX::XMFLOAT3 _viewDirection);
+	TriangleSortStats                               GetTriangleSortStats();
+	unsigned int                                    GetId();
 	Microsoft::WRL::ComPtr<ID3D11Buffer>*           GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer>*           GetIndexBuffer();
 	int                                             GetIndexCount();
+	DirectX::BoundingSphere                         GetBounds();
+	// UV units per local-space unit across the surface (the square root of UV area over surface area)
+	float                                           GetUVDensity();
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer>            bufferVertex;
 	Microsoft::WRL::ComPtr<ID3D11Buffer>            bufferIndex;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext>     deviceContext;
 	int                                             countIndex;
+	unsigned int                                    id;
+	DirectX::BoundingSphere                         bounds;
+	float                                           uvDensity;
+
+	// Back-to-front triangle orders, and the dynamic index buffer holding the last one used
+	std::shared_ptr<TriangleSorter>                 triangleSorter;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>            bufferSortedIndex;
+	int                                             sortedBucket;
 
 	void											CalculateTangents(
 														Vertex*										_verts,
@@ -0,0 +1,686 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MIP_GENERATOR_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MIP_GENERATOR_TARGET_AVX2
+#else
+#define MIP_GENERATOR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	// How far the windowed sinc filters reach either side of a texel, in texels of the mip being made
+	const double FILTER_RADIUS = 3;
+	const double KAISER_ALPHA = 4;
+	const double PI = 3.14159265358979323846;
+
+	// Roughly how many texels of a new mip one job makes: enough rows that the rows above they share aren't filtered over and over,
+	// few enough that a level splits into jobs for every thread
+	const unsigned int TEXELS_PER_JOB = 32768;
+
+	// The source texels one axis of a mip reads from, for each of its texels
+	struct FilterTaps
+	{
+		unsigned int						count;				// Taps per texel, padded with zero weights to the most any texel needs (and to an even number)
+		std::vector<unsigned int>			indices;			// Source texel of each tap, texel by texel
+		std::vector<float>					weights;
+		std::vector<unsigned char>			adjacent;			// Whether each texel's taps are side by side in the source, so two load at once
+		std::vector<float>					adjacentWeights;	// For those: each even tap's weight four times, then the odd tap's after it
+		std::vector<float>					pairedWeights;		// For two texels at once: each tap's weight for the first four times, then for the second
+	};
+
+	// What the shaders' pow(2.2) turns each 8 bit value into, and back
+	struct GammaTables
+	{
+		float								linear[256];
+		float								thresholds[256];	// The linear value from which each byte rounds up to the next
+		int									buckets[25 << 8];	// The byte at the start of each range of float bits (exponent and top mantissa bits), up to 1
+		unsigned int						steps;				// The most bytes any value in a range is past the range's start
+
+		GammaTables()
+		{
+			for (int i = 0; i < 256; i++)
+			{
+				linear[i] = (float)pow(i / 255.0, 2.2);
+				thresholds[i] = i < 255 ? (float)pow((i + 0.5) / 255.0, 2.2) : 2.0f;
+			}
+			steps = 0;
+			for (unsigned int i = 0; i < (25u << 8); i++)
+			{
+				unsigned int bits = (i + (103u << 8)) << 15;
+				float value;
+				memcpy(&value, &bits, sizeof(value));
+				int byte = 0;
+				while (value >= thresholds[byte]) byte++;
+				buckets[i] = byte;
+				if (i > 0) steps = std::max(steps, (unsigned int)(byte - buckets[i - 1]));
+			}
+		}
+
+		unsigned char Encode(float _value) const
+		{
+			if (!(_value >= thresholds[0])) return 0;
+			if (_value >= 1) return 255;
+
+			// Values from the smallest threshold up have exponents 103 to 126, so the bucket is close; at most a byte or two short
+			unsigned int bits;
+			memcpy(&bits, &_value, sizeof(bits));
+			int byte = buckets[(bits >> 15) - (103u << 8)];
+			while (_value >= thresholds[byte]) byte++;
+			return (unsigned char)byte;
+		}
+	};
+
+	const GammaTables& GetGammaTables()
+	{
+		static GammaTables tables;
+		return tables;
+	}
+
+	unsigned char ToByte(float _value)
+	{
+		return (unsigned char)std::min(std::max(_value * 255 + 0.5f, 0.0f), 255.0f);
+	}
+
+	double Sinc(double _x)
+	{
+		if (fabs(_x) < 1e-9) return 1;
+		return sin(PI * _x) / (PI * _x);
+	}
+
+	double BesselI0(double _x)
+	{
+		// The series converges quickly for the small arguments a Kaiser window uses
+		double sum = 1;
+		double term = 1;
+		for (int k = 1; k < 32; k++)
+		{
+			term *= (_x / (2 * k)) * (_x / (2 * k));
+			sum += term;
+			if (term < sum * 1e-12) break;
+		}
+		return sum;
+	}
+
+	double Kernel(MipFilter _filter, double _x)
+	{
+		if (fabs(_x) >= FILTER_RADIUS) return 0;
+		if (_filter == MipFilter::Lanczos) return Sinc(_x) * Sinc(_x / FILTER_RADIUS);
+
+		double window = _x / FILTER_RADIUS;
+		return Sinc(_x) * BesselI0(KAISER_ALPHA * sqrt(1 - window * window)) / BesselI0(KAISER_ALPHA);
+	}
+
+	FilterTaps BuildTaps(unsigned int _source, unsigned int _destination, MipFilter _filter, bool _wrap)
+	{
+		std::vector<std::vector<std::pair<unsigned int, double>>> texels(_destination);
+		double scale = (double)_source / _destination;
+		for (unsigned int x = 0; x < _destination; x++)
+		{
+			std::vector<std::pair<int, double>> taps;
+			if (_source == _destination)
+			{
+				// An axis already 1 texel long stays as it is
+				taps.push_back({ (int)x, 1.0 });
+			}
+			else if (_filter == MipFilter::Box)
+			{
+				// Each source texel counts for as much of it as the new texel covers
+				double left = x * scale;
+				double right = (x + 1) * scale;
+				for (int s = (int)floor(left); s < (int)ceil(right); s++)
+				{
+					double overlap = std::min(s + 1.0, right) - std::max((double)s, left);
+					if (overlap > 0) taps.push_back({ s, overlap });
+				}
+			}
+			else
+			{
+				double center = (x + 0.5) * scale;
+				for (int s = (int)floor(center - FILTER_RADIUS * scale); s <= (int)ceil(center + FILTER_RADIUS * scale); s++)
+				{
+					double weight = Kernel(_filter, (s + 0.5 - center) / scale);
+					if (weight != 0) taps.push_back({ s, weight });
+				}
+			}
+
+			double sum = 0;
+			for (auto& tap : taps) sum += tap.second;
+			for (auto& tap : taps)
+			{
+				int index = tap.first;
+				if (_wrap) index = ((index % (int)_source) + (int)_source) % (int)_source;
+				else index = std::min(std::max(index, 0), (int)_source - 1);
+				texels[x].push_back({ (unsigned int)index, tap.second / sum });
+			}
+		}
+
+		FilterTaps filter = {};
+		for (auto& taps : texels) filter.count = std::max(filter.count, (unsigned int)taps.size());
+		filter.count += filter.count & 1;
+		filter.indices.resize((size_t)_destination * filter.count);
+		filter.weights.resize((size_t)_destination * filter.count);
+		filter.adjacent.resize(_destination);
+		filter.adjacentWeights.resize((size_t)_destination * filter.count * 4);
+		for (unsigned int x = 0; x < _destination; x++)
+		{
+			unsigned int* indices = filter.indices.data() + (size_t)x * filter.count;
+			float* weights = filter.weights.data() + (size_t)x * filter.count;
+			filter.adjacent[x] = 1;
+			for (unsigned int k = 0; k < filter.count; k++)
+			{
+				bool padding = k >= texels[x].size();
+				indices[k] = padding ? texels[x].back().first : texels[x][k].first;
+				weights[k] = padding ? 0.0f : (float)texels[x][k].second;
+				if (indices[k] != indices[0] + k) filter.adjacent[x] = 0;
+				for (int c = 0; c < 4; c++) filter.adjacentWeights[((size_t)x * filter.count + k) * 4 + c] = weights[k];
+			}
+		}
+
+		filter.pairedWeights.resize((size_t)(_destination / 2) * filter.count * 8);
+		for (unsigned int pair = 0; pair < _destination / 2; pair++)
+		{
+			for (unsigned int k = 0; k < filter.count; k++)
+			{
+				float* weights = filter.pairedWeights.data() + ((size_t)pair * filter.count + k) * 8;
+				for (int c = 0; c < 4; c++)
+				{
+					weights[c] = filter.weights[(size_t)(pair * 2) * filter.count + k];
+					weights[c + 4] = filter.weights[(size_t)(pair * 2 + 1) * filter.count + k];
+				}
+			}
+		}
+		return filter;
+	}
+
+	// Filters one row of RGBA floats along its length
+	void FilterRow(const float* _source, float* _destination, const FilterTaps& _taps, unsigned int _first, unsigned int _end)
+	{
+		for (unsigned int x = _first; x < _end; x++)
+		{
+			const unsigned int* indices = _taps.indices.data() + (size_t)x * _taps.count;
+			const float* weights = _taps.weights.data() + (size_t)x * _taps.count;
+			// Even and odd taps are summed apart, as the vector loops do
+			float evenSums[4] = {};
+			float oddSums[4] = {};
+			for (unsigned int k = 0; k < _taps.count; k += 2)
+			{
+				const float* even = _source + (size_t)indices[k] * 4;
+				const float* odd = _source + (size_t)indices[k + 1] * 4;
+				for (int c = 0; c < 4; c++)
+				{
+					evenSums[c] += even[c] * weights[k];
+					oddSums[c] += odd[c] * weights[k + 1];
+				}
+			}
+			for (int c = 0; c < 4; c++) _destination[(size_t)x * 4 + c] = evenSums[c] + oddSums[c];
+		}
+	}
+
+	// Weighs whole rows together into one
+	void FilterColumns(const float* const* _rows, const float* _weights, unsigned int _count, float* _destination, size_t _first, size_t _end)
+	{
+		for (size_t i = _first; i < _end; i++)
+		{
+			float sum = 0;
+			for (unsigned int k = 0; k < _count; k++) sum += _rows[k][i] * _weights[k];
+			_destination[i] = sum;
+		}
+	}
+
+#ifdef MIP_GENERATOR_AVX2
+	MIP_GENERATOR_TARGET_AVX2 void FilterRowAVX2(const float* _source, float* _destination, const FilterTaps& _taps, unsigned int _width)
+	{
+		unsigned int x = 0;
+		while (x < _width)
+		{
+			if (_taps.adjacent[x])
+			{
+				// Two neighbouring taps per load, even ones in the low half; the halves are added at the end
+				const float* source = _source + (size_t)_taps.indices[(size_t)x * _taps.count] * 4;
+				const float* weights = _taps.adjacentWeights.data() + (size_t)x * _taps.count * 4;
+				__m256 sums = _mm256_setzero_ps();
+				for (unsigned int k = 0; k < _taps.count; k += 2)
+				{
+					sums = _mm256_add_ps(sums, _mm256_mul_ps(_mm256_loadu_ps(source + k * 4), _mm256_loadu_ps(weights + k * 4)));
+				}
+				_mm_storeu_ps(_destination + (size_t)x * 4, _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1)));
+				x++;
+				continue;
+			}
+			if (x % 2 != 0 || x + 1 >= _width)
+			{
+				FilterRow(_source, _destination, _taps, x, x + 1);
+				x++;
+				continue;
+			}
+
+			// Texels near a wrapped or clamped edge, two at a time
+			const unsigned int* first = _taps.indices.data() + (size_t)x * _taps.count;
+			const unsigned int* second = first + _taps.count;
+			const float* weights = _taps.pairedWeights.data() + (size_t)(x / 2) * _taps.count * 8;
+			__m256 evenSums = _mm256_setzero_ps();
+			__m256 oddSums = _mm256_setzero_ps();
+			for (unsigned int k = 0; k < _taps.count; k += 2)
+			{
+				__m256 even = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(_source + (size_t)first[k] * 4)), _mm_loadu_ps(_source + (size_t)second[k] * 4), 1);
+				__m256 odd = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(_source + (size_t)first[k + 1] * 4)), _mm_loadu_ps(_source + (size_t)second[k + 1] * 4), 1);
+				evenSums = _mm256_add_ps(evenSums, _mm256_mul_ps(even, _mm256_loadu_ps(weights + k * 8)));
+				oddSums = _mm256_add_ps(oddSums, _mm256_mul_ps(odd, _mm256_loadu_ps(weights + (k + 1) * 8)));
+			}
+			_mm256_storeu_ps(_destination + (size_t)x * 4, _mm256_add_ps(evenSums, oddSums));
+			x += 2;
+		}
+	}
+
+	MIP_GENERATOR_TARGET_AVX2 void FilterColumnsAVX2(const float* const* _rows, const float* _weights, unsigned int _count, float* _destination, size_t _length)
+	{
+		size_t i = 0;
+		for (; i + 8 <= _length; i += 8)
+		{
+			__m256 sums = _mm256_setzero_ps();
+			for (unsigned int k = 0; k < _count; k++)
+			{
+				sums = _mm256_add_ps(sums, _mm256_mul_ps(_mm256_loadu_ps(_rows[k] + i), _mm256_set1_ps(_weights[k])));
+			}
+			_mm256_storeu_ps(_destination + i, sums);
+		}
+		FilterColumns(_rows, _weights, _count, _destination, i, _length);
+	}
+#endif
+
+	// Brings filtered texels back into range (renormalizing normals), keeping the floats for the next level and storing bytes
+	void FinishRow(float* _texels, unsigned char* _bytes, unsigned int _first, unsigned int _end, MipContent _content)
+	{
+		const GammaTables& gamma = GetGammaTables();
+		for (unsigned int x = _first; x < _end; x++)
+		{
+			float* texel = _texels + (size_t)x * 4;
+			unsigned char* bytes = _bytes + (size_t)x * 4;
+			texel[3] = std::min(std::max(texel[3], 0.0f), 1.0f);
+			bytes[3] = ToByte(texel[3]);
+
+			if (_content == MipContent::Normal)
+			{
+				// Filtering shortens the normals where they disagree; put them back to unit length
+				float length = sqrtf(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+				for (int c = 0; c < 3; c++)
+				{
+					texel[c] = length > 1e-6f ? texel[c] / length : (c == 2 ? 1.0f : 0.0f);
+					bytes[c] = ToByte(texel[c] * 0.5f + 0.5f);
+				}
+				continue;
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				texel[c] = std::min(std::max(texel[c], 0.0f), 1.0f);
+				bytes[c] = _content == MipContent::Color ? gamma.Encode(texel[c]) : ToByte(texel[c]);
+			}
+		}
+	}
+
+#ifdef MIP_GENERATOR_AVX2
+	MIP_GENERATOR_TARGET_AVX2 inline __m256i ToBytesAVX2(__m256 _values)
+	{
+		__m256 scaled = _mm256_add_ps(_mm256_mul_ps(_values, _mm256_set1_ps(255)), _mm256_set1_ps(0.5f));
+		return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), _mm256_set1_ps(255)));
+	}
+
+	// Two texels of FinishRow: the floats are updated in place, and their bytes returned as ints
+	MIP_GENERATOR_TARGET_AVX2 inline __m256i FinishTexelsAVX2(float* _texels, MipContent _content, const GammaTables& _gamma)
+	{
+		const __m256 alpha = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+		__m256 texels = _mm256_loadu_ps(_texels);
+		__m256 clamped = _mm256_min_ps(_mm256_max_ps(texels, _mm256_setzero_ps()), _mm256_set1_ps(1));
+
+		if (_content == MipContent::Normal)
+		{
+			__m256 length = _mm256_sqrt_ps(_mm256_dp_ps(texels, texels, 0x77));
+			__m256 normal = _mm256_blendv_ps(_mm256_setr_ps(0, 0, 1, 0, 0, 0, 1, 0), _mm256_div_ps(texels, length), _mm256_cmp_ps(length, _mm256_set1_ps(1e-6f), _CMP_GT_OQ));
+			normal = _mm256_blendv_ps(normal, clamped, alpha);
+			_mm256_storeu_ps(_texels, normal);
+			__m256 encoded = _mm256_add_ps(_mm256_mul_ps(normal, _mm256_set1_ps(0.5f)), _mm256_set1_ps(0.5f));
+			return ToBytesAVX2(_mm256_blendv_ps(encoded, clamped, alpha));
+		}
+
+		_mm256_storeu_ps(_texels, clamped);
+		__m256i bytes = ToBytesAVX2(clamped);
+		if (_content == MipContent::Linear) return bytes;
+
+		// Gamma.Encode for all eight at once: the range's byte, then up to steps thresholds further
+		__m256i bucket = _mm256_max_epi32(_mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(clamped), 15), _mm256_set1_epi32(103 << 8)), _mm256_setzero_si256());
+		__m256i encoded = _mm256_i32gather_epi32(_gamma.buckets, bucket, 4);
+		for (unsigned int step = 0; step < _gamma.steps; step++)
+		{
+			__m256 threshold = _mm256_i32gather_ps(_gamma.thresholds, encoded, 4);
+			encoded = _mm256_sub_epi32(encoded, _mm256_castps_si256(_mm256_cmp_ps(clamped, threshold, _CMP_GE_OQ)));
+		}
+		return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(encoded), _mm256_castsi256_ps(bytes), alpha));
+	}
+
+	MIP_GENERATOR_TARGET_AVX2 void FinishRowAVX2(float* _texels, unsigned char* _bytes, unsigned int _width, MipContent _content)
+	{
+		const GammaTables& gamma = GetGammaTables();
+		unsigned int x = 0;
+		for (; x + 4 <= _width; x += 4)
+		{
+			__m256i first = FinishTexelsAVX2(_texels + (size_t)x * 4, _content, gamma);
+			__m256i second = FinishTexelsAVX2(_texels + (size_t)x * 4 + 8, _content, gamma);
+
+			// Packing works within each half, leaving the texels' bytes in the order 0, 2, 1, 3
+			__m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(first, second), _mm256_setzero_si256());
+			packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+			_mm_storeu_si128((__m128i*)(_bytes + (size_t)x * 4), _mm256_castsi256_si128(packed));
+		}
+		FinishRow(_texels, _bytes, x, _width, _content);
+	}
+#endif
+
+	// A level's texels as filtering expects them (linear colors, normals from -1 to 1)
+	void ExpandRow(const unsigned char* _bytes, float* _texels, unsigned int _width, const float (*_table)[256])
+	{
+		for (unsigned int x = 0; x < _width; x++, _bytes += 4, _texels += 4)
+		{
+			_texels[0] = _table[0][_bytes[0]];
+			_texels[1] = _table[1][_bytes[1]];
+			_texels[2] = _table[2][_bytes[2]];
+			_texels[3] = _table[3][_bytes[3]];
+		}
+	}
+
+	// Lets the pool's threads wait for each other between passes
+	class Meeting
+	{
+	public:
+		Meeting(unsigned int _count) : count(_count), arrived(0), generation(0) {}
+
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			unsigned int current = generation;
+			if (++arrived == count)
+			{
+				arrived = 0;
+				generation++;
+				allArrived.notify_all();
+				return;
+			}
+			allArrived.wait(lock, [&] { return generation != current; });
+		}
+
+	private:
+		std::mutex							mutex;
+		std::condition_variable				allArrived;
+		unsigned int						count;
+		unsigned int						arrived;
+		unsigned int						generation;
+	};
+}
+
+MipGenerator::MipGenerator(unsigned int _threads)
+{
+	threads = _threads < 1 ? 1 : _threads;
+	avx2 = HasAVX2();
+}
+
+MipGenerator::~MipGenerator()
+{
+}
+
+void MipGenerator::Generate(std::vector<DecodedImage>& _mips, MipSettings _settings, MipStats* _stats)
+{
+	std::vector<std::vector<DecodedImage>> slices(1);
+	slices[0].push_back(std::move(_mips[0]));
+	Generate(slices, _settings, _stats);
+	_mips = std::move(slices[0]);
+}
+
+bool MipGenerator::Generate(std::vector<std::vector<DecodedImage>>& _slices, MipSettings _settings, MipStats* _stats)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (_slices.empty()) return true;
+	for (auto& slice : _slices)
+	{
+		slice.resize(1);
+		if (slice[0].width != _slices[0][0].width || slice[0].height != _slices[0][0].height) return false;
+	}
+
+	// Every level's size, and the taps between each and the next
+	std::vector<unsigned int> widths(1, _slices[0][0].width);
+	std::vector<unsigned int> heights(1, _slices[0][0].height);
+	while (widths.back() > 1 || heights.back() > 1)
+	{
+		widths.push_back(widths.back() > 1 ? widths.back() / 2 : 1);
+		heights.push_back(heights.back() > 1 ? heights.back() / 2 : 1);
+	}
+	unsigned int levels = (unsigned int)widths.size();
+	std::vector<FilterTaps> rowTaps(levels);
+	std::vector<FilterTaps> columnTaps(levels);
+	unsigned long long texels = 0;
+	for (unsigned int level = 1; level < levels; level++)
+	{
+		rowTaps[level] = BuildTaps(widths[level - 1], widths[level], _settings.filter, _settings.wrap);
+		columnTaps[level] = BuildTaps(heights[level - 1], heights[level], _settings.filter, _settings.wrap);
+		texels += (unsigned long long)widths[level - 1] * heights[level - 1] * _slices.size();
+	}
+
+	// Each slice's mips, plus floats for the level being read (odd levels in one buffer, even in the other)
+	struct SliceBuffers
+	{
+		std::vector<float>					levels[2];
+	};
+	std::vector<SliceBuffers> buffers(_slices.size());
+	for (size_t s = 0; s < _slices.size(); s++)
+	{
+		_slices[s].resize(levels);
+		for (unsigned int level = 1; level < levels; level++)
+		{
+			_slices[s][level].width = widths[level];
+			_slices[s][level].height = heights[level];
+			_slices[s][level].pixels.resize((size_t)widths[level] * heights[level] * 4);
+		}
+		if (levels > 2) buffers[s].levels[1].resize((size_t)widths[1] * heights[1] * 4);
+		if (levels > 3) buffers[s].levels[0].resize((size_t)widths[2] * heights[2] * 4);
+	}
+
+	float table[4][256];
+	const GammaTables& gamma = GetGammaTables();
+	for (int c = 0; c < 4; c++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			if (c == 3 || _settings.content == MipContent::Linear) table[c][i] = i / 255.0f;
+			else if (_settings.content == MipContent::Color) table[c][i] = gamma.linear[i];
+			else table[c][i] = i / 127.5f - 1;
+		}
+	}
+
+	// Each level is split into bands of rows from every slice; a band filters the rows above it it needs, then its columns
+	std::vector<unsigned int> rowsPerJob(levels);
+	std::vector<unsigned int> jobsPerSlice(levels);
+	unsigned int workers = 1;
+	for (unsigned int level = 1; level < levels; level++)
+	{
+		rowsPerJob[level] = std::max(1u, TEXELS_PER_JOB / widths[level]);
+		jobsPerSlice[level] = (heights[level] + rowsPerJob[level] - 1) / rowsPerJob[level];
+		workers = std::max(workers, std::min(threads, jobsPerSlice[level] * (unsigned int)_slices.size()));
+	}
+	std::unique_ptr<std::atomic<unsigned int>[]> nextJobs(new std::atomic<unsigned int>[levels]);
+	for (unsigned int level = 0; level < levels; level++) nextJobs[level].store(0);
+	Meeting meeting(workers);
+	bool useAVX2 = avx2;
+
+	auto work = [&]()
+	{
+		std::vector<float> expanded;
+		std::vector<float> filtered;
+		std::vector<int> slots;
+		std::vector<unsigned int> sourceRows;
+		std::vector<const float*> rows;
+		for (unsigned int level = 1; level < levels; level++)
+		{
+			unsigned int sourceWidth = widths[level - 1];
+			unsigned int width = widths[level];
+			const FilterTaps& taps = columnTaps[level];
+			unsigned int jobs = jobsPerSlice[level] * (unsigned int)_slices.size();
+			slots.assign(heights[level - 1], -1);
+			rows.resize(taps.count);
+
+			for (unsigned int job = nextJobs[level]++; job < jobs; job = nextJobs[level]++)
+			{
+				size_t s = job / jobsPerSlice[level];
+				unsigned int first = (job % jobsPerSlice[level]) * rowsPerJob[level];
+				unsigned int end = std::min(first + rowsPerJob[level], heights[level]);
+
+				// Every row of the level above the band's columns reach, each filtered once
+				sourceRows.clear();
+				for (size_t i = (size_t)first * taps.count; i < (size_t)end * taps.count; i++)
+				{
+					if (slots[taps.indices[i]] >= 0) continue;
+					slots[taps.indices[i]] = (int)sourceRows.size();
+					sourceRows.push_back(taps.indices[i]);
+				}
+				if (filtered.size() < sourceRows.size() * width * 4) filtered.resize(sourceRows.size() * width * 4);
+
+				for (size_t slot = 0; slot < sourceRows.size(); slot++)
+				{
+					// The top level is still bytes, so its rows are expanded as they're needed
+					const float* source;
+					if (level == 1)
+					{
+						expanded.resize((size_t)sourceWidth * 4);
+						ExpandRow(_slices[s][0].pixels.data() + (size_t)sourceRows[slot] * sourceWidth * 4, expanded.data(), sourceWidth, table);
+						source = expanded.data();
+					}
+					else source = buffers[s].levels[(level - 1) & 1].data() + (size_t)sourceRows[slot] * sourceWidth * 4;
+
+					float* destination = filtered.data() + slot * width * 4;
+#ifdef MIP_GENERATOR_AVX2
+					if (useAVX2)
+					{
+						FilterRowAVX2(source, destination, rowTaps[level], width);
+						continue;
+					}
+#endif
+					FilterRow(source, destination, rowTaps[level], 0, width);
+				}
+
+				// The last level's floats aren't needed, so it's filtered in the scratch row after the band's
+				bool keep = level + 1 < levels;
+				if (!keep && filtered.size() < (sourceRows.size() + 1) * width * 4) filtered.resize((sourceRows.size() + 1) * width * 4);
+				for (unsigned int y = first; y < end; y++)
+				{
+					for (unsigned int k = 0; k < taps.count; k++)
+					{
+						rows[k] = filtered.data() + (size_t)slots[taps.indices[(size_t)y * taps.count + k]] * width * 4;
+					}
+					float* destination = keep ? buffers[s].levels[level & 1].data() + (size_t)y * width * 4 : filtered.data() + sourceRows.size() * width * 4;
+					const float* weights = taps.weights.data() + (size_t)y * taps.count;
+					unsigned char* bytes = _slices[s][level].pixels.data() + (size_t)y * width * 4;
+#ifdef MIP_GENERATOR_AVX2
+					if (useAVX2)
+					{
+						FilterColumnsAVX2(rows.data(), weights, taps.count, destination, (size_t)width * 4);
+						FinishRowAVX2(destination, bytes, width, _settings.content);
+						continue;
+					}
+#endif
+					FilterColumns(rows.data(), weights, taps.count, destination, 0, (size_t)width * 4);
+					FinishRow(destination, bytes, 0, width, _settings.content);
+				}
+
+				for (unsigned int row : sourceRows) slots[row] = -1;
+			}
+			meeting.Wait();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 1; i < workers; i++)
+	{
+		pool.push_back(std::thread(work));
+	}
+	work();
+	for (auto& thread : pool)
+	{
+		thread.join();
+	}
+
+	if (_stats)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		_stats->milliseconds = elapsed.count();
+		_stats->texels = texels;
+		_stats->megapixelsPerSecond = elapsed.count() > 0 ? texels / (elapsed.count() * 1000) : 0;
+		_stats->threads = workers;
+		_stats->avx2 = useAVX2;
+	}
+	return true;
+}
+
+void MipGenerator::SetAVX2(bool _enabled)
+{
+	avx2 = _enabled && HasAVX2();
+}
+
+MipSettings MipGenerator::GetSettings(const std::string& _path)
+{
+	std::string name = _path.substr(_path.find_last_of("/\\") + 1);
+	std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower(c); });
+
+	if (name.find("normal") != std::string::npos) return { MipContent::Normal, MipFilter::Kaiser, true };
+	if (name.find("roughness") != std::string::npos || name.find("metal") != std::string::npos || name.find("specular") != std::string::npos)
+		return { MipContent::Linear, MipFilter::Kaiser, true };
+
+	// Lighting ramps are looked up, not tiled, so their ends mustn't bleed into each other
+	if (name.find("ramp") != std::string::npos) return { MipContent::Linear, MipFilter::Kaiser, false };
+	return { MipContent::Color, MipFilter::Kaiser, true };
+}
+
+const char* MipGenerator::GetFilterName(MipFilter _filter)
+{
+	switch (_filter)
+	{
+	case MipFilter::Box: return "box";
+	case MipFilter::Kaiser: return "Kaiser";
+	case MipFilter::Lanczos: return "Lanczos";
+	}
+	return "";
+}
+
+bool MipGenerator::HasAVX2()
+{
+#if defined(MIP_GENERATOR_AVX2) && defined(_MSC_VER)
+	// AVX2 needs the OS to save the wide registers too
+	static bool supported = []()
+	{
+		int info[4];
+		__cpuid(info, 1);
+		if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28))) return false;
+		if ((_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}();
+	return supported;
+#elif defined(MIP_GENERATOR_AVX2)
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "PngDecoder.h"
+
+// How each mip's texels are weighed from the level above
+enum class MipFilter
+{
+	Box,													// The 2x2 (or, at odd sizes, 3x3) texels each one covers, by area
+	Kaiser,													// Kaiser windowed sinc over 3 texels of the new mip either side, sharp with little ringing
+	Lanczos,												// Lanczos 3, sharper still, ringing a little more on hard edges
+};
+
+// What a texture's texels hold, which decides how they're averaged
+enum class MipContent
+{
+	Color,													// Gamma encoded (as the shaders' pow(2.2) expects), so filtered in linear space
+	Linear,													// Data stored as is (roughness, metalness...)
+	Normal,													// Unit vectors in RGB, renormalized after filtering
+};
+
+struct MipSettings
+{
+	MipContent								content;
+	MipFilter								filter;
+	bool									wrap;				// Whether filters reach across edges to the other side (tiling textures) or clamp (cube faces, decals)
+};
+
+struct MipStats
+{
+	double									milliseconds;
+	double									megapixelsPerSecond;// Texels filtered (every level's source, over every slice) per second
+	unsigned long long						texels;
+	unsigned int							threads;
+	bool									avx2;				// Whether the filters ran eight floats at a time
+};
+
+// --------------------------------------------------------
+// Builds mip chains on the CPU, from the top level down to 1x1
+//
+// Texels are turned into floats (linear ones, for colors) and
+// each level is filtered from the one above at full precision,
+// separably: rows first, into a scratch image a new mip wide,
+// then columns. Only then are they clamped, normals brought
+// back to unit length and the result stored as RGBA8 again.
+// Each output texel's taps are worked out once per axis, with
+// their weights normalized, so odd sizes (where a level is
+// less than half the size of the one above) come out right.
+//
+// Rows of every slice of a level are shared out over a pool
+// of threads, which meet between passes; slices of an array
+// or cube map are filtered side by side. Where the CPU has
+// AVX2, both passes run two RGBA texels per instruction,
+// adding taps in the same order as the plain loop so either
+// way gives the same bytes.
+//
+// Nothing here knows about D3D; TextureLoader, TextureCooker
+// and Game::CreateCubemap hand it decoded images.
+// --------------------------------------------------------
+class MipGenerator
+{
+public:
+											/// <summary>
+											/// Makes a generator
+											/// </summary>
+											/// <param name="_threads">The number of threads to filter on (1 runs on the caller's thread alone)</param>
+	MipGenerator(unsigned int _threads);
+	~MipGenerator();
+
+											/// <summary>
+											/// Fills in every mip after the first
+											/// </summary>
+											/// <param name="_mips">Holds the top mip going in, and the whole chain coming out</param>
+											/// <param name="_settings">The content of the texture and the filter to use</param>
+											/// <param name="_stats">Receives timings, if not null</param>
+	void									Generate(std::vector<DecodedImage>& _mips, MipSettings _settings, MipStats* _stats = 0);
+											/// <summary>
+											/// Fills in every mip after the first of each slice of an array (or each face of a cube map)
+											/// </summary>
+											/// <param name="_slices">Each slice's top mip going in (all the same size), and its whole chain coming out</param>
+											/// <returns>Whether the slices were all the same size</returns>
+	bool									Generate(std::vector<std::vector<DecodedImage>>& _slices, MipSettings _settings, MipStats* _stats = 0);
+											/// <summary>
+											/// Turns AVX2 off (or back on, where the CPU has it), to compare the two
+											/// </summary>
+	void									SetAVX2(bool _enabled);
+
+											/// <summary>
+											/// Picks the content for a texture from its file name (_normals, _roughness...), filtering with Kaiser and wrapping
+											/// </summary>
+	static MipSettings						GetSettings(const std::string& _path);
+	static const char*						GetFilterName(MipFilter _filter);
+											/// <summary>
+											/// Gets whether the CPU (and OS) can run AVX2
+											/// </summary>
+	static bool								HasAVX2();
+
+private:
+	unsigned int							threads;
+	bool									avx2;
+};
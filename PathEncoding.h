@@ -0,0 +1,113 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+// --------------------------------------------------------
+// Converts between the wide paths Windows hands out and the
+// UTF-8 that loaders, caches and registries keep them in, so
+// every character survives and two paths only match if they
+// really are the same
+//
+// wchar_t is UTF-16 on Windows and UTF-32 elsewhere. A lone
+// surrogate (which Windows file names can hold) is written
+// as its own three bytes, so every wide path comes back the
+// same; bytes that aren't UTF-8 read back as U+FFFD
+// --------------------------------------------------------
+inline std::string WidePathToUTF8(const std::wstring& _path)
+{
+	std::string utf8;
+	utf8.reserve(_path.size());
+	for (size_t i = 0; i < _path.size(); i++)
+	{
+		unsigned long code = (unsigned long)_path[i];
+		if (sizeof(wchar_t) == 2)
+		{
+			code &= 0xFFFF;
+			unsigned long next = i + 1 < _path.size() ? (unsigned long)_path[i + 1] & 0xFFFF : 0;
+			if (code >= 0xD800 && code <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF)
+			{
+				code = 0x10000 + ((code - 0xD800) << 10) + (next - 0xDC00);
+				i++;
+			}
+		}
+		if (code > 0x10FFFF) code = 0xFFFD;
+
+		if (code < 0x80)
+		{
+			utf8 += (char)code;
+		}
+		else if (code < 0x800)
+		{
+			utf8 += (char)(0xC0 | (code >> 6));
+			utf8 += (char)(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			utf8 += (char)(0xE0 | (code >> 12));
+			utf8 += (char)(0x80 | ((code >> 6) & 0x3F));
+			utf8 += (char)(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			utf8 += (char)(0xF0 | (code >> 18));
+			utf8 += (char)(0x80 | ((code >> 12) & 0x3F));
+			utf8 += (char)(0x80 | ((code >> 6) & 0x3F));
+			utf8 += (char)(0x80 | (code & 0x3F));
+		}
+	}
+	return utf8;
+}
+
+inline std::wstring UTF8PathToWide(const std::string& _path)
+{
+	std::wstring wide;
+	wide.reserve(_path.size());
+	for (size_t i = 0; i < _path.size();)
+	{
+		unsigned char lead = (unsigned char)_path[i];
+		unsigned int length = lead < 0x80 ? 1 : lead >= 0xC2 && lead < 0xE0 ? 2 : lead >= 0xE0 && lead < 0xF0 ? 3 : lead >= 0xF0 && lead < 0xF5 ? 4 : 0;
+		unsigned long code = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+
+		// Every continuation byte has to be there, and the result can't be overlong or past U+10FFFF
+		bool valid = length > 0 && i + length <= _path.size();
+		for (unsigned int k = 1; valid && k < length; k++)
+		{
+			unsigned char continuation = (unsigned char)_path[i + k];
+			valid = (continuation & 0xC0) == 0x80;
+			code = (code << 6) | (continuation & 0x3F);
+		}
+		if (valid && ((length == 3 && code < 0x800) || (length == 4 && (code < 0x10000 || code > 0x10FFFF)))) valid = false;
+		if (!valid)
+		{
+			wide += (wchar_t)0xFFFD;
+			i++;
+			continue;
+		}
+		i += length;
+
+		if (sizeof(wchar_t) == 2 && code >= 0x10000)
+		{
+			wide += (wchar_t)(0xD800 + ((code - 0x10000) >> 10));
+			wide += (wchar_t)(0xDC00 + ((code - 0x10000) & 0x3FF));
+		}
+		else
+		{
+			wide += (wchar_t)code;
+		}
+	}
+	return wide;
+}
+
+// --------------------------------------------------------
+// Opens a UTF-8 path for reading; Windows' narrow file
+// functions would take it as the ANSI code page instead
+// --------------------------------------------------------
+inline void OpenUTF8Path(std::ifstream& _file, const std::string& _path, std::ios::openmode _mode)
+{
+#ifdef _WIN32
+	_file.open(UTF8PathToWide(_path).c_str(), _mode);
+#else
+	_file.open(_path, _mode);
+#endif
+}
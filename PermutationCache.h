@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Feature bits that make up a permutation key (see Permutations.hlsli)
+constexpr auto PERMUTATION_ALBEDO = 1 << 0;
+constexpr auto PERMUTATION_NORMAL = 1 << 1;
+constexpr auto PERMUTATION_SPECULAR = 1 << 2;
+constexpr auto PERMUTATION_EMISSIVE = 1 << 3;
+constexpr auto PERMUTATION_REFLECTION = 1 << 4;
+constexpr auto PERMUTATION_RAMPDIFFUSE = 1 << 5;
+constexpr auto PERMUTATION_RAMPSPECULAR = 1 << 6;
+constexpr auto PERMUTATION_ORM = 1 << 7;
+constexpr auto PERMUTATION_COUNT = 8;
+
+// The #define each feature bit turns on, in bit order
+static const char* const permutationDefines[PERMUTATION_COUNT] =
+{
+	"HAS_ALBEDO_MAP",
+	"HAS_NORMAL_MAP",
+	"HAS_SPECULAR_MAP",
+	"HAS_EMISSIVE_MAP",
+	"HAS_REFLECTION_MAP",
+	"HAS_RAMP_DIFFUSE",
+	"HAS_RAMP_SPECULAR",
+	"HAS_ORM_MAP",
+};
+
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+struct PermutationStats
+{
+	unsigned int							sources;
+	unsigned int							possible;		// Variants the registered sources could need, given their supported features
+	unsigned int							compiled;		// Variants actually built
+	unsigned int							failed;
+	unsigned int							lookups;
+	unsigned int							hits;
+};
+
+// --------------------------------------------------------
+// Maps a shader source plus a set of feature bits to a
+// variant of that shader compiled with matching #defines.
+//
+// Each source declares which features it actually branches
+// on; anything else is masked out of the key, so e.g. a
+// reflection map on a toon material doesn't create a new
+// variant.  Variants are compiled on first use and kept.
+//
+// Compiling is left to the callback so the keying and
+// lookup don't depend on a device.
+// --------------------------------------------------------
+template <typename TShader>
+class PermutationCacheT
+{
+public:
+	typedef std::function<std::shared_ptr<TShader>(const std::wstring&, const ShaderDefines&)> CompileFunction;
+
+	PermutationCacheT(CompileFunction _compile)
+	{
+		compile = _compile;
+		stats = {};
+	}
+
+											/// <summary>
+											/// Adds a shader source that can be compiled into permutations
+											/// </summary>
+											/// <param name="_source">The source file the compile callback is given</param>
+											/// <param name="_supportedFeatures">The PERMUTATION_{features} the shader has switches for</param>
+											/// <returns>The id used to look up the source's variants</returns>
+	unsigned int							RegisterSource(std::wstring _source, unsigned int _supportedFeatures)
+	{
+		Source source = {};
+		source.path = _source;
+		source.supportedFeatures = _supportedFeatures;
+		sources.push_back(source);
+		return (unsigned int)(sources.size() - 1);
+	}
+
+											/// <summary>
+											/// Builds the key for a variant, dropping features the source doesn't support
+											/// </summary>
+											/// <param name="_sourceId">The id returned by RegisterSource</param>
+											/// <param name="_features">The PERMUTATION_{features} wanted</param>
+	uint64_t								MakeKey(unsigned int _sourceId, unsigned int _features)
+	{
+		return ((uint64_t)_sourceId << 32) | (_features & sources[_sourceId].supportedFeatures);
+	}
+
+											/// <summary>
+											/// Builds the #defines a variant is compiled with (every supported feature is defined, to 0 or 1)
+											/// </summary>
+	ShaderDefines							MakeDefines(unsigned int _sourceId, unsigned int _features)
+	{
+		ShaderDefines defines;
+		defines.push_back(std::make_pair(std::string("PERMUTATION"), std::string("1")));
+		for (int i = 0; i < PERMUTATION_COUNT; i++)
+		{
+			if (!(sources[_sourceId].supportedFeatures & (1 << i))) continue;
+			defines.push_back(std::make_pair(std::string(permutationDefines[i]), std::string((_features & (1 << i)) ? "1" : "0")));
+		}
+		return defines;
+	}
+
+											/// <summary>
+											/// Gets the variant of a source for a set of features, compiling it if needed
+											/// </summary>
+											/// <param name="_sourceId">The id returned by RegisterSource</param>
+											/// <param name="_features">The PERMUTATION_{features} wanted</param>
+											/// <returns>The variant, or null if it failed to compile (failures aren't retried)</returns>
+	std::shared_ptr<TShader>				Get(unsigned int _sourceId, unsigned int _features)
+	{
+		stats.lookups++;
+		uint64_t key = MakeKey(_sourceId, _features);
+		auto found = variants.find(key);
+		if (found != variants.end())
+		{
+			stats.hits++;
+			return found->second;
+		}
+
+		std::shared_ptr<TShader> variant = compile(sources[_sourceId].path, MakeDefines(_sourceId, (unsigned int)key));
+		if (variant)
+			stats.compiled++;
+		else
+			stats.failed++;
+
+		variants[key] = variant;
+		return variant;
+	}
+
+	PermutationStats						GetStats()
+	{
+		PermutationStats current = stats;
+		current.sources = (unsigned int)sources.size();
+		current.possible = 0;
+		for (auto& source : sources)
+		{
+			unsigned int bits = 0;
+			for (int i = 0; i < PERMUTATION_COUNT; i++)
+				if (source.supportedFeatures & (1 << i)) bits++;
+			current.possible += 1u << bits;
+		}
+		return current;
+	}
+
+private:
+	struct Source
+	{
+		std::wstring						path;
+		unsigned int						supportedFeatures;
+	};
+
+	CompileFunction							compile;
+	std::vector<Source>						sources;
+	std::unordered_map<uint64_t, std::shared_ptr<TShader>>	variants;
+	PermutationStats						stats;
+};
@@ -0,0 +1,59 @@
+#ifndef __SHADER_PERMUTATIONS__
+#define __SHADER_PERMUTATIONS__
+
+// Feature switches for shaders that come in permutations
+// - Variants are compiled with PERMUTATION and a 0/1 HAS_* define per
+//   feature (see ShaderPermutations.h), so unused texture paths are
+//   compiled out instead of branched around per pixel
+// - Without PERMUTATION the switches fall back to the material's
+//   cbuffer flags, so the plain build of each shader still works
+#ifdef PERMUTATION
+
+#ifndef HAS_ALBEDO_MAP
+#define HAS_ALBEDO_MAP 0
+#endif
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 0
+#endif
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 0
+#endif
+#ifndef HAS_EMISSIVE_MAP
+#define HAS_EMISSIVE_MAP 0
+#endif
+#ifndef HAS_REFLECTION_MAP
+#define HAS_REFLECTION_MAP 0
+#endif
+#ifndef HAS_RAMP_DIFFUSE
+#define HAS_RAMP_DIFFUSE 0
+#endif
+#ifndef HAS_RAMP_SPECULAR
+#define HAS_RAMP_SPECULAR 0
+#endif
+#ifndef HAS_ORM_MAP
+#define HAS_ORM_MAP 0
+#endif
+
+#define USE_ALBEDO_MAP		HAS_ALBEDO_MAP
+#define USE_NORMAL_MAP		HAS_NORMAL_MAP
+#define USE_SPECULAR_MAP	HAS_SPECULAR_MAP
+#define USE_EMISSIVE_MAP	HAS_EMISSIVE_MAP
+#define USE_REFLECTION_MAP	HAS_REFLECTION_MAP
+#define USE_RAMP_DIFFUSE	HAS_RAMP_DIFFUSE
+#define USE_RAMP_SPECULAR	HAS_RAMP_SPECULAR
+#define USE_ORM_MAP			HAS_ORM_MAP
+
+#else
+
+#define USE_ALBEDO_MAP		(hasAlbedoMap > 0)
+#define USE_NORMAL_MAP		(hasNormalMap > 0)
+#define USE_SPECULAR_MAP	(hasSpecularMap > 0)
+#define USE_EMISSIVE_MAP	(hasEmissiveMap > 0)
+#define USE_REFLECTION_MAP	(hasReflectionMap > 0)
+#define USE_RAMP_DIFFUSE	(hasRampDiffuse > 0)
+#define USE_RAMP_SPECULAR	(hasRampSpecular > 0)
+#define USE_ORM_MAP			(hasOrmMap > 0)
+
+#endif
+
+#endif
@@ -0,0 +1,211 @@
+#include "PipelineCache.h"
+#include "ResourceRegistry.h"
+
+// Singleton requirement
+PipelineCache* PipelineCache::instance;
+
+#pragma region State Keys
+template <typename T>
+static void AppendKey(std::string& _key, const T& _value)
+{
+	_key.append((const char*)&_value, sizeof(T));
+}
+
+std::string MakeStateKey(const D3D11_SAMPLER_DESC& _desc)
+{
+	std::string key;
+	AppendKey(key, _desc.Filter);
+	AppendKey(key, _desc.AddressU);
+	AppendKey(key, _desc.AddressV);
+	AppendKey(key, _desc.AddressW);
+	AppendKey(key, _desc.MipLODBias);
+	AppendKey(key, _desc.MaxAnisotropy);
+	AppendKey(key, _desc.ComparisonFunc);
+	for (int i = 0; i < 4; i++)
+		AppendKey(key, _desc.BorderColor[i]);
+	AppendKey(key, _desc.MinLOD);
+	AppendKey(key, _desc.MaxLOD);
+	return key;
+}
+
+std::string MakeStateKey(const D3D11_BLEND_DESC& _desc)
+{
+	std::string key;
+	AppendKey(key, _desc.AlphaToCoverageEnable);
+	AppendKey(key, _desc.IndependentBlendEnable);
+
+	// Only the first target counts unless blending is set per target
+	int targets = _desc.IndependentBlendEnable ? 8 : 1;
+	for (int i = 0; i < targets; i++)
+	{
+		const D3D11_RENDER_TARGET_BLEND_DESC& target = _desc.RenderTarget[i];
+		AppendKey(key, target.BlendEnable);
+		AppendKey(key, target.SrcBlend);
+		AppendKey(key, target.DestBlend);
+		AppendKey(key, target.BlendOp);
+		AppendKey(key, target.SrcBlendAlpha);
+		AppendKey(key, target.DestBlendAlpha);
+		AppendKey(key, target.BlendOpAlpha);
+		AppendKey(key, target.RenderTargetWriteMask);
+	}
+	return key;
+}
+
+std::string MakeStateKey(const D3D11_RASTERIZER_DESC& _desc)
+{
+	std::string key;
+	AppendKey(key, _desc.FillMode);
+	AppendKey(key, _desc.CullMode);
+	AppendKey(key, _desc.FrontCounterClockwise);
+	AppendKey(key, _desc.DepthBias);
+	AppendKey(key, _desc.DepthBiasClamp);
+	AppendKey(key, _desc.SlopeScaledDepthBias);
+	AppendKey(key, _desc.DepthClipEnable);
+	AppendKey(key, _desc.ScissorEnable);
+	AppendKey(key, _desc.MultisampleEnable);
+	AppendKey(key, _desc.AntialiasedLineEnable);
+	return key;
+}
+
+static void AppendKey(std::string& _key, const D3D11_DEPTH_STENCILOP_DESC& _desc)
+{
+	AppendKey(_key, _desc.StencilFailOp);
+	AppendKey(_key, _desc.StencilDepthFailOp);
+	AppendKey(_key, _desc.StencilPassOp);
+	AppendKey(_key, _desc.StencilFunc);
+}
+
+std::string MakeStateKey(const D3D11_DEPTH_STENCIL_DESC& _desc)
+{
+	std::string key;
+	AppendKey(key, _desc.DepthEnable);
+	AppendKey(key, _desc.DepthWriteMask);
+	AppendKey(key, _desc.DepthFunc);
+	AppendKey(key, _desc.StencilEnable);
+	AppendKey(key, _desc.StencilReadMask);
+	AppendKey(key, _desc.StencilWriteMask);
+	AppendKey(key, _desc.FrontFace);
+	AppendKey(key, _desc.BackFace);
+	return key;
+}
+#pragma endregion
+
+#pragma region In-Use Checks
+template <typename T>
+static bool SharedInUse(const std::shared_ptr<T>& _value)
+{
+	return _value.use_count() > 1;
+}
+
+template <typename T>
+static bool ComInUse(const Microsoft::WRL::ComPtr<T>& _value)
+{
+	// COM only reports the count from AddRef/Release
+	_value->AddRef();
+	return _value->Release() > 1;
+}
+#pragma endregion
+
+void PipelineCache::Initialize(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context)
+{
+	device = _device;
+	context = _context;
+}
+
+std::shared_ptr<SimpleVertexShader> PipelineCache::GetVertexShader(const std::wstring& _file)
+{
+	return vertexShaders.Get(NormalizeResourcePath(_file), [&]()
+		{
+			// A shader that failed to load comes back empty, so it isn't cached
+			std::shared_ptr<SimpleVertexShader> shader = std::make_shared<SimpleVertexShader>(device, context, _file.c_str());
+			if (!shader->IsShaderValid())
+				return std::shared_ptr<SimpleVertexShader>();
+			return shader;
+		});
+}
+
+std::shared_ptr<SimplePixelShader> PipelineCache::GetPixelShader(const std::wstring& _file)
+{
+	return pixelShaders.Get(NormalizeResourcePath(_file), [&]()
+		{
+			// A shader that failed to load comes back empty, so it isn't cached
+			std::shared_ptr<SimplePixelShader> shader = std::make_shared<SimplePixelShader>(device, context, _file.c_str());
+			if (!shader->IsShaderValid())
+				return std::shared_ptr<SimplePixelShader>();
+			return shader;
+		});
+}
+
+Microsoft::WRL::ComPtr<ID3D11SamplerState> PipelineCache::GetSamplerState(const D3D11_SAMPLER_DESC& _desc)
+{
+	return samplers.Get(MakeStateKey(_desc), [&]()
+		{
+			Microsoft::WRL::ComPtr<ID3D11SamplerState> state;
+			device->CreateSamplerState(&_desc, state.GetAddressOf());
+			return state;
+		});
+}
+
+Microsoft::WRL::ComPtr<ID3D11BlendState> PipelineCache::GetBlendState(const D3D11_BLEND_DESC& _desc)
+{
+	return blendStates.Get(MakeStateKey(_desc), [&]()
+		{
+			Microsoft::WRL::ComPtr<ID3D11BlendState> state;
+			device->CreateBlendState(&_desc, state.GetAddressOf());
+			return state;
+		});
+}
+
+Microsoft::WRL::ComPtr<ID3D11RasterizerState> PipelineCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& _desc)
+{
+	return rasterizerStates.Get(MakeStateKey(_desc), [&]()
+		{
+			Microsoft::WRL::ComPtr<ID3D11RasterizerState> state;
+			device->CreateRasterizerState(&_desc, state.GetAddressOf());
+			return state;
+		});
+}
+
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> PipelineCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& _desc)
+{
+	return depthStencilStates.Get(MakeStateKey(_desc), [&]()
+		{
+			Microsoft::WRL::ComPtr<ID3D11DepthStencilState> state;
+			device->CreateDepthStencilState(&_desc, state.GetAddressOf());
+			return state;
+		});
+}
+
+unsigned int PipelineCache::Trim()
+{
+	unsigned int dropped = 0;
+	dropped += vertexShaders.Trim(SharedInUse<SimpleVertexShader>);
+	dropped += pixelShaders.Trim(SharedInUse<SimplePixelShader>);
+	dropped += samplers.Trim(ComInUse<ID3D11SamplerState>);
+	dropped += blendStates.Trim(ComInUse<ID3D11BlendState>);
+	dropped += rasterizerStates.Trim(ComInUse<ID3D11RasterizerState>);
+	dropped += depthStencilStates.Trim(ComInUse<ID3D11DepthStencilState>);
+	return dropped;
+}
+
+void PipelineCache::Clear()
+{
+	vertexShaders.Clear();
+	pixelShaders.Clear();
+	samplers.Clear();
+	blendStates.Clear();
+	rasterizerStates.Clear();
+	depthStencilStates.Clear();
+}
+
+PipelineCacheStats PipelineCache::GetStats()
+{
+	PipelineCacheStats stats = {};
+	stats.vertexShaders = vertexShaders.GetStats(SharedInUse<SimpleVertexShader>);
+	stats.pixelShaders = pixelShaders.GetStats(SharedInUse<SimplePixelShader>);
+	stats.samplers = samplers.GetStats(ComInUse<ID3D11SamplerState>);
+	stats.blendStates = blendStates.GetStats(ComInUse<ID3D11BlendState>);
+	stats.rasterizerStates = rasterizerStates.GetStats(ComInUse<ID3D11RasterizerState>);
+	stats.depthStencilStates = depthStencilStates.GetStats(ComInUse<ID3D11DepthStencilState>);
+	return stats;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include "DedupCache.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Keys for state descriptors, built field by field so the
+// padding inside some of the descs (e.g. after the stencil
+// masks) can't make identical states look different
+// --------------------------------------------------------
+std::string MakeStateKey(const D3D11_SAMPLER_DESC& _desc);
+std::string MakeStateKey(const D3D11_BLEND_DESC& _desc);
+std::string MakeStateKey(const D3D11_RASTERIZER_DESC& _desc);
+std::string MakeStateKey(const D3D11_DEPTH_STENCIL_DESC& _desc);
+
+struct PipelineCacheStats
+{
+	DedupStats								vertexShaders;
+	DedupStats								pixelShaders;
+	DedupStats								samplers;
+	DedupStats								blendStates;
+	DedupStats								rasterizerStates;
+	DedupStats								depthStencilStates;
+};
+
+// --------------------------------------------------------
+// Central creation point for shaders and pipeline state
+// objects, so asking twice for the same shader file or the
+// same state desc returns the object made the first time
+// --------------------------------------------------------
+class PipelineCache
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static PipelineCache& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new PipelineCache();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	PipelineCache(PipelineCache const&) = delete;
+	void operator=(PipelineCache const&) = delete;
+
+private:
+	static PipelineCache* instance;
+	PipelineCache() {};
+#pragma endregion
+
+public:
+											/// <summary>
+											/// Sets the device and context new objects are created with
+											/// </summary>
+	void									Initialize(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+
+											/// <summary>
+											/// Gets the shader loaded from a compiled shader file
+											/// </summary>
+											/// <param name="_file">The full path of the .cso file (paths naming the same file share a shader)</param>
+											/// <returns>The shader, or null if the file couldn't be loaded</returns>
+	std::shared_ptr<SimpleVertexShader>		GetVertexShader(const std::wstring& _file);
+	std::shared_ptr<SimplePixelShader>		GetPixelShader(const std::wstring& _file);
+
+	Microsoft::WRL::ComPtr<ID3D11SamplerState>		GetSamplerState(const D3D11_SAMPLER_DESC& _desc);
+	Microsoft::WRL::ComPtr<ID3D11BlendState>		GetBlendState(const D3D11_BLEND_DESC& _desc);
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState>	GetRasterizerState(const D3D11_RASTERIZER_DESC& _desc);
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState>	GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& _desc);
+
+											/// <summary>
+											/// Drops every cached object that nothing outside the cache holds
+											/// </summary>
+											/// <returns>The number of objects dropped</returns>
+	unsigned int							Trim();
+											/// <summary>
+											/// Drops every cached object (call before the device goes away)
+											/// </summary>
+	void									Clear();
+	PipelineCacheStats						GetStats();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device>	device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+
+	DedupCache<std::string, std::shared_ptr<SimpleVertexShader>>			vertexShaders;
+	DedupCache<std::string, std::shared_ptr<SimplePixelShader>>				pixelShaders;
+	DedupCache<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>>		samplers;
+	DedupCache<std::string, Microsoft::WRL::ComPtr<ID3D11BlendState>>		blendStates;
+	DedupCache<std::string, Microsoft::WRL::ComPtr<ID3D11RasterizerState>>	rasterizerStates;
+	DedupCache<std::string, Microsoft::WRL::ComPtr<ID3D11DepthStencilState>>	depthStencilStates;
+};
@@ -0,0 +1,661 @@
+#include "PngDecoder.h"
+#include "PathEncoding.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+// Widest and tallest image accepted (the largest texture D3D11 can make)
+constexpr auto PNG_MAX_DIMENSION = 16384;
+
+// Huffman codes up to this long are decoded with one table lookup; longer ones walk the code lengths
+constexpr auto INFLATE_FAST_BITS = 10;
+constexpr auto INFLATE_MAX_BITS = 15;
+
+// Zero bytes that may be read past the end of the stream before it's called truncated
+constexpr auto INFLATE_MAX_PADDING = 8;
+
+#pragma region Inflate
+namespace
+{
+	const unsigned short lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned char lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const unsigned short distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned char distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const unsigned char codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Reads the stream least significant bit first, a byte at a time into a 64 bit buffer
+	struct BitReader
+	{
+		const unsigned char*				next;
+		const unsigned char*				end;
+		uint64_t							bits;
+		unsigned int						count;
+		unsigned int						padding;			// Zero bytes put in the buffer after the stream ran out
+
+		// Tops the buffer up to at least 57 bits, which covers the longest length and distance pair
+		void Refill()
+		{
+			while (count <= 56)
+			{
+				if (next < end) bits |= (uint64_t)*next++ << count;
+				else padding++;
+				count += 8;
+			}
+		}
+
+		unsigned int Take(unsigned int _bits)
+		{
+			unsigned int value = (unsigned int)(bits & ((1ull << _bits) - 1));
+			bits >>= _bits;
+			count -= _bits;
+			return value;
+		}
+	};
+
+	// A canonical Huffman code: a lookup table for short codes and the counts per length for the rest
+	struct HuffmanTable
+	{
+		unsigned short						fast[1 << INFLATE_FAST_BITS];	// (symbol << 4) | length, or 0 if the code is longer
+		unsigned short						counts[INFLATE_MAX_BITS + 1];
+		unsigned short						symbols[288];					// Ordered by code length, then symbol
+
+		bool Build(const unsigned char* _lengths, unsigned int _count)
+		{
+			memset(counts, 0, sizeof(counts));
+			for (unsigned int i = 0; i < _count; i++)
+			{
+				counts[_lengths[i]]++;
+			}
+			counts[0] = 0;
+
+			// More codes than the lengths have room for can't be decoded (fewer is fine, like a single distance code)
+			int left = 1;
+			for (int length = 1; length <= INFLATE_MAX_BITS; length++)
+			{
+				left = (left << 1) - counts[length];
+				if (left < 0) return false;
+			}
+
+			unsigned short offsets[INFLATE_MAX_BITS + 1];
+			unsigned int nextCode[INFLATE_MAX_BITS + 1];
+			offsets[1] = 0;
+			nextCode[1] = 0;
+			for (int length = 1; length < INFLATE_MAX_BITS; length++)
+			{
+				offsets[length + 1] = offsets[length] + counts[length];
+				nextCode[length + 1] = (nextCode[length] + counts[length]) << 1;
+			}
+
+			memset(fast, 0, sizeof(fast));
+			for (unsigned int symbol = 0; symbol < _count; symbol++)
+			{
+				unsigned int length = _lengths[symbol];
+				if (length == 0) continue;
+				symbols[offsets[length]++] = (unsigned short)symbol;
+
+				unsigned int code = nextCode[length]++;
+				if (length > INFLATE_FAST_BITS) continue;
+
+				// Codes are stored first bit first, so the table is indexed by the code reversed
+				unsigned int reversed = 0;
+				for (unsigned int b = 0; b < length; b++)
+				{
+					reversed |= ((code >> b) & 1) << (length - 1 - b);
+				}
+				for (unsigned int i = reversed; i < (1u << INFLATE_FAST_BITS); i += 1u << length)
+				{
+					fast[i] = (unsigned short)((symbol << 4) | length);
+				}
+			}
+			return true;
+		}
+
+		// The reader has to hold at least INFLATE_MAX_BITS bits
+		int Decode(BitReader& _reader) const
+		{
+			unsigned int entry = fast[_reader.bits & ((1 << INFLATE_FAST_BITS) - 1)];
+			if (entry != 0)
+			{
+				_reader.Take(entry & 15);
+				return (int)(entry >> 4);
+			}
+
+			// Canonical codes of one length are consecutive, so walk the lengths until the code falls in one's range
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int length = 1; length <= INFLATE_MAX_BITS; length++)
+			{
+				code |= (int)_reader.Take(1);
+				int count = counts[length];
+				if (code - count < first) return symbols[index + (code - first)];
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+	};
+
+	bool InflateBlock(BitReader& _reader, const HuffmanTable& _literals, const HuffmanTable& _distances, std::vector<unsigned char>& _output, size_t& _position)
+	{
+		while (true)
+		{
+			_reader.Refill();
+			if (_reader.padding > INFLATE_MAX_PADDING) return false;
+
+			int symbol = _literals.Decode(_reader);
+			if (symbol < 0) return false;
+			if (symbol < 256)
+			{
+				if (_position == _output.size()) _output.resize(_output.size() * 2 + 1024);
+				_output[_position++] = (unsigned char)symbol;
+				continue;
+			}
+			if (symbol == 256) return true;
+
+			symbol -= 257;
+			if (symbol >= 29) return false;
+			unsigned int length = lengthBase[symbol] + _reader.Take(lengthExtra[symbol]);
+
+			int distanceSymbol = _distances.Decode(_reader);
+			if (distanceSymbol < 0 || distanceSymbol >= 30) return false;
+			size_t distance = distanceBase[distanceSymbol] + _reader.Take(distanceExtra[distanceSymbol]);
+			if (distance > _position) return false;
+
+			if (_position + length > _output.size()) _output.resize((_output.size() + length) * 2);
+			unsigned char* destination = _output.data() + _position;
+			const unsigned char* source = destination - distance;
+			if (distance >= length)
+			{
+				memcpy(destination, source, length);
+			}
+			else
+			{
+				// Overlapping copies repeat the last few bytes, so they have to go one at a time
+				for (unsigned int i = 0; i < length; i++)
+				{
+					destination[i] = source[i];
+				}
+			}
+			_position += length;
+		}
+	}
+}
+
+bool PngDecoder::Inflate(const unsigned char* _data, size_t _size, size_t _expectedSize, std::vector<unsigned char>& _output)
+{
+	// Compression method 8 (deflate), a header that checks out and no preset dictionary
+	if (_size < 2) return false;
+	if ((_data[0] & 0x0F) != 8 || ((_data[0] << 8) | _data[1]) % 31 != 0 || (_data[1] & 0x20) != 0) return false;
+
+	BitReader reader = { _data + 2, _data + _size, 0, 0, 0 };
+	_output.resize(_expectedSize > 0 ? _expectedSize : _size * 4);
+	size_t position = 0;
+
+	HuffmanTable literals;
+	HuffmanTable distances;
+	bool last = false;
+	while (!last)
+	{
+		reader.Refill();
+		if (reader.padding > INFLATE_MAX_PADDING) return false;
+		last = reader.Take(1) == 1;
+		unsigned int type = reader.Take(2);
+
+		if (type == 0)
+		{
+			// Stored: skip to the next byte boundary, then hand the buffered bytes back to the stream and copy straight from it
+			reader.Take(reader.count & 7);
+			unsigned int length = reader.Take(16);
+			unsigned int inverse = reader.Take(16);
+			if ((length ^ 0xFFFF) != inverse) return false;
+
+			unsigned int buffered = reader.count / 8;
+			if (reader.padding > buffered) return false;
+			reader.next -= buffered - reader.padding;
+			reader.bits = 0;
+			reader.count = 0;
+			reader.padding = 0;
+
+			if ((size_t)(reader.end - reader.next) < length) return false;
+			if (position + length > _output.size()) _output.resize(position + length);
+			memcpy(_output.data() + position, reader.next, length);
+			reader.next += length;
+			position += length;
+			continue;
+		}
+
+		unsigned char lengths[288 + 32];
+		if (type == 1)
+		{
+			// Fixed codes
+			for (int i = 0; i < 288; i++)
+			{
+				lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+			}
+			for (int i = 0; i < 30; i++)
+			{
+				lengths[288 + i] = 5;
+			}
+			literals.Build(lengths, 288);
+			distances.Build(lengths + 288, 30);
+		}
+		else if (type == 2)
+		{
+			// Dynamic codes, whose lengths are themselves Huffman coded
+			unsigned int literalCount = reader.Take(5) + 257;
+			unsigned int distanceCount = reader.Take(5) + 1;
+			unsigned int codeLengthCount = reader.Take(4) + 4;
+			if (literalCount > 286 || distanceCount > 30) return false;
+
+			unsigned char codeLengthLengths[19] = {};
+			reader.Refill();
+			for (unsigned int i = 0; i < codeLengthCount; i++)
+			{
+				codeLengthLengths[codeLengthOrder[i]] = (unsigned char)reader.Take(3);
+			}
+			HuffmanTable codeLengths;
+			if (!codeLengths.Build(codeLengthLengths, 19)) return false;
+
+			unsigned int total = literalCount + distanceCount;
+			unsigned int i = 0;
+			while (i < total)
+			{
+				reader.Refill();
+				if (reader.padding > INFLATE_MAX_PADDING) return false;
+
+				int symbol = codeLengths.Decode(reader);
+				if (symbol < 0) return false;
+				if (symbol < 16)
+				{
+					lengths[i++] = (unsigned char)symbol;
+					continue;
+				}
+
+				unsigned char value = 0;
+				unsigned int repeat = 0;
+				if (symbol == 16)
+				{
+					if (i == 0) return false;
+					value = lengths[i - 1];
+					repeat = 3 + reader.Take(2);
+				}
+				else if (symbol == 17) repeat = 3 + reader.Take(3);
+				else repeat = 11 + reader.Take(7);
+
+				if (i + repeat > total) return false;
+				memset(lengths + i, value, repeat);
+				i += repeat;
+			}
+
+			// Without an end of block code the block could never finish
+			if (lengths[256] == 0) return false;
+			if (!literals.Build(lengths, literalCount)) return false;
+			if (!distances.Build(lengths + literalCount, distanceCount)) return false;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (!InflateBlock(reader, literals, distances, _output, position)) return false;
+	}
+
+	// The last block can't have ended in the padding
+	if (reader.padding * 8 > reader.count) return false;
+	_output.resize(position);
+	return true;
+}
+#pragma endregion
+
+#pragma region PNG
+namespace
+{
+	// Where each Adam7 pass starts and how far apart its pixels are
+	const unsigned int adam7StartX[7] = { 0, 4, 0, 2, 0, 1, 0 };
+	const unsigned int adam7StartY[7] = { 0, 0, 4, 0, 2, 0, 1 };
+	const unsigned int adam7StepX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+	const unsigned int adam7StepY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+
+	enum PngColorType
+	{
+		PNG_GRAY = 0,
+		PNG_RGB = 2,
+		PNG_PALETTE = 3,
+		PNG_GRAY_ALPHA = 4,
+		PNG_RGBA = 6,
+	};
+
+	// What the header and the chunks before the image data said
+	struct PngInfo
+	{
+		unsigned int						width;
+		unsigned int						height;
+		unsigned int						depth;
+		unsigned int						colorType;
+		unsigned int						channels;
+		bool								interlaced;
+		unsigned char						palette[256][4];
+		bool								hasKey;				// A gray or RGB value that's transparent (from tRNS)
+		unsigned int						key[3];
+	};
+
+	unsigned int ReadBigEndian(const unsigned char* _data)
+	{
+		return ((unsigned int)_data[0] << 24) | ((unsigned int)_data[1] << 16) | ((unsigned int)_data[2] << 8) | _data[3];
+	}
+
+	size_t GetRowBytes(const PngInfo& _info, unsigned int _width)
+	{
+		return ((size_t)_width * _info.channels * _info.depth + 7) / 8;
+	}
+
+	unsigned char Paeth(unsigned char _left, unsigned char _up, unsigned char _upLeft)
+	{
+		int estimate = (int)_left + _up - _upLeft;
+		int toLeft = estimate > _left ? estimate - _left : _left - estimate;
+		int toUp = estimate > _up ? estimate - _up : _up - estimate;
+		int toUpLeft = estimate > _upLeft ? estimate - _upLeft : _upLeft - estimate;
+		if (toLeft <= toUp && toLeft <= toUpLeft) return _left;
+		if (toUp <= toUpLeft) return _up;
+		return _upLeft;
+	}
+
+	// Undoes a row's filter in place, against the already unfiltered row above it
+	bool Unfilter(unsigned char _filter, unsigned char* _row, const unsigned char* _prior, size_t _bytes, unsigned int _pixelBytes)
+	{
+		switch (_filter)
+		{
+		case 0:
+			break;
+		case 1:
+			for (size_t i = _pixelBytes; i < _bytes; i++) _row[i] += _row[i - _pixelBytes];
+			break;
+		case 2:
+			for (size_t i = 0; i < _bytes; i++) _row[i] += _prior[i];
+			break;
+		case 3:
+			for (size_t i = 0; i < _pixelBytes && i < _bytes; i++) _row[i] += _prior[i] >> 1;
+			for (size_t i = _pixelBytes; i < _bytes; i++) _row[i] += (unsigned char)(((unsigned int)_row[i - _pixelBytes] + _prior[i]) >> 1);
+			break;
+		case 4:
+			for (size_t i = 0; i < _pixelBytes && i < _bytes; i++) _row[i] += _prior[i];
+			for (size_t i = _pixelBytes; i < _bytes; i++) _row[i] += Paeth(_row[i - _pixelBytes], _prior[i], _prior[i - _pixelBytes]);
+			break;
+		default:
+			return false;
+		}
+		return true;
+	}
+
+	// Gets sample i of a row packed at 1, 2 or 4 bits (leftmost pixel in the high bits)
+	unsigned int GetPackedSample(const unsigned char* _row, unsigned int _index, unsigned int _depth)
+	{
+		unsigned int bit = _index * _depth;
+		return (_row[bit >> 3] >> (8 - _depth - (bit & 7))) & ((1u << _depth) - 1);
+	}
+
+	// Spreads one unfiltered row out to RGBA, _step pixels apart in the destination
+	void ExpandRow(const PngInfo& _info, const unsigned char* _row, unsigned int _width, unsigned char* _destination, unsigned int _step)
+	{
+		unsigned int stride = _step * 4;
+		if (_info.depth == 8)
+		{
+			switch (_info.colorType)
+			{
+			case PNG_RGBA:
+				if (_step == 1)
+				{
+					memcpy(_destination, _row, (size_t)_width * 4);
+					return;
+				}
+				for (unsigned int i = 0; i < _width; i++, _row += 4, _destination += stride)
+				{
+					memcpy(_destination, _row, 4);
+				}
+				return;
+			case PNG_RGB:
+				for (unsigned int i = 0; i < _width; i++, _row += 3, _destination += stride)
+				{
+					_destination[0] = _row[0];
+					_destination[1] = _row[1];
+					_destination[2] = _row[2];
+					_destination[3] = _info.hasKey && _row[0] == _info.key[0] && _row[1] == _info.key[1] && _row[2] == _info.key[2] ? 0 : 255;
+				}
+				return;
+			case PNG_GRAY:
+				for (unsigned int i = 0; i < _width; i++, _row++, _destination += stride)
+				{
+					_destination[0] = _destination[1] = _destination[2] = _row[0];
+					_destination[3] = _info.hasKey && _row[0] == _info.key[0] ? 0 : 255;
+				}
+				return;
+			case PNG_GRAY_ALPHA:
+				for (unsigned int i = 0; i < _width; i++, _row += 2, _destination += stride)
+				{
+					_destination[0] = _destination[1] = _destination[2] = _row[0];
+					_destination[3] = _row[1];
+				}
+				return;
+			}
+		}
+
+		if (_info.depth == 16)
+		{
+			// Only the high byte is kept, but transparency keys compare the whole sample
+			for (unsigned int i = 0; i < _width; i++, _destination += stride)
+			{
+				const unsigned char* pixel = _row + (size_t)i * _info.channels * 2;
+				unsigned int first = (pixel[0] << 8) | pixel[1];
+				if (_info.colorType == PNG_GRAY || _info.colorType == PNG_GRAY_ALPHA)
+				{
+					_destination[0] = _destination[1] = _destination[2] = pixel[0];
+					if (_info.colorType == PNG_GRAY_ALPHA) _destination[3] = pixel[2];
+					else _destination[3] = _info.hasKey && first == _info.key[0] ? 0 : 255;
+				}
+				else
+				{
+					_destination[0] = pixel[0];
+					_destination[1] = pixel[2];
+					_destination[2] = pixel[4];
+					if (_info.colorType == PNG_RGBA) _destination[3] = pixel[6];
+					else _destination[3] = _info.hasKey && first == _info.key[0] && (unsigned int)((pixel[2] << 8) | pixel[3]) == _info.key[1] && (unsigned int)((pixel[4] << 8) | pixel[5]) == _info.key[2] ? 0 : 255;
+				}
+			}
+			return;
+		}
+
+		// Palette indices and low bit depth gray
+		for (unsigned int i = 0; i < _width; i++, _destination += stride)
+		{
+			unsigned int sample = _info.depth == 8 ? _row[i] : GetPackedSample(_row, i, _info.depth);
+			if (_info.colorType == PNG_PALETTE)
+			{
+				memcpy(_destination, _info.palette[sample], 4);
+			}
+			else
+			{
+				// Stretch the sample's range out to 0-255 (1 bit * 255, 2 bit * 85, 4 bit * 17)
+				unsigned char gray = (unsigned char)(sample * (255 / ((1u << _info.depth) - 1)));
+				_destination[0] = _destination[1] = _destination[2] = gray;
+				_destination[3] = _info.hasKey && sample == _info.key[0] ? 0 : 255;
+			}
+		}
+	}
+}
+
+bool PngDecoder::Decode(const unsigned char* _data, size_t _size, DecodedImage& _image)
+{
+	static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (_size < 8 || memcmp(_data, signature, 8) != 0) return false;
+
+	PngInfo info = {};
+	for (int i = 0; i < 256; i++)
+	{
+		info.palette[i][3] = 255;
+	}
+	unsigned int paletteSize = 0;
+	bool hasHeader = false;
+	bool hasEnd = false;
+	std::vector<unsigned char> compressed;
+
+	// Chunks are a length, a type, the data and a CRC
+	size_t offset = 8;
+	while (!hasEnd && offset + 12 <= _size)
+	{
+		size_t length = ReadBigEndian(_data + offset);
+		const unsigned char* type = _data + offset + 4;
+		const unsigned char* chunk = _data + offset + 8;
+		if (length > _size - offset - 12) return false;
+		offset += length + 12;
+
+		if (memcmp(type, "IHDR", 4) == 0)
+		{
+			if (length < 13) return false;
+			info.width = ReadBigEndian(chunk);
+			info.height = ReadBigEndian(chunk + 4);
+			info.depth = chunk[8];
+			info.colorType = chunk[9];
+			info.interlaced = chunk[12] == 1;
+			if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1) return false;
+			if (info.width == 0 || info.height == 0 || info.width > PNG_MAX_DIMENSION || info.height > PNG_MAX_DIMENSION) return false;
+
+			// Each color type only allows some bit depths
+			unsigned int d = info.depth;
+			switch (info.colorType)
+			{
+			case PNG_GRAY: info.channels = 1; if (d != 1 && d != 2 && d != 4 && d != 8 && d != 16) return false; break;
+			case PNG_RGB: info.channels = 3; if (d != 8 && d != 16) return false; break;
+			case PNG_PALETTE: info.channels = 1; if (d != 1 && d != 2 && d != 4 && d != 8) return false; break;
+			case PNG_GRAY_ALPHA: info.channels = 2; if (d != 8 && d != 16) return false; break;
+			case PNG_RGBA: info.channels = 4; if (d != 8 && d != 16) return false; break;
+			default: return false;
+			}
+			hasHeader = true;
+		}
+		else if (!hasHeader)
+		{
+			return false;
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			paletteSize = (unsigned int)(length / 3);
+			if (paletteSize > 256) return false;
+			for (unsigned int i = 0; i < paletteSize; i++)
+			{
+				memcpy(info.palette[i], chunk + i * 3, 3);
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0)
+		{
+			if (info.colorType == PNG_PALETTE)
+			{
+				for (size_t i = 0; i < length && i < 256; i++)
+				{
+					info.palette[i][3] = chunk[i];
+				}
+			}
+			else if (info.colorType == PNG_GRAY && length >= 2)
+			{
+				info.hasKey = true;
+				info.key[0] = (chunk[0] << 8) | chunk[1];
+			}
+			else if (info.colorType == PNG_RGB && length >= 6)
+			{
+				info.hasKey = true;
+				for (int c = 0; c < 3; c++)
+				{
+					info.key[c] = (chunk[c * 2] << 8) | chunk[c * 2 + 1];
+				}
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+		{
+			hasEnd = true;
+		}
+	}
+	if (!hasHeader || compressed.empty()) return false;
+	if (info.colorType == PNG_PALETTE && paletteSize == 0) return false;
+
+	// 8 bit keys are compared against the byte itself
+	if (info.depth == 8)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			info.key[c] &= 0xFF;
+		}
+	}
+
+	// Every pass (or the whole image, when it isn't interlaced) is a run of rows, each led by its filter type
+	unsigned int passCount = info.interlaced ? 7 : 1;
+	unsigned int passWidths[7] = {};
+	unsigned int passHeights[7] = {};
+	size_t expected = 0;
+	for (unsigned int p = 0; p < passCount; p++)
+	{
+		unsigned int startX = info.interlaced ? adam7StartX[p] : 0;
+		unsigned int startY = info.interlaced ? adam7StartY[p] : 0;
+		unsigned int stepX = info.interlaced ? adam7StepX[p] : 1;
+		unsigned int stepY = info.interlaced ? adam7StepY[p] : 1;
+		passWidths[p] = info.width > startX ? (info.width - startX + stepX - 1) / stepX : 0;
+		passHeights[p] = info.height > startY ? (info.height - startY + stepY - 1) / stepY : 0;
+		if (passWidths[p] > 0) expected += (size_t)passHeights[p] * (GetRowBytes(info, passWidths[p]) + 1);
+	}
+
+	std::vector<unsigned char> filtered;
+	if (!Inflate(compressed.data(), compressed.size(), expected, filtered)) return false;
+	if (filtered.size() < expected) return false;
+
+	_image.width = info.width;
+	_image.height = info.height;
+	_image.pixels.resize((size_t)info.width * info.height * 4);
+
+	unsigned int pixelBytes = (info.channels * info.depth + 7) / 8;
+	std::vector<unsigned char> zeroRow(GetRowBytes(info, info.width), 0);
+	unsigned char* source = filtered.data();
+	for (unsigned int p = 0; p < passCount; p++)
+	{
+		if (passWidths[p] == 0 || passHeights[p] == 0) continue;
+		unsigned int startX = info.interlaced ? adam7StartX[p] : 0;
+		unsigned int startY = info.interlaced ? adam7StartY[p] : 0;
+		unsigned int stepX = info.interlaced ? adam7StepX[p] : 1;
+		unsigned int stepY = info.interlaced ? adam7StepY[p] : 1;
+		size_t rowBytes = GetRowBytes(info, passWidths[p]);
+
+		const unsigned char* prior = zeroRow.data();
+		for (unsigned int y = 0; y < passHeights[p]; y++)
+		{
+			unsigned char* row = source + 1;
+			if (!Unfilter(source[0], row, prior, rowBytes, pixelBytes)) return false;
+
+			unsigned char* destination = _image.pixels.data() + (((size_t)(startY + y * stepY) * info.width) + startX) * 4;
+			ExpandRow(info, row, passWidths[p], destination, stepX);
+
+			prior = row;
+			source += rowBytes + 1;
+		}
+	}
+	return true;
+}
+
+bool PngDecoder::DecodeFile(const std::string& _path, DecodedImage& _image)
+{
+	std::ifstream file;
+	OpenUTF8Path(file, _path, std::ios::binary | std::ios::ate);
+	if (!file) return false;
+
+	std::streamoff size = file.tellg();
+	if (size <= 0) return false;
+	std::vector<unsigned char> data((size_t)size);
+	file.seekg(0);
+	if (!file.read((char*)data.data(), size)) return false;
+
+	return Decode(data.data(), data.size(), _image);
+}
+#pragma endregion
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// An image decoded to 8 bit RGBA, rows from top to bottom
+struct DecodedImage
+{
+	unsigned int							width;
+	unsigned int							height;
+	std::vector<unsigned char>				pixels;				// width * height * 4 bytes
+};
+
+// --------------------------------------------------------
+// Decodes PNG files without WIC or any other library
+//
+// Handles every standard color type and bit depth, palettes
+// with transparency and Adam7 interlacing, and always gives
+// back RGBA8: grayscale is spread to RGB, 16 bit channels keep
+// their high byte and missing alpha is opaque. Color space
+// chunks are ignored, like the shaders (which do their own
+// gamma) expect.
+//
+// The IDAT stream is inflated here too, with a table lookup
+// for the common short codes. CRCs and the Adler checksum are
+// not checked; a broken file fails on its structure instead.
+// --------------------------------------------------------
+class PngDecoder
+{
+public:
+											/// <summary>
+											/// Decodes a PNG file already in memory
+											/// </summary>
+											/// <param name="_data">The file's bytes</param>
+											/// <param name="_size">The file's size in bytes</param>
+											/// <param name="_image">Receives the image</param>
+											/// <returns>Whether the file was a PNG this could decode</returns>
+	static bool								Decode(const unsigned char* _data, size_t _size, DecodedImage& _image);
+											/// <summary>
+											/// Reads and decodes a PNG file
+											/// </summary>
+											/// <param name="_path">The full path of the file, in UTF-8</param>
+											/// <param name="_image">Receives the image</param>
+											/// <returns>Whether the file could be read and decoded</returns>
+	static bool								DecodeFile(const std::string& _path, DecodedImage& _image);
+											/// <summary>
+											/// Inflates a zlib stream
+											/// </summary>
+											/// <param name="_data">The stream, starting at its two byte header</param>
+											/// <param name="_size">The stream's size in bytes</param>
+											/// <param name="_expectedSize">How much data the stream should hold, if known (the output grows past it if needed)</param>
+											/// <param name="_output">Receives the data</param>
+											/// <returns>Whether the stream was complete and valid</returns>
+	static bool								Inflate(const unsigned char* _data, size_t _size, size_t _expectedSize, std::vector<unsigned char>& _output);
+};
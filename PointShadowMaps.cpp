@@ -0,0 +1,241 @@
+#include "PointShadowMaps.h"
+#include "PipelineCache.h"
+#include "ShadowMaps.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+
+// Depth bias for the atlas, to keep lit surfaces from shadowing themselves
+constexpr auto POINT_SHADOW_DEPTH_BIAS = 1000;
+constexpr auto POINT_SHADOW_SLOPE_SCALED_DEPTH_BIAS = 1.0f;
+
+// Texels kept between a filtered lookup and its tile's edge (half the PCF kernel, plus half a texel for the bilinear taps)
+constexpr auto POINT_SHADOW_EDGE_TEXELS = 1.5f;
+
+PointShadowMaps::PointShadowMaps(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, std::shared_ptr<SimpleVertexShader> _vertexShader)
+{
+	device = _device;
+	context = _context;
+	vertexShader = _vertexShader;
+	worldHandle = vertexShader->GetVariableHandle("world");
+	lightViewProjectionHandle = vertexShader->GetVariableHandle("lightViewProjection");
+	memset(shadowData, 0, sizeof(shadowData));
+
+	// Typeless, so the same texture can be drawn into as depth and read back as floats
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = SHADOW_ATLAS_RESOLUTION;
+	textureDesc.Height = SHADOW_ATLAS_RESOLUTION;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthDesc = {};
+	depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	depthDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	device->CreateDepthStencilView(texture.Get(), &depthDesc, depthView.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	viewDesc.Texture2D.MipLevels = 1;
+	device->CreateShaderResourceView(texture.Get(), &viewDesc, atlasView.GetAddressOf());
+
+	// Nothing has been drawn yet, so start the whole atlas on the far plane
+	context->ClearDepthStencilView(depthView.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	// One entry per slot, rewritten every frame
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = sizeof(PointShadowData) * MAX_SHADOWED_POINT_LIGHTS;
+	bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = sizeof(PointShadowData);
+	device->CreateBuffer(&bufferDesc, 0, dataBuffer.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC dataViewDesc = {};
+	dataViewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	dataViewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	dataViewDesc.Buffer.NumElements = MAX_SHADOWED_POINT_LIGHTS;
+	device->CreateShaderResourceView(dataBuffer.Get(), &dataViewDesc, dataView.GetAddressOf());
+
+	// Same sampler as the cascades (the pipeline cache hands back the same object)
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.BorderColor[0] = 1.0f;
+	samplerDesc.BorderColor[1] = 1.0f;
+	samplerDesc.BorderColor[2] = 1.0f;
+	samplerDesc.BorderColor[3] = 1.0f;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	D3D11_RASTERIZER_DESC rasterDesc = {};
+	rasterDesc.FillMode = D3D11_FILL_SOLID;
+	rasterDesc.CullMode = D3D11_CULL_BACK;
+	rasterDesc.DepthClipEnable = true;
+	rasterDesc.DepthBias = POINT_SHADOW_DEPTH_BIAS;
+	rasterDesc.SlopeScaledDepthBias = POINT_SHADOW_SLOPE_SCALED_DEPTH_BIAS;
+
+	// Writes depth wherever it draws, for wiping a tile back to the far plane
+	D3D11_DEPTH_STENCIL_DESC clearDesc = {};
+	clearDesc.DepthEnable = true;
+	clearDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	clearDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+
+	PipelineCache& pipelineCache = PipelineCache::GetInstance();
+	sampler = pipelineCache.GetSamplerState(samplerDesc);
+	rasterState = pipelineCache.GetRasterizerState(rasterDesc);
+	clearDepthState = pipelineCache.GetDepthStencilState(clearDesc);
+
+	// A quad filling the viewport on the far plane, drawn with identity matrices (clockwise, so it survives back face culling)
+	Vertex vertices[] = {
+		{ XMFLOAT3(-1, -1, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0), XMFLOAT2(0, 1) },
+		{ XMFLOAT3(-1, 1, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0), XMFLOAT2(0, 0) },
+		{ XMFLOAT3(1, 1, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0), XMFLOAT2(1, 0) },
+		{ XMFLOAT3(1, -1, 1), XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0), XMFLOAT2(1, 1) },
+	};
+	unsigned int indices[] = { 1, 2, 3, 1, 3, 0 };
+	clearQuad = std::make_shared<Mesh>(vertices, 4, indices, 6, device, context);
+}
+
+PointShadowMaps::~PointShadowMaps()
+{
+}
+
+void PointShadowMaps::Render(std::shared_ptr<Camera> _camera, float _screenHeight, std::vector<Light>& _lights, const std::vector<std::shared_ptr<Entity>>& _casters)
+{
+	casterData.resize(_casters.size());
+	for (size_t i = 0; i < _casters.size(); i++)
+	{
+		casterData[i].bounds = _casters[i]->GetBounds();
+		casterData[i].world = _casters[i]->GetTransform()->GetWorldMatrix();
+	}
+	atlas.Update(_camera->GetViewMatrix(), _camera->GetProjectionMatrix(), _screenHeight, _lights, casterData);
+
+	// Only lights holding tiles are shadowed, and they find their tiles by slot
+	for (auto& light : _lights)
+	{
+		if (light.Type != LIGHT_TYPE_POINT) continue;
+		light.Shadowed = 0.0f;
+		light.ShadowIndex = 0.0f;
+	}
+
+	bool anyDirty = false;
+	for (unsigned int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		const ShadowAtlasSlot& slot = atlas.GetSlot(s);
+		if (slot.lightIndex < 0) continue;
+		_lights[slot.lightIndex].Shadowed = 1.0f;
+		_lights[slot.lightIndex].ShadowIndex = (float)s;
+		anyDirty |= slot.dirtyFaces != 0;
+
+		float farClip = (std::max)(slot.range, SHADOW_POINT_NEAR * 2);
+		float depthScale = farClip / (farClip - SHADOW_POINT_NEAR);
+		for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			const ShadowAtlasTile& tile = slot.tiles[f];
+			shadowData[s].faces[f] = XMFLOAT4(
+				(float)tile.x / SHADOW_ATLAS_RESOLUTION,
+				(float)tile.y / SHADOW_ATLAS_RESOLUTION,
+				(float)tile.size / SHADOW_ATLAS_RESOLUTION,
+				POINT_SHADOW_EDGE_TEXELS / tile.size);
+		}
+		shadowData[s].depth = XMFLOAT4(depthScale, -SHADOW_POINT_NEAR * depthScale, 1.0f / SHADOW_ATLAS_RESOLUTION, 0.0f);
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(context->Map(dataBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, shadowData, sizeof(shadowData));
+		context->Unmap(dataBuffer.Get(), 0);
+	}
+	if (!anyDirty) return;
+
+	// The atlas can't be drawn into while it's still bound for reading
+	StateCache& cache = StateCache::GetInstance();
+	cache.PSSetShaderResource(POINT_SHADOW_ATLAS_SLOT, 0);
+
+	// Hang on to the frame's targets and viewport to put back afterwards
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> frameTarget;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> frameDepth;
+	context->OMGetRenderTargets(1, frameTarget.GetAddressOf(), frameDepth.GetAddressOf());
+	D3D11_VIEWPORT frameViewport = {};
+	UINT viewportCount = 1;
+	context->RSGetViewports(&viewportCount, &frameViewport);
+
+	// Depth only
+	vertexShader->SetShader();
+	cache.PSSetShader(0);
+	context->OMSetRenderTargets(0, 0, depthView.Get());
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	for (unsigned int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		const ShadowAtlasSlot& slot = atlas.GetSlot(s);
+		if (slot.lightIndex < 0) continue;
+
+		for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			if (!(slot.dirtyFaces & (1u << f))) continue;
+
+			D3D11_VIEWPORT viewport = {};
+			viewport.TopLeftX = (float)slot.tiles[f].x;
+			viewport.TopLeftY = (float)slot.tiles[f].y;
+			viewport.Width = (float)slot.tiles[f].size;
+			viewport.Height = (float)slot.tiles[f].size;
+			viewport.MaxDepth = 1.0f;
+			context->RSSetViewports(1, &viewport);
+
+			// Wipe the tile (without the bias, which would pull the quad off the far plane)
+			cache.RSSetState(0);
+			cache.OMSetDepthStencilState(clearDepthState.Get(), 0);
+			vertexShader->SetMatrix4x4(worldHandle, identity);
+			vertexShader->SetMatrix4x4(lightViewProjectionHandle, identity);
+			vertexShader->CopyAllBufferData();
+			clearQuad->Bind();
+			clearQuad->DrawIndexed();
+
+			cache.RSSetState(rasterState.Get());
+			cache.OMSetDepthStencilState(0, 0);
+			vertexShader->SetMatrix4x4(lightViewProjectionHandle, slot.faceViewProjection[f]);
+			for (unsigned int index : atlas.GetCasters(s, f))
+			{
+				Entity* entity = _casters[index].get();
+				vertexShader->SetMatrix4x4(worldHandle, entity->GetTransform()->GetWorldMatrix());
+				vertexShader->CopyAllBufferData();
+				entity->GetMesh()->Bind();
+				entity->GetMesh()->DrawIndexed();
+			}
+		}
+	}
+
+	cache.RSSetState(0);
+	context->OMSetRenderTargets(1, frameTarget.GetAddressOf(), frameDepth.Get());
+	context->RSSetViewports(1, &frameViewport);
+}
+
+void PointShadowMaps::Bind()
+{
+	StateCache& cache = StateCache::GetInstance();
+	cache.PSSetShaderResource(POINT_SHADOW_ATLAS_SLOT, atlasView.Get());
+	cache.PSSetShaderResource(POINT_SHADOW_DATA_SLOT, dataView.Get());
+	cache.PSSetSampler(SHADOW_SAMPLER_SLOT, sampler.Get());
+}
+
+ShadowAtlasStats PointShadowMaps::GetStats()
+{
+	return atlas.GetStats();
+}
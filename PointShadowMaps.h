@@ -0,0 +1,77 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "Entity.h"
+#include "Mesh.h"
+#include "ShadowAtlas.h"
+#include "SimpleShader.h"
+
+// Registers the atlas and its per-light data are bound to (the comparison sampler is shared with ShadowMaps)
+// - These should match Shadows.hlsli
+constexpr auto POINT_SHADOW_ATLAS_SLOT = 24;
+constexpr auto POINT_SHADOW_DATA_SLOT = 25;
+
+// Where a shadowed point light's faces are in the atlas
+// - This should match PointShadow in Shadows.hlsli
+struct PointShadowData
+{
+	DirectX::XMFLOAT4	faces[SHADOW_CUBE_FACES];	// Atlas UV offset (xy) and scale (z) of each face's tile, and the inset (w) that keeps filtering inside it
+	DirectX::XMFLOAT4	depth;						// Depth from distance along a face: x + y / distance; z is the atlas texel size
+};
+
+// --------------------------------------------------------
+// Point light shadows in one depth atlas: each shadowed
+// light's cube faces are tiles placed by a ShadowAtlas
+//
+// Only the faces the atlas marks dirty are drawn each
+// frame; the rest keep what was drawn into them before.
+// A tile is cleared by drawing a quad on its far plane,
+// since clearing the depth view would wipe every tile.
+// --------------------------------------------------------
+class PointShadowMaps
+{
+public:
+	PointShadowMaps(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, std::shared_ptr<SimpleVertexShader> _vertexShader);
+	~PointShadowMaps();
+
+											/// <summary>
+											/// Places the point lights in the atlas, marks the ones that got tiles and draws their dirty faces,
+											/// leaving the frame's targets and viewport bound afterwards
+											/// </summary>
+											/// <param name="_camera">The camera rendering this frame</param>
+											/// <param name="_screenHeight">The height of the screen in pixels</param>
+											/// <param name="_lights">The scene's lights (Shadowed and ShadowIndex are set on the point lights)</param>
+											/// <param name="_casters">The entities that cast shadows</param>
+	void									Render(std::shared_ptr<Camera> _camera, float _screenHeight, std::vector<Light>& _lights, const std::vector<std::shared_ptr<Entity>>& _casters);
+											/// <summary>
+											/// Binds the atlas, its per-light data and the comparison sampler to the pixel shader stage
+											/// </summary>
+	void									Bind();
+
+	ShadowAtlasStats						GetStats();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device>		device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+
+	ShadowAtlas								atlas;
+	std::vector<ShadowAtlasCaster>			casterData;
+	PointShadowData							shadowData[MAX_SHADOWED_POINT_LIGHTS];
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	atlasView;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView>		depthView;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>				dataBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	dataView;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState>			sampler;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState>		rasterState;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState>		clearDepthState;
+	std::shared_ptr<Mesh>					clearQuad;
+
+	std::shared_ptr<SimpleVertexShader>		vertexShader;
+	SimpleShaderHandle						worldHandle;
+	SimpleShaderHandle						lightViewProjectionHandle;
+};
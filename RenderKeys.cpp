@@ -0,0 +1,122 @@
+#include "RenderKeys.h"
+
+#include <cstddef>
+#include <utility>
+
+uint64_t RenderKeys::Make(int _pass, unsigned int _program, unsigned int _material, unsigned int _mesh, unsigned int _depth)
+{
+	uint64_t pass = (uint64_t)(_pass & 0x3);
+	uint64_t program = (uint64_t)(_program & ((1 << RENDERKEY_PROGRAM_BITS) - 1));
+	uint64_t material = (uint64_t)(_material & ((1 << RENDERKEY_MATERIAL_BITS) - 1));
+	uint64_t mesh = (uint64_t)(_mesh & ((1 << RENDERKEY_MESH_BITS) - 1));
+	uint64_t depth = (uint64_t)(_depth & ((1 << RENDERKEY_DEPTH_BITS) - 1));
+
+	uint64_t state = (program << (RENDERKEY_MATERIAL_BITS + RENDERKEY_MESH_BITS)) | (material << RENDERKEY_MESH_BITS) | mesh;
+	if (_pass == RENDERPASS_TRANSPARENT)
+	{
+		// Blending needs back-to-front, so distance leads (inverted) and state only breaks ties
+		uint64_t inverted = ((1 << RENDERKEY_DEPTH_BITS) - 1) - depth;
+		return (pass << 62) | (inverted << 38) | state;
+	}
+
+	// Opaque draws group by state first, then go front-to-back within each group for early-z
+	return (pass << 62) | (state << RENDERKEY_DEPTH_BITS) | depth;
+}
+
+unsigned int RenderKeys::QuantizeDepth(float _distance, float _farClip)
+{
+	float depth = _distance / _farClip;
+	if (depth < 0) depth = 0;
+	if (depth > 1) depth = 1;
+	return (unsigned int)(depth * ((1 << RENDERKEY_DEPTH_BITS) - 1));
+}
+
+int RenderKeys::GetPass(uint64_t _key)
+{
+	return (int)(_key >> 62);
+}
+
+void RenderKeys::RadixSort(std::vector<RenderKey>& _keys, std::vector<RenderKey>& _scratch)
+{
+	size_t count = _keys.size();
+	if (count < 2) return;
+	_scratch.resize(count);
+
+	// Build all eight histograms in a single read of the keys
+	unsigned int histograms[8][256] = {};
+	for (auto& k : _keys)
+	{
+		for (int d = 0; d < 8; d++)
+		{
+			histograms[d][(k.key >> (d * 8)) & 0xFF]++;
+		}
+	}
+
+	RenderKey* source = _keys.data();
+	RenderKey* destination = _scratch.data();
+	for (int d = 0; d < 8; d++)
+	{
+		// A digit every key shares wouldn't move anything
+		unsigned int* histogram = histograms[d];
+		if (histogram[(source[0].key >> (d * 8)) & 0xFF] == count) continue;
+
+		unsigned int offsets[256];
+		unsigned int total = 0;
+		for (int b = 0; b < 256; b++)
+		{
+			offsets[b] = total;
+			total += histogram[b];
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			destination[offsets[(source[i].key >> (d * 8)) & 0xFF]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (source != _keys.data())
+	{
+		_keys.swap(_scratch);
+	}
+}
+
+bool RenderKeys::InsertionSort(std::vector<RenderKey>& _keys, unsigned int _maxMoves, unsigned int& _moves)
+{
+	_moves = 0;
+	for (size_t i = 1; i < _keys.size(); i++)
+	{
+		// Equal keys go by index, so they end up in add order whatever order they started in
+		RenderKey key = _keys[i];
+		size_t j = i;
+		while (j > 0 && (_keys[j - 1].key > key.key || (_keys[j - 1].key == key.key && _keys[j - 1].index > key.index)))
+		{
+			_keys[j] = _keys[j - 1];
+			j--;
+			_moves++;
+		}
+		_keys[j] = key;
+
+		if (_moves > _maxMoves) return false;
+	}
+	return true;
+}
+
+bool RenderKeys::CoherentSort(std::vector<RenderKey>& _keys, const std::vector<unsigned int>& _previousOrder, std::vector<RenderKey>& _scratch, unsigned int _maxMoves, unsigned int& _moves)
+{
+	// Lay the keys out in last frame's order; the add-ordered keys stay in the scratch space
+	_scratch.resize(_keys.size());
+	for (size_t i = 0; i < _keys.size(); i++)
+	{
+		_scratch[i] = _keys[_previousOrder[i]];
+	}
+	_keys.swap(_scratch);
+	if (InsertionSort(_keys, _maxMoves, _moves))
+		return true;
+
+	// The radix sort only keeps ties in add order if it starts from add order, not the part-sorted keys
+	_keys.swap(_scratch);
+	RadixSort(_keys, _scratch);
+	return false;
+}
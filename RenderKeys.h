@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+constexpr auto RENDERPASS_OPAQUE = 0;
+constexpr auto RENDERPASS_TRANSPARENT = 1;
+
+// Key field widths (see the layout below)
+constexpr auto RENDERKEY_PROGRAM_BITS = 10;
+constexpr auto RENDERKEY_MATERIAL_BITS = 14;
+constexpr auto RENDERKEY_MESH_BITS = 14;
+constexpr auto RENDERKEY_DEPTH_BITS = 24;
+
+// A single draw as seen by the sort: the packed key and where its data lives
+struct RenderKey
+{
+	uint64_t								key;
+	unsigned int							index;
+};
+
+// --------------------------------------------------------
+// Packs draws into 64-bit sort keys and sorts them
+//
+// Opaque:      pass(2) | program(10) | material(14) | mesh(14) | depth(24)
+// Transparent: pass(2) | ~depth(24) | program(10) | material(14) | mesh(14)
+//
+// Draws with identical keys keep the order they were added in,
+// whichever sort ran (a key's index is its place in add order,
+// and the insertion sort breaks ties on it). Nothing here knows
+// about D3D; RenderQueue builds the keys from its entities.
+// --------------------------------------------------------
+class RenderKeys
+{
+public:
+											/// <summary>
+											/// Packs a draw's pass, state ids and depth into a key
+											/// </summary>
+											/// <param name="_pass">The pass (see RENDERPASS_{types})</param>
+											/// <param name="_depth">Distance from the camera, quantized to RENDERKEY_DEPTH_BITS (see QuantizeDepth)</param>
+	static uint64_t							Make(int _pass, unsigned int _program, unsigned int _material, unsigned int _mesh, unsigned int _depth);
+											/// <summary>
+											/// Quantizes a distance across the view range for a key (clamped to [0, far])
+											/// </summary>
+	static unsigned int						QuantizeDepth(float _distance, float _farClip);
+											/// <summary>
+											/// Gets the pass a key was made for
+											/// </summary>
+	static int								GetPass(uint64_t _key);
+
+											/// <summary>
+											/// Stable LSD radix sort on the keys, 8 bits at a time; digits every key shares are skipped
+											/// </summary>
+											/// <param name="_keys">The keys to sort (sorted in place)</param>
+											/// <param name="_scratch">Scratch space, resized as needed so it can be reused between calls</param>
+	static void								RadixSort(std::vector<RenderKey>& _keys, std::vector<RenderKey>& _scratch);
+											/// <summary>
+											/// Insertion sort on the keys and then their indices, giving up once it has moved too many
+											/// </summary>
+											/// <param name="_keys">The keys to sort (sorted in place; left part-sorted on giving up)</param>
+											/// <param name="_maxMoves">How many single-place moves to allow before giving up</param>
+											/// <param name="_moves">Receives the number of moves made</param>
+											/// <returns>Whether the keys were fully sorted</returns>
+	static bool								InsertionSort(std::vector<RenderKey>& _keys, unsigned int _maxMoves, unsigned int& _moves);
+											/// <summary>
+											/// Sorts keys starting from last frame's order, falling back to a radix sort from add order if the insertion sort gives up
+											/// </summary>
+											/// <param name="_keys">The keys in add order, each index its place (sorted in place)</param>
+											/// <param name="_previousOrder">Last frame's sorted indices, for the same draws</param>
+											/// <param name="_scratch">Scratch space, resized as needed so it can be reused between calls</param>
+											/// <param name="_maxMoves">How many single-place moves the insertion sort may make</param>
+											/// <param name="_moves">Receives the number of moves made</param>
+											/// <returns>Whether the insertion sort finished the job</returns>
+	static bool								CoherentSort(std::vector<RenderKey>& _keys, const std::vector<unsigned int>& _previousOrder, std::vector<RenderKey>& _scratch, unsigned int _maxMoves, unsigned int& _moves);
+};
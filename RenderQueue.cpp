@@ -0,0 +1,273 @@
+#include "RenderQueue.h"
+#include "StateCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX;
+
+// How far the insertion sort may move keys (on average) before the radix sort takes over
+constexpr auto RENDERQUEUE_COHERENT_MOVES_PER_KEY = 4;
+
+RenderQueue::RenderQueue()
+{
+	cameraPosition = XMFLOAT3(0, 0, 0);
+	lights = 0;
+	coherentSort = true;
+	lightLOD = true;
+	nextProgramId = 0;
+	stats = {};
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+void RenderQueue::Begin(std::shared_ptr<Camera> _camera, const std::vector<Light>& _lights)
+{
+	camera = _camera;
+	cameraPosition = camera->GetTransform()->GetPosition();
+	lights = &_lights;
+	items.clear();
+	keys.clear();
+	stats = {};
+	ReleaseDeadPrograms();
+}
+
+void RenderQueue::Add(std::shared_ptr<Entity> _entity, int _pass, ID3D11RasterizerState* _rasterState, bool _sortTriangles)
+{
+	RenderItem item = {};
+	item.entity = _entity.get();
+	item.material = _entity->GetMaterial().get();
+	item.mesh = _entity->GetMesh().get();
+	item.rasterState = _rasterState;
+	item.sortTriangles = _sortTriangles;
+	item.program = GetProgramId(item.material);
+
+	// Distance from the camera to the bounds, quantized across the view range
+	BoundingSphere bounds = _entity->GetBounds();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	item.lightLOD.center = bounds.Center;
+	item.lightLOD.exactCount = SelectObjectLights(*lights, bounds.Center, bounds.Radius, item.lightLOD.exactIndices, MAX_OBJECT_LIGHTS, &stats.lights);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.lights.milliseconds += elapsed.count();
+
+	float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - XMLoadFloat3(&cameraPosition)));
+	unsigned int quantized = RenderKeys::QuantizeDepth(distance, camera->GetFarClip());
+
+	RenderKey key = {};
+	key.key = RenderKeys::Make(_pass, item.program, item.material->GetId(), item.mesh->GetId(), quantized);
+	key.index = (unsigned int)items.size();
+
+	items.push_back(item);
+	keys.push_back(key);
+}
+
+void RenderQueue::Sort()
+{
+	// Count how often state would change if the draws went out in the order they were added
+	for (unsigned int i = 0; i < items.size(); i++)
+	{
+		if (i == 0 || items[i].program != items[i - 1].program) stats.unsortedProgramChanges++;
+		if (i == 0 || items[i].material != items[i - 1].material) stats.unsortedMaterialChanges++;
+		if (i == 0 || items[i].mesh != items[i - 1].mesh) stats.unsortedMeshChanges++;
+	}
+
+	// Every draw's leftover lights go through the projection in one batch
+	irradiance.resize(items.size());
+	if (lightLOD && !items.empty())
+	{
+		std::chrono::high_resolution_clock::time_point projectStart = std::chrono::high_resolution_clock::now();
+		lightLODObjects.resize(items.size());
+		for (size_t i = 0; i < items.size(); i++)
+		{
+			lightLODObjects[i] = items[i].lightLOD;
+		}
+		ProjectRemainingLights(*lights, lightLODObjects.data(), (unsigned int)items.size(), irradiance.data());
+		std::chrono::duration<double, std::milli> projectElapsed = std::chrono::high_resolution_clock::now() - projectStart;
+		stats.lightLODMilliseconds = projectElapsed.count();
+	}
+	else
+	{
+		std::fill(irradiance.begin(), irradiance.end(), SHIrradiance());
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// Last frame's order is only a useful starting point if the same draws were queued in the same order
+	bool sameDraws = coherentSort && previousOrder.size() == keys.size();
+	for (unsigned int i = 0; sameDraws && i < items.size(); i++)
+	{
+		sameDraws = previousEntities[i] == items[i].entity;
+	}
+
+	if (sameDraws)
+	{
+		stats.coherentSort = RenderKeys::CoherentSort(keys, previousOrder, scratch, (unsigned int)keys.size() * RENDERQUEUE_COHERENT_MOVES_PER_KEY, stats.insertionMoves);
+	}
+	else
+	{
+		stats.coherentSort = false;
+		RenderKeys::RadixSort(keys, scratch);
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	stats.sortMilliseconds = elapsed.count();
+
+	// Remember this frame's order for the next one
+	previousOrder.resize(keys.size());
+	previousEntities.resize(items.size());
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		previousOrder[i] = keys[i].index;
+	}
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		previousEntities[i] = items[i].entity;
+	}
+}
+
+void RenderQueue::Submit(int _pass)
+{
+	// Nothing is assumed to be bound coming in, since other drawing may have happened in between passes
+	unsigned int lastProgram = UINT_MAX;
+	Material* lastMaterial = 0;
+	Mesh* lastMesh = 0;
+	StateCache& cache = StateCache::GetInstance();
+	ObjectLightData objectLights = {};
+
+	for (auto& key : keys)
+	{
+		if (RenderKeys::GetPass(key.key) != _pass) continue;
+		RenderItem& item = items[key.index];
+
+		if (item.program != lastProgram)
+		{
+			item.material->ActivateShaders();
+			lastProgram = item.program;
+			stats.programChanges++;
+		}
+		if (item.material != lastMaterial)
+		{
+			item.material->ActivateMaterial();
+			lastMaterial = item.material;
+			stats.materialChanges++;
+		}
+
+		objectLights.lightCount = (float)item.lightLOD.exactCount;
+		for (unsigned int i = 0; i < item.lightLOD.exactCount; i++)
+		{
+			objectLights.lights[i] = (*lights)[item.lightLOD.exactIndices[i]];
+		}
+		memcpy(objectLights.irradiance, irradiance[key.index].coefficients, sizeof(objectLights.irradiance));
+		item.material->ActivateObject(item.entity->GetTransform(), objectLights);
+
+		if (item.sortTriangles)
+		{
+			// The sorted order lives in its own index buffer, so whatever draws next has to re-bind
+			if (item.mesh->BindSorted(GetLocalViewDirection(item))) stats.sortedUploads++;
+			lastMesh = 0;
+			stats.meshChanges++;
+			stats.sortedDraws++;
+		}
+		else if (item.mesh != lastMesh)
+		{
+			item.mesh->Bind();
+			lastMesh = item.mesh;
+			stats.meshChanges++;
+		}
+		cache.RSSetState(item.rasterState);
+
+		item.mesh->DrawIndexed();
+		stats.draws++;
+	}
+
+	// Leave the default rasterizer state behind for whatever draws next
+	cache.RSSetState(0);
+}
+
+RenderQueueStats RenderQueue::GetStats()
+{
+	return stats;
+}
+
+void RenderQueue::SetCoherentSort(bool _enabled)
+{
+	coherentSort = _enabled;
+	previousOrder.clear();
+	previousEntities.clear();
+}
+
+void RenderQueue::SetLightLOD(bool _enabled)
+{
+	lightLOD = _enabled;
+}
+
+XMFLOAT3 RenderQueue::GetLocalViewDirection(RenderItem& _item)
+{
+	// Bring the camera into the mesh's space (which also undoes negative scales) and point at it from the bounds' center
+	XMFLOAT4X4 world = _item.entity->GetTransform()->GetWorldMatrix();
+	XMMATRIX worldInverse = XMMatrixInverse(0, XMLoadFloat4x4(&world));
+	XMVECTOR localCamera = XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), worldInverse);
+
+	BoundingSphere bounds = _item.mesh->GetBounds();
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, localCamera - XMLoadFloat3(&bounds.Center));
+	return direction;
+}
+
+#pragma region Internal Key Building
+unsigned int RenderQueue::GetProgramId(Material* _material)
+{
+	// Shader pairs get small ids as they're first seen, so they fit in the key
+	std::shared_ptr<SimpleVertexShader> vertexShader = _material->GetVertexShader();
+	std::shared_ptr<SimplePixelShader> pixelShader = _material->GetPixelShader();
+	std::pair<SimpleVertexShader*, SimplePixelShader*> program(vertexShader.get(), pixelShader.get());
+	auto found = programIds.find(program);
+	if (found != programIds.end())
+	{
+		if (!found->second.vertexShader.expired() && !found->second.pixelShader.expired()) return found->second.id;
+
+		// A pair freed since Begin whose addresses went to new shaders; the new pair can't keep its id
+		freeProgramIds.push_back(found->second.id);
+		programIds.erase(found);
+	}
+
+	// Every live pair needs its own id, or two programs would share a key and interleave
+	assert(programIds.size() < (1u << RENDERKEY_PROGRAM_BITS) && "More shader pairs alive than the render key's program bits can tell apart");
+
+	ProgramEntry entry = { vertexShader, pixelShader, nextProgramId };
+	if (!freeProgramIds.empty())
+	{
+		entry.id = freeProgramIds.back();
+		freeProgramIds.pop_back();
+	}
+	else
+	{
+		nextProgramId++;
+	}
+	programIds.insert({ program, entry });
+	return entry.id;
+}
+
+void RenderQueue::ReleaseDeadPrograms()
+{
+	// Pairs whose shaders have been freed give their ids back
+	for (auto it = programIds.begin(); it != programIds.end();)
+	{
+		if (it->second.vertexShader.expired() || it->second.pixelShader.expired())
+		{
+			freeProgramIds.push_back(it->second.id);
+			it = programIds.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+#pragma endregion
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "Entity.h"
+#include "LightAssignment.h"
+#include "LightLOD.h"
+#include "RenderKeys.h"
+
+struct RenderQueueStats
+{
+	unsigned int							draws;
+	unsigned int							programChanges;
+	unsigned int							materialChanges;
+	unsigned int							meshChanges;
+	unsigned int							unsortedProgramChanges;
+	unsigned int							unsortedMaterialChanges;
+	unsigned int							unsortedMeshChanges;
+	double									sortMilliseconds;
+	bool									coherentSort;		// Whether last frame's order was close enough to finish with an insertion sort
+	unsigned int							insertionMoves;
+	unsigned int							sortedDraws;		// Draws with their triangles ordered back-to-front
+	unsigned int							sortedUploads;		// Of those, draws whose triangle order had to be uploaded
+	LightAssignmentStats					lights;				// Building each queued draw's light list
+	double									lightLODMilliseconds;	// Projecting the lights that missed each list into SH
+};
+
+// --------------------------------------------------------
+// Collects a frame's entity draws and submits them in state order
+//
+// Each draw is packed into a 64-bit key and radix sorted (see
+// RenderKeys.h), so draws sharing shaders, materials and meshes end
+// up next to each other and only the state that actually changes
+// gets re-bound.
+//
+// Draws with identical keys (e.g. the back and front faces of one
+// transparent entity) keep the order they were added in, however
+// the keys were sorted. Draws can instead ask for their own triangles to
+// be sorted back-to-front, which covers both faces in one draw.
+//
+// Each draw also gets its own short list of the lights reaching
+// its bounds, chosen as it's queued and uploaded as it's drawn.
+// The lights that miss the list are projected into SH irradiance
+// for all draws at once as the queue is sorted (see LightLOD.h).
+//
+// When the same entities are queued as last frame, the keys start
+// out in last frame's sorted order instead; with a steady camera
+// only a few draws change places, so an insertion sort finishes
+// the job and the radix sort (from add order) is only needed if
+// it runs long.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+											/// <summary>
+											/// Empties the queue and sets the camera used for depth keys and submission
+											/// </summary>
+											/// <param name="_camera">The camera rendering this frame</param>
+											/// <param name="_lights">The scene's lights (must stay alive and unchanged until after Submit)</param>
+	void									Begin(std::shared_ptr<Camera> _camera, const std::vector<Light>& _lights);
+											/// <summary>
+											/// Queues an entity to be drawn
+											/// </summary>
+											/// <param name="_entity">The entity to draw</param>
+											/// <param name="_pass">The pass to draw it in (see RENDERPASS_{types})</param>
+											/// <param name="_rasterState">The rasterizer state to draw it with (0 for the default)</param>
+											/// <param name="_sortTriangles">Whether to draw the mesh's triangles back-to-front from the camera</param>
+	void									Add(std::shared_ptr<Entity> _entity, int _pass, ID3D11RasterizerState* _rasterState = 0, bool _sortTriangles = false);
+											/// <summary>
+											/// Sorts everything queued since Begin, and projects each draw's leftover lights
+											/// </summary>
+	void									Sort();
+											/// <summary>
+											/// Draws the sorted entities of one pass, skipping redundant binds (per-frame data must already be bound)
+											/// </summary>
+											/// <param name="_pass">The pass to draw (see RENDERPASS_{types})</param>
+	void									Submit(int _pass);
+
+	RenderQueueStats						GetStats();
+											/// <summary>
+											/// Turns the insertion sort over last frame's order on or off (on by default)
+											/// </summary>
+	void									SetCoherentSort(bool _enabled);
+											/// <summary>
+											/// Turns projecting the lights that miss each draw's list into SH on or off (on by default)
+											/// </summary>
+	void									SetLightLOD(bool _enabled);
+
+private:
+	struct RenderItem
+	{
+		Entity*								entity;
+		Material*							material;
+		Mesh*								mesh;
+		ID3D11RasterizerState*				rasterState;
+		unsigned int						program;
+		bool								sortTriangles;
+		LightLODObject						lightLOD;			// Center and the lights drawn exactly
+	};
+
+	DirectX::XMFLOAT3						GetLocalViewDirection(RenderItem& _item);
+
+	unsigned int							GetProgramId(Material* _material);
+	void									ReleaseDeadPrograms();
+
+	std::shared_ptr<Camera>					camera;
+	DirectX::XMFLOAT3						cameraPosition;
+	const std::vector<Light>*				lights;
+
+	std::vector<RenderItem>					items;
+	std::vector<LightLODObject>				lightLODObjects;
+	std::vector<SHIrradiance>				irradiance;			// Per item
+	bool									lightLOD;
+	std::vector<RenderKey>					keys;
+	std::vector<RenderKey>					scratch;
+	bool									coherentSort;
+	std::vector<unsigned int>				previousOrder;
+	std::vector<Entity*>					previousEntities;
+	struct ProgramEntry
+	{
+		std::weak_ptr<SimpleVertexShader>	vertexShader;		// Held weakly so a freed pair is noticed, even if its address comes back
+		std::weak_ptr<SimplePixelShader>	pixelShader;
+		unsigned int						id;
+	};
+	std::map<std::pair<SimpleVertexShader*, SimplePixelShader*>, ProgramEntry>	programIds;
+	std::vector<unsigned int>				freeProgramIds;		// Ids of freed pairs, handed out again before new ones
+	unsigned int							nextProgramId;
+
+	RenderQueueStats						stats;
+};
@@ -0,0 +1,79 @@
+#include "ResourceRegistry.h"
+#include "PathEncoding.h"
+
+#include <fstream>
+
+std::string NormalizeResourcePath(const std::string& _path)
+{
+	std::vector<std::string> parts;
+	std::string part;
+	bool rooted = !_path.empty() && (_path[0] == '/' || _path[0] == '\\');
+
+	for (size_t i = 0; i <= _path.size(); i++)
+	{
+		char c = i < _path.size() ? _path[i] : '/';
+		if (c != '/' && c != '\\')
+		{
+			part += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+			continue;
+		}
+
+		if (part == "..")
+		{
+			if (!parts.empty() && parts.back() != "..") parts.pop_back();
+			else parts.push_back(part);
+		}
+		else if (!part.empty() && part != ".")
+		{
+			parts.push_back(part);
+		}
+		part.clear();
+	}
+
+	std::string normalized = rooted ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i > 0) normalized += '/';
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+std::string NormalizeResourcePath(const std::wstring& _path)
+{
+	// In UTF-8, so paths that differ anywhere stay different keys (only ASCII letters are folded)
+	return NormalizeResourcePath(WidePathToUTF8(_path));
+}
+
+// 64-bit FNV-1a, as for shader blobs
+unsigned long long HashResourceContent(const void* _data, size_t _size)
+{
+	const unsigned char* bytes = (const unsigned char*)_data;
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < _size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool ReadResourceFile(const std::string& _path, std::vector<unsigned char>& _data)
+{
+	std::ifstream file;
+	OpenUTF8Path(file, _path, std::ios::binary | std::ios::ate);
+	if (!file) return false;
+
+	std::streamoff size = file.tellg();
+	if (size <= 0) return false;
+	_data.resize((size_t)size);
+	file.seekg(0);
+	return (bool)file.read((char*)_data.data(), size);
+}
+
+bool ResourceFilesMatch(const std::string& _a, const std::string& _b)
+{
+	std::vector<unsigned char> a;
+	std::vector<unsigned char> b;
+	return ReadResourceFile(_a, a) && ReadResourceFile(_b, b) && a == b;
+}
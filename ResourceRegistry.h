@@ -0,0 +1,256 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ResourceRegistryStats
+{
+	unsigned int							requests;			// Acquire calls
+	unsigned int							pathHits;			// Of those, paths (once normalized) already held
+	unsigned int							contentHits;		// Loads whose contents matched a resource already held, and were merged into it
+	unsigned int							collisions;			// Loads whose hash and size matched a resource held but whose bytes didn't
+	unsigned int							created;			// Entries that had to be loaded (merged ones included)
+	unsigned int							freed;				// Resources dropped when their last reference went
+	unsigned int							live;
+	unsigned int							references;			// Held over every live resource
+	unsigned long long						liveBytes;			// Memory the live resources take
+	unsigned long long						savedBytes;			// Memory extra copies would take if every reference had its own
+};
+
+// --------------------------------------------------------
+// Makes a path a key for the file it names: lowercase (the
+// file system isn't case sensitive), forward slashes, and no
+// empty, "." or ".." parts (".." past the start is kept)
+// --------------------------------------------------------
+std::string NormalizeResourcePath(const std::string& _path);
+std::string NormalizeResourcePath(const std::wstring& _path);
+
+// --------------------------------------------------------
+// Hashes a file's bytes (64-bit FNV-1a), so files with the
+// same contents can be told apart from ones with the same name
+// --------------------------------------------------------
+unsigned long long HashResourceContent(const void* _data, size_t _size);
+
+// --------------------------------------------------------
+// Reads a whole file (its path in UTF-8) into memory, for
+// hashing and loading; fails if it can't be read or is empty
+// --------------------------------------------------------
+bool ReadResourceFile(const std::string& _path, std::vector<unsigned char>& _data);
+
+// --------------------------------------------------------
+// Checks whether two files hold the same bytes; fails if
+// either can't be read
+// --------------------------------------------------------
+bool ResourceFilesMatch(const std::string& _a, const std::string& _b);
+
+// --------------------------------------------------------
+// Counts references to loaded resources, so each file is
+// only loaded once however it's named, and frees them when
+// the last user lets go
+//
+// Acquire looks a path up once it's normalized, and either
+// adds a reference to what's there or makes a new entry for
+// the caller to load. Once the caller has the file's bytes,
+// Resolve looks for a resource already loaded from the same
+// contents under another name; if there is one, the new
+// entry is merged into it (its path and references move
+// across) and the caller should use that one instead. A
+// matching hash and size only make that likely, so the
+// caller confirms the bytes match before anything merges;
+// a collision keeps its own entry.
+//
+// Release drops a reference and reports when the resource
+// should be freed. Handles stay valid until then, apart from
+// the one a merge replaces. Nothing here knows about D3D or
+// files; values are whatever the caller frees resources by.
+// --------------------------------------------------------
+template <typename TValue>
+class ResourceRegistry
+{
+public:
+	ResourceRegistry()
+	{
+		nextHandle = 0;
+		stats = {};
+	}
+
+											/// <summary>
+											/// Adds a reference to the resource loaded from a path, making an entry for it if there isn't one
+											/// </summary>
+											/// <param name="_path">The path of the file, in any form that names it</param>
+											/// <param name="_created">Set if the entry is new, and the caller has to load it and Set its value</param>
+											/// <returns>The handle of the resource</returns>
+	unsigned int							Acquire(const std::string& _path, bool& _created)
+	{
+		stats.requests++;
+		std::string key = NormalizeResourcePath(_path);
+		auto found = paths.find(key);
+		if (found != paths.end())
+		{
+			stats.pathHits++;
+			entries[found->second].references++;
+			_created = false;
+			return found->second;
+		}
+
+		unsigned int handle = nextHandle++;
+		Entry entry = {};
+		entry.references = 1;
+		entry.paths.push_back(key);
+		entries.insert({ handle, entry });
+		paths.insert({ key, handle });
+		stats.created++;
+		_created = true;
+		return handle;
+	}
+
+											/// <summary>
+											/// Records the contents a new entry was loaded from, merging it into any resource with the same contents
+											/// </summary>
+											/// <param name="_handle">A handle Acquire created</param>
+											/// <param name="_contentHash">The file's HashResourceContent</param>
+											/// <param name="_contentSize">The file's size, so a hash collision also needs the sizes to match</param>
+											/// <param name="_sameContents">Called with the handle of a resource with the same hash and size; returns whether its bytes really match</param>
+											/// <returns>The handle to use from now on: _handle, or the resource it was merged into (_handle is then gone)</returns>
+	template <typename TSameContents>
+	unsigned int							Resolve(unsigned int _handle, unsigned long long _contentHash, unsigned long long _contentSize, TSameContents _sameContents)
+	{
+		ContentKey content = { _contentHash, _contentSize };
+		Entry& entry = entries[_handle];
+		entry.content = content;
+		entry.resolved = true;
+
+		auto found = contents.find(content);
+		if (found == contents.end() || found->second == _handle)
+		{
+			contents.insert({ content, _handle });
+			return _handle;
+		}
+
+		// Different bytes under the same key: the first one loaded keeps the key, so later loads are only compared with it
+		if (!_sameContents(found->second))
+		{
+			stats.collisions++;
+			return _handle;
+		}
+
+		Entry& duplicate = entries[_handle];
+		Entry& original = entries[found->second];
+		original.references += duplicate.references;
+		for (auto& path : duplicate.paths)
+		{
+			paths[path] = found->second;
+			original.paths.push_back(path);
+		}
+		entries.erase(_handle);
+		stats.contentHits++;
+		return found->second;
+	}
+
+											/// <summary>
+											/// Stores what the caller frees the resource by, and how much memory it takes
+											/// </summary>
+	void									Set(unsigned int _handle, const TValue& _value, unsigned long long _bytes)
+	{
+		Entry& entry = entries[_handle];
+		entry.value = _value;
+		entry.bytes = _bytes;
+	}
+	const TValue&							Get(unsigned int _handle)
+	{
+		return entries[_handle].value;
+	}
+											/// <summary>
+											/// Gets the first path a resource was acquired by, normalized
+											/// </summary>
+	const std::string&						GetPath(unsigned int _handle)
+	{
+		return entries[_handle].paths[0];
+	}
+	bool									Contains(unsigned int _handle)
+	{
+		return entries.find(_handle) != entries.end();
+	}
+
+											/// <summary>
+											/// Drops a reference
+											/// </summary>
+											/// <param name="_handle">The handle Acquire or Resolve gave</param>
+											/// <param name="_value">Receives the resource's value when it's freed</param>
+											/// <returns>Whether that was the last reference, so the caller should free the resource</returns>
+	bool									Release(unsigned int _handle, TValue& _value)
+	{
+		auto found = entries.find(_handle);
+		if (found == entries.end()) return false;
+
+		Entry& entry = found->second;
+		if (--entry.references > 0) return false;
+
+		for (auto& path : entry.paths)
+		{
+			paths.erase(path);
+		}
+		if (entry.resolved)
+		{
+			auto content = contents.find(entry.content);
+			if (content != contents.end() && content->second == _handle) contents.erase(content);
+		}
+		_value = entry.value;
+		entries.erase(found);
+		stats.freed++;
+		return true;
+	}
+
+	ResourceRegistryStats					GetStats()
+	{
+		ResourceRegistryStats current = stats;
+		current.live = (unsigned int)entries.size();
+		current.references = 0;
+		current.liveBytes = 0;
+		current.savedBytes = 0;
+		for (auto& entry : entries)
+		{
+			current.references += entry.second.references;
+			current.liveBytes += entry.second.bytes;
+			current.savedBytes += entry.second.bytes * (entry.second.references - 1);
+		}
+		return current;
+	}
+
+private:
+	struct ContentKey
+	{
+		unsigned long long					hash;
+		unsigned long long					size;
+
+		bool operator==(const ContentKey& _other) const
+		{
+			return hash == _other.hash && size == _other.size;
+		}
+	};
+
+	struct ContentKeyHash
+	{
+		size_t operator()(const ContentKey& _key) const
+		{
+			return (size_t)(_key.hash ^ (_key.size * 0x9E3779B97F4A7C15ull));
+		}
+	};
+
+	struct Entry
+	{
+		TValue								value;
+		unsigned long long					bytes;
+		unsigned int						references;
+		bool								resolved;			// Whether content holds the file's contents yet
+		ContentKey							content;
+		std::vector<std::string>			paths;				// Every normalized path that names it
+	};
+
+	std::unordered_map<unsigned int, Entry>	entries;			// By handle
+	std::unordered_map<std::string, unsigned int>	paths;
+	std::unordered_map<ContentKey, unsigned int, ContentKeyHash>	contents;
+	unsigned int							nextHandle;
+	ResourceRegistryStats					stats;
+};
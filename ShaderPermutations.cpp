@@ -0,0 +1,53 @@
+#include "ShaderPermutations.h"
+
+#include "DXCore.h"
+#include "ConstantBuffers.h"
+
+std::shared_ptr<SimplePixelShader> CompilePixelPermutation(
+	Microsoft::WRL::ComPtr<ID3D11Device>		_device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	_context,
+	const std::wstring&							_source,
+	const ShaderDefines&						_defines)
+{
+	// D3D wants a null-terminated array of name/value pairs
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (auto& define : _defines)
+	{
+		macros.push_back({ define.first.c_str(), define.second.c_str() });
+	}
+	macros.push_back({ 0, 0 });
+
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(DEBUG) || defined(_DEBUG)
+	flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	Microsoft::WRL::ComPtr<ID3DBlob> errors;
+	HRESULT result = D3DCompileFromFile(
+		DXCore::GetFullPathTo_Wide(L"Shaders/" + _source).c_str(),
+		macros.data(),
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main",
+		"ps_5_0",
+		flags,
+		0,
+		blob.GetAddressOf(),
+		errors.GetAddressOf());
+
+	if (FAILED(result))
+	{
+		printf("Shader permutation of '%ls' failed to compile\n", _source.c_str());
+		if (errors) printf("%s\n", (const char*)errors->GetBufferPointer());
+		return 0;
+	}
+
+	std::shared_ptr<SimplePixelShader> shader = std::make_shared<SimplePixelShader>(_device, _context, blob);
+	if (!shader->IsShaderValid()) return 0;
+
+	// Variants share the per-frame buffer the same way their base shaders do
+	shader->SetBufferExternal(CBUFFER_PERFRAME);
+	return shader;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "PermutationCache.h"
+#include "SimpleShader.h"
+
+typedef PermutationCacheT<SimplePixelShader> PermutationCache;
+
+// --------------------------------------------------------
+// Compiles a pixel shader variant from its .hlsl source
+// (copied next to the executable under Shaders/)
+//
+// The project's FxCompile items build one .cso per file, and
+// the sources here have ~100 possible variants between them
+// of which the loaded materials use a handful, so variants
+// are compiled on first use rather than all ahead of time.
+// --------------------------------------------------------
+std::shared_ptr<SimplePixelShader> CompilePixelPermutation(
+	Microsoft::WRL::ComPtr<ID3D11Device>		_device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	_context,
+	const std::wstring&							_source,
+	const ShaderDefines&						_defines);
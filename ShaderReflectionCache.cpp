@@ -0,0 +1,126 @@
+#include "ShaderReflectionCache.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// Copies out the constant buffers, variables, bound
+// resources and input signature of a compiled shader
+// --------------------------------------------------------
+bool ReflectShaderBlob(Microsoft::WRL::ComPtr<ID3DBlob> blob, ShaderReflectionData& reflection)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
+	HRESULT hr = D3DReflect(
+		blob->GetBufferPointer(),
+		blob->GetBufferSize(),
+		IID_ID3D11ShaderReflection,
+		(void**)refl.GetAddressOf());
+	if (FAILED(hr))
+		return false;
+
+	reflection = ShaderReflectionData();
+	reflection.BlobHash = HashShaderBlob(blob->GetBufferPointer(), blob->GetBufferSize());
+
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
+
+	// Bound resources (structured buffers are treated as textures)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
+	{
+		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
+		refl->GetResourceBindingDesc(r, &resourceDesc);
+
+		ShaderReflectionResource resource;
+		resource.Name = resourceDesc.Name;
+		resource.BindIndex = resourceDesc.BindPoint;
+
+		switch (resourceDesc.Type)
+		{
+		case D3D_SIT_STRUCTURED:
+		case D3D_SIT_TEXTURE:
+			reflection.Textures.push_back(resource);
+			break;
+
+		case D3D_SIT_SAMPLER:
+			reflection.Samplers.push_back(resource);
+			break;
+		}
+	}
+
+	// Constant buffers and their variables
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+	{
+		ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+
+		D3D11_SHADER_BUFFER_DESC bufferDesc;
+		cb->GetDesc(&bufferDesc);
+
+		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ShaderReflectionBuffer buffer;
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = (unsigned int)bufferDesc.Type;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
+
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+
+			ShaderReflectionVariable variable;
+			variable.Name = varDesc.Name;
+			variable.ByteOffset = varDesc.StartOffset;
+			variable.Size = varDesc.Size;
+			buffer.Variables.push_back(variable);
+		}
+
+		reflection.ConstantBuffers.push_back(buffer);
+	}
+
+	// Input signature, for building vertex shader input layouts
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		ShaderReflectionInput input;
+		input.SemanticName = paramDesc.SemanticName;
+		input.SemanticIndex = paramDesc.SemanticIndex;
+		input.ComponentType = (unsigned int)paramDesc.ComponentType;
+		input.Mask = paramDesc.Mask;
+		reflection.Inputs.push_back(input);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Sidecar files are read and written as blobs, using the
+// same D3D helpers that load the .cso files themselves
+// --------------------------------------------------------
+bool ReadShaderReflectionSidecar(const std::wstring& path, uint64_t expectedHash, ShaderReflectionData& reflection)
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (D3DReadFileToBlob(path.c_str(), blob.GetAddressOf()) != S_OK)
+		return false;
+
+	return ParseShaderReflection(
+		(const unsigned char*)blob->GetBufferPointer(),
+		blob->GetBufferSize(),
+		expectedHash,
+		reflection);
+}
+
+bool WriteShaderReflectionSidecar(const std::wstring& path, const ShaderReflectionData& reflection)
+{
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(reflection, bytes);
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (FAILED(D3DCreateBlob(bytes.size(), blob.GetAddressOf())))
+		return false;
+
+	memcpy(blob->GetBufferPointer(), bytes.data(), bytes.size());
+	return D3DWriteBlobToFile(blob.Get(), path.c_str(), TRUE) == S_OK;
+}
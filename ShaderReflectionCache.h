@@ -0,0 +1,21 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <wrl/client.h>
+#include <string>
+#include "ShaderReflectionData.h"
+
+// --------------------------------------------------------
+// Runs D3DReflect over a compiled shader and copies out
+// the results
+// --------------------------------------------------------
+bool ReflectShaderBlob(Microsoft::WRL::ComPtr<ID3DBlob> blob, ShaderReflectionData& reflection);
+
+// --------------------------------------------------------
+// File helpers: reading fails if the sidecar is missing or
+// stale, and writing failures are ignored by callers since
+// the sidecar is only ever an optimization
+// --------------------------------------------------------
+bool ReadShaderReflectionSidecar(const std::wstring& path, uint64_t expectedHash, ShaderReflectionData& reflection);
+bool WriteShaderReflectionSidecar(const std::wstring& path, const ShaderReflectionData& reflection);
@@ -0,0 +1,208 @@
+#include "ShaderReflectionData.h"
+
+// --------------------------------------------------------
+// 64-bit FNV-1a
+// --------------------------------------------------------
+uint64_t HashShaderBlob(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Serialization helpers
+// --------------------------------------------------------
+static void WriteU32(std::vector<unsigned char>& bytes, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		bytes.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static void WriteU64(std::vector<unsigned char>& bytes, uint64_t value)
+{
+	WriteU32(bytes, (uint32_t)value);
+	WriteU32(bytes, (uint32_t)(value >> 32));
+}
+
+static void WriteString(std::vector<unsigned char>& bytes, const std::string& value)
+{
+	WriteU32(bytes, (uint32_t)value.size());
+	bytes.insert(bytes.end(), value.begin(), value.end());
+}
+
+void SerializeShaderReflection(const ShaderReflectionData& reflection, std::vector<unsigned char>& bytes)
+{
+	bytes.clear();
+	WriteU32(bytes, REFLECTION_SIDECAR_MAGIC);
+	WriteU32(bytes, REFLECTION_SIDECAR_VERSION);
+	WriteU64(bytes, reflection.BlobHash);
+
+	WriteU32(bytes, (uint32_t)reflection.ConstantBuffers.size());
+	for (auto& buffer : reflection.ConstantBuffers)
+	{
+		WriteString(bytes, buffer.Name);
+		WriteU32(bytes, buffer.Type);
+		WriteU32(bytes, buffer.Size);
+		WriteU32(bytes, buffer.BindIndex);
+		WriteU32(bytes, (uint32_t)buffer.Variables.size());
+		for (auto& variable : buffer.Variables)
+		{
+			WriteString(bytes, variable.Name);
+			WriteU32(bytes, variable.ByteOffset);
+			WriteU32(bytes, variable.Size);
+		}
+	}
+
+	WriteU32(bytes, (uint32_t)reflection.Textures.size());
+	for (auto& texture : reflection.Textures)
+	{
+		WriteString(bytes, texture.Name);
+		WriteU32(bytes, texture.BindIndex);
+	}
+
+	WriteU32(bytes, (uint32_t)reflection.Samplers.size());
+	for (auto& sampler : reflection.Samplers)
+	{
+		WriteString(bytes, sampler.Name);
+		WriteU32(bytes, sampler.BindIndex);
+	}
+
+	WriteU32(bytes, (uint32_t)reflection.Inputs.size());
+	for (auto& input : reflection.Inputs)
+	{
+		WriteString(bytes, input.SemanticName);
+		WriteU32(bytes, input.SemanticIndex);
+		WriteU32(bytes, input.ComponentType);
+		WriteU32(bytes, input.Mask);
+	}
+}
+
+// --------------------------------------------------------
+// Bounds-checked reading over a sidecar's bytes; once a
+// read fails every later read fails too, so the parser
+// only has to check at the end (and before allocating)
+// --------------------------------------------------------
+class SidecarReader
+{
+public:
+	SidecarReader(const unsigned char* bytes, size_t size) : bytes(bytes), size(size), position(0), failed(false) {}
+
+	uint32_t ReadU32()
+	{
+		if (failed || size - position < 4) { failed = true; return 0; }
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+			value |= (uint32_t)bytes[position + i] << (i * 8);
+		position += 4;
+		return value;
+	}
+
+	uint64_t ReadU64()
+	{
+		uint64_t low = ReadU32();
+		uint64_t high = ReadU32();
+		return low | (high << 32);
+	}
+
+	std::string ReadString()
+	{
+		uint32_t length = ReadU32();
+		if (failed || size - position < length) { failed = true; return std::string(); }
+		std::string value((const char*)bytes + position, length);
+		position += length;
+		return value;
+	}
+
+	// Reads an element count, rejecting any that couldn't fit in what's left
+	uint32_t ReadCount(size_t minimumElementSize)
+	{
+		uint32_t count = ReadU32();
+		if (failed || count > (size - position) / minimumElementSize) { failed = true; return 0; }
+		return count;
+	}
+
+	bool Failed() { return failed; }
+	bool AtEnd() { return position == size; }
+
+private:
+	const unsigned char* bytes;
+	size_t size;
+	size_t position;
+	bool failed;
+};
+
+bool ParseShaderReflection(const unsigned char* bytes, size_t size, uint64_t expectedHash, ShaderReflectionData& reflection)
+{
+	SidecarReader reader(bytes, size);
+	if (reader.ReadU32() != REFLECTION_SIDECAR_MAGIC) return false;
+	if (reader.ReadU32() != REFLECTION_SIDECAR_VERSION) return false;
+
+	ShaderReflectionData parsed;
+	parsed.BlobHash = reader.ReadU64();
+	if (reader.Failed() || parsed.BlobHash != expectedHash) return false;
+
+	uint32_t bufferCount = reader.ReadCount(20);
+	for (uint32_t b = 0; b < bufferCount && !reader.Failed(); b++)
+	{
+		ShaderReflectionBuffer buffer;
+		buffer.Name = reader.ReadString();
+		buffer.Type = reader.ReadU32();
+		buffer.Size = reader.ReadU32();
+		buffer.BindIndex = reader.ReadU32();
+
+		uint32_t variableCount = reader.ReadCount(12);
+		for (uint32_t v = 0; v < variableCount && !reader.Failed(); v++)
+		{
+			ShaderReflectionVariable variable;
+			variable.Name = reader.ReadString();
+			variable.ByteOffset = reader.ReadU32();
+			variable.Size = reader.ReadU32();
+
+			// A variable outside its buffer would have SetData write past the local copy
+			if ((uint64_t)variable.ByteOffset + variable.Size > buffer.Size) return false;
+			buffer.Variables.push_back(variable);
+		}
+		parsed.ConstantBuffers.push_back(buffer);
+	}
+
+	uint32_t textureCount = reader.ReadCount(8);
+	for (uint32_t t = 0; t < textureCount && !reader.Failed(); t++)
+	{
+		ShaderReflectionResource texture;
+		texture.Name = reader.ReadString();
+		texture.BindIndex = reader.ReadU32();
+		parsed.Textures.push_back(texture);
+	}
+
+	uint32_t samplerCount = reader.ReadCount(8);
+	for (uint32_t s = 0; s < samplerCount && !reader.Failed(); s++)
+	{
+		ShaderReflectionResource sampler;
+		sampler.Name = reader.ReadString();
+		sampler.BindIndex = reader.ReadU32();
+		parsed.Samplers.push_back(sampler);
+	}
+
+	uint32_t inputCount = reader.ReadCount(16);
+	for (uint32_t i = 0; i < inputCount && !reader.Failed(); i++)
+	{
+		ShaderReflectionInput input;
+		input.SemanticName = reader.ReadString();
+		input.SemanticIndex = reader.ReadU32();
+		input.ComponentType = reader.ReadU32();
+		input.Mask = reader.ReadU32();
+		parsed.Inputs.push_back(input);
+	}
+
+	if (reader.Failed() || !reader.AtEnd())
+		return false;
+
+	reflection = parsed;
+	return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sidecar files sit next to the compiled shader, e.g. VertexShader.cso.refl
+constexpr auto REFLECTION_SIDECAR_EXTENSION = L".refl";
+constexpr auto REFLECTION_SIDECAR_MAGIC = 0x4C465253u; // "SRFL"
+constexpr auto REFLECTION_SIDECAR_VERSION = 1u;
+
+// --------------------------------------------------------
+// Everything SimpleShader needs from shader reflection,
+// as plain data that can be written to and read from disk
+// --------------------------------------------------------
+struct ShaderReflectionVariable
+{
+	std::string Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+struct ShaderReflectionBuffer
+{
+	std::string Name;
+	unsigned int Type;
+	unsigned int Size;
+	unsigned int BindIndex;
+	std::vector<ShaderReflectionVariable> Variables;
+};
+
+struct ShaderReflectionResource
+{
+	std::string Name;
+	unsigned int BindIndex;
+};
+
+struct ShaderReflectionInput
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int ComponentType;
+	unsigned int Mask;
+};
+
+struct ShaderReflectionData
+{
+	uint64_t BlobHash = 0;
+	std::vector<ShaderReflectionBuffer> ConstantBuffers;
+	std::vector<ShaderReflectionResource> Textures;
+	std::vector<ShaderReflectionResource> Samplers;
+	std::vector<ShaderReflectionInput> Inputs; // Only used by vertex shaders
+};
+
+// --------------------------------------------------------
+// Hashes compiled shader code (64-bit FNV-1a), so a sidecar
+// written for an older build of a shader is never used
+// --------------------------------------------------------
+uint64_t HashShaderBlob(const void* data, size_t size);
+
+// --------------------------------------------------------
+// Sidecar format (little endian, no padding):
+//
+//   u32 magic, u32 version, u64 blob hash
+//   u32 count, then per constant buffer:
+//     str name, u32 type, u32 size, u32 bind index
+//     u32 count, then per variable: str name, u32 offset, u32 size
+//   u32 count, then per texture: str name, u32 bind index
+//   u32 count, then per sampler: str name, u32 bind index
+//   u32 count, then per input: str semantic, u32 index, u32 component type, u32 mask
+//
+// where str is a u32 length followed by that many chars
+// --------------------------------------------------------
+void SerializeShaderReflection(const ShaderReflectionData& reflection, std::vector<unsigned char>& bytes);
+
+// --------------------------------------------------------
+// Parses a sidecar, failing on anything malformed, from a
+// different version or made for a different blob
+// --------------------------------------------------------
+bool ParseShaderReflection(const unsigned char* bytes, size_t size, uint64_t expectedHash, ShaderReflectionData& reflection);
@@ -0,0 +1,533 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX;
+
+// Dirty bits with every face of a cube set
+constexpr auto SHADOW_ALL_FACES = (1u << SHADOW_CUBE_FACES) - 1;
+
+#pragma region Cube Faces
+// Right, up and forward of each face, as a left-handed view looking out from the light
+// - These should match getPointShadow in Shadows.hlsli
+static const float FACE_RIGHT[SHADOW_CUBE_FACES][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { 1, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 }, { -1, 0, 0 } };
+static const float FACE_UP[SHADOW_CUBE_FACES][3] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 } };
+static const float FACE_FORWARD[SHADOW_CUBE_FACES][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+static float Dot(const float* _axis, XMFLOAT3 _vector)
+{
+	return _axis[0] * _vector.x + _axis[1] * _vector.y + _axis[2] * _vector.z;
+}
+#pragma endregion
+
+#pragma region Allocator
+ShadowAtlasAllocator::ShadowAtlasAllocator(unsigned int _resolution, unsigned int _minimumTile)
+{
+	resolution = _resolution;
+	levels = 1;
+	while ((_resolution >> levels) >= _minimumTile) levels++;
+
+	// Each level has four times the nodes of the one above it
+	unsigned int nodes = 0;
+	unsigned int levelNodes = 1;
+	for (unsigned int l = 0; l < levels; l++)
+	{
+		levelStarts.push_back(nodes);
+		nodes += levelNodes;
+		levelNodes *= 4;
+	}
+	states.resize(nodes);
+	Clear();
+}
+
+ShadowAtlasAllocator::~ShadowAtlasAllocator()
+{
+}
+
+bool ShadowAtlasAllocator::Allocate(unsigned int _size, ShadowAtlasTile& _tile)
+{
+	if (_size == 0 || (_size & (_size - 1)) != 0 || _size > resolution) return false;
+	unsigned int target = 0;
+	while ((resolution >> target) > _size) target++;
+	if (target >= levels) return false;
+
+	unsigned int best = 0;
+	unsigned int bestLevel = UINT_MAX;
+	FindFree(0, 0, target, best, bestLevel);
+	if (bestLevel == UINT_MAX) return false;
+
+	// Split the free node down to the size asked for, always carrying on in the first quarter
+	unsigned int node = best;
+	for (unsigned int level = bestLevel; level < target; level++)
+	{
+		states[node] = NODE_SPLIT;
+		for (unsigned int c = 1; c <= 4; c++)
+		{
+			states[node * 4 + c] = NODE_FREE;
+		}
+		node = node * 4 + 1;
+	}
+
+	states[node] = NODE_USED;
+	usedTexels += (unsigned long long)_size * _size;
+	_tile = GetTile(node);
+	return true;
+}
+
+void ShadowAtlasAllocator::Free(const ShadowAtlasTile& _tile)
+{
+	if (_tile.node >= states.size() || states[_tile.node] != NODE_USED) return;
+	states[_tile.node] = NODE_FREE;
+	usedTexels -= (unsigned long long)_tile.size * _tile.size;
+
+	// Merge back up while every quarter of the parent is free
+	unsigned int node = _tile.node;
+	while (node != 0)
+	{
+		unsigned int parent = (node - 1) / 4;
+		for (unsigned int c = 1; c <= 4; c++)
+		{
+			if (states[parent * 4 + c] != NODE_FREE) return;
+		}
+		states[parent] = NODE_FREE;
+		node = parent;
+	}
+}
+
+void ShadowAtlasAllocator::Clear()
+{
+	std::fill(states.begin(), states.end(), NODE_FREE);
+	usedTexels = 0;
+}
+
+unsigned long long ShadowAtlasAllocator::GetUsedTexels()
+{
+	return usedTexels;
+}
+
+unsigned int ShadowAtlasAllocator::GetResolution()
+{
+	return resolution;
+}
+
+unsigned int ShadowAtlasAllocator::GetLevel(unsigned int _node)
+{
+	unsigned int level = 0;
+	while (level + 1 < levels && levelStarts[level + 1] <= _node) level++;
+	return level;
+}
+
+ShadowAtlasTile ShadowAtlasAllocator::GetTile(unsigned int _node)
+{
+	// A node's place in its level spells out the quarters taken from the root, two bits each
+	unsigned int level = GetLevel(_node);
+	unsigned int index = _node - levelStarts[level];
+
+	ShadowAtlasTile tile = {};
+	tile.node = _node;
+	tile.size = resolution >> level;
+	for (unsigned int depth = 0; depth < level; depth++)
+	{
+		unsigned int quarter = (index >> ((level - 1 - depth) * 2)) & 3;
+		unsigned int half = resolution >> (depth + 1);
+		tile.x += (quarter & 1) * half;
+		tile.y += (quarter >> 1) * half;
+	}
+	return tile;
+}
+
+void ShadowAtlasAllocator::FindFree(unsigned int _node, unsigned int _level, unsigned int _target, unsigned int& _best, unsigned int& _bestLevel)
+{
+	switch (states[_node])
+	{
+	case NODE_USED:
+		return;
+
+	case NODE_FREE:
+		// Smallest free node that still fits; ties go to the first one found
+		if (_bestLevel == UINT_MAX || _level > _bestLevel)
+		{
+			_best = _node;
+			_bestLevel = _level;
+		}
+		return;
+
+	case NODE_SPLIT:
+		if (_level >= _target) return;
+		for (unsigned int c = 1; c <= 4; c++)
+		{
+			FindFree(_node * 4 + c, _level + 1, _target, _best, _bestLevel);
+		}
+		return;
+	}
+}
+#pragma endregion
+
+ShadowAtlas::ShadowAtlas()
+	: allocator(SHADOW_ATLAS_RESOLUTION, SHADOW_ATLAS_MIN_TILE)
+{
+	for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		slots[s] = {};
+		slots[s].lightIndex = -1;
+	}
+	stats = {};
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+}
+
+void ShadowAtlas::Update(const XMFLOAT4X4& _view, const XMFLOAT4X4& _projection, float _screenHeight,
+	const std::vector<Light>& _lights, const std::vector<ShadowAtlasCaster>& _casters)
+{
+	stats = {};
+	float tanHalfFovX = 1.0f / _projection._11;
+	float tanHalfFovY = 1.0f / _projection._22;
+
+	// Rank the point lights on screen, most important first (ties keep light order, so results don't flicker)
+	struct Candidate
+	{
+		unsigned int light;
+		float coverage;
+		float importance;
+		unsigned int requestedSize;
+		unsigned int budgetSize;
+	};
+	std::vector<Candidate> candidates;
+	for (unsigned int i = 0; i < _lights.size(); i++)
+	{
+		const Light& light = _lights[i];
+		if (light.Type != LIGHT_TYPE_POINT || light.Range <= 0) continue;
+
+		float coverage = GetScreenCoverage(_view, tanHalfFovX, tanHalfFovY, light.Position, light.Range);
+		if (coverage <= 0) continue;
+		candidates.push_back({ i, coverage, coverage * light.Intensity, 0, 0 });
+	}
+	stats.candidates = (unsigned int)candidates.size();
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& _a, const Candidate& _b)
+		{
+			if (_a.importance != _b.importance) return _a.importance > _b.importance;
+			return _a.light < _b.light;
+		});
+	if (candidates.size() > MAX_SHADOWED_POINT_LIGHTS)
+		candidates.resize(MAX_SHADOWED_POINT_LIGHTS);
+
+	auto findSlot = [&](int _light)
+		{
+			for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+			{
+				if (slots[s].lightIndex == _light) return s;
+			}
+			return -1;
+		};
+
+	// Each light asks for tiles sized to its screen coverage (held near size boundaries by what it asked for last frame)
+	unsigned long long budgetTexels = 0;
+	for (auto& candidate : candidates)
+	{
+		int slot = findSlot((int)candidate.light);
+		candidate.requestedSize = GetTileSize(candidate.coverage, _screenHeight, slot >= 0 ? slots[slot].requestedSize : 0);
+		candidate.budgetSize = candidate.requestedSize;
+		budgetTexels += (unsigned long long)SHADOW_CUBE_FACES * candidate.budgetSize * candidate.budgetSize;
+	}
+
+	// Halve the largest requests (the lowest ranked first) until everything fits, so space is shared out by rank
+	// rather than the first few lights taking it all
+	const unsigned long long atlasTexels = (unsigned long long)SHADOW_ATLAS_RESOLUTION * SHADOW_ATLAS_RESOLUTION;
+	while (budgetTexels > atlasTexels)
+	{
+		int largest = -1;
+		for (int r = 0; r < (int)candidates.size(); r++)
+		{
+			unsigned int size = candidates[r].budgetSize;
+			if (size > SHADOW_ATLAS_MIN_TILE && (largest < 0 || size >= candidates[largest].budgetSize)) largest = r;
+		}
+		if (largest < 0) break;
+
+		unsigned int size = candidates[largest].budgetSize;
+		budgetTexels -= (unsigned long long)SHADOW_CUBE_FACES * (size * size - (size / 2) * (size / 2));
+		candidates[largest].budgetSize = size / 2;
+	}
+
+	// Lights that dropped out of the top few give their tiles back
+	auto getRank = [&](int _light)
+		{
+			for (unsigned int r = 0; r < candidates.size(); r++)
+			{
+				if ((int)candidates[r].light == _light) return (int)r;
+			}
+			return -1;
+		};
+	for (auto& slot : slots)
+	{
+		slot.dirtyFaces = 0;
+		if (slot.lightIndex >= 0 && getRank(slot.lightIndex) < 0) FreeSlot(slot);
+	}
+
+	// A different set of casters (e.g. a new scene) can't be compared, so everything counts as moved
+	bool castersReplaced = previousCasters.size() != _casters.size();
+	std::vector<unsigned int> moved;
+	for (unsigned int i = 0; i < _casters.size(); i++)
+	{
+		if (castersReplaced || memcmp(&_casters[i].world, &previousCasters[i].world, sizeof(XMFLOAT4X4)) != 0)
+			moved.push_back(i);
+	}
+	stats.movedCasters = (unsigned int)moved.size();
+
+	// Place lights in rank order, so the most important ones get first claim on the atlas
+	bool placed[MAX_SHADOWED_POINT_LIGHTS] = {};
+	for (auto& candidate : candidates)
+	{
+		const Light& light = _lights[candidate.light];
+
+		// Tiles that no longer suit the light's share of the atlas are given back and asked for again
+		int slotIndex = findSlot((int)candidate.light);
+		if (slotIndex >= 0 && slots[slotIndex].budgetSize != candidate.budgetSize)
+		{
+			FreeSlot(slots[slotIndex]);
+		}
+
+		if (slotIndex < 0 || slots[slotIndex].lightIndex < 0)
+		{
+			// There's always an empty slot, since only the lights ranked so far (or below) hold any
+			for (int s = 0; slotIndex < 0 && s < MAX_SHADOWED_POINT_LIGHTS; s++)
+			{
+				if (slots[s].lightIndex < 0) slotIndex = s;
+			}
+			ShadowAtlasSlot& slot = slots[slotIndex];
+			slot.lightIndex = (int)candidate.light;
+			slot.budgetSize = candidate.budgetSize;
+
+			// Push out lower ranked lights (the least important first) until this one fits at its share,
+			// and only settle for smaller tiles once there's nothing left to push out
+			while (!AllocateSlot(slot, slot.budgetSize))
+			{
+				int evict = -1;
+				int evictRank = -1;
+				for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+				{
+					if (s == slotIndex || placed[s] || slots[s].lightIndex < 0) continue;
+					int rank = getRank(slots[s].lightIndex);
+					if (rank > evictRank)
+					{
+						evict = s;
+						evictRank = rank;
+					}
+				}
+				if (evict < 0)
+				{
+					AllocateSlot(slot, SHADOW_ATLAS_MIN_TILE);
+					break;
+				}
+
+				FreeSlot(slots[evict]);
+				stats.evictions++;
+			}
+			if (slot.size == 0)
+			{
+				FreeSlot(slot);
+				continue;
+			}
+
+			slot.dirtyFaces = SHADOW_ALL_FACES;
+			stats.allocations++;
+		}
+
+		ShadowAtlasSlot& slot = slots[slotIndex];
+		slot.importance = candidate.importance;
+		slot.requestedSize = candidate.requestedSize;
+		placed[slotIndex] = true;
+		if (slot.size < slot.requestedSize) stats.downsized++;
+
+		// A light that moved or changed range has to redraw every face
+		if (slot.dirtyFaces == SHADOW_ALL_FACES || slot.range != light.Range ||
+			slot.position.x != light.Position.x || slot.position.y != light.Position.y || slot.position.z != light.Position.z)
+		{
+			slot.position = light.Position;
+			slot.range = light.Range;
+			for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+			{
+				slot.faceViewProjection[f] = BuildFaceViewProjection(slot.position, slot.range, f);
+			}
+			slot.dirtyFaces = SHADOW_ALL_FACES;
+			continue;
+		}
+
+		// Otherwise only faces a moving caster was or is in
+		for (unsigned int index : moved)
+		{
+			for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+			{
+				if (slot.dirtyFaces & (1u << f)) continue;
+				if ((!castersReplaced && FaceTouchesSphere(slot.position, slot.range, f, previousCasters[index].bounds)) ||
+					FaceTouchesSphere(slot.position, slot.range, f, _casters[index].bounds))
+				{
+					slot.dirtyFaces |= 1u << f;
+				}
+			}
+		}
+		if (castersReplaced) slot.dirtyFaces = SHADOW_ALL_FACES;
+	}
+
+	// Pick out the casters for every face that has to be redrawn
+	for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		ShadowAtlasSlot& slot = slots[s];
+		for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			casters[s][f].clear();
+		}
+		if (slot.lightIndex < 0) continue;
+		stats.shadowedLights++;
+
+		for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			if (!(slot.dirtyFaces & (1u << f)))
+			{
+				stats.facesCached++;
+				continue;
+			}
+
+			for (unsigned int i = 0; i < _casters.size(); i++)
+			{
+				if (FaceTouchesSphere(slot.position, slot.range, f, _casters[i].bounds)) casters[s][f].push_back(i);
+			}
+			stats.facesRendered++;
+			stats.casterDraws += (unsigned int)casters[s][f].size();
+		}
+	}
+	stats.usedTexels = allocator.GetUsedTexels();
+
+	previousCasters = _casters;
+}
+
+const ShadowAtlasSlot& ShadowAtlas::GetSlot(unsigned int _slot)
+{
+	return slots[_slot];
+}
+
+const std::vector<unsigned int>& ShadowAtlas::GetCasters(unsigned int _slot, unsigned int _face)
+{
+	return casters[_slot][_face];
+}
+
+ShadowAtlasStats ShadowAtlas::GetStats()
+{
+	return stats;
+}
+
+float ShadowAtlas::GetScreenCoverage(const XMFLOAT4X4& _view, float _tanHalfFovX, float _tanHalfFovY, XMFLOAT3 _position, float _range)
+{
+	// Into view space (row vector convention, as with DirectXMath)
+	XMFLOAT3 center = XMFLOAT3(
+		_position.x * _view._11 + _position.y * _view._21 + _position.z * _view._31 + _view._41,
+		_position.x * _view._12 + _position.y * _view._22 + _position.z * _view._32 + _view._42,
+		_position.x * _view._13 + _position.y * _view._23 + _position.z * _view._33 + _view._43);
+
+	float distanceSquared = center.x * center.x + center.y * center.y + center.z * center.z;
+	if (distanceSquared <= _range * _range) return 1.0f;
+
+	// Off screen if the range is entirely behind the camera or past a side of the frustum
+	if (center.z < -_range) return 0.0f;
+	if (fabsf(center.x) - center.z * _tanHalfFovX > _range * sqrtf(1 + _tanHalfFovX * _tanHalfFovX)) return 0.0f;
+	if (fabsf(center.y) - center.z * _tanHalfFovY > _range * sqrtf(1 + _tanHalfFovY * _tanHalfFovY)) return 0.0f;
+
+	// Tangent of the angle the range covers, against the frustum's
+	float coverage = _range / sqrtf(distanceSquared - _range * _range) / _tanHalfFovY;
+	return (std::min)(coverage, 1.0f);
+}
+
+unsigned int ShadowAtlas::GetTileSize(float _coverage, float _screenHeight, unsigned int _currentSize)
+{
+	// A cube face sees a quarter turn, about half the range's width from outside
+	float desired = _coverage * _screenHeight * 0.5f;
+	unsigned int size = SHADOW_ATLAS_MAX_TILE;
+	while (size > SHADOW_ATLAS_MIN_TILE && size > desired) size /= 2;
+	if (_currentSize == 0) return size;
+
+	if (size > _currentSize && desired < _currentSize * 2 * SHADOW_ATLAS_HYSTERESIS) return _currentSize;
+	if (size < _currentSize && desired >= _currentSize / SHADOW_ATLAS_HYSTERESIS) return _currentSize;
+	return size;
+}
+
+bool ShadowAtlas::FaceTouchesSphere(XMFLOAT3 _position, float _range, unsigned int _face, const BoundingSphere& _sphere)
+{
+	XMFLOAT3 offset = XMFLOAT3(_sphere.Center.x - _position.x, _sphere.Center.y - _position.y, _sphere.Center.z - _position.z);
+	float reach = _range + _sphere.Radius;
+	if (offset.x * offset.x + offset.y * offset.y + offset.z * offset.z > reach * reach) return false;
+
+	// The face's pyramid is bounded by four planes at 45 degrees to its forward axis
+	float right = Dot(FACE_RIGHT[_face], offset);
+	float up = Dot(FACE_UP[_face], offset);
+	float forward = Dot(FACE_FORWARD[_face], offset);
+	float slack = _sphere.Radius * 1.41421356f;
+	return forward - fabsf(right) >= -slack && forward - fabsf(up) >= -slack;
+}
+
+XMFLOAT4X4 ShadowAtlas::BuildFaceViewProjection(XMFLOAT3 _position, float _range, unsigned int _face)
+{
+	// Same as a LookTo view times XMMatrixPerspectiveFovLH with a 90 degree field of view and square aspect
+	float farClip = (std::max)(_range, SHADOW_POINT_NEAR * 2);
+	float depthScale = farClip / (farClip - SHADOW_POINT_NEAR);
+	float depthBias = -SHADOW_POINT_NEAR * depthScale;
+
+	const float* right = FACE_RIGHT[_face];
+	const float* up = FACE_UP[_face];
+	const float* forward = FACE_FORWARD[_face];
+
+	XMFLOAT4X4 result = {};
+	for (int row = 0; row < 3; row++)
+	{
+		result.m[row][0] = right[row];
+		result.m[row][1] = up[row];
+		result.m[row][2] = forward[row] * depthScale;
+		result.m[row][3] = forward[row];
+	}
+	float forwardOffset = -Dot(forward, _position);
+	result.m[3][0] = -Dot(right, _position);
+	result.m[3][1] = -Dot(up, _position);
+	result.m[3][2] = forwardOffset * depthScale + depthBias;
+	result.m[3][3] = forwardOffset;
+	return result;
+}
+
+#pragma region Slots
+bool ShadowAtlas::AllocateSlot(ShadowAtlasSlot& _slot, unsigned int _smallest)
+{
+	// Step down a size at a time until all six faces fit
+	for (unsigned int size = _slot.budgetSize; size >= _smallest; size /= 2)
+	{
+		unsigned int allocated = 0;
+		while (allocated < SHADOW_CUBE_FACES && allocator.Allocate(size, _slot.tiles[allocated])) allocated++;
+		if (allocated == SHADOW_CUBE_FACES)
+		{
+			_slot.size = size;
+			return true;
+		}
+
+		for (unsigned int f = 0; f < allocated; f++)
+		{
+			allocator.Free(_slot.tiles[f]);
+		}
+	}
+	_slot.size = 0;
+	return false;
+}
+
+void ShadowAtlas::FreeSlot(ShadowAtlasSlot& _slot)
+{
+	if (_slot.size > 0)
+	{
+		for (unsigned int f = 0; f < SHADOW_CUBE_FACES; f++)
+		{
+			allocator.Free(_slot.tiles[f]);
+		}
+	}
+	_slot = {};
+	_slot.lightIndex = -1;
+}
+#pragma endregion
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+#include "Lights.h"
+
+// Width and height of the point light shadow atlas, in texels
+constexpr auto SHADOW_ATLAS_RESOLUTION = 4096;
+
+// Smallest and largest tiles a cube face can get (both powers of two)
+constexpr auto SHADOW_ATLAS_MIN_TILE = 64;
+constexpr auto SHADOW_ATLAS_MAX_TILE = 1024;
+
+// The most point lights with shadows at once
+// - Each one takes a PointShadow in the buffer Shadows.hlsli reads
+constexpr auto MAX_SHADOWED_POINT_LIGHTS = 16;
+
+// Faces of a point light's cube, in the order +X, -X, +Y, -Y, +Z, -Z
+constexpr auto SHADOW_CUBE_FACES = 6;
+
+// Near plane of every cube face (the far plane is the light's range)
+constexpr auto SHADOW_POINT_NEAR = 0.05f;
+
+// How far past a tile size boundary a light's screen size has to go before its tiles are resized,
+// so a light hovering on a boundary doesn't get re-rendered every frame
+constexpr auto SHADOW_ATLAS_HYSTERESIS = 1.25f;
+
+struct ShadowAtlasTile
+{
+	unsigned int							node;				// Quadtree node (see ShadowAtlasAllocator)
+	unsigned int							x;					// Top left corner and size, in atlas texels
+	unsigned int							y;
+	unsigned int							size;
+};
+
+// --------------------------------------------------------
+// Quadtree allocator for square, power of two tiles
+//
+// The root is the whole atlas and every node splits into
+// four quarters, down to SHADOW_ATLAS_MIN_TILE. A request
+// takes the smallest free node that fits (so larger free
+// space stays whole) and splits it down to size; freeing a
+// tile merges its parent back whenever all four quarters
+// are free again.
+// --------------------------------------------------------
+class ShadowAtlasAllocator
+{
+public:
+	ShadowAtlasAllocator(unsigned int _resolution, unsigned int _minimumTile);
+	~ShadowAtlasAllocator();
+
+											/// <summary>
+											/// Claims a tile
+											/// </summary>
+											/// <param name="_size">Width and height in texels (a power of two between the minimum tile and the atlas)</param>
+											/// <param name="_tile">Receives the tile</param>
+											/// <returns>Whether there was room</returns>
+	bool									Allocate(unsigned int _size, ShadowAtlasTile& _tile);
+	void									Free(const ShadowAtlasTile& _tile);
+	void									Clear();
+
+											/// <summary>
+											/// Gets the texels currently handed out
+											/// </summary>
+	unsigned long long						GetUsedTexels();
+	unsigned int							GetResolution();
+
+private:
+	enum NodeState : unsigned char
+	{
+		NODE_FREE,
+		NODE_SPLIT,
+		NODE_USED,
+	};
+
+	unsigned int							resolution;
+	unsigned int							levels;				// Level 0 is the root, levels - 1 holds the smallest tiles
+	std::vector<NodeState>					states;				// Heap order: node n's quarters are 4n + 1 to 4n + 4
+	std::vector<unsigned int>				levelStarts;
+	unsigned long long						usedTexels;
+
+	unsigned int							GetLevel(unsigned int _node);
+	ShadowAtlasTile							GetTile(unsigned int _node);
+	void									FindFree(unsigned int _node, unsigned int _level, unsigned int _target, unsigned int& _best, unsigned int& _bestLevel);
+};
+
+// Where one shadow-casting entity is, as the atlas last saw it
+struct ShadowAtlasCaster
+{
+	DirectX::BoundingSphere					bounds;
+	DirectX::XMFLOAT4X4						world;				// Compared between frames to catch moves the bounds miss (like spinning in place)
+};
+
+// A point light holding tiles in the atlas
+struct ShadowAtlasSlot
+{
+	int										lightIndex;			// Into the lights given to Update, or -1 for an empty slot
+	float									importance;
+	unsigned int							requestedSize;		// Tile size the light's screen size calls for
+	unsigned int							budgetSize;			// Its share once every shadowed light's request fits in the atlas
+	unsigned int							size;				// Tile size it got (smaller if the free space was too broken up)
+	ShadowAtlasTile							tiles[SHADOW_CUBE_FACES];
+	DirectX::XMFLOAT4X4						faceViewProjection[SHADOW_CUBE_FACES];
+	DirectX::XMFLOAT3						position;			// The light's position and range when its faces were last drawn
+	float									range;
+	unsigned int							dirtyFaces;			// Bit per face that has to be redrawn this frame
+};
+
+struct ShadowAtlasStats
+{
+	unsigned int							candidates;			// Point lights on screen
+	unsigned int							shadowedLights;		// Of those, lights holding tiles
+	unsigned int							allocations;		// Lights given new tiles this frame
+	unsigned int							downsized;			// Lights with smaller tiles than their screen size calls for
+	unsigned int							evictions;			// Lights pushed out of the atlas by more important ones
+	unsigned int							movedCasters;
+	unsigned int							facesRendered;		// Tiles redrawn this frame
+	unsigned int							facesCached;		// Tiles reused from earlier frames
+	unsigned int							casterDraws;		// Caster draws over every redrawn tile
+	unsigned long long						usedTexels;
+};
+
+// --------------------------------------------------------
+// Plans shadows for point lights in a shared depth atlas,
+// with each light's cube faces as six tiles
+//
+// Lights are ranked by how much of the screen their range
+// covers (times their intensity) and the top few get tiles
+// sized to that coverage; when those don't all fit, the
+// largest requests are halved, the lowest ranked first.
+// Faces are cached between frames:
+// one is only redrawn when its tiles are new, its light
+// moved, or a caster that was or is inside the face's part
+// of the light's range has moved. A light with nothing
+// moving around it is drawn once and then left alone.
+//
+// Everything here is deterministic and knows nothing about
+// D3D; PointShadowMaps renders the dirty faces.
+// --------------------------------------------------------
+class ShadowAtlas
+{
+public:
+	ShadowAtlas();
+	~ShadowAtlas();
+
+											/// <summary>
+											/// Ranks the point lights, (re)allocates their tiles and finds the faces that have to be redrawn
+											/// </summary>
+											/// <param name="_view">The camera's view matrix</param>
+											/// <param name="_projection">The camera's (symmetric, perspective) projection matrix</param>
+											/// <param name="_screenHeight">The height of the screen in pixels</param>
+											/// <param name="_lights">The scene's lights (only point lights are considered)</param>
+											/// <param name="_casters">Everything that casts shadows</param>
+	void									Update(const DirectX::XMFLOAT4X4& _view, const DirectX::XMFLOAT4X4& _projection, float _screenHeight,
+												const std::vector<Light>& _lights, const std::vector<ShadowAtlasCaster>& _casters);
+
+	const ShadowAtlasSlot&					GetSlot(unsigned int _slot);
+											/// <summary>
+											/// Gets the indices (into the casters given to Update) of the casters to draw into a dirty face, in order
+											/// </summary>
+	const std::vector<unsigned int>&		GetCasters(unsigned int _slot, unsigned int _face);
+	ShadowAtlasStats						GetStats();
+
+											/// <summary>
+											/// Gets how much of the screen's height a point light's range covers, from 0 (off screen) to 1
+											/// </summary>
+	static float							GetScreenCoverage(const DirectX::XMFLOAT4X4& _view, float _tanHalfFovX, float _tanHalfFovY, DirectX::XMFLOAT3 _position, float _range);
+											/// <summary>
+											/// Picks the power of two tile size for a light's coverage, keeping its current size near boundaries
+											/// </summary>
+											/// <param name="_coverage">From GetScreenCoverage</param>
+											/// <param name="_screenHeight">The height of the screen in pixels</param>
+											/// <param name="_currentSize">The size the light asked for last frame, or 0</param>
+	static unsigned int						GetTileSize(float _coverage, float _screenHeight, unsigned int _currentSize);
+											/// <summary>
+											/// Checks whether a sphere reaches into one cube face's part of a light's range
+											/// </summary>
+	static bool								FaceTouchesSphere(DirectX::XMFLOAT3 _position, float _range, unsigned int _face, const DirectX::BoundingSphere& _sphere);
+											/// <summary>
+											/// Builds the 90 degree view and projection of one cube face
+											/// </summary>
+	static DirectX::XMFLOAT4X4				BuildFaceViewProjection(DirectX::XMFLOAT3 _position, float _range, unsigned int _face);
+
+private:
+	ShadowAtlasAllocator					allocator;
+	ShadowAtlasSlot							slots[MAX_SHADOWED_POINT_LIGHTS];
+	std::vector<unsigned int>				casters[MAX_SHADOWED_POINT_LIGHTS][SHADOW_CUBE_FACES];
+	std::vector<ShadowAtlasCaster>			previousCasters;
+	ShadowAtlasStats						stats;
+
+	bool									AllocateSlot(ShadowAtlasSlot& _slot, unsigned int _smallest);
+	void									FreeSlot(ShadowAtlasSlot& _slot);
+};
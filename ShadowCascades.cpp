@@ -0,0 +1,220 @@
+#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Cascade radii are rounded up to this fraction of a unit, so float noise can't resize them between frames
+constexpr auto SHADOW_RADIUS_STEP = 16.0f;
+
+#pragma region Matrix Helpers
+// Row vector convention, as with DirectXMath: p' = p * M
+static XMFLOAT3 TransformPoint(const XMFLOAT4X4& _matrix, XMFLOAT3 _point)
+{
+	return XMFLOAT3(
+		_point.x * _matrix.m[0][0] + _point.y * _matrix.m[1][0] + _point.z * _matrix.m[2][0] + _matrix.m[3][0],
+		_point.x * _matrix.m[0][1] + _point.y * _matrix.m[1][1] + _point.z * _matrix.m[2][1] + _matrix.m[3][1],
+		_point.x * _matrix.m[0][2] + _point.y * _matrix.m[1][2] + _point.z * _matrix.m[2][2] + _matrix.m[3][2]);
+}
+
+static XMFLOAT4X4 Multiply(const XMFLOAT4X4& _a, const XMFLOAT4X4& _b)
+{
+	XMFLOAT4X4 result;
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			result.m[row][column] =
+				_a.m[row][0] * _b.m[0][column] + _a.m[row][1] * _b.m[1][column] +
+				_a.m[row][2] * _b.m[2][column] + _a.m[row][3] * _b.m[3][column];
+		}
+	}
+	return result;
+}
+
+static XMFLOAT3 Normalize(XMFLOAT3 _vector)
+{
+	float length = sqrtf(_vector.x * _vector.x + _vector.y * _vector.y + _vector.z * _vector.z);
+	return length > 0 ? XMFLOAT3(_vector.x / length, _vector.y / length, _vector.z / length) : _vector;
+}
+
+static XMFLOAT3 Cross(XMFLOAT3 _a, XMFLOAT3 _b)
+{
+	return XMFLOAT3(_a.y * _b.z - _a.z * _b.y, _a.z * _b.x - _a.x * _b.z, _a.x * _b.y - _a.y * _b.x);
+}
+
+// Same layout as XMMatrixOrthographicOffCenterLH
+static void BuildProjection(ShadowCascade& _cascade)
+{
+	float left = _cascade.lightCenter.x - _cascade.radius;
+	float right = _cascade.lightCenter.x + _cascade.radius;
+	float bottom = _cascade.lightCenter.y - _cascade.radius;
+	float top = _cascade.lightCenter.y + _cascade.radius;
+
+	XMFLOAT4X4& projection = _cascade.projection;
+	projection = {};
+	projection._11 = 2.0f / (right - left);
+	projection._22 = 2.0f / (top - bottom);
+	projection._33 = 1.0f / (_cascade.depthMax - _cascade.depthMin);
+	projection._41 = (left + right) / (left - right);
+	projection._42 = (top + bottom) / (bottom - top);
+	projection._43 = _cascade.depthMin / (_cascade.depthMin - _cascade.depthMax);
+	projection._44 = 1.0f;
+
+	_cascade.viewProjection = Multiply(_cascade.view, _cascade.projection);
+}
+#pragma endregion
+
+ShadowCascades::ShadowCascades()
+{
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		cascades[c] = {};
+	}
+	stats = {};
+}
+
+ShadowCascades::~ShadowCascades()
+{
+}
+
+void ShadowCascades::Update(const XMFLOAT4X4& _view, const XMFLOAT4X4& _projection, float _nearClip, float _farClip,
+	XMFLOAT3 _lightDirection, const std::vector<BoundingSphere>& _casters)
+{
+	// The view's rotation rows hold the camera's axes, and its translation is the position brought through them
+	XMFLOAT3 forward = XMFLOAT3(_view._13, _view._23, _view._33);
+	XMFLOAT3 position = XMFLOAT3(
+		-(_view._41 * _view._11 + _view._42 * _view._12 + _view._43 * _view._13),
+		-(_view._41 * _view._21 + _view._42 * _view._22 + _view._43 * _view._23),
+		-(_view._41 * _view._31 + _view._42 * _view._32 + _view._43 * _view._33));
+	float tanHalfFovX = 1.0f / _projection._11;
+	float tanHalfFovY = 1.0f / _projection._22;
+
+	float splits[SHADOW_CASCADE_COUNT + 1];
+	ComputeSplits(_nearClip, (std::min)(_farClip, SHADOW_DISTANCE), SHADOW_SPLIT_LAMBDA, SHADOW_CASCADE_COUNT, splits);
+	XMFLOAT4X4 lightView = BuildLightView(_lightDirection);
+
+	stats = {};
+	stats.casters = (unsigned int)_casters.size();
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		cascades[c] = FitCascade(position, forward, tanHalfFovX, tanHalfFovY, splits[c], splits[c + 1], lightView, SHADOW_MAP_RESOLUTION);
+		stats.casterTests += CullCasters(cascades[c], _casters, casters[c]);
+		stats.cascadeCasters[c] = (unsigned int)casters[c].size();
+		stats.drawnCasters += stats.cascadeCasters[c];
+	}
+}
+
+const ShadowCascade& ShadowCascades::GetCascade(unsigned int _cascade)
+{
+	return cascades[_cascade];
+}
+
+const std::vector<unsigned int>& ShadowCascades::GetCasters(unsigned int _cascade)
+{
+	return casters[_cascade];
+}
+
+ShadowStats ShadowCascades::GetStats()
+{
+	return stats;
+}
+
+void ShadowCascades::ComputeSplits(float _near, float _far, float _lambda, unsigned int _count, float* _splits)
+{
+	for (unsigned int i = 0; i <= _count; i++)
+	{
+		float fraction = (float)i / _count;
+		float logarithmic = _near * powf(_far / _near, fraction);
+		float uniform = _near + (_far - _near) * fraction;
+		_splits[i] = _lambda * logarithmic + (1 - _lambda) * uniform;
+	}
+
+	// Pin the ends so rounding can't leave a gap before the first cascade or after the last
+	_splits[0] = _near;
+	_splits[_count] = _far;
+}
+
+XMFLOAT4X4 ShadowCascades::BuildLightView(XMFLOAT3 _lightDirection)
+{
+	// Look along the light (away from it), with world up unless the light is nearly straight up or down
+	XMFLOAT3 forward = Normalize(XMFLOAT3(-_lightDirection.x, -_lightDirection.y, -_lightDirection.z));
+	XMFLOAT3 up = fabsf(forward.y) > 0.99f ? XMFLOAT3(0, 0, 1) : XMFLOAT3(0, 1, 0);
+	XMFLOAT3 right = Normalize(Cross(up, forward));
+	up = Cross(forward, right);
+
+	XMFLOAT4X4 view = {};
+	view._11 = right.x;
+	view._21 = right.y;
+	view._31 = right.z;
+	view._12 = up.x;
+	view._22 = up.y;
+	view._32 = up.z;
+	view._13 = forward.x;
+	view._23 = forward.y;
+	view._33 = forward.z;
+	view._44 = 1.0f;
+	return view;
+}
+
+ShadowCascade ShadowCascades::FitCascade(XMFLOAT3 _cameraPosition, XMFLOAT3 _cameraForward, float _tanHalfFovX, float _tanHalfFovY,
+	float _splitNear, float _splitFar, const XMFLOAT4X4& _lightView, unsigned int _resolution)
+{
+	ShadowCascade cascade = {};
+	cascade.splitNear = _splitNear;
+	cascade.splitFar = _splitFar;
+	cascade.view = _lightView;
+
+	// The slice's corners sit at depth * k from the view axis; the smallest sphere through the near and
+	// far corners is centered on the axis, unless that lands past the far plane (a wide, shallow slice)
+	float k2 = _tanHalfFovX * _tanHalfFovX + _tanHalfFovY * _tanHalfFovY;
+	float depth = (_splitFar + _splitNear) * (1 + k2) * 0.5f;
+	float radius;
+	if (depth >= _splitFar)
+	{
+		depth = _splitFar;
+		radius = _splitFar * sqrtf(k2);
+	}
+	else
+	{
+		radius = sqrtf((depth - _splitNear) * (depth - _splitNear) + _splitNear * _splitNear * k2);
+	}
+	cascade.radius = ceilf(radius * SHADOW_RADIUS_STEP) / SHADOW_RADIUS_STEP;
+	cascade.center = XMFLOAT3(
+		_cameraPosition.x + _cameraForward.x * depth,
+		_cameraPosition.y + _cameraForward.y * depth,
+		_cameraPosition.z + _cameraForward.z * depth);
+
+	// Whole texels in light space are whole texels in the world, since the light view never moves
+	cascade.texelSize = 2 * cascade.radius / _resolution;
+	XMFLOAT3 lightCenter = TransformPoint(_lightView, cascade.center);
+	cascade.lightCenter = XMFLOAT2(
+		floorf(lightCenter.x / cascade.texelSize) * cascade.texelSize,
+		floorf(lightCenter.y / cascade.texelSize) * cascade.texelSize);
+	cascade.depthMin = lightCenter.z - cascade.radius;
+	cascade.depthMax = lightCenter.z + cascade.radius;
+
+	BuildProjection(cascade);
+	return cascade;
+}
+
+unsigned int ShadowCascades::CullCasters(ShadowCascade& _cascade, const std::vector<BoundingSphere>& _casters, std::vector<unsigned int>& _visible)
+{
+	_visible.clear();
+	for (unsigned int i = 0; i < _casters.size(); i++)
+	{
+		// Anything across the box and in front of its far plane can throw a shadow into it
+		XMFLOAT3 center = TransformPoint(_cascade.view, _casters[i].Center);
+		float reach = _cascade.radius + _casters[i].Radius;
+		if (fabsf(center.x - _cascade.lightCenter.x) > reach) continue;
+		if (fabsf(center.y - _cascade.lightCenter.y) > reach) continue;
+		if (center.z - _casters[i].Radius > _cascade.depthMax) continue;
+
+		_cascade.depthMin = (std::min)(_cascade.depthMin, center.z - _casters[i].Radius);
+		_visible.push_back(i);
+	}
+
+	BuildProjection(_cascade);
+	return (unsigned int)_casters.size();
+}
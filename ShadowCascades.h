@@ -0,0 +1,131 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+// Slices of the view range that each get their own shadow map
+// - Should match SHADOW_CASCADE_COUNT in Defines.hlsli (at most 4, since the splits go up as a float4)
+constexpr auto SHADOW_CASCADE_COUNT = 4;
+
+// Width and height of each cascade's shadow map, in texels
+constexpr auto SHADOW_MAP_RESOLUTION = 2048;
+
+// How far from the camera shadows reach, since the far clip is usually much further than they'd hold up
+constexpr auto SHADOW_DISTANCE = 80.0f;
+
+// Blend between uniform (0) and logarithmic (1) split distances
+constexpr auto SHADOW_SPLIT_LAMBDA = 0.8f;
+
+struct ShadowCascade
+{
+	float									splitNear;			// View depth range the cascade covers
+	float									splitFar;
+	DirectX::XMFLOAT3						center;				// Bounding sphere of the camera frustum slice (world space)
+	float									radius;
+	DirectX::XMFLOAT2						lightCenter;		// Light space x/y the ortho box is centered on (snapped to whole texels)
+	float									texelSize;			// World units per shadow map texel
+	float									depthMin;			// Light space depth range, pulled toward the light to take in every caster
+	float									depthMax;
+	DirectX::XMFLOAT4X4						view;				// Light view (shared by every cascade)
+	DirectX::XMFLOAT4X4						projection;
+	DirectX::XMFLOAT4X4						viewProjection;
+};
+
+struct ShadowStats
+{
+	unsigned int							casters;							// Caster bounds given to Update
+	unsigned int							casterTests;
+	unsigned int							drawnCasters;						// Caster draws over every cascade
+	unsigned int							cascadeCasters[SHADOW_CASCADE_COUNT];
+};
+
+// --------------------------------------------------------
+// Fits cascaded shadow maps for a directional light to the
+// camera and picks out each cascade's shadow casters
+//
+// Splits follow the practical scheme, blending logarithmic
+// and uniform distances between the camera's near clip and
+// SHADOW_DISTANCE (or its far clip, if that's closer).
+//
+// Each cascade is an ortho projection around the bounding
+// sphere of its slice of the camera frustum, so its size
+// doesn't change as the camera turns. The light view sits
+// at the world origin and the sphere's center is snapped to
+// whole texels in it, so texels stay put in the world as
+// the camera moves and shadow edges don't shimmer.
+//
+// A caster is kept for a cascade if its bounds touch the
+// cascade's box extruded toward the light (anything in
+// there can shadow the slice), and the box's near plane is
+// pulled back to the nearest kept caster.
+//
+// Everything here is deterministic and knows nothing about
+// D3D; ShadowMaps renders the results.
+// --------------------------------------------------------
+class ShadowCascades
+{
+public:
+	ShadowCascades();
+	~ShadowCascades();
+
+											/// <summary>
+											/// Fits every cascade to the camera and culls the casters for each
+											/// </summary>
+											/// <param name="_view">The camera's view matrix</param>
+											/// <param name="_projection">The camera's (symmetric, perspective) projection matrix</param>
+											/// <param name="_nearClip">The camera's near clip distance</param>
+											/// <param name="_farClip">The camera's far clip distance</param>
+											/// <param name="_lightDirection">The light's Direction (pointing toward the light)</param>
+											/// <param name="_casters">World space bounds of everything that casts shadows</param>
+	void									Update(const DirectX::XMFLOAT4X4& _view, const DirectX::XMFLOAT4X4& _projection, float _nearClip, float _farClip,
+												DirectX::XMFLOAT3 _lightDirection, const std::vector<DirectX::BoundingSphere>& _casters);
+
+	const ShadowCascade&					GetCascade(unsigned int _cascade);
+											/// <summary>
+											/// Gets the indices (into the casters given to Update) of the casters drawn into a cascade, in order
+											/// </summary>
+	const std::vector<unsigned int>&		GetCasters(unsigned int _cascade);
+	ShadowStats								GetStats();
+
+											/// <summary>
+											/// Computes the practical split distances
+											/// </summary>
+											/// <param name="_near">Where the first cascade starts</param>
+											/// <param name="_far">Where the last cascade ends</param>
+											/// <param name="_lambda">Blend between uniform (0) and logarithmic (1) splits</param>
+											/// <param name="_count">The number of cascades</param>
+											/// <param name="_splits">Receives _count + 1 distances, from _near to _far</param>
+	static void								ComputeSplits(float _near, float _far, float _lambda, unsigned int _count, float* _splits);
+											/// <summary>
+											/// Builds a view looking along a light from the world origin
+											/// </summary>
+											/// <param name="_lightDirection">The light's Direction (pointing toward the light)</param>
+	static DirectX::XMFLOAT4X4				BuildLightView(DirectX::XMFLOAT3 _lightDirection);
+											/// <summary>
+											/// Fits a cascade's sphere, texel-snapped bounds and depth range to one slice of the camera frustum
+											/// </summary>
+											/// <param name="_cameraPosition">The camera's position (world space)</param>
+											/// <param name="_cameraForward">The camera's forward direction (world space, unit length)</param>
+											/// <param name="_tanHalfFovX">Tangent of half the camera's horizontal field of view</param>
+											/// <param name="_tanHalfFovY">Tangent of half the camera's vertical field of view</param>
+											/// <param name="_splitNear">Where the slice starts (view depth)</param>
+											/// <param name="_splitFar">Where the slice ends (view depth)</param>
+											/// <param name="_lightView">The light view from BuildLightView</param>
+											/// <param name="_resolution">The shadow map's width and height in texels</param>
+	static ShadowCascade					FitCascade(DirectX::XMFLOAT3 _cameraPosition, DirectX::XMFLOAT3 _cameraForward, float _tanHalfFovX, float _tanHalfFovY,
+												float _splitNear, float _splitFar, const DirectX::XMFLOAT4X4& _lightView, unsigned int _resolution);
+											/// <summary>
+											/// Keeps the casters touching a fitted cascade's extruded box, then pulls its near plane back to them and builds its projection
+											/// </summary>
+											/// <param name="_cascade">A cascade from FitCascade</param>
+											/// <param name="_casters">World space caster bounds</param>
+											/// <param name="_visible">Receives the indices of the casters kept</param>
+											/// <returns>The number of casters tested</returns>
+	static unsigned int						CullCasters(ShadowCascade& _cascade, const std::vector<DirectX::BoundingSphere>& _casters, std::vector<unsigned int>& _visible);
+
+private:
+	ShadowCascade							cascades[SHADOW_CASCADE_COUNT];
+	std::vector<unsigned int>				casters[SHADOW_CASCADE_COUNT];
+	ShadowStats								stats;
+};
@@ -0,0 +1,147 @@
+#include "ShadowMaps.h"
+#include "PipelineCache.h"
+#include "StateCache.h"
+
+using namespace DirectX;
+
+// Depth bias for the shadow pass, to keep lit surfaces from shadowing themselves
+constexpr auto SHADOW_DEPTH_BIAS = 1000;
+constexpr auto SHADOW_SLOPE_SCALED_DEPTH_BIAS = 1.0f;
+
+ShadowMaps::ShadowMaps(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, std::shared_ptr<SimpleVertexShader> _vertexShader)
+{
+	device = _device;
+	context = _context;
+	vertexShader = _vertexShader;
+	worldHandle = vertexShader->GetVariableHandle("world");
+	lightViewProjectionHandle = vertexShader->GetVariableHandle("lightViewProjection");
+
+	// Typeless, so the same texture can be drawn into as depth and read back as floats
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = SHADOW_MAP_RESOLUTION;
+	textureDesc.Height = SHADOW_MAP_RESOLUTION;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = SHADOW_CASCADE_COUNT;
+	textureDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf());
+
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC depthDesc = {};
+		depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		depthDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		depthDesc.Texture2DArray.FirstArraySlice = c;
+		depthDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(texture.Get(), &depthDesc, depthViews[c].GetAddressOf());
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	viewDesc.Texture2DArray.MipLevels = 1;
+	viewDesc.Texture2DArray.ArraySize = SHADOW_CASCADE_COUNT;
+	device->CreateShaderResourceView(texture.Get(), &viewDesc, shadowView.GetAddressOf());
+
+	// Anything outside a cascade counts as lit
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.BorderColor[0] = 1.0f;
+	samplerDesc.BorderColor[1] = 1.0f;
+	samplerDesc.BorderColor[2] = 1.0f;
+	samplerDesc.BorderColor[3] = 1.0f;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	D3D11_RASTERIZER_DESC rasterDesc = {};
+	rasterDesc.FillMode = D3D11_FILL_SOLID;
+	rasterDesc.CullMode = D3D11_CULL_BACK;
+	rasterDesc.DepthClipEnable = true;
+	rasterDesc.DepthBias = SHADOW_DEPTH_BIAS;
+	rasterDesc.SlopeScaledDepthBias = SHADOW_SLOPE_SCALED_DEPTH_BIAS;
+
+	PipelineCache& pipelineCache = PipelineCache::GetInstance();
+	sampler = pipelineCache.GetSamplerState(samplerDesc);
+	rasterState = pipelineCache.GetRasterizerState(rasterDesc);
+}
+
+ShadowMaps::~ShadowMaps()
+{
+}
+
+void ShadowMaps::Render(std::shared_ptr<Camera> _camera, XMFLOAT3 _lightDirection, const std::vector<std::shared_ptr<Entity>>& _casters)
+{
+	casterBounds.resize(_casters.size());
+	for (size_t i = 0; i < _casters.size(); i++)
+	{
+		casterBounds[i] = _casters[i]->GetBounds();
+	}
+	cascades.Update(_camera->GetViewMatrix(), _camera->GetProjectionMatrix(), _camera->GetNearClip(), _camera->GetFarClip(), _lightDirection, casterBounds);
+
+	// The maps can't be drawn into while they're still bound for reading
+	StateCache& cache = StateCache::GetInstance();
+	cache.PSSetShaderResource(SHADOW_MAP_SLOT, 0);
+
+	// Hang on to the frame's targets and viewport to put back afterwards
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> frameTarget;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> frameDepth;
+	context->OMGetRenderTargets(1, frameTarget.GetAddressOf(), frameDepth.GetAddressOf());
+	D3D11_VIEWPORT frameViewport = {};
+	UINT viewportCount = 1;
+	context->RSGetViewports(&viewportCount, &frameViewport);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)SHADOW_MAP_RESOLUTION;
+	viewport.Height = (float)SHADOW_MAP_RESOLUTION;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+
+	// Depth only
+	vertexShader->SetShader();
+	cache.PSSetShader(0);
+	cache.RSSetState(rasterState.Get());
+
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		context->ClearDepthStencilView(depthViews[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		context->OMSetRenderTargets(0, 0, depthViews[c].Get());
+		vertexShader->SetMatrix4x4(lightViewProjectionHandle, cascades.GetCascade(c).viewProjection);
+
+		for (unsigned int index : cascades.GetCasters(c))
+		{
+			Entity* entity = _casters[index].get();
+			vertexShader->SetMatrix4x4(worldHandle, entity->GetTransform()->GetWorldMatrix());
+			vertexShader->CopyAllBufferData();
+			entity->GetMesh()->Bind();
+			entity->GetMesh()->DrawIndexed();
+		}
+	}
+
+	cache.RSSetState(0);
+	context->OMSetRenderTargets(1, frameTarget.GetAddressOf(), frameDepth.Get());
+	context->RSSetViewports(1, &frameViewport);
+}
+
+void ShadowMaps::Bind()
+{
+	StateCache& cache = StateCache::GetInstance();
+	cache.PSSetShaderResource(SHADOW_MAP_SLOT, shadowView.Get());
+	cache.PSSetSampler(SHADOW_SAMPLER_SLOT, sampler.Get());
+}
+
+const ShadowCascade& ShadowMaps::GetCascade(unsigned int _cascade)
+{
+	return cascades.GetCascade(_cascade);
+}
+
+ShadowStats ShadowMaps::GetStats()
+{
+	return cascades.GetStats();
+}
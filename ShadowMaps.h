@@ -0,0 +1,61 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "Camera.h"
+#include "Entity.h"
+#include "ShadowCascades.h"
+#include "SimpleShader.h"
+
+// Registers the shadow maps and their comparison sampler are bound to
+// - These should match Shadows.hlsli
+constexpr auto SHADOW_MAP_SLOT = 23;
+constexpr auto SHADOW_SAMPLER_SLOT = 15;
+
+// --------------------------------------------------------
+// Cascaded shadow maps for one directional light: a depth
+// texture array with a slice per cascade
+//
+// Each frame the cascades are refit to the camera (see
+// ShadowCascades) and every slice gets only the casters
+// that can shadow its part of the view.
+// --------------------------------------------------------
+class ShadowMaps
+{
+public:
+	ShadowMaps(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, std::shared_ptr<SimpleVertexShader> _vertexShader);
+	~ShadowMaps();
+
+											/// <summary>
+											/// Fits the cascades and draws each one's casters, leaving the frame's targets and viewport bound afterwards
+											/// </summary>
+											/// <param name="_camera">The camera rendering this frame</param>
+											/// <param name="_lightDirection">The shadowed light's Direction (pointing toward the light)</param>
+											/// <param name="_casters">The entities that cast shadows</param>
+	void									Render(std::shared_ptr<Camera> _camera, DirectX::XMFLOAT3 _lightDirection, const std::vector<std::shared_ptr<Entity>>& _casters);
+											/// <summary>
+											/// Binds the shadow maps and their comparison sampler to the pixel shader stage
+											/// </summary>
+	void									Bind();
+
+	const ShadowCascade&					GetCascade(unsigned int _cascade);
+	ShadowStats								GetStats();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device>		device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+
+	ShadowCascades							cascades;
+	std::vector<DirectX::BoundingSphere>	casterBounds;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	shadowView;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView>		depthViews[SHADOW_CASCADE_COUNT];
+	Microsoft::WRL::ComPtr<ID3D11SamplerState>			sampler;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState>		rasterState;
+
+	std::shared_ptr<SimpleVertexShader>		vertexShader;
+	SimpleShaderHandle						worldHandle;
+	SimpleShaderHandle						lightViewProjectionHandle;
+};
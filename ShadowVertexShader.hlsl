@@ -0,0 +1,17 @@
+#include "Defines.hlsli"
+#include "ConstantBuffers.hlsli"
+
+// The cascade being drawn into (see ShadowMaps.h)
+cbuffer ShadowCascade : register(b1)
+{
+	matrix lightViewProjection;
+}
+
+// --------------------------------------------------------
+// Depth-only vertex shader for the shadow maps: no pixel
+// shader runs, so only the position goes out
+// --------------------------------------------------------
+float4 main(VertexShaderInput input) : SV_POSITION
+{
+	return mul(lightViewProjection, mul(world, float4(input.localPosition, 1.0f)));
+}
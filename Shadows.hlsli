@@ -0,0 +1,109 @@
+#ifndef __SHADER_SHADOWS__
+#define __SHADER_SHADOWS__
+
+#include "Defines.hlsli"
+#include "ConstantBuffers.hlsli"
+
+// Cascaded shadow maps for the shadowed directional light (see ShadowCascades.h)
+// - These should match ShadowMaps.h
+Texture2DArray ShadowMaps					: register(t23); // One slice per cascade
+SamplerComparisonState ShadowSampler		: register(s15);
+
+// Where a shadowed point light's cube faces are in the atlas (see ShadowAtlas.h)
+// - This should match PointShadowData in PointShadowMaps.h
+struct PointShadow
+{
+	float4 faces[6];	// Atlas UV offset (xy) and scale (z) of each face's tile, and the inset (w) that keeps filtering inside it
+	float4 depth;		// Depth from distance along a face: x + y / distance; z is the atlas texel size
+};
+
+// Point light shadows, six tiles per light in one atlas
+// - These should match PointShadowMaps.h
+Texture2D PointShadowAtlas					: register(t24);
+StructuredBuffer<PointShadow> PointShadows	: register(t25); // Indexed by a light's ShadowIndex
+
+// Gets how lit a pixel is by the shadowed light, from 0 (fully shadowed) to 1
+float getShadow(float3 worldPosition)
+{
+	if (shadowTexelSize <= 0)
+		return 1;
+
+	// Cascades are picked by view depth, matching how their splits were made
+	float depth = mul(view, float4(worldPosition, 1)).z;
+	if (depth >= shadowSplits[SHADOW_CASCADE_COUNT - 1])
+		return 1;
+
+	uint cascade = 0;
+	[unroll]
+	for (uint c = 0; c < SHADOW_CASCADE_COUNT - 1; c++)
+	{
+		cascade += depth >= shadowSplits[c] ? 1 : 0;
+	}
+
+	float4 shadowPosition = mul(shadowViewProjection[cascade], float4(worldPosition, 1));
+	float2 uv = shadowPosition.xy * float2(0.5f, -0.5f) + 0.5f;
+
+	// 3x3 PCF, each tap already bilinearly filtered by the comparison sampler
+	float lit = 0;
+	[unroll]
+	for (int y = -1; y <= 1; y++)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; x++)
+		{
+			lit += ShadowMaps.SampleCmpLevelZero(ShadowSampler, float3(uv + float2(x, y) * shadowTexelSize, cascade), shadowPosition.z);
+		}
+	}
+	return lit / 9;
+}
+
+// Gets how lit a pixel is by a point light, from 0 (fully shadowed) to 1
+float getPointShadow(Light light, float3 worldPosition)
+{
+	if (light.Shadowed <= 0)
+		return 1;
+	PointShadow shadow = PointShadows[(uint)light.ShadowIndex];
+
+	// Pick the cube face the pixel is in and get its right, up and forward coordinates there
+	// - These should match the faces in ShadowAtlas.cpp
+	float3 offset = worldPosition - light.Position;
+	float3 size = abs(offset);
+	uint face;
+	float3 local;
+	if (size.x >= size.y && size.x >= size.z)
+	{
+		face = offset.x > 0 ? 0 : 1;
+		local = offset.x > 0 ? float3(-offset.z, offset.y, offset.x) : float3(offset.z, offset.y, -offset.x);
+	}
+	else if (size.y >= size.z)
+	{
+		face = offset.y > 0 ? 2 : 3;
+		local = offset.y > 0 ? float3(offset.x, -offset.z, offset.y) : float3(offset.x, offset.z, -offset.y);
+	}
+	else
+	{
+		face = offset.z > 0 ? 4 : 5;
+		local = offset.z > 0 ? offset : float3(-offset.x, offset.y, -offset.z);
+	}
+
+	// Stay far enough inside the face's tile that filtering never reaches a neighbour
+	float4 tile = shadow.faces[face];
+	float2 uv = clamp(local.xy / local.z * float2(0.5f, -0.5f) + 0.5f, tile.w, 1 - tile.w);
+	uv = tile.xy + uv * tile.z;
+	float depth = shadow.depth.x + shadow.depth.y / local.z;
+
+	// 3x3 PCF, as with the cascades
+	float lit = 0;
+	[unroll]
+	for (int y = -1; y <= 1; y++)
+	{
+		[unroll]
+		for (int x = -1; x <= 1; x++)
+		{
+			lit += PointShadowAtlas.SampleCmpLevelZero(ShadowSampler, uv + float2(x, y) * shadow.depth.z, depth);
+		}
+	}
+	return lit / 9;
+}
+
+#endif
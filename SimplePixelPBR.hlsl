@@ -3,26 +3,27 @@
 #include "HelpersPBR.hlsli"
 #include "Lights.hlsli"
 #include "LightsPBR.hlsli"
+#include "ConstantBuffers.hlsli"
+#include "Clusters.hlsli"
+#include "Shadows.hlsli"
+#include "Permutations.hlsli"
 
-#define MAX_LIGHTS 128
-
-cbuffer ExternalData : register(b0)
+cbuffer PerMaterial : register(b1)
 {
 	float2 offset;
 	float2 scale;
 
-	float3 cameraPosition;
-	float lightCount;
-
 	float normalIntensity;
+	float roughness;
+	float metalness;
+	float occlusion;
 
-	Light lights[MAX_LIGHTS];
+	int hasOrmMap;
 }
 
 Texture2D Albedo : register(t0);
 Texture2D Normal : register(t1);
-Texture2D Roughness : register(t2);
-Texture2D Metalness : register(t3);
+Texture2D ORM : register(t2);
 TextureCube Reflection : register(t4);
 SamplerState BasicSampler : register(s0);
 
@@ -39,25 +40,33 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// gets normal map
 	float3 normal = getNormal(BasicSampler, Normal, input.uv, input.normal, input.tangent, normalIntensity);
 
-	// get pbr values
-	float roughness = Roughness.Sample(BasicSampler, input.uv).r;
-	float metalness = Metalness.Sample(BasicSampler, input.uv).r;
-	float3 specular = lerp(F0_NON_METAL.rrr, albedo.rgb, metalness);
+	// get pbr values: occlusion, roughness and metalness packed in one map, or constants where the maps were one color
+	float3 orm = float3(occlusion, roughness, metalness);
+	if (USE_ORM_MAP)
+	{
+		orm = ORM.Sample(BasicSampler, input.uv).rgb;
+	}
+	float surfaceRoughness = orm.g;
+	float surfaceMetalness = orm.b;
+	float3 specular = lerp(F0_NON_METAL.rrr, albedo.rgb, surfaceMetalness);
 
 	// pre-calculate view
 	float3 view = normalize(cameraPosition - input.worldPosition);
 
-	// calculate lighting
-	float3 light = float3(0, 0, 0);
-	for (int i = 0; i < lightCount; i++)
+	// calculate lighting, with occlusion darkening only the ambient (the SH term holds direct lights that missed the object's list)
+	float3 light = (ambient * orm.r + getIrradianceSH(lightIrradiance, normal)) * albedo.rgb * (1 - surfaceMetalness);
+	uint2 clusterRange = getClusterRange(input.screenPosition, input.worldPosition);
+	float shadow = getShadow(input.worldPosition);
+	for (uint i = 0; i < (uint)lightCount + clusterRange.y; i++)
 	{
-		switch (lights[i].Type)
+		Light source = getLight(i, clusterRange);
+		switch (source.Type)
 		{
 		case LIGHT_TYPE_DIRECTIONAL:
-			light += directionalLightPBR(lights[i], normal, view, roughness, metalness, albedo, specular);
+			light += directionalLightPBR(source, normal, view, surfaceRoughness, surfaceMetalness, albedo, specular) * lerp(1, shadow, source.Shadowed);
 			break;
 		case LIGHT_TYPE_POINT:
-			light += pointLightPBR(lights[i], normal, view, roughness, metalness, albedo, specular, input.worldPosition);
+			light += pointLightPBR(source, normal, view, surfaceRoughness, surfaceMetalness, albedo, specular, input.worldPosition) * getPointShadow(source, input.worldPosition);
 			break;
 		}
 	}
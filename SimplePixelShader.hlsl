@@ -1,20 +1,16 @@
 #include "Defines.hlsli"
 #include "Helpers.hlsli"
 #include "Lights.hlsli"
+#include "ConstantBuffers.hlsli"
+#include "Clusters.hlsli"
+#include "Shadows.hlsli"
+#include "Permutations.hlsli"
 
-#define MAX_LIGHTS 128
-
-cbuffer ExternalData : register(b0)
+cbuffer PerMaterial : register(b1)
 {
-	float3 cameraPosition;
-	int hasNormalMap;
-
 	float2 offset;
 	float2 scale;
 
-	float3 ambient;
-	float lightCount;
-
 	float3 tint;
 	int hasAlbedoMap;
 
@@ -26,10 +22,12 @@ cbuffer ExternalData : register(b0)
 	float roughness;
 	float normalIntensity;
 
+	int hasNormalMap;
 	int hasSpecularMap;
 	int hasReflectionMap;
+	float specularAmount;
 
-	Light lights[MAX_LIGHTS];
+	float3 emitColor;
 }
 
 Texture2D Albedo : register(t0);
@@ -51,7 +49,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// get alpha from exposed alpha value, multiply it by albedo alpha if there is one
 	float3 surface = tint;
 	float alphaValue = alpha;
-	if (hasAlbedoMap)
+	if (USE_ALBEDO_MAP)
 	{
 		float4 sampledAlbedo = Albedo.Sample(BasicSampler, input.uv);
 		// discard if the alpha of the texture is less than the cutoff point
@@ -65,42 +63,45 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// gets normal map if there is one
 	float3 normal = input.normal;
-	if (hasNormalMap > 0)
+	if (USE_NORMAL_MAP)
 		normal = getNormal(BasicSampler, Normal, input.uv, input.normal, input.tangent, normalIntensity);
 
 	// gets specular value; if there is a specular map, use that instead
-	float specular = 1;
-	if (hasSpecularMap > 0)
+	float specular = specularAmount;
+	if (USE_SPECULAR_MAP)
 		specular = Specular.Sample(BasicSampler, input.uv).r;
 
 	// pre-calculate view
 	float3 view = getView(cameraPosition, input.worldPosition);
 
 	// calculate lighting
-	float3 light = ambient * surface;
-	for (int i = 0; i < lightCount; i++)
+	float3 light = (ambient + getIrradianceSH(lightIrradiance, normal)) * surface;
+	uint2 clusterRange = getClusterRange(input.screenPosition, input.worldPosition);
+	float shadow = getShadow(input.worldPosition);
+	for (uint i = 0; i < (uint)lightCount + clusterRange.y; i++)
 	{
-		switch (lights[i].Type)
+		Light source = getLight(i, clusterRange);
+		switch (source.Type)
 		{
 		case LIGHT_TYPE_DIRECTIONAL:
-			light += calculateDirectionalLight(lights[i], -normal, view, roughness, surface, specular);
+			light += calculateDirectionalLight(source, -normal, view, roughness, surface, specular) * lerp(1, shadow, source.Shadowed);
 			break;
 		case LIGHT_TYPE_POINT:
-			light += calculatePointLight(lights[i], normal, view, input.worldPosition, roughness, surface, specular);
+			light += calculatePointLight(source, normal, view, input.worldPosition, roughness, surface, specular) * getPointShadow(source, input.worldPosition);
 			break;
 		}
 	}
 
 	// get emission; use emissive map if there is one
-	float3 emit = float3(1, 1, 1);
-	if (hasEmissiveMap > 0)
+	float3 emit = emitColor;
+	if (USE_EMISSIVE_MAP)
 		emit = Emissive.Sample(BasicSampler, input.uv).rgb;
 
 	// calculate the final color value with lighting and emission
 	float3 final = float3(light + (emit * emitAmount));
 
 	// utilize reflection map if there is one
-	if (hasReflectionMap > 0)
+	if (USE_REFLECTION_MAP)
 	{
 		float3 reflVec = getReflection(view, normal);
 		float3 reflCol = Reflection.Sample(BasicSampler, reflVec).rgba;
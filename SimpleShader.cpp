@@ -2,11 +2,23 @@
 // LICENSE: MIT
 
 #include "SimpleShader.h"
+#include "StateCache.h"
+
+#include <chrono>
 
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// Running total of bytes copied into constant buffers
+size_t ISimpleShader::UploadedBytes = 0;
+
+// Reflection sidecar state and running totals
+bool ISimpleShader::UseReflectionCache = true;
+unsigned int ISimpleShader::ReflectionCacheHits = 0;
+unsigned int ISimpleShader::ReflectionCacheMisses = 0;
+double ISimpleShader::ReflectionMilliseconds = 0;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -67,6 +79,7 @@ void ISimpleShader::CleanUp()
 		delete samplerStates[i];
 
 	// Clean up tables
+	variables.clear();
 	varTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
@@ -97,10 +110,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Create the shader - Calls an overloaded version of this abstract
-	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
-	if (!shaderValid)
+	// Create the shader and reflect it (or read the reflection saved last time)
+	if (!LoadShaderBlob(shaderBlob, std::wstring(shaderFile) + REFLECTION_SIDECAR_EXTENSION))
 	{
 		if (ReportErrors)
 		{
@@ -112,82 +123,75 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
+	// All set
+	return true;
+}
 
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
+// --------------------------------------------------------
+// Creates the shader from compiled bytecode and builds the
+// variable table from its reflection data.
+//
+// blob        - The compiled shader
+// sidecarFile - Where the blob's reflection data is cached,
+//               or empty to always reflect
+//
+// Returns true if shader is created properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob(Microsoft::WRL::ComPtr<ID3DBlob> blob, std::wstring sidecarFile)
+{
+	shaderBlob = blob;
+	if (!shaderBlob)
+		return false;
+
+	// Get information about this shader and its variables,
+	// buffers, etc. before creating it, since vertex shaders
+	// build their input layout from it
+	if (!LoadReflection(sidecarFile))
+		return false;
+
+	// Create the shader - Calls an overloaded version of this abstract
+	// method in the appropriate child class
+	shaderValid = CreateShader(shaderBlob);
+	if (!shaderValid)
+		return false;
 
 	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
 
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (auto& texture : reflection.Textures)
 	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
-		// Check the type
-		switch (resourceDesc.Type)
-		{
-		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
-		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
+		// Create the SRV wrapper
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = texture.BindIndex;						// Shader bind point
+		srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
 
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
-		break;
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(texture.Name, srv));
+		shaderResourceViews.push_back(srv);
+	}
 
-		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
+	for (auto& sampler : reflection.Samplers)
+	{
+		// Create the sampler wrapper
+		SimpleSampler* samp = new SimpleSampler();
+		samp->BindIndex = sampler.BindIndex;				// Shader bind point
+		samp->Index = (unsigned int)samplerStates.size();	// Raw index
 
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
-		break;
-		}
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(sampler.Name, samp));
+		samplerStates.push_back(samp);
 	}
 
 	// Loop through all constant buffers
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
-		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-
-		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
+		const ShaderReflectionBuffer& bufferDesc = reflection.ConstantBuffers[b];
 
 		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
 
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
 		constantBuffers[b].Name = bufferDesc.Name;
 		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
@@ -207,28 +211,19 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (auto& varDesc : bufferDesc.Variables)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
-
 			// Create the variable struct
 			SimpleShaderVariable varStruct = {};
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
+			varStruct.ByteOffset = varDesc.ByteOffset;
 			varStruct.Size = varDesc.Size;
-
-			// Get a string version
-			std::string varName(varDesc.Name);
+			varStruct.Index = (unsigned int)variables.size();
 
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varDesc.Name, varStruct));
 			constantBuffers[b].Variables.push_back(varStruct);
+			variables.push_back(varStruct);
 		}
 	}
 
@@ -236,6 +231,81 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	return true;
 }
 
+// --------------------------------------------------------
+// Fills in the reflection data for the current blob, from
+// its sidecar file if that was written for this exact blob,
+// otherwise with D3DReflect (saving a new sidecar after)
+//
+// sidecarFile - Where the reflection data is cached, or
+//               empty to always reflect
+// --------------------------------------------------------
+bool ISimpleShader::LoadReflection(std::wstring sidecarFile)
+{
+	// Shaders built in memory have nowhere to cache to, so they aren't counted either
+	if (sidecarFile.empty())
+		return ReflectShaderBlob(shaderBlob, reflection);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	bool loaded = false;
+	if (UseReflectionCache)
+	{
+		uint64_t hash = HashShaderBlob(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+		loaded = ReadShaderReflectionSidecar(sidecarFile, hash, reflection);
+	}
+
+	if (loaded)
+	{
+		ReflectionCacheHits++;
+	}
+	else
+	{
+		loaded = ReflectShaderBlob(shaderBlob, reflection);
+		ReflectionCacheMisses++;
+
+		// Failing to write just means reflecting again next time
+		if (loaded && UseReflectionCache)
+			WriteShaderReflectionSidecar(sidecarFile, reflection);
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	ReflectionMilliseconds += elapsed.count();
+	return loaded;
+}
+
+// --------------------------------------------------------
+// Uploads a constant buffer's local data, skipping buffers
+// that haven't changed since their last upload
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(SimpleConstantBuffer* cb)
+{
+	if (cb->Ring != 0)
+	{
+		// Ring space from an earlier frame (or from before a discard) may have been reused, so it counts as changed
+		if (!cb->Dirty && cb->RingGeneration == cb->Ring->GetGeneration())
+			return;
+
+		if (!cb->Ring->Upload(cb->LocalDataBuffer, cb->Size, cb->RingFirstConstant, cb->RingNumConstants))
+			return;
+
+		// The data moved, so it has to be bound again at its new offset
+		cb->RingGeneration = cb->Ring->GetGeneration();
+		cb->Dirty = false;
+		UploadedBytes += cb->Size;
+		BindRingBuffer(cb);
+		return;
+	}
+
+	if (!cb->Dirty)
+		return;
+
+	deviceContext->UpdateSubresource(
+		cb->ConstantBuffer.Get(), 0, 0,
+		cb->LocalDataBuffer, 0, 0);
+	cb->Dirty = false;
+	UploadedBytes += cb->Size;
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -351,10 +421,12 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		// External buffers are uploaded by whoever owns them
+		if (constantBuffers[i].External)
+			continue;
+
+		// Copy the entire local data buffer (if it changed)
+		UploadBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -382,10 +454,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0,
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -404,10 +474,94 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
+	// Copy the data (if it changed) and get out
+	UploadBuffer(cb);
+}
+
+// --------------------------------------------------------
+// Copies local data for the specified constant buffer into
+// a different buffer, such as one created with
+// CreateCompatibleBuffer() and owned by a material
+//
+// bufferName - Specifies the name of the buffer to copy
+// target - The buffer to copy into
+// --------------------------------------------------------
+void ISimpleShader::CopyBufferData(std::string bufferName, ID3D11Buffer* target)
+{
+	// Ensure the shader is valid
+	if (!shaderValid || target == 0) return;
+
+	// Check for the buffer
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return;
+
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0,
-		cb->LocalDataBuffer, 0, 0);
+	deviceContext->UpdateSubresource(target, 0, 0, cb->LocalDataBuffer, 0, 0);
+	UploadedBytes += cb->Size;
+}
+
+// --------------------------------------------------------
+// Marks a constant buffer as managed outside of this shader
+// (e.g. one shared by several shaders, or one per material).
+// External buffers are not copied by CopyAllBufferData()
+// or bound by SetShader(); their owner does both.
+//
+// bufferName - The name of the constant buffer
+// external - Whether the buffer is externally managed
+//
+// Returns true if the buffer was found, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferExternal(std::string bufferName, bool external)
+{
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return false;
+
+	cb->External = external;
+	return true;
+}
+
+// --------------------------------------------------------
+// Sub-allocates a constant buffer's data from a shared ring
+// every time it changes, binding it by offset, instead of
+// updating the buffer the shader created for it.  Meant for
+// per-draw data in vertex and pixel shaders.
+//
+// bufferName - The name of the constant buffer
+// ring - The ring to allocate from, or null to stop using one
+//
+// Returns true if the buffer was found and the ring is usable
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferRing(std::string bufferName, ConstantBufferRing* ring)
+{
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return false;
+	if (ring != 0 && !ring->IsSupported()) return false;
+
+	cb->Ring = ring;
+	cb->Dirty = true;
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates a new constant buffer the same size as the
+// specified one, for callers that keep their own copy
+//
+// bufferName - The name of the constant buffer to match
+//
+// Returns the new buffer, or null if the buffer doesn't exist
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11Buffer> ISimpleShader::CreateCompatibleBuffer(std::string bufferName)
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
+	if (!cb) return buffer;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = ((cb->Size + 15) / 16) * 16;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+	return buffer;
 }
 
 
@@ -448,14 +602,8 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 	}
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
-
-	// Success
-	return true;
+	// Set it through its handle
+	return SetData((SimpleShaderHandle)var->Index, data, size);
 }
 
 // --------------------------------------------------------
@@ -538,6 +686,117 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Gets a handle to a variable for setting it without a
+// name lookup, or SIMPLESHADER_INVALID_HANDLE if the
+// variable doesn't exist.  Handles stay valid for the
+// lifetime of the shader.
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	SimpleShaderVariable* var = FindVariable(name, -1);
+	return var == 0 ? SIMPLESHADER_INVALID_HANDLE : (SimpleShaderHandle)var->Index;
+}
+
+// --------------------------------------------------------
+// Gets a handle to an SRV (or SIMPLESHADER_INVALID_HANDLE)
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetShaderResourceViewHandle(std::string name)
+{
+	const SimpleSRV* srv = GetShaderResourceViewInfo(name);
+	return srv == 0 ? SIMPLESHADER_INVALID_HANDLE : (SimpleShaderHandle)srv->Index;
+}
+
+// --------------------------------------------------------
+// Gets a handle to a sampler (or SIMPLESHADER_INVALID_HANDLE)
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetSamplerHandle(std::string name)
+{
+	const SimpleSampler* samp = GetSamplerInfo(name);
+	return samp == 0 ? SIMPLESHADER_INVALID_HANDLE : (SimpleShaderHandle)samp->Index;
+}
+
+// --------------------------------------------------------
+// Copies data into a variable's spot in the local data
+// buffer by handle
+//
+// handle - A handle from GetVariableHandle()
+// data - The data to copy
+// size - The size of the data (can be less than the variable)
+//
+// Returns true if data is copied, false if the handle is invalid
+// or the data doesn't fit
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderHandle handle, const void* data, unsigned int size)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	if ((unsigned int)handle >= variables.size())
+		return false;
+
+	const SimpleShaderVariable& var = variables[handle];
+	if (size > var.Size)
+		return false;
+
+	// Set the data in the local data buffer, unless it's already there
+	SimpleConstantBuffer& cb = constantBuffers[var.ConstantBufferIndex];
+	if (memcmp(cb.LocalDataBuffer + var.ByteOffset, data, size) == 0)
+		return true;
+
+	memcpy(cb.LocalDataBuffer + var.ByteOffset, data, size);
+	cb.Dirty = true;
+
+	// Success
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets INTEGER data by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(SimpleShaderHandle handle, int data)
+{
+	return this->SetData(handle, &data, sizeof(int));
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT variable by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat(SimpleShaderHandle handle, float data)
+{
+	return this->SetData(handle, &data, sizeof(float));
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT2 variable by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2 data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 2);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT3 variable by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3 data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT4 variable by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4 data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+// --------------------------------------------------------
+// Sets a MATRIX (4x4) variable by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -770,28 +1029,19 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
+	// reflected input signature to create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Read input layout description from shader info
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	for (auto& input : reflection.Inputs)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc = {};
+		paramDesc.SemanticName = input.SemanticName.c_str(); // Lives as long as the reflection data
+		paramDesc.SemanticIndex = input.SemanticIndex;
+		paramDesc.ComponentType = (D3D_REGISTER_COMPONENT_TYPE)input.ComponentType;
+		paramDesc.Mask = (BYTE)input.Mask;
 
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
@@ -871,25 +1121,48 @@ void SimpleVertexShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	// Set the shader and input layout (through the cache, so rebinding the same shader is free)
+	StateCache& cache = StateCache::GetInstance();
+	cache.IASetInputLayout(inputLayout.Get());
+	cache.VSSetShader(shader.Get());
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, or that are bound by their owner
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
+		// Ring buffers are bound wherever their data currently lives
+		if (constantBuffers[i].Ring != 0)
+		{
+			BindRingBuffer(&constantBuffers[i]);
+			continue;
+		}
+
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
+		cache.VSSetConstantBuffer(
 			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			constantBuffers[i].ConstantBuffer.Get());
 	}
 }
 
+// --------------------------------------------------------
+// Binds the part of the ring holding a buffer's latest data
+// --------------------------------------------------------
+void SimpleVertexShader::BindRingBuffer(SimpleConstantBuffer* cb)
+{
+	// Nothing has been uploaded yet, so there's nothing to bind
+	if (cb->RingNumConstants == 0)
+		return;
+
+	StateCache::GetInstance().VSSetConstantBufferRange(
+		cb->BindIndex,
+		cb->Ring->GetBuffer(),
+		cb->RingFirstConstant,
+		cb->RingNumConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the vertex shader stage
 //
@@ -913,8 +1186,27 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		return false;
 	}
 
+	// Set it through its handle
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view in the vertex shader stage by handle
+//
+// handle - A handle from GetShaderResourceViewHandle()
+// srv - The shader resource view in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	StateCache::GetInstance().VSSetShaderResource(srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -943,8 +1235,27 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set it through its handle
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the vertex shader stage by handle
+//
+// handle - A handle from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	// Set the sampler state
+	StateCache::GetInstance().VSSetSampler(sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -965,6 +1276,17 @@ SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor for shaders compiled at runtime (e.g. with
+// extra defines), which are already in memory
+// --------------------------------------------------------
+SimplePixelShader::SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob)
+	: ISimpleShader(device, context)
+{
+	// Set up from the already-compiled blob
+	this->LoadShaderBlob(shaderBlob);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -1014,24 +1336,47 @@ void SimplePixelShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
-	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	// Set the shader (through the cache, so rebinding the same shader is free)
+	StateCache& cache = StateCache::GetInstance();
+	cache.PSSetShader(shader.Get());
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, or that are bound by their owner
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
+		// Ring buffers are bound wherever their data currently lives
+		if (constantBuffers[i].Ring != 0)
+		{
+			BindRingBuffer(&constantBuffers[i]);
+			continue;
+		}
+
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
+		cache.PSSetConstantBuffer(
 			constantBuffers[i].BindIndex,
-			1,
-			constantBuffers[i].ConstantBuffer.GetAddressOf());
+			constantBuffers[i].ConstantBuffer.Get());
 	}
 }
 
+// --------------------------------------------------------
+// Binds the part of the ring holding a buffer's latest data
+// --------------------------------------------------------
+void SimplePixelShader::BindRingBuffer(SimpleConstantBuffer* cb)
+{
+	// Nothing has been uploaded yet, so there's nothing to bind
+	if (cb->RingNumConstants == 0)
+		return;
+
+	StateCache::GetInstance().PSSetConstantBufferRange(
+		cb->BindIndex,
+		cb->Ring->GetBuffer(),
+		cb->RingFirstConstant,
+		cb->RingNumConstants);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the pixel shader stage
 //
@@ -1055,8 +1400,27 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 		return false;
 	}
 
+	// Set it through its handle
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view in the pixel shader stage by handle
+//
+// handle - A handle from GetShaderResourceViewHandle()
+// srv - The shader resource view in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	StateCache::GetInstance().PSSetShaderResource(srvInfo->BindIndex, srv);
 
 	// Success
 	return true;
@@ -1085,8 +1449,27 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set it through its handle
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the pixel shader stage by handle
+//
+// handle - A handle from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	// Set the sampler state
+	StateCache::GetInstance().PSSetSampler(sampInfo->BindIndex, samplerState);
 
 	// Success
 	return true;
@@ -1164,8 +1547,8 @@ void SimpleDomainShader::SetShaderAndCBs()
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, or that are bound by their owner
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1199,8 +1582,27 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		return false;
 	}
 
+	// Set it through its handle
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view in the domain shader stage by handle
+//
+// handle - A handle from GetShaderResourceViewHandle()
+// srv - The shader resource view in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleDomainShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
 	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1229,8 +1631,27 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set it through its handle
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the domain shader stage by handle
+//
+// handle - A handle from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleDomainShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	// Set the sampler state
+	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1307,8 +1728,8 @@ void SimpleHullShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, or that are bound by their owner
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1342,8 +1763,27 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 		return false;
 	}
 
+	// Set it through its handle
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view in the hull shader stage by handle
+//
+// handle - A handle from GetShaderResourceViewHandle()
+// srv - The shader resource view in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleHullShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
 	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1372,8 +1812,27 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set it through its handle
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the hull shader stage by handle
+//
+// handle - A handle from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleHullShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	// Set the sampler state
+	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1581,8 +2040,8 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, or that are bound by their owner
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1616,8 +2075,27 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 		return false;
 	}
 
+	// Set it through its handle
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view in the geometry shader stage by handle
+//
+// handle - A handle from GetShaderResourceViewHandle()
+// srv - The shader resource view in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
 	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1646,8 +2124,27 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set it through its handle
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the geometry shader stage by handle
+//
+// handle - A handle from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	// Set the sampler state
+	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -1791,8 +2288,8 @@ void SimpleComputeShader::SetShaderAndCBs()
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		// Skip "buffers" that aren't true constant buffers, or that are bound by their owner
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].External)
 			continue;
 
 		// This is a real constant buffer, so set it
@@ -1887,8 +2384,27 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 		return false;
 	}
 
+	// Set it through its handle
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view in the Compute shader stage by handle
+//
+// handle - A handle from GetShaderResourceViewHandle()
+// srv - The shader resource view in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleComputeShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
 	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -1917,8 +2433,27 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	// Set it through its handle
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
+
+// --------------------------------------------------------
+// Sets a sampler state in the Compute shader stage by handle
+//
+// handle - A handle from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool SimpleComputeShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	// Invalid handles (including the -1 for "not found") wrap around past the end
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	// Set the sampler state
+	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
@@ -10,11 +10,22 @@
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
+#include "ConstantBufferRing.h"
+#include "ShaderReflectionCache.h"
+
 #include <unordered_map>
 #include <vector>
 #include <string>
 
 
+// --------------------------------------------------------
+// Handles to variables, SRVs and samplers are just their
+// raw indices, looked up by name once and then used to
+// set data without any string hashing or allocation
+// --------------------------------------------------------
+typedef int SimpleShaderHandle;
+const SimpleShaderHandle SIMPLESHADER_INVALID_HANDLE = -1;
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -24,6 +35,7 @@ struct SimpleShaderVariable
 	unsigned int ByteOffset;
 	unsigned int Size;
 	unsigned int ConstantBufferIndex;
+	unsigned int Index; // The raw index of the variable (its handle)
 };
 
 // --------------------------------------------------------
@@ -39,6 +51,14 @@ struct SimpleConstantBuffer
 	unsigned int BindIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
+	bool External = false; // Uploaded and bound by its owner, not the shader
+	bool Dirty = true; // Local data changed since the last upload
+
+	// Set when the buffer's data is sub-allocated from a shared ring instead of using ConstantBuffer
+	ConstantBufferRing* Ring = 0;
+	unsigned int RingGeneration = 0;
+	UINT RingFirstConstant = 0;
+	UINT RingNumConstants = 0;
 	std::vector<SimpleShaderVariable> Variables;
 };
 
@@ -77,6 +97,14 @@ public:
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(std::string bufferName, ID3D11Buffer* target);
+
+	// Constant buffers managed outside the shader
+	bool SetBufferExternal(std::string bufferName, bool external = true);
+	Microsoft::WRL::ComPtr<ID3D11Buffer> CreateCompatibleBuffer(std::string bufferName);
+
+	// Constant buffers sub-allocated from a ring each time they change (vertex and pixel shaders only)
+	bool SetBufferRing(std::string bufferName, ConstantBufferRing* ring);
 
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
@@ -92,9 +120,26 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Resolving handles (SIMPLESHADER_INVALID_HANDLE if not found)
+	SimpleShaderHandle GetVariableHandle(std::string name);
+	SimpleShaderHandle GetShaderResourceViewHandle(std::string name);
+	SimpleShaderHandle GetSamplerHandle(std::string name);
+
+	// Sets shader data by handle
+	bool SetData(SimpleShaderHandle handle, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderHandle handle, int data);
+	bool SetFloat(SimpleShaderHandle handle, float data);
+	bool SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
+	virtual bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState) = 0;
 
 	// Simple resource checking
 	bool HasVariable(std::string name);
@@ -120,11 +165,21 @@ public:
 
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> GetDeviceContext() { return deviceContext; }
 
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Upload tracking (bytes copied into constant buffers; reset whenever convenient)
+	static size_t UploadedBytes;
+
+	// Reflection results are cached in a sidecar next to each .cso file
+	static bool UseReflectionCache;
+	static unsigned int ReflectionCacheHits;
+	static unsigned int ReflectionCacheMisses;
+	static double ReflectionMilliseconds; // Time spent getting reflection data, from either source
+
 protected:
 
 	bool shaderValid;
@@ -137,6 +192,7 @@ protected:
 
 	// Maps for variables and buffers
 	SimpleConstantBuffer* constantBuffers; // For index-based lookup
+	std::vector<SimpleShaderVariable> variables; // For handle-based lookup
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
@@ -144,15 +200,24 @@ protected:
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
-	// Initialization method
+	// Reflection results the tables above are built from
+	ShaderReflectionData reflection;
+
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderBlob(Microsoft::WRL::ComPtr<ID3DBlob> blob, std::wstring sidecarFile = L"");
+	bool LoadReflection(std::wstring sidecarFile);
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void BindRingBuffer(SimpleConstantBuffer* cb) {}
 
 	virtual void CleanUp();
 
+	// Uploads a constant buffer's local data if it needs it
+	void UploadBuffer(SimpleConstantBuffer* cb);
+
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
@@ -183,6 +248,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -190,6 +257,7 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindRingBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -201,16 +269,20 @@ class SimplePixelShader : public ISimpleShader
 {
 public:
 	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR shaderFile);
+	SimplePixelShader(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	~SimplePixelShader();
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetDirectXShader() { return shader; }
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	void BindRingBuffer(SimpleConstantBuffer* cb);
 	void CleanUp();
 };
 
@@ -226,6 +298,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
@@ -246,6 +320,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
@@ -266,6 +342,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -307,6 +385,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
@@ -1,4 +1,6 @@
 #include "Sky.h"
+#include "StateCache.h"
+#include "PipelineCache.h"
 
 Sky::Sky(
 	std::shared_ptr<Mesh>								_mesh,
@@ -13,16 +15,18 @@ Sky::Sky(
 	sampler = _sampler;
 	vertexShader = _vertexShader;
 	pixelShader = _pixelShader;
+	textureHandle = pixelShader->GetShaderResourceViewHandle("SkyTexture");
+	samplerHandle = pixelShader->GetSamplerHandle("Sampler");
 
 	D3D11_RASTERIZER_DESC rDesc = {};
 	rDesc.FillMode = D3D11_FILL_SOLID;
 	rDesc.CullMode = D3D11_CULL_FRONT;
-	_device->CreateRasterizerState(&rDesc, rasterizerState.GetAddressOf());
+	rasterizerState = PipelineCache::GetInstance().GetRasterizerState(rDesc);
 
 	D3D11_DEPTH_STENCIL_DESC dDesc = {};
 	dDesc.DepthEnable = true;
 	dDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-	_device->CreateDepthStencilState(&dDesc, depthState.GetAddressOf());
+	depthState = PipelineCache::GetInstance().GetDepthStencilState(dDesc);
 }
 
 Sky::~Sky()
@@ -31,21 +35,20 @@ Sky::~Sky()
 
 void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, std::shared_ptr<Camera> _camera)
 {
-	_context->RSSetState(rasterizerState.Get());
-	_context->OMSetDepthStencilState(depthState.Get(), 0);
+	StateCache& cache = StateCache::GetInstance();
+	cache.RSSetState(rasterizerState.Get());
+	cache.OMSetDepthStencilState(depthState.Get(), 0);
 
-	vertexShader->SetMatrix4x4("view", _camera->GetViewMatrix());
-	vertexShader->SetMatrix4x4("projection", _camera->GetProjectionMatrix());
-	vertexShader->CopyAllBufferData();
+	// View and projection come from the per-frame buffer
 	vertexShader->SetShader();
 
-	pixelShader->SetShaderResourceView("SkyTexture", cubemap.Get());
-	pixelShader->SetSamplerState("Sampler", sampler.Get());
+	pixelShader->SetShaderResourceView(textureHandle, cubemap.Get());
+	pixelShader->SetSamplerState(samplerHandle, sampler.Get());
 	pixelShader->CopyAllBufferData();
 	pixelShader->SetShader();
 
 	mesh->Draw();
 
-	_context->RSSetState(0);
-	_context->OMSetDepthStencilState(0, 0);
+	cache.RSSetState(0);
+	cache.OMSetDepthStencilState(0, 0);
 }
@@ -31,4 +31,6 @@ private:
 	std::shared_ptr<Mesh>									mesh;
 	std::shared_ptr<SimpleVertexShader>						vertexShader;
 	std::shared_ptr<SimplePixelShader>						pixelShader;
+	SimpleShaderHandle										textureHandle;
+	SimpleShaderHandle										samplerHandle;
 };
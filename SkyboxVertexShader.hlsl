@@ -1,10 +1,5 @@
 #include "SkyboxDefines.hlsli"
-
-cbuffer ExternalData : register(b0)
-{
-	matrix view;
-	matrix projection;
-}
+#include "ConstantBuffers.hlsli"
 
 matrix RemoveTranslation(matrix m)
 {
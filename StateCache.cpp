@@ -0,0 +1,4 @@
+#include "StateCache.h"
+
+// Singleton requirement
+StateCache* StateCache::instance;
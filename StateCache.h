@@ -0,0 +1,346 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <cstdint>
+
+// --------------------------------------------------------
+// A single piece of shadowed pipeline state.  Starts out
+// unknown, so the first set after creation (or after an
+// Invalidate) always goes through.
+// --------------------------------------------------------
+template <typename T>
+struct StateShadow
+{
+	T		value;
+	bool	known;
+
+	// Records the new value, returning whether it actually changed
+	bool Set(T _value)
+	{
+		if (known && value == _value) return false;
+		value = _value;
+		known = true;
+		return true;
+	}
+};
+
+// --------------------------------------------------------
+// Shadows the pipeline state bound through a device context
+// and only forwards calls that would actually change it.
+//
+// Templated on the context so it can run against a recording
+// mock instead of a real ID3D11DeviceContext; the mock only
+// needs the same Set methods the cache forwards to. Binding
+// constant buffer ranges needs a second, newer context (11.1),
+// which may be missing; the range binds are then unavailable.
+//
+// Anything bound directly on the context behind the cache's
+// back (or a resource being released and its address reused)
+// leaves the shadow stale, so call Invalidate() after that.
+// --------------------------------------------------------
+template <typename TContext, typename TRangeContext = TContext>
+class StateCacheT
+{
+public:
+	StateCacheT()
+	{
+		context = 0;
+		rangeContext = 0;
+		Invalidate();
+		ResetCounters();
+	}
+
+	// The range context may be null (or the same object as the context)
+	void Initialize(TContext* _context, TRangeContext* _rangeContext)
+	{
+		context = _context;
+		rangeContext = _rangeContext;
+		Invalidate();
+	}
+
+	bool CanBindRanges() { return rangeContext != 0; }
+
+	// Forgets everything that's bound, so the next call of each kind goes through
+	void Invalidate()
+	{
+		inputLayout.known = false;
+		topology.known = false;
+		indexBuffer.known = false;
+		indexFormat.known = false;
+		indexOffset.known = false;
+		rasterState.known = false;
+		blendState.known = false;
+		blendMask.known = false;
+		blendFactorKnown = false;
+		depthState.known = false;
+		stencilRef.known = false;
+		vertexShader.known = false;
+		pixelShader.known = false;
+		for (auto& s : vertexBuffers) s.known = false;
+		for (auto& s : vertexStrides) s.known = false;
+		for (auto& s : vertexOffsets) s.known = false;
+		InvalidateStage(vertexStage);
+		InvalidateStage(pixelStage);
+	}
+
+	void ResetCounters()
+	{
+		issued = 0;
+		filtered = 0;
+	}
+
+	unsigned int GetIssuedCount() { return issued; }
+	unsigned int GetFilteredCount() { return filtered; }
+
+#pragma region Input Assembler
+	void IASetInputLayout(ID3D11InputLayout* _layout)
+	{
+		if (!Track(inputLayout.Set(_layout))) return;
+		context->IASetInputLayout(_layout);
+	}
+
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY _topology)
+	{
+		if (!Track(topology.Set(_topology))) return;
+		context->IASetPrimitiveTopology(_topology);
+	}
+
+	void IASetVertexBuffer(UINT _slot, ID3D11Buffer* _buffer, UINT _stride, UINT _offset)
+	{
+		bool changed = vertexBuffers[_slot].Set(_buffer);
+		changed = vertexStrides[_slot].Set(_stride) || changed;
+		changed = vertexOffsets[_slot].Set(_offset) || changed;
+		if (!Track(changed)) return;
+		context->IASetVertexBuffers(_slot, 1, &_buffer, &_stride, &_offset);
+	}
+
+	void IASetIndexBuffer(ID3D11Buffer* _buffer, DXGI_FORMAT _format, UINT _offset)
+	{
+		bool changed = indexBuffer.Set(_buffer);
+		changed = indexFormat.Set(_format) || changed;
+		changed = indexOffset.Set(_offset) || changed;
+		if (!Track(changed)) return;
+		context->IASetIndexBuffer(_buffer, _format, _offset);
+	}
+#pragma endregion
+
+#pragma region Shader Stages
+	void VSSetShader(ID3D11VertexShader* _shader)
+	{
+		if (!Track(vertexShader.Set(_shader))) return;
+		context->VSSetShader(_shader, 0, 0);
+	}
+
+	void PSSetShader(ID3D11PixelShader* _shader)
+	{
+		if (!Track(pixelShader.Set(_shader))) return;
+		context->PSSetShader(_shader, 0, 0);
+	}
+
+	void VSSetConstantBuffer(UINT _slot, ID3D11Buffer* _buffer)
+	{
+		if (!Track(SetConstantBuffer(vertexStage, _slot, _buffer, WHOLE_BUFFER))) return;
+		context->VSSetConstantBuffers(_slot, 1, &_buffer);
+	}
+
+	void PSSetConstantBuffer(UINT _slot, ID3D11Buffer* _buffer)
+	{
+		if (!Track(SetConstantBuffer(pixelStage, _slot, _buffer, WHOLE_BUFFER))) return;
+		context->PSSetConstantBuffers(_slot, 1, &_buffer);
+	}
+
+	// Binds part of a buffer, in 16-byte constants (only when CanBindRanges)
+	void VSSetConstantBufferRange(UINT _slot, ID3D11Buffer* _buffer, UINT _firstConstant, UINT _numConstants)
+	{
+		if (!Track(SetConstantBuffer(vertexStage, _slot, _buffer, ((uint64_t)_firstConstant << 32) | _numConstants))) return;
+		rangeContext->VSSetConstantBuffers1(_slot, 1, &_buffer, &_firstConstant, &_numConstants);
+	}
+
+	void PSSetConstantBufferRange(UINT _slot, ID3D11Buffer* _buffer, UINT _firstConstant, UINT _numConstants)
+	{
+		if (!Track(SetConstantBuffer(pixelStage, _slot, _buffer, ((uint64_t)_firstConstant << 32) | _numConstants))) return;
+		rangeContext->PSSetConstantBuffers1(_slot, 1, &_buffer, &_firstConstant, &_numConstants);
+	}
+
+	void VSSetShaderResource(UINT _slot, ID3D11ShaderResourceView* _srv)
+	{
+		if (!Track(vertexStage.resources[_slot].Set(_srv))) return;
+		context->VSSetShaderResources(_slot, 1, &_srv);
+	}
+
+	void PSSetShaderResource(UINT _slot, ID3D11ShaderResourceView* _srv)
+	{
+		if (!Track(pixelStage.resources[_slot].Set(_srv))) return;
+		context->PSSetShaderResources(_slot, 1, &_srv);
+	}
+
+	// Binds a run of slots, issuing only the span between the first and last slot that change
+	void PSSetShaderResources(UINT _startSlot, UINT _count, ID3D11ShaderResourceView* const* _srvs)
+	{
+		int first = -1;
+		int last = -1;
+		for (UINT i = 0; i < _count; i++)
+		{
+			if (!pixelStage.resources[_startSlot + i].Set(_srvs[i])) continue;
+			if (first < 0) first = i;
+			last = i;
+		}
+		if (!Track(first >= 0)) return;
+		context->PSSetShaderResources(_startSlot + first, last - first + 1, _srvs + first);
+	}
+
+	void VSSetSampler(UINT _slot, ID3D11SamplerState* _sampler)
+	{
+		if (!Track(vertexStage.samplers[_slot].Set(_sampler))) return;
+		context->VSSetSamplers(_slot, 1, &_sampler);
+	}
+
+	void PSSetSampler(UINT _slot, ID3D11SamplerState* _sampler)
+	{
+		if (!Track(pixelStage.samplers[_slot].Set(_sampler))) return;
+		context->PSSetSamplers(_slot, 1, &_sampler);
+	}
+
+	void PSSetSamplers(UINT _startSlot, UINT _count, ID3D11SamplerState* const* _samplers)
+	{
+		int first = -1;
+		int last = -1;
+		for (UINT i = 0; i < _count; i++)
+		{
+			if (!pixelStage.samplers[_startSlot + i].Set(_samplers[i])) continue;
+			if (first < 0) first = i;
+			last = i;
+		}
+		if (!Track(first >= 0)) return;
+		context->PSSetSamplers(_startSlot + first, last - first + 1, _samplers + first);
+	}
+#pragma endregion
+
+#pragma region Rasterizer & Output Merger
+	void RSSetState(ID3D11RasterizerState* _state)
+	{
+		if (!Track(rasterState.Set(_state))) return;
+		context->RSSetState(_state);
+	}
+
+	void OMSetBlendState(ID3D11BlendState* _state, const FLOAT* _blendFactor, UINT _sampleMask)
+	{
+		// A null factor means the default of all ones
+		FLOAT factor[4] = { 1, 1, 1, 1 };
+		if (_blendFactor != 0)
+		{
+			for (int i = 0; i < 4; i++) factor[i] = _blendFactor[i];
+		}
+
+		bool changed = blendState.Set(_state);
+		changed = blendMask.Set(_sampleMask) || changed;
+		if (!blendFactorKnown || factor[0] != blendFactor[0] || factor[1] != blendFactor[1] || factor[2] != blendFactor[2] || factor[3] != blendFactor[3])
+		{
+			for (int i = 0; i < 4; i++) blendFactor[i] = factor[i];
+			blendFactorKnown = true;
+			changed = true;
+		}
+		if (!Track(changed)) return;
+		context->OMSetBlendState(_state, factor, _sampleMask);
+	}
+
+	void OMSetDepthStencilState(ID3D11DepthStencilState* _state, UINT _stencilRef)
+	{
+		bool changed = depthState.Set(_state);
+		changed = stencilRef.Set(_stencilRef) || changed;
+		if (!Track(changed)) return;
+		context->OMSetDepthStencilState(_state, _stencilRef);
+	}
+#pragma endregion
+
+private:
+	struct StageState
+	{
+		StateShadow<ID3D11Buffer*>					constantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		StateShadow<uint64_t>						constantBufferRanges[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		StateShadow<ID3D11ShaderResourceView*>		resources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		StateShadow<ID3D11SamplerState*>			samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	};
+
+	void InvalidateStage(StageState& _stage)
+	{
+		for (auto& s : _stage.constantBuffers) s.known = false;
+		for (auto& s : _stage.constantBufferRanges) s.known = false;
+		for (auto& s : _stage.resources) s.known = false;
+		for (auto& s : _stage.samplers) s.known = false;
+	}
+
+	// A constant buffer binding is the buffer plus the range of it that's visible
+	static const uint64_t WHOLE_BUFFER = UINT64_MAX;
+	bool SetConstantBuffer(StageState& _stage, UINT _slot, ID3D11Buffer* _buffer, uint64_t _range)
+	{
+		bool changed = _stage.constantBuffers[_slot].Set(_buffer);
+		changed = _stage.constantBufferRanges[_slot].Set(_range) || changed;
+		return changed;
+	}
+
+	// Counts the call one way or the other, passing through whether it should be issued
+	bool Track(bool _changed)
+	{
+		if (_changed) issued++;
+		else filtered++;
+		return _changed;
+	}
+
+	TContext*										context;
+	TRangeContext*									rangeContext;
+
+	StateShadow<ID3D11InputLayout*>					inputLayout;
+	StateShadow<D3D11_PRIMITIVE_TOPOLOGY>			topology;
+	StateShadow<ID3D11Buffer*>						vertexBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	StateShadow<UINT>								vertexStrides[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	StateShadow<UINT>								vertexOffsets[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	StateShadow<ID3D11Buffer*>						indexBuffer;
+	StateShadow<DXGI_FORMAT>						indexFormat;
+	StateShadow<UINT>								indexOffset;
+
+	StateShadow<ID3D11VertexShader*>				vertexShader;
+	StateShadow<ID3D11PixelShader*>					pixelShader;
+	StageState										vertexStage;
+	StageState										pixelStage;
+
+	StateShadow<ID3D11RasterizerState*>				rasterState;
+	StateShadow<ID3D11BlendState*>					blendState;
+	StateShadow<UINT>								blendMask;
+	FLOAT											blendFactor[4];
+	bool											blendFactorKnown;
+	StateShadow<ID3D11DepthStencilState*>			depthState;
+	StateShadow<UINT>								stencilRef;
+
+	unsigned int									issued;
+	unsigned int									filtered;
+};
+
+// --------------------------------------------------------
+// The state cache for the game's immediate context (plus
+// its 11.1 interface, for binding constant buffer ranges)
+// --------------------------------------------------------
+class StateCache : public StateCacheT<ID3D11DeviceContext, ID3D11DeviceContext1>
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static StateCache& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new StateCache();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	StateCache(StateCache const&) = delete;
+	void operator=(StateCache const&) = delete;
+
+private:
+	static StateCache* instance;
+	StateCache() {};
+#pragma endregion
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdio>
+
+// --------------------------------------------------------
+// The little the headless tests need: CHECK prints where a
+// condition failed and counts it, and CheckResult is what
+// main returns (nonzero when anything failed)
+//
+// The tests aren't part of the game's project; each one is
+// a small program built on its own (see its header comment).
+// --------------------------------------------------------
+static int checkFailures = 0;
+
+#define CHECK(_condition) \
+	do \
+	{ \
+		if (!(_condition)) \
+		{ \
+			checkFailures++; \
+			printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #_condition); \
+		} \
+	} while (0)
+
+static int CheckResult(const char* _name)
+{
+	if (checkFailures == 0)
+		printf("%s: passed\n", _name);
+	else
+		printf("%s: %d checks failed\n", _name, checkFailures);
+	return checkFailures == 0 ? 0 : 1;
+}
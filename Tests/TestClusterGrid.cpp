@@ -0,0 +1,142 @@
+// --------------------------------------------------------
+// Tests ClusterGrid's binning against AssignBruteForce, which
+// tests every light against every cluster: the ranges and
+// light indices have to match exactly, for any light count
+// and any number of threads, and across repeated calls that
+// reuse the grid's pool
+//
+// Only DirectXMath's types are used, so nothing needs a
+// device. Build it on its own, e.g.
+//   cl /EHsc /I.. TestClusterGrid.cpp ..\ClusterGrid.cpp
+// --------------------------------------------------------
+#include "../ClusterGrid.h"
+#include "Check.h"
+
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+// A left-handed perspective projection, as Camera makes
+static XMFLOAT4X4 Projection(float _fov, float _aspect, float _nearClip, float _farClip)
+{
+	XMFLOAT4X4 projection = {};
+	float height = 1.0f / tanf(_fov / 2);
+	projection._11 = height / _aspect;
+	projection._22 = height;
+	projection._33 = _farClip / (_farClip - _nearClip);
+	projection._34 = 1;
+	projection._43 = -_nearClip * _farClip / (_farClip - _nearClip);
+	return projection;
+}
+
+// The view from a camera at a position, turned about y
+static XMFLOAT4X4 View(float _yaw, XMFLOAT3 _position)
+{
+	XMFLOAT4X4 view = {};
+	float c = cosf(_yaw);
+	float s = sinf(_yaw);
+	view._11 = c;
+	view._13 = s;
+	view._22 = 1;
+	view._31 = -s;
+	view._33 = c;
+	view._44 = 1;
+	view._41 = -(_position.x * view._11 + _position.y * view._21 + _position.z * view._31);
+	view._42 = -(_position.x * view._12 + _position.y * view._22 + _position.z * view._32);
+	view._43 = -(_position.x * view._13 + _position.y * view._23 + _position.z * view._33);
+	return view;
+}
+
+// A directional light (which binning skips) and point lights scattered around the camera
+static std::vector<Light> MakeLights(unsigned int _count, unsigned int _seed)
+{
+	std::mt19937 random(_seed);
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::vector<Light> lights;
+	lights.push_back(Light::Directional(XMFLOAT3(1, 0, 0), XMFLOAT3(1, 1, 1), 1));
+	for (unsigned int i = 0; i < _count; i++)
+	{
+		XMFLOAT3 position(unit(random) * 400 - 200, unit(random) * 60 - 10, unit(random) * 400 - 200);
+		lights.push_back(Light::Point(position, XMFLOAT3(1, 1, 1), 1, 0.5f + unit(random) * 15));
+	}
+	return lights;
+}
+
+static bool MatchesBruteForce(ClusterGrid& _grid, const XMFLOAT4X4& _view, const std::vector<Light>& _lights, unsigned int _threads)
+{
+	_grid.AssignBruteForce(_view, _lights);
+	std::vector<ClusterRange> expectedRanges = _grid.GetRanges();
+	std::vector<unsigned int> expectedIndices = _grid.GetLightIndices();
+	unsigned int expectedVisible = _grid.GetStats().visibleLights;
+
+	_grid.Assign(_view, _lights, _threads);
+	const std::vector<ClusterRange>& ranges = _grid.GetRanges();
+	if (ranges.size() != expectedRanges.size()) return false;
+	for (size_t c = 0; c < ranges.size(); c++)
+	{
+		if (ranges[c].offset != expectedRanges[c].offset || ranges[c].count != expectedRanges[c].count) return false;
+	}
+	return _grid.GetLightIndices() == expectedIndices && _grid.GetStats().visibleLights == expectedVisible;
+}
+
+static void TestAgainstBruteForce()
+{
+	ClusterGrid grid;
+	grid.SetProjection(Projection(1.0472f, 16.0f / 9.0f, 0.01f, 1000.0f), 0.01f, 1000.0f);
+	XMFLOAT4X4 view = View(0.7f, XMFLOAT3(3, 5, -20));
+
+	unsigned int counts[] = { 0, 1, 100, 1000, 5000 };
+	unsigned int threads[] = { 1, 3, 8, 2 };
+	for (unsigned int count : counts)
+	{
+		std::vector<Light> lights = MakeLights(count, count + 7);
+		for (unsigned int t : threads)
+		{
+			CHECK(MatchesBruteForce(grid, view, lights, t));
+		}
+	}
+
+	// The pool grows to the most threads asked for, and fewer still uses only that many
+	std::vector<Light> lights = MakeLights(5000, 11);
+	grid.Assign(view, lights, 8);
+	CHECK(grid.GetStats().threads == 8);
+	grid.Assign(view, lights, 2);
+	CHECK(grid.GetStats().threads == 2);
+}
+
+static void TestEdgeCases()
+{
+	ClusterGrid grid;
+	grid.SetProjection(Projection(1.0472f, 16.0f / 9.0f, 0.01f, 1000.0f), 0.01f, 1000.0f);
+	XMFLOAT4X4 view = View(0.7f, XMFLOAT3(3, 5, -20));
+
+	// A tiny light at the camera, one reaching every cluster, and one behind the camera
+	std::vector<Light> lights;
+	lights.push_back(Light::Point(XMFLOAT3(3, 5, -20), XMFLOAT3(1, 1, 1), 1, 0.005f));
+	lights.push_back(Light::Point(XMFLOAT3(3, 5, -20), XMFLOAT3(1, 1, 1), 1, 5000));
+	lights.push_back(Light::Point(XMFLOAT3(3, 5, -40), XMFLOAT3(1, 1, 1), 1, 1));
+	CHECK(MatchesBruteForce(grid, view, lights, 4));
+
+	// The light reaching everything is in every cluster, and nothing's in none
+	grid.Assign(view, lights, 1);
+	bool everywhere = true;
+	for (auto& range : grid.GetRanges())
+	{
+		if (range.count == 0) everywhere = false;
+	}
+	CHECK(everywhere);
+
+	// Only directional lights: nothing to bin
+	std::vector<Light> directional = MakeLights(0, 1);
+	grid.Assign(view, directional, 4);
+	CHECK(grid.GetLightIndices().empty());
+	CHECK(grid.GetStats().lights == 0);
+}
+
+int main()
+{
+	TestAgainstBruteForce();
+	TestEdgeCases();
+	return CheckResult("ClusterGrid");
+}
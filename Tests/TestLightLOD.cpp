@@ -0,0 +1,221 @@
+// --------------------------------------------------------
+// Tests the light LOD: the SSE projection against a plain
+// double-precision one, SH irradiance against the clamped
+// cosine it stands in for, and MeasureLightLODError on a
+// scene of a thousand point lights, where the error has to
+// stay under a bound for each K and the SH term has to do
+// better than leaving the lights out
+//
+// Only DirectXMath is used, so nothing needs a device. Build
+// it on its own, e.g.
+//   cl /EHsc /I.. TestLightLOD.cpp ..\LightLOD.cpp ..\LightAssignment.cpp
+// --------------------------------------------------------
+#include "../LightLOD.h"
+#include "../LightAssignment.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+// Relative RMS error allowed with K lights exact and the rest as SH, averaged over the scene
+struct ErrorBound
+{
+	unsigned int	exactLights;
+	float			maxError;
+};
+
+static const ErrorBound errorBounds[] = {
+	{ 0, 0.30f },
+	{ 1, 0.25f },
+	{ 2, 0.15f },
+	{ 4, 0.06f },
+	{ MAX_OBJECT_LIGHTS, 0.01f },
+};
+static const unsigned int errorBoundCount = sizeof(errorBounds) / sizeof(errorBounds[0]);
+
+// One projection the slow way, for checking ProjectRemainingLights against
+static SHIrradiance ProjectReference(const std::vector<Light>& _lights, const LightLODObject& _object)
+{
+	double sh[SH_COEFFICIENTS][3] = {};
+	for (unsigned int i = 0; i < _lights.size(); i++)
+	{
+		if (std::find(_object.exactIndices, _object.exactIndices + _object.exactCount, i) != _object.exactIndices + _object.exactCount) continue;
+
+		const Light& light = _lights[i];
+		double weight, x, y, z;
+		if (light.Type == LIGHT_TYPE_DIRECTIONAL)
+		{
+			double length = sqrt(light.Direction.x * light.Direction.x + light.Direction.y * light.Direction.y + light.Direction.z * light.Direction.z);
+			weight = light.Intensity;
+			x = light.Direction.x / length;
+			y = light.Direction.y / length;
+			z = light.Direction.z / length;
+		}
+		else
+		{
+			double dx = light.Position.x - _object.center.x;
+			double dy = light.Position.y - _object.center.y;
+			double dz = light.Position.z - _object.center.z;
+			double distance = sqrt(dx * dx + dy * dy + dz * dz);
+			if (distance >= light.Range) continue;
+			double falloff = 1 - distance * distance / (light.Range * light.Range);
+			weight = light.Intensity * falloff * falloff;
+			distance = std::max(distance, 1e-6);
+			x = dx / distance;
+			y = dy / distance;
+			z = dz / distance;
+		}
+
+		// L2 basis times each band of the clamped cosine
+		double basis[SH_COEFFICIENTS] = {
+			0.282095 * 3.141593,
+			0.488603 * 2.094395 * y, 0.488603 * 2.094395 * z, 0.488603 * 2.094395 * x,
+			1.092548 * 0.785398 * x * y, 1.092548 * 0.785398 * y * z, 0.315392 * 0.785398 * (3 * z * z - 1),
+			1.092548 * 0.785398 * x * z, 0.546274 * 0.785398 * (x * x - y * y),
+		};
+		for (int c = 0; c < SH_COEFFICIENTS; c++)
+		{
+			sh[c][0] += basis[c] * weight * light.Color.x;
+			sh[c][1] += basis[c] * weight * light.Color.y;
+			sh[c][2] += basis[c] * weight * light.Color.z;
+		}
+	}
+
+	SHIrradiance irradiance;
+	for (int c = 0; c < SH_COEFFICIENTS; c++)
+	{
+		irradiance.coefficients[c] = XMFLOAT4((float)sh[c][0], (float)sh[c][1], (float)sh[c][2], 0);
+	}
+	return irradiance;
+}
+
+// A sun and a thousand colored point lights over a 60 x 20 x 60 area
+static std::vector<Light> MakeScene(std::mt19937& _random)
+{
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::vector<Light> lights;
+	lights.push_back(Light::Directional(XMFLOAT3(0.3f, -1, 0.2f), XMFLOAT3(1, 1, 1), 1));
+	for (int i = 0; i < 1000; i++)
+	{
+		XMFLOAT3 position(unit(_random) * 60 - 30, unit(_random) * 20 - 10, unit(_random) * 60 - 30);
+		XMFLOAT3 color(unit(_random), unit(_random), unit(_random));
+		lights.push_back(Light::Point(position, color, 0.5f + unit(_random), 60 * (0.02f + 0.06f * unit(_random))));
+	}
+	return lights;
+}
+
+static void TestProjection()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::vector<Light> lights = MakeScene(random);
+
+	// An odd count, so the last group of four is short, and a spread of exact list lengths
+	const unsigned int count = 43;
+	std::vector<LightLODObject> objects(count);
+	std::vector<SHIrradiance> irradiance(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		objects[i].center = XMFLOAT3(unit(random) * 60 - 30, unit(random) * 20 - 10, unit(random) * 60 - 30);
+		objects[i].exactCount = SelectObjectLights(lights, objects[i].center, 1.5f, objects[i].exactIndices, i % 5 == 0 ? MAX_OBJECT_LIGHTS : i % 4);
+	}
+	ProjectRemainingLights(lights, objects.data(), count, irradiance.data());
+
+	float worst = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		SHIrradiance reference = ProjectReference(lights, objects[i]);
+		float scale = fabsf(reference.coefficients[0].x) + 1e-3f;
+		for (int c = 0; c < SH_COEFFICIENTS; c++)
+		{
+			worst = std::max(worst, fabsf(irradiance[i].coefficients[c].x - reference.coefficients[c].x) / scale);
+			worst = std::max(worst, fabsf(irradiance[i].coefficients[c].y - reference.coefficients[c].y) / scale);
+			worst = std::max(worst, fabsf(irradiance[i].coefficients[c].z - reference.coefficients[c].z) / scale);
+		}
+	}
+	CHECK(worst < 1e-4f);
+}
+
+static void TestSingleLight()
+{
+	// One directional light: the SH should come close to the clamped cosine (L2 can't do better than about 0.1 of the peak)
+	std::vector<Light> lights = { Light::Directional(XMFLOAT3(0, 0, 1), XMFLOAT3(1, 1, 1), 1) };
+	LightLODObject object = {};
+	SHIrradiance irradiance;
+	ProjectRemainingLights(lights, &object, 1, &irradiance);
+
+	float worst = 0;
+	for (int i = 0; i < 2000; i++)
+	{
+		float z = 1 - 2 * (i + 0.5f) / 2000;
+		float ring = sqrtf(1 - z * z);
+		float angle = 2.399963f * i;
+		XMFLOAT3 normal(cosf(angle) * ring, sinf(angle) * ring, z);
+		worst = std::max(worst, fabsf(EvaluateSHIrradiance(irradiance, normal).x - std::max(0.0f, z)));
+	}
+	CHECK(worst < 0.1f);
+
+	// Exact lights are left out entirely
+	object.exactCount = 1;
+	object.exactIndices[0] = 0;
+	ProjectRemainingLights(lights, &object, 1, &irradiance);
+	CHECK(irradiance.coefficients[0].x == 0);
+}
+
+static void TestErrorBounds()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::vector<Light> lights = MakeScene(random);
+
+	LightLODError totals[errorBoundCount] = {};
+	const unsigned int count = 43;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		LightLODError errors[errorBoundCount] = {};
+		for (unsigned int k = 0; k < errorBoundCount; k++)
+		{
+			errors[k].exactLights = errorBounds[k].exactLights;
+		}
+		XMFLOAT3 center(unit(random) * 60 - 30, unit(random) * 20 - 10, unit(random) * 60 - 30);
+		MeasureLightLODError(lights, center, 0.5f + 2 * unit(random), XMFLOAT3(0, 5, -15), errors, errorBoundCount);
+		for (unsigned int k = 0; k < errorBoundCount; k++)
+		{
+			totals[k].standard += errors[k].standard / count;
+			totals[k].standardDropped += errors[k].standardDropped / count;
+			totals[k].pbr += errors[k].pbr / count;
+			totals[k].pbrDropped += errors[k].pbrDropped / count;
+		}
+	}
+
+	for (unsigned int k = 0; k < errorBoundCount; k++)
+	{
+		printf("  K = %u: standard %5.1f%% (dropped %5.1f%%), PBR %5.1f%% (dropped %5.1f%%)\n", errorBounds[k].exactLights,
+			100 * totals[k].standard, 100 * totals[k].standardDropped, 100 * totals[k].pbr, 100 * totals[k].pbrDropped);
+
+		CHECK(totals[k].standard < errorBounds[k].maxError);
+		CHECK(totals[k].pbr < errorBounds[k].maxError);
+
+		// The SH never does worse than leaving the lights out
+		CHECK(totals[k].standard <= totals[k].standardDropped + 1e-4f);
+		CHECK(totals[k].pbr <= totals[k].pbrDropped + 1e-4f);
+
+		// More lights exact, less error
+		if (k > 0)
+		{
+			CHECK(totals[k].standard <= totals[k - 1].standard);
+			CHECK(totals[k].pbr <= totals[k - 1].pbr);
+		}
+	}
+}
+
+int main()
+{
+	TestProjection();
+	TestSingleLight();
+	TestErrorBounds();
+	return CheckResult("LightLOD");
+}
@@ -0,0 +1,120 @@
+// --------------------------------------------------------
+// Tests PermutationCacheT's keys, masking, #defines and
+// caching, with a compile callback that records what it's
+// asked for instead of compiling anything
+//
+// Build it on its own, e.g.
+//   g++ -std=c++14 -I.. TestPermutationCache.cpp -o testpermutationcache
+// --------------------------------------------------------
+#include "../PermutationCache.h"
+#include "Check.h"
+
+// Stands in for a compiled shader: what it was built from
+struct FakeShader
+{
+	std::wstring	source;
+	ShaderDefines	defines;
+};
+
+static std::string FindDefine(const ShaderDefines& _defines, const char* _name)
+{
+	for (auto& define : _defines)
+	{
+		if (define.first == _name) return define.second;
+	}
+	return "";
+}
+
+static void TestKeys()
+{
+	PermutationCacheT<FakeShader> cache([](const std::wstring&, const ShaderDefines&) { return std::shared_ptr<FakeShader>(); });
+	unsigned int standard = cache.RegisterSource(L"SimplePixelShader.hlsl", PERMUTATION_ALBEDO | PERMUTATION_NORMAL | PERMUTATION_REFLECTION);
+	unsigned int pbr = cache.RegisterSource(L"SimplePixelPBR.hlsl", PERMUTATION_ORM);
+	CHECK(standard != pbr);
+
+	// Features a source has no switch for are dropped from its key
+	CHECK(cache.MakeKey(standard, PERMUTATION_ALBEDO | PERMUTATION_RAMPDIFFUSE) == cache.MakeKey(standard, PERMUTATION_ALBEDO));
+	CHECK(cache.MakeKey(standard, PERMUTATION_ALBEDO) != cache.MakeKey(standard, PERMUTATION_ALBEDO | PERMUTATION_NORMAL));
+	CHECK(cache.MakeKey(pbr, PERMUTATION_ALBEDO | PERMUTATION_NORMAL) == cache.MakeKey(pbr, 0));
+	CHECK(cache.MakeKey(pbr, 0xffffffff) == cache.MakeKey(pbr, PERMUTATION_ORM));
+
+	// The same features on different sources never share a key
+	CHECK(cache.MakeKey(standard, 0) != cache.MakeKey(pbr, 0));
+	CHECK(cache.MakeKey(standard, PERMUTATION_ORM) != cache.MakeKey(pbr, PERMUTATION_ORM));
+}
+
+static void TestDefines()
+{
+	PermutationCacheT<FakeShader> cache([](const std::wstring&, const ShaderDefines&) { return std::shared_ptr<FakeShader>(); });
+	unsigned int toon = cache.RegisterSource(L"ToonShader.hlsl", PERMUTATION_ALBEDO | PERMUTATION_RAMPDIFFUSE | PERMUTATION_RAMPSPECULAR);
+
+	// PERMUTATION plus every supported feature, each 0 or 1, and nothing the source doesn't support
+	ShaderDefines defines = cache.MakeDefines(toon, PERMUTATION_ALBEDO | PERMUTATION_RAMPSPECULAR | PERMUTATION_NORMAL);
+	CHECK(defines.size() == 4);
+	CHECK(FindDefine(defines, "PERMUTATION") == "1");
+	CHECK(FindDefine(defines, "HAS_ALBEDO_MAP") == "1");
+	CHECK(FindDefine(defines, "HAS_RAMP_DIFFUSE") == "0");
+	CHECK(FindDefine(defines, "HAS_RAMP_SPECULAR") == "1");
+	CHECK(FindDefine(defines, "HAS_NORMAL_MAP") == "");
+
+	// Every feature bit has its own define
+	for (int i = 0; i < PERMUTATION_COUNT; i++)
+	{
+		for (int j = i + 1; j < PERMUTATION_COUNT; j++)
+		{
+			CHECK(std::string(permutationDefines[i]) != permutationDefines[j]);
+		}
+	}
+}
+
+static void TestCaching()
+{
+	int compiles = 0;
+	PermutationCacheT<FakeShader> cache([&compiles](const std::wstring& _source, const ShaderDefines& _defines)
+		{
+			compiles++;
+
+			// Pretend variants with a reflection map don't compile
+			if (FindDefine(_defines, "HAS_REFLECTION_MAP") == "1") return std::shared_ptr<FakeShader>();
+			std::shared_ptr<FakeShader> shader = std::make_shared<FakeShader>();
+			shader->source = _source;
+			shader->defines = _defines;
+			return shader;
+		});
+	unsigned int standard = cache.RegisterSource(L"SimplePixelShader.hlsl", PERMUTATION_ALBEDO | PERMUTATION_NORMAL | PERMUTATION_REFLECTION);
+	unsigned int toon = cache.RegisterSource(L"ToonShader.hlsl", PERMUTATION_ALBEDO | PERMUTATION_RAMPDIFFUSE);
+
+	// Feature sets that mask to the same key share one variant
+	std::shared_ptr<FakeShader> first = cache.Get(standard, PERMUTATION_ALBEDO);
+	std::shared_ptr<FakeShader> second = cache.Get(standard, PERMUTATION_ALBEDO | PERMUTATION_RAMPDIFFUSE);
+	CHECK(first != 0 && first == second);
+	CHECK(compiles == 1);
+	CHECK(first != 0 && first->source == L"SimplePixelShader.hlsl");
+	CHECK(first != 0 && FindDefine(first->defines, "HAS_ALBEDO_MAP") == "1");
+
+	// The callback is given the masked features, not the ones asked for
+	std::shared_ptr<FakeShader> ramp = cache.Get(toon, PERMUTATION_ALBEDO | PERMUTATION_REFLECTION);
+	CHECK(ramp != 0 && FindDefine(ramp->defines, "HAS_REFLECTION_MAP") == "");
+	CHECK(compiles == 2);
+
+	// Failures come back null and aren't retried
+	CHECK(cache.Get(standard, PERMUTATION_REFLECTION) == 0);
+	CHECK(cache.Get(standard, PERMUTATION_REFLECTION) == 0);
+	CHECK(compiles == 3);
+
+	PermutationStats stats = cache.GetStats();
+	CHECK(stats.sources == 2);
+	CHECK(stats.possible == 8 + 4);
+	CHECK(stats.compiled == 2);
+	CHECK(stats.failed == 1);
+	CHECK(stats.lookups == 5);
+	CHECK(stats.hits == 2);
+}
+
+int main()
+{
+	TestKeys();
+	TestDefines();
+	TestCaching();
+	return CheckResult("PermutationCache");
+}
@@ -0,0 +1,106 @@
+// --------------------------------------------------------
+// Tests DedupCache the way PipelineCache uses it: shader
+// files keyed by their normalized path, failed loads left
+// out of the cache, and Trim/GetStats with an in-use test
+//
+// Build it on its own, e.g.
+//   g++ -std=c++14 -I.. TestPipelineCache.cpp ../ResourceRegistry.cpp -o testpipelinecache
+// --------------------------------------------------------
+#include "../DedupCache.h"
+#include "../ResourceRegistry.h"
+#include "Check.h"
+
+#include <memory>
+#include <string>
+
+// Stands in for a loaded shader: the file it was loaded from
+struct FakeShader
+{
+	std::wstring	file;
+};
+
+static bool SharedInUse(const std::shared_ptr<FakeShader>& _value)
+{
+	return _value.use_count() > 1;
+}
+
+// What PipelineCache::GetPixelShader does, with a load that fails for any file named "missing"
+static std::shared_ptr<FakeShader> GetShader(DedupCache<std::string, std::shared_ptr<FakeShader>>& _cache, const std::wstring& _file, int& _loads)
+{
+	return _cache.Get(NormalizeResourcePath(_file), [&]()
+		{
+			_loads++;
+			if (NormalizeResourcePath(_file).find("missing") != std::string::npos)
+				return std::shared_ptr<FakeShader>();
+			std::shared_ptr<FakeShader> shader = std::make_shared<FakeShader>();
+			shader->file = _file;
+			return shader;
+		});
+}
+
+static void TestShaderKeys()
+{
+	DedupCache<std::string, std::shared_ptr<FakeShader>> cache;
+	int loads = 0;
+
+	// Spellings of one file share a shader
+	std::shared_ptr<FakeShader> first = GetShader(cache, L"C:\\Game\\Shaders\\Foo.cso", loads);
+	CHECK(GetShader(cache, L"c:/game/shaders/foo.cso", loads) == first);
+	CHECK(GetShader(cache, L"C:\\Game\\.\\Shaders\\..\\Shaders\\FOO.cso", loads) == first);
+	CHECK(GetShader(cache, L"C:/Game//Shaders/Foo.cso", loads) == first);
+	CHECK(loads == 1);
+
+	// Different files don't
+	CHECK(GetShader(cache, L"C:\\Game\\Shaders\\Bar.cso", loads) != first);
+	CHECK(GetShader(cache, L"C:\\Game\\Foo.cso", loads) != first);
+	CHECK(loads == 3);
+
+	CHECK(NormalizeResourcePath(std::wstring(L"./Foo.cso")) == NormalizeResourcePath(std::string("foo.cso")));
+}
+
+static void TestFailedLoads()
+{
+	DedupCache<std::string, std::shared_ptr<FakeShader>> cache;
+	int loads = 0;
+
+	// A failed load comes back null, and is tried again next time rather than cached
+	CHECK(GetShader(cache, L"Missing.cso", loads) == 0);
+	CHECK(GetShader(cache, L"./missing.cso", loads) == 0);
+	CHECK(loads == 2);
+
+	DedupStats stats = cache.GetStats(SharedInUse);
+	CHECK(stats.live == 0);
+	CHECK(stats.requests == 2);
+	CHECK(stats.created == 0);
+}
+
+static void TestTrim()
+{
+	DedupCache<std::string, std::shared_ptr<FakeShader>> cache;
+	int loads = 0;
+
+	std::shared_ptr<FakeShader> held = GetShader(cache, L"Held.cso", loads);
+	GetShader(cache, L"Dropped.cso", loads);
+
+	DedupStats stats = cache.GetStats(SharedInUse);
+	CHECK(stats.live == 2 && stats.inUse == 1);
+
+	// Only what nothing else holds is dropped, and it's loaded again if asked for
+	CHECK(cache.Trim(SharedInUse) == 1);
+	CHECK(GetShader(cache, L"Held.cso", loads) == held);
+	CHECK(loads == 2);
+	GetShader(cache, L"Dropped.cso", loads);
+	CHECK(loads == 3);
+
+	cache.Clear();
+	CHECK(cache.GetStats(SharedInUse).live == 0);
+	CHECK(held.use_count() == 1);
+}
+
+int main()
+{
+	TestShaderKeys();
+	TestFailedLoads();
+	TestTrim();
+	return CheckResult("PipelineCache");
+}
@@ -0,0 +1,114 @@
+// --------------------------------------------------------
+// Tests RenderKeys' sorts: key order, and that draws with
+// identical keys come out in add order whether the radix
+// sort ran, the insertion sort over last frame's order
+// finished, or it gave up and the radix sort took over
+//
+// Build it on its own, e.g.
+//   g++ -std=c++14 -I.. TestRenderKeys.cpp ../RenderKeys.cpp -o testrenderkeys
+// --------------------------------------------------------
+#include "../RenderKeys.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <random>
+
+// Keys in add order, drawn from only a few values so there are plenty of ties
+static std::vector<RenderKey> MakeKeys(unsigned int _count, unsigned int _values, std::mt19937& _random)
+{
+	std::vector<RenderKey> keys(_count);
+	for (unsigned int i = 0; i < _count; i++)
+	{
+		keys[i].key = RenderKeys::Make(RENDERPASS_OPAQUE, _random() % _values, 0, 0, 0);
+		keys[i].index = i;
+	}
+	return keys;
+}
+
+// What every sort has to agree with
+static std::vector<RenderKey> StableSorted(std::vector<RenderKey> _keys)
+{
+	std::stable_sort(_keys.begin(), _keys.end(), [](const RenderKey& _a, const RenderKey& _b) { return _a.key < _b.key; });
+	return _keys;
+}
+
+static bool SameOrder(const std::vector<RenderKey>& _a, const std::vector<RenderKey>& _b)
+{
+	if (_a.size() != _b.size()) return false;
+	for (size_t i = 0; i < _a.size(); i++)
+	{
+		if (_a[i].index != _b[i].index) return false;
+	}
+	return true;
+}
+
+static std::vector<unsigned int> OrderOf(const std::vector<RenderKey>& _keys)
+{
+	std::vector<unsigned int> order(_keys.size());
+	for (size_t i = 0; i < _keys.size(); i++)
+	{
+		order[i] = _keys[i].index;
+	}
+	return order;
+}
+
+static void TestKeyLayout()
+{
+	// Opaque draws group by state first, transparent ones go back to front
+	CHECK(RenderKeys::Make(RENDERPASS_OPAQUE, 1, 0, 0, 100) < RenderKeys::Make(RENDERPASS_OPAQUE, 2, 0, 0, 0));
+	CHECK(RenderKeys::Make(RENDERPASS_TRANSPARENT, 1, 0, 0, 100) < RenderKeys::Make(RENDERPASS_TRANSPARENT, 0, 0, 0, 0));
+	CHECK(RenderKeys::Make(RENDERPASS_OPAQUE, 1023, 0, 0, 0) < RenderKeys::Make(RENDERPASS_TRANSPARENT, 0, 0, 0, 0));
+	CHECK(RenderKeys::GetPass(RenderKeys::Make(RENDERPASS_TRANSPARENT, 5, 6, 7, 8)) == RENDERPASS_TRANSPARENT);
+
+	CHECK(RenderKeys::QuantizeDepth(-1.0f, 100.0f) == 0);
+	CHECK(RenderKeys::QuantizeDepth(200.0f, 100.0f) == RenderKeys::QuantizeDepth(100.0f, 100.0f));
+	CHECK(RenderKeys::QuantizeDepth(10.0f, 100.0f) < RenderKeys::QuantizeDepth(20.0f, 100.0f));
+}
+
+static void TestRadixSort()
+{
+	std::mt19937 random(37);
+	std::vector<RenderKey> keys = MakeKeys(5000, 16, random);
+	std::vector<RenderKey> scratch;
+	std::vector<RenderKey> expected = StableSorted(keys);
+	RenderKeys::RadixSort(keys, scratch);
+	CHECK(SameOrder(keys, expected));
+}
+
+static void TestCoherentSort()
+{
+	std::mt19937 random(37);
+	std::vector<RenderKey> scratch;
+
+	// Last frame's order puts tied keys the wrong way round; a finished insertion sort still gives add order
+	std::vector<RenderKey> keys = MakeKeys(2000, 16, random);
+	std::vector<RenderKey> expected = StableSorted(keys);
+	std::vector<unsigned int> previousOrder = OrderOf(expected);
+	std::reverse(previousOrder.begin(), previousOrder.end());
+	unsigned int moves = 0;
+	CHECK(RenderKeys::CoherentSort(keys, previousOrder, scratch, 0xffffffff, moves));
+	CHECK(SameOrder(keys, expected));
+
+	// Same again, but the insertion sort gives up part way and the radix sort has to finish
+	keys = MakeKeys(2000, 16, random);
+	expected = StableSorted(keys);
+	previousOrder = OrderOf(expected);
+	std::reverse(previousOrder.begin(), previousOrder.end());
+	CHECK(!RenderKeys::CoherentSort(keys, previousOrder, scratch, 1000, moves));
+	CHECK(SameOrder(keys, expected));
+
+	// Last frame's order already right: nothing moves
+	keys = MakeKeys(2000, 16, random);
+	expected = StableSorted(keys);
+	CHECK(RenderKeys::CoherentSort(keys, OrderOf(expected), scratch, 0, moves));
+	CHECK(moves == 0);
+	CHECK(SameOrder(keys, expected));
+}
+
+int main()
+{
+	TestKeyLayout();
+	TestRadixSort();
+	TestCoherentSort();
+	return CheckResult("RenderKeys");
+}
@@ -0,0 +1,188 @@
+// --------------------------------------------------------
+// Tests ResourceRegistry: path normalization, sharing by
+// path, merging by contents (only once the bytes are
+// confirmed, so a hash collision keeps its own entry), the
+// stats, and releasing; converting wide paths to UTF-8 and
+// back; and the file helpers against the sidecars in Fixtures
+//
+// Build it on its own and run it from this folder, e.g.
+//   g++ -std=c++14 -I.. TestResourceRegistry.cpp ../ResourceRegistry.cpp -o testresourceregistry
+//   ./testresourceregistry Fixtures
+// --------------------------------------------------------
+#include "../ResourceRegistry.h"
+#include "../PathEncoding.h"
+#include "Check.h"
+
+#include <climits>
+
+static std::string fixtureFolder = "Fixtures";
+
+static bool AlwaysSame(unsigned int /*_original*/)
+{
+	return true;
+}
+
+static bool NeverSame(unsigned int /*_original*/)
+{
+	return false;
+}
+
+static void TestNormalize()
+{
+	CHECK(NormalizeResourcePath("Assets\\Textures\\PBR\\Bronze_Albedo.png") == "assets/textures/pbr/bronze_albedo.png");
+	CHECK(NormalizeResourcePath("./Assets//Textures/../Textures/./x.PNG") == "assets/textures/x.png");
+	CHECK(NormalizeResourcePath("../a/b/../../c") == "../c");
+	CHECK(NormalizeResourcePath("../../a") == "../../a");
+	CHECK(NormalizeResourcePath("/abs/./p/") == "/abs/p");
+	CHECK(NormalizeResourcePath("C:\\Dir\\..\\f.png") == "c:/f.png");
+	CHECK(NormalizeResourcePath("") == "");
+	CHECK(NormalizeResourcePath(std::wstring(L"Assets\\Models\\..\\Models\\Cube.OBJ")) == "assets/models/cube.obj");
+
+	// Wide paths that only differ above ASCII stay apart, even where their low bytes match
+	CHECK(NormalizeResourcePath(std::wstring(L"Assets/Caf\u00E9.png")) == "assets/caf\xC3\xA9.png");
+	CHECK(NormalizeResourcePath(std::wstring(L"Assets/Caf\u00E9.png")) != NormalizeResourcePath(std::wstring(L"Assets/Caf\u01E9.png")));
+}
+
+static void TestPathEncoding()
+{
+	// One, two, three and four byte forms
+	CHECK(WidePathToUTF8(L"a") == "a");
+	CHECK(WidePathToUTF8(L"\u00E9") == "\xC3\xA9");
+	CHECK(WidePathToUTF8(L"\u20AC") == "\xE2\x82\xAC");
+	CHECK(WidePathToUTF8(L"\U0001F600") == "\xF0\x9F\x98\x80");
+	CHECK(UTF8PathToWide("\xF0\x9F\x98\x80") == L"\U0001F600");
+
+	// Every code point comes back as it went in, lone surrogates included
+	bool roundTrips = true;
+	for (unsigned long code = 1; code <= 0x10FFFF; code++)
+	{
+		std::wstring wide;
+		if (sizeof(wchar_t) == 2 && code >= 0x10000)
+		{
+			wide += (wchar_t)(0xD800 + ((code - 0x10000) >> 10));
+			wide += (wchar_t)(0xDC00 + ((code - 0x10000) & 0x3FF));
+		}
+		else
+		{
+			wide += (wchar_t)code;
+		}
+		if (UTF8PathToWide(WidePathToUTF8(wide)) != wide) roundTrips = false;
+	}
+	CHECK(roundTrips);
+
+	// Broken UTF-8 reads as U+FFFD a byte at a time, and the rest still comes through
+	CHECK(UTF8PathToWide("a\xFF" "b") == L"a\uFFFDb");
+	CHECK(UTF8PathToWide("\xC0\x80") == L"\uFFFD\uFFFD");
+	CHECK(UTF8PathToWide("\xE0\x80\x80") == L"\uFFFD\uFFFD\uFFFD");
+	CHECK(UTF8PathToWide("\xE2\x82") == L"\uFFFD\uFFFD");
+	CHECK(UTF8PathToWide("\xF4\x90\x80\x80") == L"\uFFFD\uFFFD\uFFFD\uFFFD");
+}
+
+static void TestSharing()
+{
+	ResourceRegistry<int> registry;
+	bool created;
+
+	// However the path is written, it names one entry
+	unsigned int a = registry.Acquire("Assets/A.png", created);
+	CHECK(created);
+	CHECK(registry.Acquire("assets\\a.png", created) == a && !created);
+	CHECK(registry.Resolve(a, 111, 10, AlwaysSame) == a);
+	registry.Set(a, 7, 1000);
+	CHECK(registry.GetPath(a) == "assets/a.png");
+
+	// A second file with the same contents merges in, and its paths name the first from then on
+	unsigned int b = registry.Acquire("Assets/B.png", created);
+	CHECK(created && b != a);
+	CHECK(registry.Acquire("Assets/x/../B.png", created) == b && !created);
+	CHECK(registry.Resolve(b, 111, 10, AlwaysSame) == a);
+	CHECK(!registry.Contains(b));
+	CHECK(registry.Acquire("assets/b.png", created) == a && !created);
+
+	// The same hash with another size isn't even compared
+	unsigned int d = registry.Acquire("Assets/D.png", created);
+	CHECK(registry.Resolve(d, 111, 11, NeverSame) == d);
+	registry.Set(d, 9, 500);
+
+	ResourceRegistryStats stats = registry.GetStats();
+	CHECK(stats.requests == 6 && stats.pathHits == 3 && stats.created == 3);
+	CHECK(stats.contentHits == 1 && stats.collisions == 0);
+	CHECK(stats.live == 2 && stats.references == 6);
+	CHECK(stats.liveBytes == 1500 && stats.savedBytes == 4000);
+
+	// The last release frees it, and after that it's loaded afresh
+	int value = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(!registry.Release(a, value));
+	}
+	CHECK(registry.Release(a, value) && value == 7);
+	CHECK(!registry.Release(a, value));
+	unsigned int again = registry.Acquire("Assets/B.png", created);
+	CHECK(created && again != a);
+	CHECK(registry.Resolve(again, 111, 10, NeverSame) == again);
+	CHECK(registry.Release(d, value) && value == 9);
+	stats = registry.GetStats();
+	CHECK(stats.freed == 2 && stats.live == 1);
+}
+
+static void TestCollision()
+{
+	ResourceRegistry<int> registry;
+	bool created;
+
+	unsigned int a = registry.Acquire("a.png", created);
+	CHECK(registry.Resolve(a, 222, 64, AlwaysSame) == a);
+
+	// Same hash and size, different bytes: asked about the right entry, and kept apart
+	unsigned int asked = UINT_MAX;
+	unsigned int b = registry.Acquire("b.png", created);
+	CHECK(registry.Resolve(b, 222, 64, [&](unsigned int _original) { asked = _original; return false; }) == b);
+	CHECK(asked == a);
+	CHECK(registry.Contains(a) && registry.Contains(b));
+	CHECK(registry.GetStats().collisions == 1 && registry.GetStats().contentHits == 0);
+
+	// Releasing the collision leaves the first one's contents in place to merge with
+	int value;
+	CHECK(registry.Release(b, value));
+	unsigned int c = registry.Acquire("c.png", created);
+	CHECK(registry.Resolve(c, 222, 64, AlwaysSame) == a);
+
+	// Once the first one goes, the next load with those contents takes its place
+	CHECK(!registry.Release(a, value));
+	CHECK(registry.Release(a, value));
+	unsigned int d = registry.Acquire("d.png", created);
+	CHECK(registry.Resolve(d, 222, 64, NeverSame) == d);
+	unsigned int e = registry.Acquire("e.png", created);
+	CHECK(registry.Resolve(e, 222, 64, AlwaysSame) == d);
+}
+
+static void TestFiles()
+{
+	// 64-bit FNV-1a's published values
+	CHECK(HashResourceContent("", 0) == 0xcbf29ce484222325ull);
+	CHECK(HashResourceContent("a", 1) == 0xaf63dc4c8601ec8cull);
+
+	std::string sidecar = fixtureFolder + "/VertexShader.cso.refl";
+	std::vector<unsigned char> data;
+	CHECK(ReadResourceFile(sidecar, data) && !data.empty());
+	CHECK(!ReadResourceFile(fixtureFolder + "/Missing.refl", data));
+
+	CHECK(ResourceFilesMatch(sidecar, sidecar));
+	CHECK(ResourceFilesMatch(sidecar, fixtureFolder + "/./VertexShader.cso.refl"));
+	CHECK(!ResourceFilesMatch(sidecar, fixtureFolder + "/Truncated.refl"));
+	CHECK(!ResourceFilesMatch(sidecar, fixtureFolder + "/BadMagic.refl"));
+	CHECK(!ResourceFilesMatch(sidecar, fixtureFolder + "/Missing.refl"));
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1) fixtureFolder = argv[1];
+
+	TestNormalize();
+	TestPathEncoding();
+	TestSharing();
+	TestCollision();
+	TestFiles();
+	return CheckResult("ResourceRegistry");
+}
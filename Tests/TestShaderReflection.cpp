@@ -0,0 +1,105 @@
+// --------------------------------------------------------
+// Tests the reflection sidecar parser against the sidecars
+// in Fixtures: one written for VertexShader.cso, and broken
+// copies of it the parser has to turn away
+//
+// Build it on its own and run it from this folder, e.g.
+//   g++ -std=c++14 -I.. TestShaderReflection.cpp ../ShaderReflectionData.cpp -o testshaderreflection
+//   ./testshaderreflection Fixtures
+// --------------------------------------------------------
+#include "../ShaderReflectionData.h"
+#include "Check.h"
+
+#include <fstream>
+#include <iterator>
+
+static std::string fixtureFolder = "Fixtures";
+
+// The fixtures stand in for a blob whose code is just the shader's name
+static const uint64_t fixtureHash = HashShaderBlob("VertexShader", 12);
+
+static std::vector<unsigned char> LoadFixture(const char* _name)
+{
+	std::ifstream file(fixtureFolder + "/" + _name, std::ios::binary);
+	CHECK(file.is_open());
+	return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static bool ParseFixture(const char* _name, uint64_t _expectedHash, ShaderReflectionData& _reflection)
+{
+	std::vector<unsigned char> bytes = LoadFixture(_name);
+	return ParseShaderReflection(bytes.data(), bytes.size(), _expectedHash, _reflection);
+}
+
+static void TestHash()
+{
+	// FNV-1a's offset basis for nothing, and different code hashes differently
+	CHECK(HashShaderBlob("", 0) == 14695981039346656037ull);
+	CHECK(HashShaderBlob("VertexShader", 12) != HashShaderBlob("VertexShadeR", 12));
+}
+
+static void TestValidSidecar()
+{
+	ShaderReflectionData reflection;
+	CHECK(ParseFixture("VertexShader.cso.refl", fixtureHash, reflection));
+	CHECK(reflection.BlobHash == fixtureHash);
+
+	CHECK(reflection.ConstantBuffers.size() == 2);
+	if (reflection.ConstantBuffers.size() == 2)
+	{
+		const ShaderReflectionBuffer& perFrame = reflection.ConstantBuffers[0];
+		CHECK(perFrame.Name == "PerFrame" && perFrame.Size == 208 && perFrame.BindIndex == 0);
+		CHECK(perFrame.Variables.size() == 3);
+		CHECK(perFrame.Variables.size() == 3 && perFrame.Variables[2].Name == "cameraPosition" && perFrame.Variables[2].ByteOffset == 128 && perFrame.Variables[2].Size == 12);
+
+		const ShaderReflectionBuffer& perObject = reflection.ConstantBuffers[1];
+		CHECK(perObject.Name == "PerObject" && perObject.Size == 128 && perObject.BindIndex == 2);
+		CHECK(perObject.Variables.size() == 2 && perObject.Variables[1].Name == "worldInvTranspose" && perObject.Variables[1].ByteOffset == 64);
+	}
+
+	CHECK(reflection.Textures.empty());
+	CHECK(reflection.Samplers.empty());
+	CHECK(reflection.Inputs.size() == 4);
+	if (reflection.Inputs.size() == 4)
+	{
+		CHECK(reflection.Inputs[0].SemanticName == "POSITION" && reflection.Inputs[0].Mask == 7);
+		CHECK(reflection.Inputs[2].SemanticName == "TEXCOORD" && reflection.Inputs[2].Mask == 3);
+		CHECK(reflection.Inputs[3].SemanticName == "TANGENT" && reflection.Inputs[3].SemanticIndex == 0);
+	}
+
+	// Writing what was read gives back the same bytes
+	std::vector<unsigned char> bytes;
+	SerializeShaderReflection(reflection, bytes);
+	CHECK(bytes == LoadFixture("VertexShader.cso.refl"));
+}
+
+static void TestRejected()
+{
+	ShaderReflectionData reflection;
+
+	// A sidecar left over from an older build of the shader
+	CHECK(!ParseFixture("VertexShader.cso.refl", fixtureHash + 1, reflection));
+
+	CHECK(!ParseFixture("Truncated.refl", fixtureHash, reflection));
+	CHECK(!ParseFixture("TrailingBytes.refl", fixtureHash, reflection));
+	CHECK(!ParseFixture("BadMagic.refl", fixtureHash, reflection));
+	CHECK(!ParseFixture("NewerVersion.refl", fixtureHash, reflection));
+	CHECK(!ParseFixture("HugeCount.refl", fixtureHash, reflection));
+	CHECK(!ParseFixture("VariableOutOfBounds.refl", fixtureHash, reflection));
+
+	// Cut short anywhere, the valid sidecar fails too
+	std::vector<unsigned char> bytes = LoadFixture("VertexShader.cso.refl");
+	for (size_t size = 0; size < bytes.size(); size++)
+	{
+		CHECK(!ParseShaderReflection(bytes.data(), size, fixtureHash, reflection));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1) fixtureFolder = argv[1];
+	TestHash();
+	TestValidSidecar();
+	TestRejected();
+	return CheckResult("ShaderReflection");
+}
@@ -0,0 +1,429 @@
+// --------------------------------------------------------
+// Tests the point light shadow atlas: the quadtree allocator
+// under random allocate/free traffic (no overlaps, frees
+// merge back to the whole atlas, best fit), the cube face
+// matrices against the shader's face pick, face caching as
+// casters and lights move, ranking, the tile size hysteresis,
+// and an oversubscribed atlas where tiles are downsized and
+// a brighter light evicts the dimmest
+//
+// Only DirectXMath's types are used, so nothing needs a
+// device. Build it on its own, e.g.
+//   cl /EHsc /I.. TestShadowAtlas.cpp ..\ShadowAtlas.cpp
+// --------------------------------------------------------
+#include "../ShadowAtlas.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace DirectX;
+
+static bool Overlap(const ShadowAtlasTile& _a, const ShadowAtlasTile& _b)
+{
+	return _a.x < _b.x + _b.size && _b.x < _a.x + _a.size && _a.y < _b.y + _b.size && _b.y < _a.y + _a.size;
+}
+
+static unsigned int CountFaces(unsigned int _dirtyFaces)
+{
+	unsigned int count = 0;
+	for (int face = 0; face < SHADOW_CUBE_FACES; face++)
+	{
+		count += (_dirtyFaces >> face) & 1;
+	}
+	return count;
+}
+
+// The face Shadows.hlsli picks for a direction from the light, and the direction in that face's space
+static unsigned int ShaderFace(XMFLOAT3 _direction, XMFLOAT3& _local)
+{
+	XMFLOAT3 d = _direction;
+	float ax = fabsf(d.x);
+	float ay = fabsf(d.y);
+	float az = fabsf(d.z);
+	if (ax >= ay && ax >= az)
+	{
+		_local = d.x > 0 ? XMFLOAT3(-d.z, d.y, d.x) : XMFLOAT3(d.z, d.y, -d.x);
+		return d.x > 0 ? 0 : 1;
+	}
+	if (ay >= az)
+	{
+		_local = d.y > 0 ? XMFLOAT3(d.x, -d.z, d.y) : XMFLOAT3(d.x, d.z, -d.y);
+		return d.y > 0 ? 2 : 3;
+	}
+	_local = d.z > 0 ? XMFLOAT3(d.x, d.y, d.z) : XMFLOAT3(-d.x, d.y, -d.z);
+	return d.z > 0 ? 4 : 5;
+}
+
+// A left-handed look-to view, as Camera makes
+static XMFLOAT4X4 View(XMFLOAT3 _position, XMFLOAT3 _forward)
+{
+	float length = sqrtf(_forward.x * _forward.x + _forward.y * _forward.y + _forward.z * _forward.z);
+	XMFLOAT3 f(_forward.x / length, _forward.y / length, _forward.z / length);
+	length = sqrtf(f.z * f.z + f.x * f.x);
+	XMFLOAT3 r(f.z / length, 0, -f.x / length);
+	XMFLOAT3 u(f.y * r.z - f.z * r.y, f.z * r.x - f.x * r.z, f.x * r.y - f.y * r.x);
+	XMFLOAT4X4 view = {};
+	view._11 = r.x; view._21 = r.y; view._31 = r.z;
+	view._12 = u.x; view._22 = u.y; view._32 = u.z;
+	view._13 = f.x; view._23 = f.y; view._33 = f.z;
+	view._41 = -(r.x * _position.x + r.y * _position.y + r.z * _position.z);
+	view._42 = -(u.x * _position.x + u.y * _position.y + u.z * _position.z);
+	view._43 = -(f.x * _position.x + f.y * _position.y + f.z * _position.z);
+	view._44 = 1;
+	return view;
+}
+
+static XMFLOAT4X4 Projection(float _fovY, float _aspect)
+{
+	XMFLOAT4X4 projection = {};
+	float tanHalfFov = tanf(_fovY / 2);
+	projection._11 = 1 / (tanHalfFov * _aspect);
+	projection._22 = 1 / tanHalfFov;
+	projection._33 = 1;
+	projection._34 = 1;
+	projection._43 = -0.01f;
+	return projection;
+}
+
+static ShadowAtlasCaster Caster(float _x, float _y, float _z, float _radius)
+{
+	ShadowAtlasCaster caster = {};
+	caster.bounds.Center = XMFLOAT3(_x, _y, _z);
+	caster.bounds.Radius = _radius;
+	caster.world._11 = caster.world._22 = caster.world._33 = caster.world._44 = 1;
+	caster.world._41 = _x;
+	caster.world._42 = _y;
+	caster.world._43 = _z;
+	return caster;
+}
+
+static void TestAllocator()
+{
+	std::mt19937 random(43);
+	std::uniform_real_distribution<float> unit(0, 1);
+	ShadowAtlasAllocator allocator(SHADOW_ATLAS_RESOLUTION, SHADOW_ATLAS_MIN_TILE);
+
+	// Random traffic: tiles are aligned, inside the atlas, never overlap, and the used count stays right
+	std::vector<ShadowAtlasTile> live;
+	bool aligned = true;
+	bool disjoint = true;
+	bool counted = true;
+	for (int step = 0; step < 20000; step++)
+	{
+		if (!live.empty() && unit(random) < 0.45f)
+		{
+			size_t i = random() % live.size();
+			allocator.Free(live[i]);
+			live.erase(live.begin() + i);
+		}
+		else
+		{
+			unsigned int size = SHADOW_ATLAS_MIN_TILE << (random() % 5);
+			ShadowAtlasTile tile;
+			if (allocator.Allocate(size, tile))
+			{
+				if (tile.size != size || tile.x % size || tile.y % size || tile.x + size > SHADOW_ATLAS_RESOLUTION || tile.y + size > SHADOW_ATLAS_RESOLUTION) aligned = false;
+				for (auto& other : live)
+				{
+					if (Overlap(other, tile)) disjoint = false;
+				}
+				live.push_back(tile);
+			}
+		}
+
+		unsigned long long used = 0;
+		for (auto& tile : live)
+		{
+			used += (unsigned long long)tile.size * tile.size;
+		}
+		if (used != allocator.GetUsedTexels()) counted = false;
+	}
+	CHECK(aligned);
+	CHECK(disjoint);
+	CHECK(counted);
+
+	// Freeing everything merges back to one whole atlas
+	for (auto& tile : live)
+	{
+		allocator.Free(tile);
+	}
+	ShadowAtlasTile whole;
+	CHECK(allocator.GetUsedTexels() == 0);
+	CHECK(allocator.Allocate(SHADOW_ATLAS_RESOLUTION, whole) && whole.x == 0 && whole.y == 0);
+	allocator.Free(whole);
+
+	// Every smallest tile can be handed out, and no more
+	unsigned int count = 0;
+	ShadowAtlasTile tile;
+	while (allocator.Allocate(SHADOW_ATLAS_MIN_TILE, tile))
+	{
+		count++;
+	}
+	unsigned int perSide = SHADOW_ATLAS_RESOLUTION / SHADOW_ATLAS_MIN_TILE;
+	CHECK(count == perSide * perSide);
+	allocator.Clear();
+	CHECK(allocator.GetUsedTexels() == 0);
+
+	// Best fit: a small tile goes into the quadrant that's already split, leaving the other three whole
+	ShadowAtlasTile big, small, quadrants[3];
+	unsigned int half = SHADOW_ATLAS_RESOLUTION / 2;
+	CHECK(allocator.Allocate(SHADOW_ATLAS_MAX_TILE, big));
+	CHECK(allocator.Allocate(SHADOW_ATLAS_MIN_TILE, small));
+	CHECK(small.x / half == big.x / half && small.y / half == big.y / half);
+	for (auto& quadrant : quadrants)
+	{
+		CHECK(allocator.Allocate(half, quadrant));
+	}
+	CHECK(!allocator.Allocate(half, tile));
+}
+
+static void TestFaces()
+{
+	std::mt19937 random(43);
+	std::uniform_real_distribution<float> unit(0, 1);
+
+	// Each face's matrix maps a point the way the shader reads it back, and keeps it inside the face
+	float worstNdc = 0;
+	float worstDepth = 0;
+	int outside = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		XMFLOAT3 position(unit(random) * 20 - 10, unit(random) * 20 - 10, unit(random) * 20 - 10);
+		float range = 1 + unit(random) * 10;
+		XMFLOAT3 d(unit(random) * 2 - 1, unit(random) * 2 - 1, unit(random) * 2 - 1);
+		float length = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+		if (length < 1e-3f) continue;
+		float distance = SHADOW_POINT_NEAR + unit(random) * (range - SHADOW_POINT_NEAR);
+		d = XMFLOAT3(d.x / length * distance, d.y / length * distance, d.z / length * distance);
+		XMFLOAT3 w(position.x + d.x, position.y + d.y, position.z + d.z);
+
+		XMFLOAT3 local;
+		unsigned int face = ShaderFace(d, local);
+		XMFLOAT4X4 m = ShadowAtlas::BuildFaceViewProjection(position, range, face);
+		float x = w.x * m._11 + w.y * m._21 + w.z * m._31 + m._41;
+		float y = w.x * m._12 + w.y * m._22 + w.z * m._32 + m._42;
+		float z = w.x * m._13 + w.y * m._23 + w.z * m._33 + m._43;
+		float ww = w.x * m._14 + w.y * m._24 + w.z * m._34 + m._44;
+		float a = range / (range - SHADOW_POINT_NEAR);
+		float b = -SHADOW_POINT_NEAR * a;
+		worstNdc = std::max(worstNdc, std::max(fabsf(x / ww - local.x / local.z), fabsf(y / ww - local.y / local.z)));
+		worstDepth = std::max(worstDepth, fabsf(z / ww - (a + b / local.z)));
+		if (fabsf(x / ww) > 1.0001f || fabsf(y / ww) > 1.0001f || z / ww > 1.0001f || (local.z >= SHADOW_POINT_NEAR && z / ww < -1e-4f)) outside++;
+	}
+	CHECK(worstNdc < 1e-4f);
+	CHECK(worstDepth < 1e-4f);
+	CHECK(outside == 0);
+
+	// FaceTouchesSphere never misses a face that part of the sphere (inside the range) falls in
+	int missed = 0;
+	for (int i = 0; i < 20000; i++)
+	{
+		float range = 5;
+		BoundingSphere sphere;
+		sphere.Center = XMFLOAT3(unit(random) * 16 - 8, unit(random) * 16 - 8, unit(random) * 16 - 8);
+		sphere.Radius = unit(random) * 2;
+		for (int k = 0; k < 50; k++)
+		{
+			XMFLOAT3 offset(unit(random) * 2 - 1, unit(random) * 2 - 1, unit(random) * 2 - 1);
+			if (offset.x * offset.x + offset.y * offset.y + offset.z * offset.z > 1) continue;
+			XMFLOAT3 q(sphere.Center.x + offset.x * sphere.Radius, sphere.Center.y + offset.y * sphere.Radius, sphere.Center.z + offset.z * sphere.Radius);
+			if (q.x * q.x + q.y * q.y + q.z * q.z > range * range) continue;
+			XMFLOAT3 local;
+			if (!ShadowAtlas::FaceTouchesSphere(XMFLOAT3(0, 0, 0), range, ShaderFace(q, local), sphere)) missed++;
+		}
+	}
+	CHECK(missed == 0);
+}
+
+static void TestCaching()
+{
+	ShadowAtlas atlas;
+	XMFLOAT4X4 view = View(XMFLOAT3(0, 5, -20), XMFLOAT3(0, -0.2f, 1));
+	XMFLOAT4X4 projection = Projection(0.8f, 16.0f / 9.0f);
+	std::vector<Light> lights = {
+		Light::Directional(XMFLOAT3(1, 1, 0), XMFLOAT3(1, 1, 1), 1),
+		Light::Point(XMFLOAT3(-6, 3, 0), XMFLOAT3(1, 1, 1), 1, 6),
+		Light::Point(XMFLOAT3(8, 3, 10), XMFLOAT3(1, 1, 1), 1, 5),
+	};
+	std::vector<ShadowAtlasCaster> casters = { Caster(-6, 0, 0, 1), Caster(-4, 3, 0, 0.5f), Caster(8, 0, 10, 1), Caster(0, -1, 0, 30) };
+
+	// The first frame draws every face, the next one none
+	atlas.Update(view, projection, 720, lights, casters);
+	ShadowAtlasStats stats = atlas.GetStats();
+	CHECK(stats.shadowedLights == 2 && stats.allocations == 2 && stats.facesRendered == 12);
+	atlas.Update(view, projection, 720, lights, casters);
+	stats = atlas.GetStats();
+	CHECK(stats.facesRendered == 0 && stats.facesCached == 12);
+
+	// A caster spinning in place on the first light's +X side: its bounds don't change but its world does
+	casters[1].world._11 = 0;
+	casters[1].world._13 = 1;
+	casters[1].world._31 = -1;
+	casters[1].world._33 = 0;
+	atlas.Update(view, projection, 720, lights, casters);
+	unsigned int slotA = atlas.GetSlot(0).lightIndex == 1 ? 0 : 1;
+	CHECK(atlas.GetStats().movedCasters == 1);
+	CHECK(atlas.GetSlot(slotA).dirtyFaces == 1);
+	CHECK(atlas.GetSlot(1 - slotA).dirtyFaces == 0);
+
+	// A caster circling under the second light never makes the first one redraw
+	unsigned int drawnA = 0;
+	unsigned int drawnB = 0;
+	for (int frame = 0; frame < 100; frame++)
+	{
+		casters[2] = Caster(8 + 2 * cosf(frame * 0.1f), 0, 10 + 2 * sinf(frame * 0.1f), 1);
+		atlas.Update(view, projection, 720, lights, casters);
+		drawnA += CountFaces(atlas.GetSlot(slotA).dirtyFaces);
+		drawnB += CountFaces(atlas.GetSlot(1 - slotA).dirtyFaces);
+	}
+	CHECK(drawnA == 0);
+	CHECK(drawnB > 0 && drawnB < 100 * SHADOW_CUBE_FACES);
+
+	// Moving a light redraws all of its faces
+	lights[1].Position.x += 0.5f;
+	atlas.Update(view, projection, 720, lights, casters);
+	CHECK(atlas.GetSlot(slotA).dirtyFaces == (1 << SHADOW_CUBE_FACES) - 1);
+}
+
+static void TestRanking()
+{
+	std::mt19937 random(43);
+	std::uniform_real_distribution<float> unit(0, 1);
+	XMFLOAT4X4 view = View(XMFLOAT3(0, 5, -30), XMFLOAT3(0, -0.1f, 1));
+	XMFLOAT4X4 projection = Projection(0.8f, 16.0f / 9.0f);
+	std::vector<Light> lights;
+	for (int i = 0; i < 200; i++)
+	{
+		lights.push_back(Light::Point(XMFLOAT3(unit(random) * 60 - 30, unit(random) * 10, unit(random) * 60 - 20), XMFLOAT3(1, 1, 1), 0.5f + unit(random), 2 + unit(random) * 10));
+	}
+	std::vector<ShadowAtlasCaster> casters;
+	for (int i = 0; i < 50; i++)
+	{
+		casters.push_back(Caster(unit(random) * 60 - 30, unit(random) * 5, unit(random) * 60 - 20, 0.5f + unit(random)));
+	}
+
+	ShadowAtlas atlas;
+	atlas.Update(view, projection, 1440, lights, casters);
+
+	// The shadowed lights are exactly the top ranked ones, and their tiles don't overlap
+	std::vector<std::pair<float, int>> ranked;
+	for (int i = 0; i < (int)lights.size(); i++)
+	{
+		float coverage = ShadowAtlas::GetScreenCoverage(view, 1 / projection._11, 1 / projection._22, lights[i].Position, lights[i].Range);
+		if (coverage > 0) ranked.push_back(std::make_pair(-coverage * lights[i].Intensity, i));
+	}
+	std::sort(ranked.begin(), ranked.end());
+	std::vector<int> top;
+	for (size_t i = 0; i < MAX_SHADOWED_POINT_LIGHTS && i < ranked.size(); i++)
+	{
+		top.push_back(ranked[i].second);
+	}
+
+	std::vector<int> shadowed;
+	std::vector<ShadowAtlasTile> tiles;
+	bool disjoint = true;
+	for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		const ShadowAtlasSlot& slot = atlas.GetSlot(s);
+		if (slot.lightIndex < 0) continue;
+		shadowed.push_back(slot.lightIndex);
+		for (int face = 0; face < SHADOW_CUBE_FACES; face++)
+		{
+			for (auto& other : tiles)
+			{
+				if (Overlap(other, slot.tiles[face])) disjoint = false;
+			}
+			tiles.push_back(slot.tiles[face]);
+		}
+	}
+	std::sort(top.begin(), top.end());
+	std::sort(shadowed.begin(), shadowed.end());
+	CHECK(top == shadowed);
+	CHECK(disjoint);
+
+	// Tile sizes, and holding the current size near a boundary
+	CHECK(ShadowAtlas::GetTileSize(1.0f, 1440, 0) == 512);
+	CHECK(ShadowAtlas::GetTileSize(1.0f, 4000, 0) == SHADOW_ATLAS_MAX_TILE);
+	CHECK(ShadowAtlas::GetTileSize(0.01f, 1440, 0) == SHADOW_ATLAS_MIN_TILE);
+	CHECK(ShadowAtlas::GetTileSize(300.0f / 720, 1440, 256) == 256);
+	CHECK(ShadowAtlas::GetTileSize(700.0f / 720, 1440, 256) == 512);
+	CHECK(ShadowAtlas::GetTileSize(230.0f / 720, 1440, 256) == 256);
+	CHECK(ShadowAtlas::GetTileSize(190.0f / 720, 1440, 256) == 128);
+
+	// The same input gives the same slots
+	ShadowAtlas first;
+	ShadowAtlas second;
+	first.Update(view, projection, 1440, lights, casters);
+	second.Update(view, projection, 1440, lights, casters);
+	bool same = true;
+	for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		if (memcmp(&first.GetSlot(s), &second.GetSlot(s), sizeof(ShadowAtlasSlot)) != 0) same = false;
+	}
+	CHECK(same);
+}
+
+static void TestOversubscribed()
+{
+	// Twenty close, screen-filling lights, getting brighter with their index: more than the atlas can hold at full size
+	ShadowAtlas atlas;
+	XMFLOAT4X4 view = View(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1));
+	XMFLOAT4X4 projection = Projection(0.8f, 1);
+	std::vector<Light> lights;
+	for (int i = 0; i < 20; i++)
+	{
+		lights.push_back(Light::Point(XMFLOAT3((i % 5) * 0.1f, 0, 1 + i * 0.01f), XMFLOAT3(1, 1, 1), 1 + i * 0.1f, 5));
+	}
+	std::vector<ShadowAtlasCaster> casters = { Caster(0, 0, 3, 1) };
+	atlas.Update(view, projection, 4000, lights, casters);
+	ShadowAtlasStats stats = atlas.GetStats();
+
+	// Every slot is filled, the tiles are downsized to fit, and a brighter light never gets less than a dimmer one
+	unsigned int sizes[21] = {};
+	unsigned int largest = 0;
+	for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		const ShadowAtlasSlot& slot = atlas.GetSlot(s);
+		if (slot.lightIndex < 0) continue;
+		sizes[slot.lightIndex] = slot.size;
+		largest = std::max(largest, slot.size);
+	}
+	CHECK(stats.shadowedLights == MAX_SHADOWED_POINT_LIGHTS);
+	CHECK(stats.downsized > 0);
+	CHECK(stats.usedTexels <= (unsigned long long)SHADOW_ATLAS_RESOLUTION * SHADOW_ATLAS_RESOLUTION);
+	CHECK(sizes[19] == largest);
+	for (int i = 5; i < 19; i++)
+	{
+		CHECK(sizes[i] <= sizes[i + 1]);
+	}
+
+	// A brighter light arriving takes the largest share, and the dimmest shadowed light is evicted
+	lights.push_back(Light::Point(XMFLOAT3(0, 0, 1), XMFLOAT3(1, 1, 1), 10, 5));
+	atlas.Update(view, projection, 4000, lights, casters);
+	unsigned int newcomer = 0;
+	unsigned int best = 0;
+	bool dimmestGone = true;
+	for (int s = 0; s < MAX_SHADOWED_POINT_LIGHTS; s++)
+	{
+		const ShadowAtlasSlot& slot = atlas.GetSlot(s);
+		if (slot.lightIndex == 20) newcomer = slot.size;
+		if (slot.lightIndex == 4) dimmestGone = false;
+		best = std::max(best, slot.size);
+	}
+	CHECK(newcomer == best);
+	CHECK(dimmestGone);
+	CHECK(atlas.GetStats().evictions >= 1);
+}
+
+int main()
+{
+	TestAllocator();
+	TestFaces();
+	TestCaching();
+	TestRanking();
+	TestOversubscribed();
+	return CheckResult("ShadowAtlas");
+}
@@ -0,0 +1,267 @@
+// --------------------------------------------------------
+// Tests ShadowCascades: the practical split scheme at both
+// ends of lambda, that every cascade holds its whole slice
+// of the camera frustum, that texel snapping keeps a fixed
+// point at the same sub-texel spot as the camera moves, and
+// that caster culling only drops casters that can't shadow
+// the slice
+//
+// Only DirectXMath's types are used, so nothing needs a
+// device. Build it on its own, e.g.
+//   cl /EHsc /I.. TestShadowCascades.cpp ..\ShadowCascades.cpp
+// --------------------------------------------------------
+#include "../ShadowCascades.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace DirectX;
+
+static const float fovY = 60 * 3.14159265f / 180;
+static const float aspect = 16.0f / 9.0f;
+
+static XMFLOAT3 Normalize(XMFLOAT3 _v)
+{
+	float length = sqrtf(_v.x * _v.x + _v.y * _v.y + _v.z * _v.z);
+	return XMFLOAT3(_v.x / length, _v.y / length, _v.z / length);
+}
+
+static XMFLOAT3 Cross(XMFLOAT3 _a, XMFLOAT3 _b)
+{
+	return XMFLOAT3(_a.y * _b.z - _a.z * _b.y, _a.z * _b.x - _a.x * _b.z, _a.x * _b.y - _a.y * _b.x);
+}
+
+static float Dot(XMFLOAT3 _a, XMFLOAT3 _b)
+{
+	return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z;
+}
+
+// A left-handed look-to view, as Camera makes
+static XMFLOAT4X4 View(XMFLOAT3 _position, XMFLOAT3 _forward)
+{
+	XMFLOAT3 forward = Normalize(_forward);
+	XMFLOAT3 right = Normalize(Cross(XMFLOAT3(0, 1, 0), forward));
+	XMFLOAT3 up = Cross(forward, right);
+	XMFLOAT4X4 view = {};
+	view._11 = right.x; view._21 = right.y; view._31 = right.z;
+	view._12 = up.x; view._22 = up.y; view._32 = up.z;
+	view._13 = forward.x; view._23 = forward.y; view._33 = forward.z;
+	view._41 = -Dot(_position, right);
+	view._42 = -Dot(_position, up);
+	view._43 = -Dot(_position, forward);
+	view._44 = 1;
+	return view;
+}
+
+static XMFLOAT4X4 Projection(float _nearClip, float _farClip)
+{
+	XMFLOAT4X4 projection = {};
+	float tanHalfFov = tanf(fovY / 2);
+	projection._11 = 1 / (aspect * tanHalfFov);
+	projection._22 = 1 / tanHalfFov;
+	projection._33 = _farClip / (_farClip - _nearClip);
+	projection._34 = 1;
+	projection._43 = -_nearClip * _farClip / (_farClip - _nearClip);
+	return projection;
+}
+
+static XMFLOAT4 Transform(const XMFLOAT4X4& _matrix, XMFLOAT3 _point)
+{
+	float in[4] = { _point.x, _point.y, _point.z, 1 };
+	float out[4] = {};
+	for (int j = 0; j < 4; j++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			out[j] += in[i] * _matrix.m[i][j];
+		}
+	}
+	return XMFLOAT4(out[0], out[1], out[2], out[3]);
+}
+
+static void TestSplits()
+{
+	float splits[SHADOW_CASCADE_COUNT + 1];
+
+	// Lambda 0 is evenly spaced
+	ShadowCascades::ComputeSplits(0.01f, 80, 0, SHADOW_CASCADE_COUNT, splits);
+	for (int i = 0; i <= SHADOW_CASCADE_COUNT; i++)
+	{
+		CHECK(fabsf(splits[i] - (0.01f + (80 - 0.01f) * i / SHADOW_CASCADE_COUNT)) < 1e-4f);
+	}
+
+	// Lambda 1 is a constant ratio from one split to the next
+	ShadowCascades::ComputeSplits(0.01f, 80, 1, SHADOW_CASCADE_COUNT, splits);
+	for (int i = 0; i <= SHADOW_CASCADE_COUNT; i++)
+	{
+		float expected = 0.01f * powf(8000, (float)i / SHADOW_CASCADE_COUNT);
+		CHECK(fabsf(splits[i] - expected) < 1e-3f * expected);
+	}
+
+	// In between, the ends are exact, the splits climb, and each sits between its uniform and log distance
+	ShadowCascades::ComputeSplits(0.01f, 80, SHADOW_SPLIT_LAMBDA, SHADOW_CASCADE_COUNT, splits);
+	CHECK(splits[0] == 0.01f && splits[SHADOW_CASCADE_COUNT] == 80);
+	for (int i = 1; i <= SHADOW_CASCADE_COUNT; i++)
+	{
+		CHECK(splits[i] > splits[i - 1]);
+		float uniform = 0.01f + (80 - 0.01f) * i / SHADOW_CASCADE_COUNT;
+		float logarithmic = 0.01f * powf(8000, (float)i / SHADOW_CASCADE_COUNT);
+		CHECK(splits[i] <= uniform + 1e-3f && splits[i] >= logarithmic - 1e-3f);
+	}
+}
+
+static void TestSliceContainment()
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1, 1);
+	XMFLOAT4X4 projection = Projection(0.01f, 1000);
+	std::vector<BoundingSphere> noCasters;
+	float tanY = tanf(fovY / 2);
+	float tanX = tanY * aspect;
+
+	// Random cameras and lights: all eight corners of each slice land inside its cascade
+	bool inside = true;
+	for (int trial = 0; trial < 500; trial++)
+	{
+		XMFLOAT3 position(unit(random) * 50, unit(random) * 20, unit(random) * 50);
+		XMFLOAT3 forward = Normalize(XMFLOAT3(unit(random), unit(random) * 0.8f, unit(random)));
+		XMFLOAT3 light = Normalize(XMFLOAT3(unit(random), fabsf(unit(random)) + 0.1f, unit(random)));
+		ShadowCascades cascades;
+		cascades.Update(View(position, forward), projection, 0.01f, 1000, light, noCasters);
+
+		XMFLOAT3 right = Normalize(Cross(XMFLOAT3(0, 1, 0), forward));
+		XMFLOAT3 up = Cross(forward, right);
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+		{
+			const ShadowCascade& cascade = cascades.GetCascade(c);
+			for (int corner = 0; corner < 8; corner++)
+			{
+				float depth = (corner & 4) ? cascade.splitFar : cascade.splitNear;
+				float x = ((corner & 1) ? 1 : -1) * tanX * depth;
+				float y = ((corner & 2) ? 1 : -1) * tanY * depth;
+				XMFLOAT3 point(
+					position.x + forward.x * depth + right.x * x + up.x * y,
+					position.y + forward.y * depth + right.y * x + up.y * y,
+					position.z + forward.z * depth + right.z * x + up.z * y);
+				XMFLOAT4 clip = Transform(cascade.viewProjection, point);
+				if (fabsf(clip.x) > 1.0001f || fabsf(clip.y) > 1.0001f || clip.z < -1e-4f || clip.z > 1.0001f) inside = false;
+			}
+		}
+	}
+	CHECK(inside);
+}
+
+static void TestTexelSnapping()
+{
+	XMFLOAT4X4 projection = Projection(0.01f, 1000);
+	XMFLOAT3 light = Normalize(XMFLOAT3(1, 0.5f, -0.5f));
+	XMFLOAT3 point(1.234f, 0.5f, 2.345f);
+	std::vector<BoundingSphere> noCasters;
+
+	// As the camera drifts by fractions of a texel, a fixed point stays on the same spot within its texel
+	double first[SHADOW_CASCADE_COUNT] = {};
+	double worst = 0;
+	for (int step = 0; step < 200; step++)
+	{
+		XMFLOAT3 position(0.0137f * step, 9, -15 + 0.0091f * step);
+		ShadowCascades cascades;
+		cascades.Update(View(position, XMFLOAT3(0, -0.1f, 1)), projection, 0.01f, 1000, light, noCasters);
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+		{
+			XMFLOAT4 clip = Transform(cascades.GetCascade(c).viewProjection, point);
+			double texel = (clip.x * 0.5 + 0.5) * SHADOW_MAP_RESOLUTION;
+			double fraction = texel - floor(texel);
+			if (step == 0)
+			{
+				first[c] = fraction;
+				continue;
+			}
+			double drift = fabs(fraction - first[c]);
+			worst = std::max(worst, std::min(drift, 1 - drift));
+		}
+	}
+	CHECK(worst < 0.01);
+}
+
+static void TestCasterCulling()
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1, 1);
+	std::uniform_real_distribution<float> spread(-150, 150);
+	XMFLOAT3 light = Normalize(XMFLOAT3(1, 0.5f, -0.5f));
+	XMFLOAT4X4 view = View(XMFLOAT3(0, 9, -15), XMFLOAT3(0, -0.1f, 1));
+	XMFLOAT4X4 projection = Projection(0.01f, 1000);
+
+	std::vector<BoundingSphere> casters;
+	for (int i = 0; i < 2000; i++)
+	{
+		casters.push_back(BoundingSphere(XMFLOAT3(spread(random), spread(random) * 0.3f, spread(random)), 0.5f + fabsf(unit(random)) * 3));
+	}
+
+	ShadowCascades cascades;
+	cascades.Update(view, projection, 0.01f, 1000, light, casters);
+	ShadowStats stats = cascades.GetStats();
+	CHECK(stats.casters == casters.size());
+	CHECK(stats.drawnCasters < stats.casters * SHADOW_CASCADE_COUNT);
+
+	bool keptInRange = true;
+	bool culledMiss = true;
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		const ShadowCascade& cascade = cascades.GetCascade(c);
+		std::vector<char> kept(casters.size(), 0);
+		for (unsigned int i : cascades.GetCasters(c))
+		{
+			kept[i] = 1;
+		}
+
+		for (size_t i = 0; i < casters.size(); i++)
+		{
+			const BoundingSphere& caster = casters[i];
+			if (kept[i])
+			{
+				// The near plane was pulled back far enough to take the whole caster in
+				XMFLOAT4 clip = Transform(cascade.viewProjection, caster.Center);
+				float nearest = clip.z - caster.Radius * cascade.projection._33;
+				if (nearest < -1e-4f || nearest > 1.0001f) keptInRange = false;
+				continue;
+			}
+
+			// Sweep a dropped caster away from the light: it must never end up inside the cascade's box
+			for (int t = 0; t <= 400; t++)
+			{
+				XMFLOAT3 swept(caster.Center.x - light.x * t, caster.Center.y - light.y * t, caster.Center.z - light.z * t);
+				XMFLOAT4 clip = Transform(cascade.viewProjection, swept);
+				float margin = caster.Radius * cascade.projection._11;
+				if (fabsf(clip.x) < 1 - margin && fabsf(clip.y) < 1 - margin && clip.z > 0 && clip.z < 1)
+				{
+					culledMiss = false;
+					break;
+				}
+			}
+		}
+	}
+	CHECK(keptInRange);
+	CHECK(culledMiss);
+
+	// The same input gives the same cascades and casters
+	ShadowCascades again;
+	again.Update(view, projection, 0.01f, 1000, light, casters);
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		CHECK(memcmp(&cascades.GetCascade(c), &again.GetCascade(c), sizeof(ShadowCascade)) == 0);
+		CHECK(cascades.GetCasters(c) == again.GetCasters(c));
+	}
+}
+
+int main()
+{
+	TestSplits();
+	TestSliceContainment();
+	TestTexelSnapping();
+	TestCasterCulling();
+	return CheckResult("ShadowCascades");
+}
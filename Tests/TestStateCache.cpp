@@ -0,0 +1,174 @@
+// --------------------------------------------------------
+// Tests StateCacheT against a mock context that records
+// every call the cache forwards, checking what's filtered,
+// what goes through, and the slot spans of batched binds
+//
+// Nothing is created on a device; the D3D headers are only
+// needed for the interface and enum types. Build it on its
+// own, e.g.
+//   cl /EHsc /I.. TestStateCache.cpp
+// --------------------------------------------------------
+#include "../StateCache.h"
+#include "Check.h"
+
+#include <string>
+#include <vector>
+
+// A forwarded call: which method, and the slot span or value it was given
+struct RecordedCall
+{
+	std::string		method;
+	UINT			start;
+	UINT			count;
+};
+
+struct MockContext
+{
+	std::vector<RecordedCall>	calls;
+
+	void Record(const char* _method, UINT _start = 0, UINT _count = 1) { calls.push_back({ _method, _start, _count }); }
+
+	void IASetInputLayout(ID3D11InputLayout*) { Record("IASetInputLayout"); }
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY) { Record("IASetPrimitiveTopology"); }
+	void IASetVertexBuffers(UINT _start, UINT _count, ID3D11Buffer* const*, const UINT*, const UINT*) { Record("IASetVertexBuffers", _start, _count); }
+	void IASetIndexBuffer(ID3D11Buffer*, DXGI_FORMAT, UINT) { Record("IASetIndexBuffer"); }
+	void VSSetShader(ID3D11VertexShader*, ID3D11ClassInstance* const*, UINT) { Record("VSSetShader"); }
+	void PSSetShader(ID3D11PixelShader*, ID3D11ClassInstance* const*, UINT) { Record("PSSetShader"); }
+	void VSSetConstantBuffers(UINT _start, UINT _count, ID3D11Buffer* const*) { Record("VSSetConstantBuffers", _start, _count); }
+	void PSSetConstantBuffers(UINT _start, UINT _count, ID3D11Buffer* const*) { Record("PSSetConstantBuffers", _start, _count); }
+	void VSSetConstantBuffers1(UINT _start, UINT _count, ID3D11Buffer* const*, const UINT*, const UINT*) { Record("VSSetConstantBuffers1", _start, _count); }
+	void PSSetConstantBuffers1(UINT _start, UINT _count, ID3D11Buffer* const*, const UINT*, const UINT*) { Record("PSSetConstantBuffers1", _start, _count); }
+	void VSSetShaderResources(UINT _start, UINT _count, ID3D11ShaderResourceView* const*) { Record("VSSetShaderResources", _start, _count); }
+	void PSSetShaderResources(UINT _start, UINT _count, ID3D11ShaderResourceView* const*) { Record("PSSetShaderResources", _start, _count); }
+	void VSSetSamplers(UINT _start, UINT _count, ID3D11SamplerState* const*) { Record("VSSetSamplers", _start, _count); }
+	void PSSetSamplers(UINT _start, UINT _count, ID3D11SamplerState* const*) { Record("PSSetSamplers", _start, _count); }
+	void RSSetState(ID3D11RasterizerState*) { Record("RSSetState"); }
+	void OMSetBlendState(ID3D11BlendState*, const FLOAT*, UINT) { Record("OMSetBlendState"); }
+	void OMSetDepthStencilState(ID3D11DepthStencilState*, UINT) { Record("OMSetDepthStencilState"); }
+};
+
+// Distinct fake objects; the cache only ever compares their addresses
+template <typename T>
+static T* Fake(uintptr_t _id)
+{
+	return (T*)(_id * 16);
+}
+
+static void TestFiltering()
+{
+	MockContext mock;
+	StateCacheT<MockContext> cache;
+	cache.Initialize(&mock, &mock);
+
+	// Even binding null goes through the first time, since the real state is unknown
+	cache.RSSetState(0);
+	cache.RSSetState(0);
+	cache.PSSetShader(Fake<ID3D11PixelShader>(1));
+	cache.PSSetShader(Fake<ID3D11PixelShader>(1));
+	cache.PSSetShader(Fake<ID3D11PixelShader>(2));
+	CHECK(mock.calls.size() == 3);
+	CHECK(cache.GetIssuedCount() == 3);
+	CHECK(cache.GetFilteredCount() == 2);
+
+	// Slots are shadowed separately, and per stage
+	mock.calls.clear();
+	cache.PSSetShaderResource(3, Fake<ID3D11ShaderResourceView>(1));
+	cache.PSSetShaderResource(4, Fake<ID3D11ShaderResourceView>(1));
+	cache.VSSetShaderResource(3, Fake<ID3D11ShaderResourceView>(1));
+	cache.PSSetShaderResource(3, Fake<ID3D11ShaderResourceView>(1));
+	CHECK(mock.calls.size() == 3);
+
+	// Invalidating forgets everything, so the same binds go through again
+	mock.calls.clear();
+	cache.Invalidate();
+	cache.RSSetState(0);
+	cache.PSSetShader(Fake<ID3D11PixelShader>(2));
+	CHECK(mock.calls.size() == 2);
+
+	cache.ResetCounters();
+	CHECK(cache.GetIssuedCount() == 0 && cache.GetFilteredCount() == 0);
+}
+
+static void TestCompoundState()
+{
+	MockContext mock;
+	StateCacheT<MockContext> cache;
+	cache.Initialize(&mock, &mock);
+
+	// A vertex buffer binding is the buffer, stride and offset together
+	cache.IASetVertexBuffer(0, Fake<ID3D11Buffer>(1), 32, 0);
+	cache.IASetVertexBuffer(0, Fake<ID3D11Buffer>(1), 32, 0);
+	cache.IASetVertexBuffer(0, Fake<ID3D11Buffer>(1), 48, 0);
+	cache.IASetVertexBuffer(0, Fake<ID3D11Buffer>(1), 48, 16);
+	CHECK(mock.calls.size() == 3);
+
+	// The same buffer bound whole and as a range are different bindings
+	mock.calls.clear();
+	cache.PSSetConstantBuffer(2, Fake<ID3D11Buffer>(2));
+	cache.PSSetConstantBufferRange(2, Fake<ID3D11Buffer>(2), 0, 16);
+	cache.PSSetConstantBufferRange(2, Fake<ID3D11Buffer>(2), 0, 16);
+	cache.PSSetConstantBufferRange(2, Fake<ID3D11Buffer>(2), 16, 16);
+	cache.PSSetConstantBuffer(2, Fake<ID3D11Buffer>(2));
+	CHECK(mock.calls.size() == 4);
+	CHECK(mock.calls.size() == 4 && mock.calls[1].method == "PSSetConstantBuffers1");
+
+	// A null blend factor is the same as all ones
+	mock.calls.clear();
+	FLOAT ones[4] = { 1, 1, 1, 1 };
+	FLOAT half[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+	cache.OMSetBlendState(0, 0, 0xffffffff);
+	cache.OMSetBlendState(0, ones, 0xffffffff);
+	cache.OMSetBlendState(0, half, 0xffffffff);
+	cache.OMSetBlendState(0, half, 0x0000ffff);
+	CHECK(mock.calls.size() == 3);
+
+	mock.calls.clear();
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(1), 0);
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(1), 1);
+	cache.OMSetDepthStencilState(Fake<ID3D11DepthStencilState>(1), 1);
+	CHECK(mock.calls.size() == 2);
+}
+
+static void TestBatchedSlots()
+{
+	MockContext mock;
+	StateCacheT<MockContext> cache;
+	cache.Initialize(&mock, &mock);
+
+	ID3D11ShaderResourceView* srvs[4] = { Fake<ID3D11ShaderResourceView>(1), Fake<ID3D11ShaderResourceView>(2), Fake<ID3D11ShaderResourceView>(3), Fake<ID3D11ShaderResourceView>(4) };
+	cache.PSSetShaderResources(0, 4, srvs);
+	CHECK(mock.calls.size() == 1 && mock.calls[0].start == 0 && mock.calls[0].count == 4);
+
+	// Only the span between the first and last changed slot is issued
+	mock.calls.clear();
+	srvs[1] = Fake<ID3D11ShaderResourceView>(5);
+	srvs[2] = Fake<ID3D11ShaderResourceView>(6);
+	cache.PSSetShaderResources(0, 4, srvs);
+	CHECK(mock.calls.size() == 1 && mock.calls[0].start == 1 && mock.calls[0].count == 2);
+
+	mock.calls.clear();
+	cache.PSSetShaderResources(0, 4, srvs);
+	CHECK(mock.calls.empty());
+
+	// Slots set one at a time are seen by the batched call too
+	mock.calls.clear();
+	cache.PSSetShaderResource(3, Fake<ID3D11ShaderResourceView>(7));
+	srvs[3] = Fake<ID3D11ShaderResourceView>(7);
+	cache.PSSetShaderResources(0, 4, srvs);
+	CHECK(mock.calls.size() == 1);
+
+	mock.calls.clear();
+	ID3D11SamplerState* samplers[3] = { Fake<ID3D11SamplerState>(1), Fake<ID3D11SamplerState>(2), Fake<ID3D11SamplerState>(3) };
+	cache.PSSetSamplers(1, 3, samplers);
+	samplers[2] = Fake<ID3D11SamplerState>(4);
+	cache.PSSetSamplers(1, 3, samplers);
+	CHECK(mock.calls.size() == 2 && mock.calls[1].start == 3 && mock.calls[1].count == 1);
+}
+
+int main()
+{
+	TestFiltering();
+	TestCompoundState();
+	TestBatchedSlots();
+	return CheckResult("StateCache");
+}
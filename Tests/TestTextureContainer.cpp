@@ -0,0 +1,299 @@
+// --------------------------------------------------------
+// Tests TextureContainer on .dds and .ktx2 files built here:
+// legacy FourCC and RGB mask headers, the DX10 header, cube
+// maps and arrays, and KTX2's levels; then broken headers,
+// every truncation of a valid file, and random byte flips,
+// none of which may give a subresource outside the file
+//
+// Build it on its own, e.g. (the fuzzing is best run under
+// a sanitizer, to catch any read past the end)
+//   g++ -std=c++14 -fsanitize=address -I.. TestTextureContainer.cpp ../TextureContainer.cpp -o testtexturecontainer
+// --------------------------------------------------------
+#include "../TextureContainer.h"
+#include "../DdsFile.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+// Vulkan formats KTX2 files name theirs by
+static const unsigned int VK_FORMAT_R8G8B8A8_UNORM = 37;
+static const unsigned int VK_FORMAT_BC7_UNORM_BLOCK = 145;
+
+// Bytes in a whole mip chain of one slice
+static size_t ChainSize(unsigned int _width, unsigned int _height, unsigned int _mips, unsigned int _bytes, bool _compressed)
+{
+	size_t total = 0;
+	for (unsigned int m = 0; m < _mips; m++)
+	{
+		unsigned int width = std::max(_width >> m, 1u);
+		unsigned int height = std::max(_height >> m, 1u);
+		total += _compressed ? (size_t)((width + 3) / 4) * ((height + 3) / 4) * _bytes : (size_t)width * height * _bytes;
+	}
+	return total;
+}
+
+struct DdsDescription
+{
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	mips;
+	unsigned int	fourCC;			// Or 0 for RGB masks
+	unsigned int	redMask;		// With RGB masks: 0xff for RGBA, 0xff0000 for BGRA
+	bool			dx10;
+	unsigned int	format;			// In the DX10 header
+	unsigned int	arraySize;
+	bool			cube;
+	size_t			payload;
+};
+
+static std::vector<unsigned char> MakeDDS(const DdsDescription& _description)
+{
+	std::vector<unsigned char> file(4 + sizeof(DdsHeader) + (_description.dx10 ? sizeof(DdsHeaderDX10) : 0));
+	uint32_t magic = DDS_MAGIC;
+	memcpy(&file[0], &magic, 4);
+
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	header.width = _description.width;
+	header.height = _description.height;
+	header.mipMapCount = _description.mips;
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	if (_description.dx10 || _description.fourCC)
+	{
+		header.pixelFormat.flags = DDPF_FOURCC;
+		header.pixelFormat.fourCC = _description.dx10 ? DDS_FOURCC_DX10 : _description.fourCC;
+	}
+	else
+	{
+		header.pixelFormat.flags = DDPF_RGB;
+		header.pixelFormat.rgbBitCount = 32;
+		header.pixelFormat.rBitMask = _description.redMask;
+		header.pixelFormat.gBitMask = 0xff00;
+		header.pixelFormat.bBitMask = _description.redMask == 0xff ? 0xff0000 : 0xff;
+		header.pixelFormat.aBitMask = 0xff000000;
+	}
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+	if (_description.cube && !_description.dx10) header.caps2 = DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES;
+	memcpy(&file[4], &header, sizeof(header));
+
+	if (_description.dx10)
+	{
+		DdsHeaderDX10 dx10 = { _description.format, DDS_DIMENSION_TEXTURE2D, _description.cube ? DDS_RESOURCE_MISC_TEXTURECUBE : 0u, _description.arraySize, 0 };
+		memcpy(&file[4 + sizeof(header)], &dx10, sizeof(dx10));
+	}
+	file.resize(file.size() + _description.payload);
+	return file;
+}
+
+// A .ktx2 file with its levels stored smallest first, each aligned to 16 bytes
+static std::vector<unsigned char> MakeKTX2(unsigned int _vkFormat, unsigned int _width, unsigned int _height, unsigned int _layers, unsigned int _faces,
+	unsigned int _levels, unsigned int _bytes, bool _compressed, unsigned int _supercompression)
+{
+	static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	size_t offset = 80 + 24 * (size_t)_levels;
+	std::vector<unsigned char> file(offset);
+	memcpy(&file[0], identifier, 12);
+	uint32_t header[9] = { _vkFormat, 1, _width, _height, 0, _layers, _faces, _levels, _supercompression };
+	memcpy(&file[12], header, sizeof(header));
+
+	for (int level = (int)_levels - 1; level >= 0; level--)
+	{
+		size_t size = ChainSize(std::max(_width >> level, 1u), std::max(_height >> level, 1u), 1, _bytes, _compressed) * std::max(_layers, 1u) * _faces;
+		offset = (offset + 15) & ~(size_t)15;
+		file.resize(offset + size);
+		uint64_t index[3] = { offset, size, size };
+		memcpy(&file[80 + 24 * level], index, sizeof(index));
+		offset += size;
+	}
+	return file;
+}
+
+// Whether the subresources follow one another from an offset to the end of the file
+static bool Contiguous(const TextureContainerLayout& _layout, size_t _offset, size_t _size)
+{
+	for (auto& subresource : _layout.subresources)
+	{
+		if (subresource.offset != _offset) return false;
+		_offset += subresource.size;
+	}
+	return _offset == _size;
+}
+
+static bool InBounds(const TextureContainerLayout& _layout, size_t _size)
+{
+	for (auto& subresource : _layout.subresources)
+	{
+		if (subresource.offset > _size || subresource.size > _size - subresource.offset) return false;
+	}
+	return true;
+}
+
+static void TestLegacyDDS()
+{
+	TextureContainerLayout layout;
+
+	// FourCC block formats
+	std::vector<unsigned char> dxt1 = MakeDDS({ 256, 128, 9, 0x31545844u, 0, false, 0, 1, false, ChainSize(256, 128, 9, 8, true) });
+	CHECK(TextureContainer::Parse(dxt1.data(), dxt1.size(), layout));
+	CHECK(layout.format == DDS_DXGI_FORMAT_BC1_UNORM && layout.mipCount == 9 && layout.arraySize == 1 && !layout.cubemap);
+	CHECK(Contiguous(layout, 128, dxt1.size()));
+	CHECK(layout.subresources[0].rowPitch == 64 * 8 && layout.subresources[0].slicePitch == layout.subresources[0].size);
+	CHECK(layout.subresources[8].width == 1 && layout.subresources[8].height == 1 && layout.subresources[8].size == 8);
+
+	std::vector<unsigned char> dxt5 = MakeDDS({ 256, 128, 9, 0x35545844u, 0, false, 0, 1, false, ChainSize(256, 128, 9, 16, true) });
+	CHECK(TextureContainer::Parse(dxt5.data(), dxt5.size(), layout) && layout.format == DDS_DXGI_FORMAT_BC3_UNORM);
+	std::vector<unsigned char> ati1 = MakeDDS({ 64, 64, 7, 0x31495441u, 0, false, 0, 1, false, ChainSize(64, 64, 7, 8, true) });
+	CHECK(TextureContainer::Parse(ati1.data(), ati1.size(), layout) && layout.format == DDS_DXGI_FORMAT_BC4_UNORM);
+	std::vector<unsigned char> ati2 = MakeDDS({ 64, 64, 7, 0x32495441u, 0, false, 0, 1, false, ChainSize(64, 64, 7, 16, true) });
+	CHECK(TextureContainer::Parse(ati2.data(), ati2.size(), layout) && layout.format == DDS_DXGI_FORMAT_BC5_UNORM);
+
+	// RGB masks, with a size that isn't a power of two
+	std::vector<unsigned char> rgba = MakeDDS({ 30, 20, 5, 0, 0xff, false, 0, 1, false, ChainSize(30, 20, 5, 4, false) });
+	CHECK(TextureContainer::Parse(rgba.data(), rgba.size(), layout) && layout.format == DDS_DXGI_FORMAT_R8G8B8A8_UNORM);
+	CHECK(layout.subresources[0].rowPitch == 120);
+	CHECK(layout.subresources[4].width == 1 && layout.subresources[4].height == 1);
+	std::vector<unsigned char> bgra = MakeDDS({ 30, 20, 5, 0, 0xff0000, false, 0, 1, false, ChainSize(30, 20, 5, 4, false) });
+	CHECK(TextureContainer::Parse(bgra.data(), bgra.size(), layout) && layout.format == DDS_DXGI_FORMAT_B8G8R8A8_UNORM);
+
+	// A cube map: six faces, each with its own chain
+	std::vector<unsigned char> cube = MakeDDS({ 64, 64, 7, 0x31545844u, 0, false, 0, 1, true, 6 * ChainSize(64, 64, 7, 8, true) });
+	CHECK(TextureContainer::Parse(cube.data(), cube.size(), layout));
+	CHECK(layout.cubemap && layout.arraySize == 6 && layout.subresources.size() == 42);
+	CHECK(Contiguous(layout, 128, cube.size()));
+	CHECK(layout.subresources[7].offset == 128 + ChainSize(64, 64, 7, 8, true) && layout.subresources[7].width == 64);
+}
+
+static void TestDX10()
+{
+	TextureContainerLayout layout;
+
+	std::vector<unsigned char> cubes = MakeDDS({ 32, 32, 6, 0, 0, true, DDS_DXGI_FORMAT_BC7_UNORM, 2, true, 12 * ChainSize(32, 32, 6, 16, true) });
+	CHECK(TextureContainer::Parse(cubes.data(), cubes.size(), layout));
+	CHECK(layout.cubemap && layout.arraySize == 12 && layout.subresources.size() == 72);
+
+	std::vector<unsigned char> array = MakeDDS({ 16, 8, 5, 0, 0, true, DDS_DXGI_FORMAT_R8_UNORM, 4, false, 4 * ChainSize(16, 8, 5, 1, false) });
+	CHECK(TextureContainer::Parse(array.data(), array.size(), layout));
+	CHECK(!layout.cubemap && layout.arraySize == 4 && Contiguous(layout, 148, array.size()));
+}
+
+static void TestBrokenDDS()
+{
+	TextureContainerLayout layout;
+	std::vector<unsigned char> valid = MakeDDS({ 64, 64, 7, 0, 0, true, DDS_DXGI_FORMAT_BC7_UNORM, 1, false, ChainSize(64, 64, 7, 16, true) });
+	CHECK(TextureContainer::Parse(valid.data(), valid.size(), layout));
+
+	// One field wrong at a time: its offset in the file, and the value
+	struct Corruption
+	{
+		size_t		offset;
+		uint32_t	value;
+	};
+	const Corruption corruptions[] = {
+		{ 0, 0x58534444u },			// Magic
+		{ 4, 123 },					// Header size
+		{ 4 + 12, 0 },				// Width of 0
+		{ 4 + 12, 32768 },			// Wider than D3D11 allows
+		{ 4 + 24, 8 },				// More mips than 64x64 has
+		{ 128, 12345 },				// A format containers don't hold
+		{ 132, 4 },					// A volume texture
+		{ 140, 0 },					// No array slices
+		{ 140, 0xffffffffu },		// Far more slices than the file holds
+	};
+	for (auto& corruption : corruptions)
+	{
+		std::vector<unsigned char> broken = valid;
+		memcpy(&broken[corruption.offset], &corruption.value, 4);
+		CHECK(!TextureContainer::Parse(broken.data(), broken.size(), layout));
+	}
+
+	// Every truncation is turned away, as is nothing at all
+	bool truncationsRejected = true;
+	for (size_t size = 0; size < valid.size(); size++)
+	{
+		if (TextureContainer::Parse(valid.data(), size, layout)) truncationsRejected = false;
+	}
+	CHECK(truncationsRejected);
+	CHECK(!TextureContainer::Parse(nullptr, 0, layout));
+
+	// Bytes past the last mip are never taken as part of it
+	std::vector<unsigned char> longer = valid;
+	longer.push_back(0);
+	CHECK(!TextureContainer::Parse(longer.data(), longer.size(), layout) || Contiguous(layout, 148, valid.size()));
+}
+
+static void TestKTX2()
+{
+	TextureContainerLayout layout;
+
+	// Levels are stored smallest first, but laid out largest first
+	std::vector<unsigned char> bc7 = MakeKTX2(VK_FORMAT_BC7_UNORM_BLOCK, 64, 32, 0, 1, 7, 16, true, 0);
+	CHECK(TextureContainer::Parse(bc7.data(), bc7.size(), layout));
+	CHECK(layout.format == DDS_DXGI_FORMAT_BC7_UNORM && layout.mipCount == 7 && layout.arraySize == 1);
+	CHECK(layout.subresources.size() == 7 && layout.subresources[0].size == 16 * 8 * 16);
+	CHECK(layout.subresources[0].offset > layout.subresources[1].offset);
+
+	// In an array, each level holds every layer, so slice 1's top mip follows slice 0's
+	std::vector<unsigned char> array = MakeKTX2(VK_FORMAT_R8G8B8A8_UNORM, 16, 16, 3, 1, 5, 4, false, 0);
+	CHECK(TextureContainer::Parse(array.data(), array.size(), layout));
+	CHECK(layout.format == DDS_DXGI_FORMAT_R8G8B8A8_UNORM && layout.arraySize == 3 && layout.subresources.size() == 15);
+	CHECK(layout.subresources[5].offset == layout.subresources[0].offset + layout.subresources[0].size);
+
+	std::vector<unsigned char> cube = MakeKTX2(VK_FORMAT_BC7_UNORM_BLOCK, 32, 32, 0, 6, 6, 16, true, 0);
+	CHECK(TextureContainer::Parse(cube.data(), cube.size(), layout) && layout.cubemap && layout.arraySize == 6);
+
+	// Supercompressed, cut short, or with a level past the end
+	std::vector<unsigned char> supercompressed = MakeKTX2(VK_FORMAT_BC7_UNORM_BLOCK, 32, 32, 0, 1, 6, 16, true, 1);
+	CHECK(!TextureContainer::Parse(supercompressed.data(), supercompressed.size(), layout));
+	bool truncationsRejected = true;
+	for (size_t size = 0; size < bc7.size(); size++)
+	{
+		if (TextureContainer::Parse(bc7.data(), size, layout)) truncationsRejected = false;
+	}
+	CHECK(truncationsRejected);
+	std::vector<unsigned char> outside = bc7;
+	uint64_t huge = ~0ull;
+	memcpy(&outside[80], &huge, 8);
+	CHECK(!TextureContainer::Parse(outside.data(), outside.size(), layout));
+}
+
+static void TestFuzz()
+{
+	std::vector<std::vector<unsigned char>> seeds = {
+		MakeDDS({ 64, 64, 7, 0, 0, true, DDS_DXGI_FORMAT_BC7_UNORM, 1, false, ChainSize(64, 64, 7, 16, true) }),
+		MakeDDS({ 64, 64, 7, 0x31545844u, 0, false, 0, 1, true, 6 * ChainSize(64, 64, 7, 8, true) }),
+		MakeDDS({ 30, 20, 5, 0, 0xff, false, 0, 1, false, ChainSize(30, 20, 5, 4, false) }),
+		MakeKTX2(VK_FORMAT_BC7_UNORM_BLOCK, 64, 32, 0, 1, 7, 16, true, 0),
+		MakeKTX2(VK_FORMAT_R8G8B8A8_UNORM, 16, 16, 3, 1, 5, 4, false, 0),
+	};
+
+	// A few bytes of the headers changed at random, and sometimes the file cut short: whatever is accepted lies inside the file
+	std::mt19937 random(7);
+	bool inBounds = true;
+	for (int i = 0; i < 100000; i++)
+	{
+		std::vector<unsigned char> file = seeds[i % seeds.size()];
+		int flips = 1 + random() % 4;
+		for (int f = 0; f < flips; f++)
+		{
+			file[random() % std::min<size_t>(file.size(), 200)] = (unsigned char)random();
+		}
+		if (random() % 8 == 0) file.resize(random() % file.size());
+
+		TextureContainerLayout layout;
+		if (TextureContainer::Parse(file.data(), file.size(), layout) && !InBounds(layout, file.size())) inBounds = false;
+	}
+	CHECK(inBounds);
+}
+
+int main()
+{
+	TestLegacyDDS();
+	TestDX10();
+	TestBrokenDDS();
+	TestKTX2();
+	TestFuzz();
+	return CheckResult("TextureContainer");
+}
@@ -0,0 +1,197 @@
+// --------------------------------------------------------
+// Tests that TexturePacker packs losslessly: every packed
+// texel holds exactly the source texel under its center (or
+// the channel's value), and a source a whole multiple smaller
+// comes back whole, each texel repeated over its block. Runs
+// over the game's roughness and metal maps and over random
+// sources of mixed sizes, and checks IsUniform
+//
+// Build it on its own and run it from this folder, e.g.
+//   g++ -std=c++14 -I.. TestTexturePacker.cpp ../TexturePacker.cpp ../PngDecoder.cpp -o testtexturepacker
+//   ./testtexturepacker ../Assets/Textures
+// --------------------------------------------------------
+#include "../TexturePacker.h"
+#include "Check.h"
+
+#include <random>
+#include <string>
+
+static std::string textureFolder = "../Assets/Textures";
+
+// Whether each packed texel holds what it should, worked out here rather than with the packer's own sampling
+static bool MatchesSources(const DecodedImage* const _sources[ORM_CHANNELS], const unsigned char _values[ORM_CHANNELS], const DecodedImage& _packed)
+{
+	if (_packed.pixels.size() != (size_t)_packed.width * _packed.height * 4) return false;
+
+	for (unsigned int y = 0; y < _packed.height; y++)
+	{
+		for (unsigned int x = 0; x < _packed.width; x++)
+		{
+			const unsigned char* texel = &_packed.pixels[((size_t)y * _packed.width + x) * 4];
+			if (texel[3] != 255) return false;
+			for (int c = 0; c < ORM_CHANNELS; c++)
+			{
+				unsigned char expected = _values[c];
+				if (_sources[c] != 0)
+				{
+					// The source texel the packed texel's center falls in, (x + 1/2) / width of the way across, kept in whole numbers
+					const DecodedImage& source = *_sources[c];
+					size_t sx = ((size_t)x * 2 + 1) * source.width / ((size_t)_packed.width * 2);
+					size_t sy = ((size_t)y * 2 + 1) * source.height / ((size_t)_packed.height * 2);
+					expected = source.pixels[(sy * source.width + sx) * 4];
+				}
+				if (texel[c] != expected) return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Whether a source a whole multiple smaller than the packed image fills each of its blocks with its texel
+static bool RepeatsWhole(const DecodedImage& _packed, int _channel, const DecodedImage& _source)
+{
+	if (_packed.width % _source.width || _packed.height % _source.height) return true;
+
+	unsigned int blockWidth = _packed.width / _source.width;
+	unsigned int blockHeight = _packed.height / _source.height;
+	for (unsigned int y = 0; y < _packed.height; y++)
+	{
+		for (unsigned int x = 0; x < _packed.width; x++)
+		{
+			unsigned char value = _source.pixels[((size_t)(y / blockHeight) * _source.width + x / blockWidth) * 4];
+			if (_packed.pixels[((size_t)y * _packed.width + x) * 4 + _channel] != value) return false;
+		}
+	}
+	return true;
+}
+
+static DecodedImage MakeImage(unsigned int _width, unsigned int _height, std::mt19937& _random)
+{
+	DecodedImage image = { _width, _height, {} };
+	image.pixels.resize((size_t)_width * _height * 4);
+	for (auto& pixel : image.pixels)
+	{
+		pixel = (unsigned char)_random();
+	}
+	return image;
+}
+
+static void TestUniform()
+{
+	unsigned char texel[4];
+	DecodedImage flat = { 5, 3, std::vector<unsigned char>(5 * 3 * 4, 77) };
+	CHECK(TexturePacker::IsUniform(flat, texel) && texel[0] == 77 && texel[3] == 77);
+
+	// Any one channel of any one texel breaks it
+	for (size_t i = 0; i < flat.pixels.size(); i += 7)
+	{
+		DecodedImage spotted = flat;
+		spotted.pixels[i] = 78;
+		CHECK(!TexturePacker::IsUniform(spotted, texel));
+	}
+
+	DecodedImage single = { 1, 1, { 1, 2, 3, 4 } };
+	CHECK(TexturePacker::IsUniform(single, texel) && texel[0] == 1 && texel[1] == 2 && texel[2] == 3 && texel[3] == 4);
+}
+
+static void TestGameMaps()
+{
+	const char* folders[] = { "PBR", "PBR", "PBR", "PBR", "PBR", "PBR", "PBR", "Transparent" };
+	const char* names[] = { "bronze", "cobblestone", "floor", "paint", "rough", "scratched", "wood", "fence" };
+
+	// Roughness and metal into G and B, as LoadORM packs them, with one-color maps left to their values
+	for (int i = 0; i < 8; i++)
+	{
+		std::string stem = textureFolder + "/" + folders[i] + "/" + names[i];
+		DecodedImage roughness;
+		DecodedImage metal;
+		CHECK(PngDecoder::DecodeFile(stem + "_roughness.png", roughness));
+		CHECK(PngDecoder::DecodeFile(stem + "_metal.png", metal));
+		if (roughness.pixels.empty() || metal.pixels.empty()) continue;
+
+		unsigned char values[ORM_CHANNELS] = { ormDefaults[0], ormDefaults[1], ormDefaults[2] };
+		const DecodedImage* sources[ORM_CHANNELS] = { 0, &roughness, &metal };
+		unsigned char texel[4];
+		if (TexturePacker::IsUniform(roughness, texel))
+		{
+			sources[ORM_ROUGHNESS] = 0;
+			values[ORM_ROUGHNESS] = texel[0];
+		}
+		if (TexturePacker::IsUniform(metal, texel))
+		{
+			sources[ORM_METALNESS] = 0;
+			values[ORM_METALNESS] = texel[0];
+		}
+
+		DecodedImage packed;
+		TexturePacker::Pack(sources, values, packed);
+		CHECK(MatchesSources(sources, values, packed));
+		for (int c = 0; c < ORM_CHANNELS; c++)
+		{
+			if (sources[c] != 0) CHECK(RepeatsWhole(packed, c, *sources[c]));
+		}
+	}
+}
+
+static void TestMixedSizes()
+{
+	// Powers of two (which divide each other) and odd sizes (which don't), with a channel sometimes left to its value
+	std::mt19937 random(50);
+	bool matched = true;
+	bool whole = true;
+	for (int i = 0; i < 3000; i++)
+	{
+		DecodedImage images[ORM_CHANNELS];
+		const DecodedImage* sources[ORM_CHANNELS];
+		unsigned char values[ORM_CHANNELS];
+		for (int c = 0; c < ORM_CHANNELS; c++)
+		{
+			values[c] = (unsigned char)random();
+			sources[c] = 0;
+			if (random() % 4 == 0) continue;
+
+			unsigned int base = 1u << (random() % 7);
+			unsigned int width = random() % 3 ? base : 1 + random() % 70;
+			unsigned int height = random() % 3 ? base : 1 + random() % 70;
+			images[c] = MakeImage(width, height, random);
+			sources[c] = &images[c];
+		}
+
+		DecodedImage packed;
+		TexturePacker::Pack(sources, values, packed);
+		if (!MatchesSources(sources, values, packed)) matched = false;
+		for (int c = 0; c < ORM_CHANNELS; c++)
+		{
+			if (sources[c] != 0 && !RepeatsWhole(packed, c, *sources[c])) whole = false;
+		}
+	}
+	CHECK(matched);
+	CHECK(whole);
+
+	// With no sources it's one texel of the values
+	const DecodedImage* none[ORM_CHANNELS] = {};
+	unsigned char values[ORM_CHANNELS] = { 1, 2, 3 };
+	DecodedImage packed;
+	TexturePacker::Pack(none, values, packed);
+	CHECK(packed.width == 1 && packed.height == 1 && packed.pixels.size() == 4);
+	CHECK(packed.pixels[0] == 1 && packed.pixels[1] == 2 && packed.pixels[2] == 3 && packed.pixels[3] == 255);
+
+	// The checks here notice a single wrong bit
+	std::mt19937 more(51);
+	DecodedImage source = MakeImage(16, 8, more);
+	const DecodedImage* sources[ORM_CHANNELS] = { &source, 0, &source };
+	TexturePacker::Pack(sources, values, packed);
+	CHECK(MatchesSources(sources, values, packed));
+	packed.pixels[5 * 4 + 2] ^= 1;
+	CHECK(!MatchesSources(sources, values, packed));
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1) textureFolder = argv[1];
+
+	TestUniform();
+	TestGameMaps();
+	TestMixedSizes();
+	return CheckResult("TexturePacker");
+}
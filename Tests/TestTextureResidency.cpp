@@ -0,0 +1,268 @@
+// --------------------------------------------------------
+// Tests TextureResidency along simulated camera paths: forty
+// textures on sixty objects down a corridor, flown through
+// and back under a roomy and a tight budget. Every frame has
+// to stay under the budget and the upload limit, with the
+// counted bytes matching the resident mips; a still camera
+// has to settle and stop loading; a halved budget has to
+// spread the blur evenly; and removing a texture gives its
+// memory back
+//
+// Nothing here needs a device. Build it on its own, e.g.
+//   g++ -std=c++14 -I.. TestTextureResidency.cpp ../TextureResidency.cpp -o testtextureresidency
+// --------------------------------------------------------
+#include "../TextureResidency.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+static const unsigned int textureCount = 40;
+static const float screenHeight = 720;
+static const float tanHalfFovY = 0.57735f;
+
+struct TestObject
+{
+	float							x;
+	float							z;
+	float							radius;
+	float							uvDensity;
+	float							uvScale;
+	std::vector<unsigned int>		textures;
+};
+
+struct PathResult
+{
+	unsigned int					violations;		// Frames over the budget or upload limit, or with the bytes miscounted
+	unsigned int					loads;
+	unsigned int					evictions;
+	double							sharp;			// Average share of asked for textures with their wanted mip resident
+};
+
+// Mostly 1024s, with a few 2048s and 512s, like the materials
+static void AddTextures(TextureResidency& _residency)
+{
+	for (unsigned int i = 0; i < textureCount; i++)
+	{
+		unsigned int size = i % 10 == 0 ? 2048 : i % 4 == 0 ? 512 : 1024;
+		_residency.Add(size, size);
+	}
+}
+
+// Sixty objects along a 300 unit corridor, each drawn with two to four of the textures
+static std::vector<TestObject> MakeObjects()
+{
+	std::mt19937 random(5);
+	std::vector<TestObject> objects;
+	for (int i = 0; i < 60; i++)
+	{
+		TestObject object;
+		object.x = (float)(random() % 12) - 6;
+		object.z = i * 5.0f;
+		object.radius = 1.0f + random() % 3;
+		object.uvDensity = 0.05f * (1 + random() % 8);
+		object.uvScale = 1.0f + random() % 2;
+		unsigned int count = 2 + random() % 3;
+		for (unsigned int k = 0; k < count; k++)
+		{
+			object.textures.push_back(random() % textureCount);
+		}
+		objects.push_back(object);
+	}
+	return objects;
+}
+
+// One frame with the camera at (x, z) looking down the corridor one way or the other; true if every invariant held
+static bool RunFrame(TextureResidency& _residency, const std::vector<TestObject>& _objects, float _x, float _z, float _forward, unsigned long long _budget)
+{
+	_residency.BeginFrame();
+	for (auto& object : _objects)
+	{
+		float dz = object.z - _z;
+		float dx = object.x - _x;
+		if (dz * _forward < -object.radius) continue;
+		float distance = std::max(sqrtf(dx * dx + dz * dz) - object.radius, 0.1f);
+		if (distance > 200) continue;
+		float uvPerPixel = TextureResidency::GetUVPerPixel(object.uvDensity, object.uvScale, distance, screenHeight, tanHalfFovY);
+		for (unsigned int texture : object.textures)
+		{
+			_residency.Request(texture, uvPerPixel);
+		}
+	}
+
+	unsigned int before[textureCount];
+	for (unsigned int i = 0; i < textureCount; i++)
+	{
+		before[i] = _residency.GetTexture(i).residentMip;
+	}
+	_residency.Update();
+	TextureResidencyStats stats = _residency.GetStats();
+
+	bool valid = true;
+	unsigned long long resident = 0;
+	unsigned long long largestLoad = 0;
+	for (unsigned int i = 0; i < textureCount; i++)
+	{
+		const ResidentTexture& texture = _residency.GetTexture(i);
+		if (texture.residentMip > texture.tailMip) valid = false;
+		for (unsigned int m = texture.residentMip; m < texture.mipCount; m++)
+		{
+			resident += TextureResidency::GetMipBytes(texture.width, texture.height, m);
+		}
+		for (unsigned int m = texture.residentMip; m < before[i]; m++)
+		{
+			largestLoad = std::max(largestLoad, TextureResidency::GetMipBytes(texture.width, texture.height, m));
+		}
+
+		// A texture whose mips changed is reported as changed
+		bool reported = std::find(_residency.GetChanged().begin(), _residency.GetChanged().end(), i) != _residency.GetChanged().end();
+		if (texture.residentMip != before[i] && !reported) valid = false;
+	}
+	if (resident != stats.residentBytes || stats.residentBytes > _budget) valid = false;
+	if (stats.uploadedBytes > TEXTURE_RESIDENCY_UPLOAD_BYTES && stats.uploadedBytes != largestLoad) valid = false;
+	return valid;
+}
+
+// Flies down the corridor and back at 10 units a second, 60 frames a second, weaving side to side
+static PathResult FlyThrough(TextureResidency& _residency, const std::vector<TestObject>& _objects, unsigned long long _budget)
+{
+	PathResult result = {};
+	const int frames = 1800;
+	for (int i = 0; i < 2 * frames; i++)
+	{
+		bool back = i >= frames;
+		int step = back ? i - frames : i;
+		float z = back ? 280 - step * 10 / 60.0f : -20 + step * 10 / 60.0f;
+		if (!RunFrame(_residency, _objects, 5 * sinf(step * 0.01f), z, back ? -1.0f : 1.0f, _budget)) result.violations++;
+
+		TextureResidencyStats stats = _residency.GetStats();
+		result.loads += stats.loads;
+		result.evictions += stats.evictions;
+		result.sharp += (stats.requested ? (double)stats.satisfied / stats.requested : 1) / (2 * frames);
+	}
+	return result;
+}
+
+static void TestRoomyBudget()
+{
+	const unsigned long long budget = 96ull << 20;
+	TextureResidency residency(budget);
+	AddTextures(residency);
+	std::vector<TestObject> objects = MakeObjects();
+
+	// Everything asked for fits, so nothing in use is ever dropped and every texture stays sharp
+	PathResult result = FlyThrough(residency, objects, budget);
+	CHECK(result.violations == 0);
+	CHECK(result.loads > 0 && result.evictions > 0);
+	CHECK(result.sharp > 0.99);
+
+	// A still camera settles, then stops loading and evicting
+	unsigned int quiet = 0;
+	for (int i = 0; i < 300; i++)
+	{
+		CHECK(RunFrame(residency, objects, 0, 140, 1, budget));
+		if (i >= 200) quiet += residency.GetStats().loads + residency.GetStats().evictions;
+	}
+	TextureResidencyStats stats = residency.GetStats();
+	CHECK(quiet == 0);
+	CHECK(stats.satisfied == stats.requested && stats.mipDeficit == 0);
+	CHECK(stats.neededEvictions == 0);
+}
+
+static void TestTightBudget()
+{
+	// Under half what the corridor asks for on average
+	unsigned long long budget = 16ull << 20;
+	TextureResidency residency(budget);
+	AddTextures(residency);
+	std::vector<TestObject> objects = MakeObjects();
+
+	PathResult result = FlyThrough(residency, objects, budget);
+	CHECK(result.violations == 0);
+	CHECK(result.sharp > 0.75 && result.sharp < 1);
+
+	unsigned int quiet = 0;
+	for (int i = 0; i < 300; i++)
+	{
+		CHECK(RunFrame(residency, objects, 0, 140, 1, budget));
+		if (i >= 200) quiet += residency.GetStats().loads + residency.GetStats().evictions;
+	}
+	CHECK(quiet == 0);
+
+	// Halving the budget again evicts down under it and settles, with the blur evened out: no texture is more
+	// than two levels shorter than one that could still give up a mip (FindVictim's rule, so the two can't trade back)
+	budget /= 2;
+	residency.SetBudget(budget);
+	for (int i = 0; i < 300; i++)
+	{
+		CHECK(RunFrame(residency, objects, 0, 140, 1, budget));
+	}
+	CHECK(residency.GetStats().loads == 0 && residency.GetStats().evictions == 0);
+	CHECK(residency.GetStats().mipDeficit > 0);
+
+	unsigned int mostShort = 0;
+	unsigned int leastShortGiving = TEXTURE_RESIDENCY_MAX_MIPS;
+	for (unsigned int i = 0; i < textureCount; i++)
+	{
+		const ResidentTexture& texture = residency.GetTexture(i);
+		if (texture.wantedMip >= texture.mipCount) continue;
+		unsigned int shortBy = texture.residentMip > texture.wantedMip ? texture.residentMip - texture.wantedMip : 0;
+		mostShort = std::max(mostShort, shortBy);
+		if (texture.residentMip < texture.tailMip) leastShortGiving = std::min(leastShortGiving, shortBy);
+	}
+	CHECK(mostShort <= leastShortGiving + 2);
+}
+
+static unsigned long long MipBytes(unsigned int _width, unsigned int _height, unsigned int _first, unsigned int _mipCount)
+{
+	unsigned long long bytes = 0;
+	for (unsigned int m = _first; m < _mipCount; m++)
+	{
+		bytes += TextureResidency::GetMipBytes(_width, _height, m);
+	}
+	return bytes;
+}
+
+static void UpdateFrame(TextureResidency& _residency, int _texture, float _uvPerPixel)
+{
+	_residency.BeginFrame();
+	if (_texture >= 0) _residency.Request(_texture, _uvPerPixel);
+	_residency.Update();
+}
+
+static void TestAddRemove()
+{
+	TextureResidency residency(64ull << 20);
+
+	// A new texture has only its tail, 64x64 down to 1x1
+	unsigned int id = residency.Add(1024, 512);
+	CHECK(residency.GetTexture(id).mipCount == 11);
+	CHECK(residency.GetTexture(id).tailMip == 4 && residency.GetTexture(id).residentMip == 4);
+	UpdateFrame(residency, -1, 0);
+	CHECK(residency.GetStats().residentBytes == MipBytes(1024, 512, 4, 11));
+
+	// Asking for full detail loads every level down to it
+	for (int frame = 0; frame < 10; frame++)
+	{
+		UpdateFrame(residency, id, 1.0f / 1024);
+	}
+	CHECK(residency.GetTexture(id).residentMip == 0);
+	CHECK(residency.GetStats().residentBytes == MipBytes(1024, 512, 0, 11));
+
+	// Removing gives all of it back, and leaves the other ids alone
+	unsigned int other = residency.Add(256, 256);
+	residency.Remove(id);
+	UpdateFrame(residency, -1, 0);
+	CHECK(residency.GetTexture(id).mipCount == 0);
+	CHECK(residency.GetTexture(other).width == 256 && residency.GetTexture(other).residentMip == 2);
+	CHECK(residency.GetStats().residentBytes == MipBytes(256, 256, 2, 9));
+}
+
+int main()
+{
+	TestRoomyBudget();
+	TestTightBudget();
+	TestAddRemove();
+	return CheckResult("TextureResidency");
+}
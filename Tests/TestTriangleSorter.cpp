@@ -0,0 +1,143 @@
+// --------------------------------------------------------
+// Tests TriangleSorter on a UV sphere: direction buckets,
+// back-to-front order for a bucket, and the order cache
+// (hits, evictions, and re-sorts under an orbiting camera)
+//
+// Only DirectXMath's types are used, so nothing needs a
+// device. Build it on its own, e.g.
+//   cl /EHsc /I.. TestTriangleSorter.cpp ..\TriangleSorter.cpp
+// --------------------------------------------------------
+#include "../TriangleSorter.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+struct TestMesh
+{
+	std::vector<XMFLOAT3>		positions;
+	std::vector<unsigned int>	indices;
+};
+
+static TestMesh MakeSphere(int _rings, int _segments)
+{
+	TestMesh mesh;
+	for (int r = 0; r <= _rings; r++)
+	{
+		for (int s = 0; s <= _segments; s++)
+		{
+			float theta = 3.14159265f * r / _rings;
+			float phi = 6.28318531f * s / _segments;
+			mesh.positions.push_back(XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+		}
+	}
+	for (int r = 0; r < _rings; r++)
+	{
+		for (int s = 0; s < _segments; s++)
+		{
+			unsigned int a = r * (_segments + 1) + s;
+			unsigned int c = a + _segments + 1;
+			unsigned int quad[6] = { a, c, a + 1, a + 1, c, c + 1 };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	return mesh;
+}
+
+static void TestBuckets()
+{
+	// Every bucket's center direction falls back in that bucket
+	for (int b = 0; b < TRIANGLESORT_BUCKET_COUNT; b++)
+	{
+		CHECK(TriangleSorter::GetBucket(TriangleSorter::GetBucketDirection(b)) == b);
+	}
+
+	// Length doesn't matter, and a zero direction still gets a bucket
+	CHECK(TriangleSorter::GetBucket(XMFLOAT3(1, 2, 3)) == TriangleSorter::GetBucket(XMFLOAT3(10, 20, 30)));
+	CHECK(TriangleSorter::GetBucket(XMFLOAT3(0, 0, 0)) == 0);
+	CHECK(TriangleSorter::GetBucket(XMFLOAT3(1, 0, 0)) != TriangleSorter::GetBucket(XMFLOAT3(-1, 0, 0)));
+}
+
+static void TestOrder()
+{
+	TestMesh mesh = MakeSphere(24, 48);
+	TriangleSorter sorter(mesh.positions.data(), sizeof(XMFLOAT3), mesh.indices.data(), (unsigned int)mesh.indices.size());
+
+	int bucket = TriangleSorter::GetBucket(XMFLOAT3(0.3f, -0.5f, 0.8f));
+	const std::vector<unsigned int>& sorted = sorter.GetIndices(bucket);
+	CHECK(sorted.size() == mesh.indices.size());
+
+	// Triangles further along the bucket's direction (nearer the camera) come later
+	XMFLOAT3 direction = TriangleSorter::GetBucketDirection(bucket);
+	float last = -1e9f;
+	bool ordered = true;
+	for (size_t t = 0; t + 2 < sorted.size(); t += 3)
+	{
+		float depth = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const XMFLOAT3& p = mesh.positions[sorted[t + k]];
+			depth += (p.x * direction.x + p.y * direction.y + p.z * direction.z) / 3;
+		}
+		if (depth < last - 1e-5f) ordered = false;
+		last = depth;
+	}
+	CHECK(ordered);
+
+	// Same triangles, only reordered
+	std::vector<unsigned int> before = mesh.indices;
+	std::vector<unsigned int> after = sorted;
+	std::sort(before.begin(), before.end());
+	std::sort(after.begin(), after.end());
+	CHECK(before == after);
+}
+
+static void TestCache()
+{
+	TestMesh mesh = MakeSphere(8, 16);
+	TriangleSorter sorter(mesh.positions.data(), sizeof(XMFLOAT3), mesh.indices.data(), (unsigned int)mesh.indices.size());
+
+	sorter.GetIndices(5);
+	sorter.GetIndices(5);
+	TriangleSortStats stats = sorter.GetStats();
+	CHECK(stats.lookups == 2 && stats.sorts == 1 && stats.cachedOrders == 1);
+
+	// Past the limit, the oldest orders go first
+	for (int b = 0; b < TRIANGLESORT_MAX_CACHED_ORDERS + 8; b++)
+	{
+		sorter.GetIndices(b);
+	}
+	stats = sorter.GetStats();
+	CHECK(stats.cachedOrders == TRIANGLESORT_MAX_CACHED_ORDERS);
+	CHECK(stats.evictions == 8);
+	unsigned int sorts = stats.sorts;
+	sorter.GetIndices(TRIANGLESORT_MAX_CACHED_ORDERS + 7);
+	CHECK(sorter.GetStats().sorts == sorts);
+	sorter.GetIndices(0);
+	CHECK(sorter.GetStats().sorts == sorts + 1);
+
+	// A camera orbiting once over a minute only re-sorts as it crosses into new buckets
+	TriangleSorter orbit(mesh.positions.data(), sizeof(XMFLOAT3), mesh.indices.data(), (unsigned int)mesh.indices.size());
+	int bucketChanges = 0;
+	int previous = -1;
+	for (int frame = 0; frame < 3600; frame++)
+	{
+		float angle = frame * 6.28318531f / 3600;
+		int bucket = TriangleSorter::GetBucket(XMFLOAT3(cosf(angle), 0.2f, sinf(angle)));
+		if (bucket != previous) bucketChanges++;
+		previous = bucket;
+		orbit.GetIndices(bucket);
+	}
+	CHECK(orbit.GetStats().sorts <= (unsigned int)bucketChanges);
+	CHECK(bucketChanges < 100);
+}
+
+int main()
+{
+	TestBuckets();
+	TestOrder();
+	TestCache();
+	return CheckResult("TriangleSorter");
+}
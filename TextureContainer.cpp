@@ -0,0 +1,310 @@
+#include "TextureContainer.h"
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// The 12 bytes every .ktx2 file starts with
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header
+	{
+		uint32_t							vkFormat;
+		uint32_t							typeSize;
+		uint32_t							pixelWidth;
+		uint32_t							pixelHeight;
+		uint32_t							pixelDepth;
+		uint32_t							layerCount;
+		uint32_t							faceCount;
+		uint32_t							levelCount;
+		uint32_t							supercompressionScheme;
+		uint32_t							dfdByteOffset;
+		uint32_t							dfdByteLength;
+		uint32_t							kvdByteOffset;
+		uint32_t							kvdByteLength;
+		uint32_t							sgdByteOffset[2];	// u64s, split so the struct has no padding
+		uint32_t							sgdByteLength[2];
+	};
+
+	struct Ktx2Level
+	{
+		uint64_t							byteOffset;
+		uint64_t							byteLength;
+		uint64_t							uncompressedByteLength;
+	};
+
+	// VkFormat values and the DXGI_FORMAT each one is
+	const unsigned int KTX2_FORMATS[][2] =
+	{
+		{ 9, DDS_DXGI_FORMAT_R8_UNORM },
+		{ 16, DDS_DXGI_FORMAT_R8G8_UNORM },
+		{ 37, DDS_DXGI_FORMAT_R8G8B8A8_UNORM },
+		{ 43, DDS_DXGI_FORMAT_R8G8B8A8_UNORM_SRGB },
+		{ 44, DDS_DXGI_FORMAT_B8G8R8A8_UNORM },
+		{ 50, DDS_DXGI_FORMAT_B8G8R8A8_UNORM_SRGB },
+		{ 97, DDS_DXGI_FORMAT_R16G16B16A16_FLOAT },
+		{ 109, DDS_DXGI_FORMAT_R32G32B32A32_FLOAT },
+		{ 131, DDS_DXGI_FORMAT_BC1_UNORM },
+		{ 132, DDS_DXGI_FORMAT_BC1_UNORM_SRGB },
+		{ 133, DDS_DXGI_FORMAT_BC1_UNORM },
+		{ 134, DDS_DXGI_FORMAT_BC1_UNORM_SRGB },
+		{ 135, DDS_DXGI_FORMAT_BC2_UNORM },
+		{ 136, DDS_DXGI_FORMAT_BC2_UNORM_SRGB },
+		{ 137, DDS_DXGI_FORMAT_BC3_UNORM },
+		{ 138, DDS_DXGI_FORMAT_BC3_UNORM_SRGB },
+		{ 139, DDS_DXGI_FORMAT_BC4_UNORM },
+		{ 140, DDS_DXGI_FORMAT_BC4_SNORM },
+		{ 141, DDS_DXGI_FORMAT_BC5_UNORM },
+		{ 142, DDS_DXGI_FORMAT_BC5_SNORM },
+		{ 143, DDS_DXGI_FORMAT_BC6H_UF16 },
+		{ 144, DDS_DXGI_FORMAT_BC6H_SF16 },
+		{ 145, DDS_DXGI_FORMAT_BC7_UNORM },
+		{ 146, DDS_DXGI_FORMAT_BC7_UNORM_SRGB },
+	};
+
+	uint32_t MakeFourCC(char _a, char _b, char _c, char _d)
+	{
+		return (uint32_t)(unsigned char)_a | ((uint32_t)(unsigned char)_b << 8) | ((uint32_t)(unsigned char)_c << 16) | ((uint32_t)(unsigned char)_d << 24);
+	}
+
+	// The format of a .dds without the DX10 header, from its fourCC or its channel masks
+	unsigned int GetLegacyFormat(const DdsPixelFormat& _pixelFormat)
+	{
+		if (_pixelFormat.flags & DDPF_FOURCC)
+		{
+			uint32_t fourCC = _pixelFormat.fourCC;
+			if (fourCC == MakeFourCC('D', 'X', 'T', '1')) return DDS_DXGI_FORMAT_BC1_UNORM;
+			if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3')) return DDS_DXGI_FORMAT_BC2_UNORM;
+			if (fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5')) return DDS_DXGI_FORMAT_BC3_UNORM;
+			if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) return DDS_DXGI_FORMAT_BC4_UNORM;
+			if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) return DDS_DXGI_FORMAT_BC5_UNORM;
+
+			// D3DFORMAT numbers some writers put here instead
+			if (fourCC == 113) return DDS_DXGI_FORMAT_R16G16B16A16_FLOAT;
+			if (fourCC == 116) return DDS_DXGI_FORMAT_R32G32B32A32_FLOAT;
+			return 0;
+		}
+
+		if ((_pixelFormat.flags & DDPF_RGB) && _pixelFormat.rgbBitCount == 32)
+		{
+			if (_pixelFormat.rBitMask == 0xFF && _pixelFormat.gBitMask == 0xFF00 && _pixelFormat.bBitMask == 0xFF0000) return DDS_DXGI_FORMAT_R8G8B8A8_UNORM;
+			if (_pixelFormat.rBitMask == 0xFF0000 && _pixelFormat.gBitMask == 0xFF00 && _pixelFormat.bBitMask == 0xFF) return DDS_DXGI_FORMAT_B8G8R8A8_UNORM;
+		}
+		return 0;
+	}
+
+	// The most mips a texture can have (down to 1x1)
+	unsigned int GetMaxMipCount(unsigned int _width, unsigned int _height)
+	{
+		unsigned int size = std::max(_width, _height);
+		unsigned int count = 1;
+		while (size > 1)
+		{
+			size >>= 1;
+			count++;
+		}
+		return count;
+	}
+
+	// Fills in a mip's size and pitches (but not where it is)
+	bool MeasureSubresource(unsigned int _bytes, bool _compressed, unsigned int _width, unsigned int _height, unsigned int _mip, TextureSubresource& _subresource)
+	{
+		_subresource = {};
+		_subresource.width = std::max(_width >> _mip, 1u);
+		_subresource.height = std::max(_height >> _mip, 1u);
+		size_t rows = _compressed ? (_subresource.height + 3) / 4 : _subresource.height;
+		size_t rowPitch = (size_t)(_compressed ? (_subresource.width + 3) / 4 : _subresource.width) * _bytes;
+
+		// D3D11_SUBRESOURCE_DATA's pitches are 32 bit
+		if (rowPitch * rows > 0xFFFFFFFFull) return false;
+		_subresource.rowPitch = (unsigned int)rowPitch;
+		_subresource.slicePitch = (unsigned int)(rowPitch * rows);
+		_subresource.size = _subresource.slicePitch;
+		return true;
+	}
+
+	// Checks what every container needs before its subresources are laid out
+	bool CheckLayout(const TextureContainerLayout& _layout)
+	{
+		unsigned int bytes;
+		bool compressed;
+		if (!TextureContainer::GetFormatInfo(_layout.format, bytes, compressed)) return false;
+		if (_layout.width == 0 || _layout.height == 0) return false;
+		if (_layout.width > TEXTURE_CONTAINER_MAX_DIMENSION || _layout.height > TEXTURE_CONTAINER_MAX_DIMENSION) return false;
+		if (_layout.mipCount == 0 || _layout.mipCount > GetMaxMipCount(_layout.width, _layout.height)) return false;
+		if (_layout.arraySize == 0 || _layout.arraySize > 2048) return false;
+		if (_layout.cubemap && (_layout.arraySize % 6 != 0 || _layout.width != _layout.height)) return false;
+		return true;
+	}
+}
+
+bool TextureContainer::Parse(const unsigned char* _data, size_t _size, TextureContainerLayout& _layout)
+{
+	if (_size >= sizeof(KTX2_IDENTIFIER) && memcmp(_data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) return ParseKTX2(_data, _size, _layout);
+	return ParseDDS(_data, _size, _layout);
+}
+
+bool TextureContainer::ParseDDS(const unsigned char* _data, size_t _size, TextureContainerLayout& _layout)
+{
+	uint32_t magic;
+	DdsHeader header;
+	if (_size < sizeof(magic) + sizeof(header)) return false;
+	memcpy(&magic, _data, sizeof(magic));
+	memcpy(&header, _data + sizeof(magic), sizeof(header));
+	if (magic != DDS_MAGIC || header.size != sizeof(DdsHeader) || header.pixelFormat.size != sizeof(DdsPixelFormat)) return false;
+	if ((header.flags & DDSD_DEPTH) || (header.caps2 & DDSCAPS2_VOLUME)) return false;
+
+	_layout = {};
+	_layout.width = header.width;
+	_layout.height = header.height;
+	_layout.mipCount = header.mipMapCount > 0 ? header.mipMapCount : 1;
+	size_t offset = sizeof(magic) + sizeof(header);
+
+	if ((header.pixelFormat.flags & DDPF_FOURCC) && header.pixelFormat.fourCC == DDS_FOURCC_DX10)
+	{
+		DdsHeaderDX10 extension;
+		if (_size < offset + sizeof(extension)) return false;
+		memcpy(&extension, _data + offset, sizeof(extension));
+		offset += sizeof(extension);
+		if (extension.resourceDimension != DDS_DIMENSION_TEXTURE2D || extension.arraySize > 2048) return false;
+
+		_layout.format = extension.dxgiFormat;
+		_layout.cubemap = (extension.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+		_layout.arraySize = extension.arraySize * (_layout.cubemap ? 6 : 1);
+	}
+	else
+	{
+		_layout.format = GetLegacyFormat(header.pixelFormat);
+
+		// Old cube maps have to have every face; a partial one can't be a D3D11 cube
+		_layout.cubemap = (header.caps2 & DDSCAPS2_CUBEMAP) != 0;
+		if (_layout.cubemap && (header.caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES) return false;
+		_layout.arraySize = _layout.cubemap ? 6 : 1;
+	}
+
+	if (!CheckLayout(_layout)) return false;
+	return LayOut(_layout, offset, _size);
+}
+
+bool TextureContainer::ParseKTX2(const unsigned char* _data, size_t _size, TextureContainerLayout& _layout)
+{
+	Ktx2Header header;
+	size_t levelsOffset = sizeof(KTX2_IDENTIFIER) + sizeof(header);
+	if (_size < levelsOffset || memcmp(_data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) return false;
+	memcpy(&header, _data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+
+	// Supercompressed levels would need inflating, which is the copy this is here to avoid
+	if (header.supercompressionScheme != 0 || header.pixelDepth > 1) return false;
+	if (header.faceCount != 1 && header.faceCount != 6) return false;
+
+	_layout = {};
+	for (auto& format : KTX2_FORMATS)
+	{
+		if (format[0] == header.vkFormat) _layout.format = format[1];
+	}
+	_layout.width = header.pixelWidth;
+	_layout.height = header.pixelHeight;
+	_layout.mipCount = header.levelCount > 0 ? header.levelCount : 1;
+	_layout.cubemap = header.faceCount == 6;
+	_layout.arraySize = (header.layerCount > 0 ? header.layerCount : 1) * header.faceCount;
+	if (!CheckLayout(_layout)) return false;
+	if (_size < levelsOffset + (size_t)_layout.mipCount * sizeof(Ktx2Level)) return false;
+
+	// Levels can be anywhere (they're usually smallest first); within one, each layer's faces follow each other
+	unsigned int bytes;
+	bool compressed;
+	GetFormatInfo(_layout.format, bytes, compressed);
+	_layout.subresources.resize((size_t)_layout.arraySize * _layout.mipCount);
+	for (unsigned int mip = 0; mip < _layout.mipCount; mip++)
+	{
+		Ktx2Level level;
+		memcpy(&level, _data + levelsOffset + mip * sizeof(Ktx2Level), sizeof(level));
+
+		TextureSubresource subresource;
+		if (!MeasureSubresource(bytes, compressed, _layout.width, _layout.height, mip, subresource)) return false;
+		if (level.byteLength != (uint64_t)subresource.size * _layout.arraySize) return false;
+		if (level.byteOffset > _size || level.byteLength > _size - level.byteOffset) return false;
+		for (unsigned int slice = 0; slice < _layout.arraySize; slice++)
+		{
+			subresource.offset = (size_t)level.byteOffset + (size_t)slice * subresource.size;
+			_layout.subresources[(size_t)slice * _layout.mipCount + mip] = subresource;
+		}
+	}
+	return true;
+}
+
+bool TextureContainer::GetFormatInfo(unsigned int _format, unsigned int& _bytes, bool& _compressed)
+{
+	_compressed = false;
+	switch (_format)
+	{
+	case DDS_DXGI_FORMAT_R32G32B32A32_FLOAT:
+		_bytes = 16;
+		return true;
+	case DDS_DXGI_FORMAT_R16G16B16A16_FLOAT:
+		_bytes = 8;
+		return true;
+	case DDS_DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DDS_DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DDS_DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DDS_DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		_bytes = 4;
+		return true;
+	case DDS_DXGI_FORMAT_R8G8_UNORM:
+		_bytes = 2;
+		return true;
+	case DDS_DXGI_FORMAT_R8_UNORM:
+		_bytes = 1;
+		return true;
+	}
+
+	_compressed = true;
+	switch (_format)
+	{
+	case DDS_DXGI_FORMAT_BC1_UNORM:
+	case DDS_DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DDS_DXGI_FORMAT_BC4_UNORM:
+	case DDS_DXGI_FORMAT_BC4_SNORM:
+		_bytes = 8;
+		return true;
+	case DDS_DXGI_FORMAT_BC2_UNORM:
+	case DDS_DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DDS_DXGI_FORMAT_BC3_UNORM:
+	case DDS_DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DDS_DXGI_FORMAT_BC5_UNORM:
+	case DDS_DXGI_FORMAT_BC5_SNORM:
+	case DDS_DXGI_FORMAT_BC6H_UF16:
+	case DDS_DXGI_FORMAT_BC6H_SF16:
+	case DDS_DXGI_FORMAT_BC7_UNORM:
+	case DDS_DXGI_FORMAT_BC7_UNORM_SRGB:
+		_bytes = 16;
+		return true;
+	}
+	return false;
+}
+
+bool TextureContainer::LayOut(TextureContainerLayout& _layout, size_t _offset, size_t _size)
+{
+	unsigned int bytes;
+	bool compressed;
+	if (!GetFormatInfo(_layout.format, bytes, compressed)) return false;
+
+	_layout.subresources.clear();
+	_layout.subresources.reserve((size_t)_layout.arraySize * _layout.mipCount);
+	for (unsigned int slice = 0; slice < _layout.arraySize; slice++)
+	{
+		for (unsigned int mip = 0; mip < _layout.mipCount; mip++)
+		{
+			TextureSubresource subresource;
+			if (!MeasureSubresource(bytes, compressed, _layout.width, _layout.height, mip, subresource)) return false;
+			subresource.offset = _offset;
+			if (_offset > _size || subresource.size > _size - _offset) return false;
+			_offset += subresource.size;
+			_layout.subresources.push_back(subresource);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// The largest texture a container may describe (D3D11's limit)
+constexpr auto TEXTURE_CONTAINER_MAX_DIMENSION = 16384;
+
+// Where one mip of one array slice (or cube face) sits in a container file
+struct TextureSubresource
+{
+	size_t									offset;				// From the start of the file
+	size_t									size;
+	unsigned int							width;
+	unsigned int							height;
+	unsigned int							rowPitch;			// Bytes per row of texels, or of 4x4 blocks
+	unsigned int							slicePitch;
+};
+
+// What a container holds, laid out for D3D11_SUBRESOURCE_DATA
+struct TextureContainerLayout
+{
+	unsigned int							format;				// A DXGI_FORMAT
+	unsigned int							width;
+	unsigned int							height;
+	unsigned int							mipCount;
+	unsigned int							arraySize;			// Counting each cube face
+	bool									cubemap;
+	std::vector<TextureSubresource>			subresources;		// Slice by slice, each slice's mips largest first (as D3D11CalcSubresource numbers them)
+};
+
+// --------------------------------------------------------
+// Reads the headers of pre-built texture files (.dds, with or
+// without the DX10 header, and .ktx2) and works out where
+// each subresource's data is, without copying any of it
+//
+// Headers are checked against each other and against the
+// file's size, so every subresource found lies inside the
+// file and has exactly the size its format and dimensions
+// call for. Only 2D textures, texture arrays and cube maps
+// in the formats GetFormatInfo knows are accepted; volume
+// textures and supercompressed KTX2 files are not.
+//
+// Nothing here knows about D3D beyond DXGI_FORMAT values;
+// ContainerTextureLoader makes textures from the layout.
+// --------------------------------------------------------
+class TextureContainer
+{
+public:
+											/// <summary>
+											/// Reads a container's headers, whichever kind it is
+											/// </summary>
+											/// <param name="_data">The whole file</param>
+											/// <param name="_size">The file's size in bytes</param>
+											/// <param name="_layout">Receives the texture's description and subresources</param>
+											/// <returns>Whether the file is a container this understands, and is complete</returns>
+	static bool								Parse(const unsigned char* _data, size_t _size, TextureContainerLayout& _layout);
+	static bool								ParseDDS(const unsigned char* _data, size_t _size, TextureContainerLayout& _layout);
+	static bool								ParseKTX2(const unsigned char* _data, size_t _size, TextureContainerLayout& _layout);
+
+											/// <summary>
+											/// Gets the size of a DXGI format's texels, or of its 4x4 blocks if it's block compressed
+											/// </summary>
+											/// <returns>Whether the format is one containers may hold</returns>
+	static bool								GetFormatInfo(unsigned int _format, unsigned int& _bytes, bool& _compressed);
+											/// <summary>
+											/// Lays out every subresource one after another from an offset, checking they fit in the file
+											/// </summary>
+											/// <returns>Whether they all fit</returns>
+	static bool								LayOut(TextureContainerLayout& _layout, size_t _offset, size_t _size);
+};
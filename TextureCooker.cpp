@@ -0,0 +1,818 @@
+#include "TextureCooker.h"
+#include "DdsFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTURE_COOKER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// 4 bit BC7 weights, out of 64
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// A block's texels by channel (so four texels load at once), as 0-255 floats
+	struct BlockTexels
+	{
+		float								channels[4][16];
+	};
+
+	struct BitWriter
+	{
+		unsigned char*						block;
+		unsigned int						bit;
+
+		void Write(unsigned int _value, unsigned int _bits)
+		{
+			for (unsigned int i = 0; i < _bits; i++, bit++)
+			{
+				if ((_value >> i) & 1) block[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const unsigned char*				block;
+		unsigned int						bit;
+
+		unsigned int Read(unsigned int _bits)
+		{
+			unsigned int value = 0;
+			for (unsigned int i = 0; i < _bits; i++, bit++)
+			{
+				value |= (unsigned int)((block[bit >> 3] >> (bit & 7)) & 1) << i;
+			}
+			return value;
+		}
+	};
+
+	// Picks the closest palette entry to each texel, returning the summed (weighted, squared) error
+	float FitIndices(const BlockTexels& _texels, const float _palette[][4], int _count, const float _weights[4], unsigned char* _indices)
+	{
+		float error = 0;
+#ifdef TEXTURE_COOKER_SSE2
+		for (int group = 0; group < 16; group += 4)
+		{
+			__m128 channels[4];
+			for (int c = 0; c < 4; c++)
+			{
+				channels[c] = _mm_loadu_ps(&_texels.channels[c][group]);
+			}
+
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (int p = 0; p < _count; p++)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (int c = 0; c < 4; c++)
+				{
+					__m128 difference = _mm_sub_ps(channels[c], _mm_set1_ps(_palette[p][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(_mm_mul_ps(difference, difference), _mm_set1_ps(_weights[c])));
+				}
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+			}
+
+			int indices[4];
+			float errors[4];
+			_mm_storeu_si128((__m128i*)indices, bestIndex);
+			_mm_storeu_ps(errors, best);
+			for (int i = 0; i < 4; i++)
+			{
+				_indices[group + i] = (unsigned char)indices[i];
+				error += errors[i];
+			}
+		}
+#else
+		for (int i = 0; i < 16; i++)
+		{
+			float best = FLT_MAX;
+			int bestIndex = 0;
+			for (int p = 0; p < _count; p++)
+			{
+				float distance = 0;
+				for (int c = 0; c < 4; c++)
+				{
+					float difference = _texels.channels[c][i] - _palette[p][c];
+					distance += difference * difference * _weights[c];
+				}
+				if (distance < best)
+				{
+					best = distance;
+					bestIndex = p;
+				}
+			}
+			_indices[i] = (unsigned char)bestIndex;
+			error += best;
+		}
+#endif
+		return error;
+	}
+
+	// The two ends of the line through the texels' mean along their principal axis, spanning every texel
+	void FindEndpoints(const BlockTexels& _texels, int _channels, float* _low, float* _high)
+	{
+		float mean[4] = {};
+		for (int c = 0; c < _channels; c++)
+		{
+			for (int i = 0; i < 16; i++) mean[c] += _texels.channels[c][i];
+			mean[c] /= 16;
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			for (int a = 0; a < _channels; a++)
+			{
+				for (int b = 0; b < _channels; b++)
+				{
+					covariance[a][b] += (_texels.channels[a][i] - mean[a]) * (_texels.channels[b][i] - mean[b]);
+				}
+			}
+		}
+
+		// Power iteration; a flat block keeps the gray axis, which is as good as any
+		float axis[4] = { 1, 1, 1, 1 };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0;
+			for (int a = 0; a < _channels; a++)
+			{
+				for (int b = 0; b < _channels; b++) next[a] += covariance[a][b] * axis[b];
+				length = std::max(length, fabsf(next[a]));
+			}
+			if (length < 1e-6f) break;
+			for (int a = 0; a < _channels; a++) axis[a] = next[a] / length;
+		}
+
+		float lowest = FLT_MAX;
+		float highest = -FLT_MAX;
+		float axisLength = 0;
+		for (int c = 0; c < _channels; c++) axisLength += axis[c] * axis[c];
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0;
+			for (int c = 0; c < _channels; c++) t += (_texels.channels[c][i] - mean[c]) * axis[c];
+			t /= axisLength;
+			lowest = std::min(lowest, t);
+			highest = std::max(highest, t);
+		}
+
+		for (int c = 0; c < _channels; c++)
+		{
+			_low[c] = std::min(std::max(mean[c] + axis[c] * lowest, 0.0f), 255.0f);
+			_high[c] = std::min(std::max(mean[c] + axis[c] * highest, 0.0f), 255.0f);
+		}
+	}
+
+	// The endpoints that best fit the texels with the indices they have (by least squares), given how far along each index lies
+	bool SolveEndpoints(const BlockTexels& _texels, int _channels, const unsigned char* _indices, const float* _fractions, float* _first, float* _second)
+	{
+		float a = 0, b = 0, c = 0;
+		float firstSums[4] = {};
+		float secondSums[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float t = _fractions[_indices[i]];
+			float s = 1 - t;
+			a += s * s;
+			b += s * t;
+			c += t * t;
+			for (int channel = 0; channel < _channels; channel++)
+			{
+				firstSums[channel] += s * _texels.channels[channel][i];
+				secondSums[channel] += t * _texels.channels[channel][i];
+			}
+		}
+
+		float determinant = a * c - b * b;
+		if (fabsf(determinant) < 1e-6f) return false;
+		for (int channel = 0; channel < _channels; channel++)
+		{
+			_first[channel] = std::min(std::max((c * firstSums[channel] - b * secondSums[channel]) / determinant, 0.0f), 255.0f);
+			_second[channel] = std::min(std::max((a * secondSums[channel] - b * firstSums[channel]) / determinant, 0.0f), 255.0f);
+		}
+		return true;
+	}
+
+	unsigned short PackColor565(const float* _color)
+	{
+		unsigned int r = (unsigned int)(_color[0] * 31 / 255 + 0.5f);
+		unsigned int g = (unsigned int)(_color[1] * 63 / 255 + 0.5f);
+		unsigned int b = (unsigned int)(_color[2] * 31 / 255 + 0.5f);
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackColor565(unsigned short _packed, float* _color)
+	{
+		unsigned int r = (_packed >> 11) & 31;
+		unsigned int g = (_packed >> 5) & 63;
+		unsigned int b = _packed & 31;
+		_color[0] = (float)((r << 3) | (r >> 2));
+		_color[1] = (float)((g << 2) | (g >> 4));
+		_color[2] = (float)((b << 3) | (b >> 2));
+		_color[3] = 0;
+	}
+
+	// Four color mode: the endpoints, then two thirds and one third of the way from the first
+	float EvaluateBC1(const BlockTexels& _texels, unsigned short _first, unsigned short _second, unsigned char* _indices)
+	{
+		const float weights[4] = { 1, 1, 1, 0 };
+		float palette[4][4];
+		UnpackColor565(_first, palette[0]);
+		UnpackColor565(_second, palette[1]);
+		for (int c = 0; c < 4; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		return FitIndices(_texels, palette, 4, weights, _indices);
+	}
+
+	void EncodeBC1(const BlockTexels& _texels, unsigned char* _block)
+	{
+		const float fractions[4] = { 0, 1, 1.0f / 3, 2.0f / 3 };
+		float first[4], second[4];
+		FindEndpoints(_texels, 3, second, first);
+
+		unsigned short bestFirst = PackColor565(first);
+		unsigned short bestSecond = PackColor565(second);
+		unsigned char bestIndices[16];
+		float bestError = EvaluateBC1(_texels, bestFirst, bestSecond, bestIndices);
+		for (int iteration = 0; iteration < 2 && bestError > 0; iteration++)
+		{
+			if (!SolveEndpoints(_texels, 3, bestIndices, fractions, first, second)) break;
+
+			unsigned char indices[16];
+			unsigned short packedFirst = PackColor565(first);
+			unsigned short packedSecond = PackColor565(second);
+			float error = EvaluateBC1(_texels, packedFirst, packedSecond, indices);
+			if (error >= bestError) break;
+			bestError = error;
+			bestFirst = packedFirst;
+			bestSecond = packedSecond;
+			memcpy(bestIndices, indices, 16);
+		}
+
+		// The first color has to be the larger for four color mode; swapping them swaps the index pairs too
+		if (bestFirst < bestSecond)
+		{
+			std::swap(bestFirst, bestSecond);
+			for (int i = 0; i < 16; i++) bestIndices[i] ^= 1;
+		}
+		else if (bestFirst == bestSecond)
+		{
+			memset(bestIndices, 0, 16);
+		}
+
+		_block[0] = (unsigned char)bestFirst;
+		_block[1] = (unsigned char)(bestFirst >> 8);
+		_block[2] = (unsigned char)bestSecond;
+		_block[3] = (unsigned char)(bestSecond >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			_block[4 + i] = (unsigned char)(bestIndices[i * 4] | (bestIndices[i * 4 + 1] << 2) | (bestIndices[i * 4 + 2] << 4) | (bestIndices[i * 4 + 3] << 6));
+		}
+	}
+
+	// Eight value mode (the first endpoint larger): the endpoints, then sevenths of the way from the first
+	float EvaluateBC4(const BlockTexels& _texels, int _first, int _second, unsigned char* _indices)
+	{
+		const float weights[4] = { 1, 0, 0, 0 };
+		float palette[8][4] = {};
+		palette[0][0] = (float)_first;
+		palette[1][0] = (float)_second;
+		for (int i = 1; i < 7; i++)
+		{
+			palette[i + 1][0] = (float)(((7 - i) * _first + i * _second + 3) / 7);
+		}
+		return FitIndices(_texels, palette, 8, weights, _indices);
+	}
+
+	// Compresses the first channel of the texels
+	void EncodeBC4(const BlockTexels& _texels, unsigned char* _block)
+	{
+		const float fractions[8] = { 0, 1, 1.0f / 7, 2.0f / 7, 3.0f / 7, 4.0f / 7, 5.0f / 7, 6.0f / 7 };
+		float lowest = 255, highest = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lowest = std::min(lowest, _texels.channels[0][i]);
+			highest = std::max(highest, _texels.channels[0][i]);
+		}
+
+		int bestFirst = (int)(highest + 0.5f);
+		int bestSecond = (int)(lowest + 0.5f);
+		unsigned char bestIndices[16] = {};
+		if (bestFirst > bestSecond)
+		{
+			float bestError = EvaluateBC4(_texels, bestFirst, bestSecond, bestIndices);
+			for (int iteration = 0; iteration < 2 && bestError > 0; iteration++)
+			{
+				float first, second;
+				if (!SolveEndpoints(_texels, 1, bestIndices, fractions, &first, &second)) break;
+
+				int roundedFirst = (int)(first + 0.5f);
+				int roundedSecond = (int)(second + 0.5f);
+				if (roundedFirst <= roundedSecond) break;
+
+				unsigned char indices[16];
+				float error = EvaluateBC4(_texels, roundedFirst, roundedSecond, indices);
+				if (error >= bestError) break;
+				bestError = error;
+				bestFirst = roundedFirst;
+				bestSecond = roundedSecond;
+				memcpy(bestIndices, indices, 16);
+			}
+		}
+		else
+		{
+			// A flat block: equal endpoints and every index on the first
+			bestSecond = bestFirst;
+		}
+
+		_block[0] = (unsigned char)bestFirst;
+		_block[1] = (unsigned char)bestSecond;
+		memset(_block + 2, 0, 6);
+		BitWriter writer = { _block + 2, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			writer.Write(bestIndices[i], 3);
+		}
+	}
+
+	// BC3 always uses four colors; BC1 uses three and transparent black when the first color isn't the larger
+	void DecodeBC1(const unsigned char* _block, unsigned char* _texels, bool _fourColors)
+	{
+		unsigned short first = (unsigned short)(_block[0] | (_block[1] << 8));
+		unsigned short second = (unsigned short)(_block[2] | (_block[3] << 8));
+		bool fourColors = _fourColors || first > second;
+		float colors[2][4];
+		UnpackColor565(first, colors[0]);
+		UnpackColor565(second, colors[1]);
+
+		unsigned char palette[4][4];
+		for (int c = 0; c < 3; c++)
+		{
+			int a = (int)colors[0][c];
+			int b = (int)colors[1][c];
+			palette[0][c] = (unsigned char)a;
+			palette[1][c] = (unsigned char)b;
+			if (fourColors)
+			{
+				palette[2][c] = (unsigned char)((2 * a + b + 1) / 3);
+				palette[3][c] = (unsigned char)((a + 2 * b + 1) / 3);
+			}
+			else
+			{
+				palette[2][c] = (unsigned char)((a + b + 1) / 2);
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = fourColors ? 255 : 0;
+
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (_block[4 + i / 4] >> ((i % 4) * 2)) & 3;
+			memcpy(_texels + i * 4, palette[index], 4);
+		}
+	}
+
+	void DecodeBC4(const unsigned char* _block, unsigned char* _texels, int _channel)
+	{
+		int first = _block[0];
+		int second = _block[1];
+		unsigned char palette[8];
+		palette[0] = (unsigned char)first;
+		palette[1] = (unsigned char)second;
+		if (first > second)
+		{
+			for (int i = 1; i < 7; i++) palette[i + 1] = (unsigned char)(((7 - i) * first + i * second + 3) / 7);
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++) palette[i + 1] = (unsigned char)(((5 - i) * first + i * second + 2) / 5);
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		BitReader reader = { _block + 2, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			_texels[i * 4 + _channel] = palette[reader.Read(3)];
+		}
+	}
+
+	// Mode 6 endpoints: 7 bits per channel plus a low bit shared by the endpoint's channels
+	struct BC7Endpoints
+	{
+		int									colors[2][4];		// 7 bit
+		int									lowBits[2];
+	};
+
+	float EvaluateBC7(const BlockTexels& _texels, const BC7Endpoints& _endpoints, unsigned char* _indices)
+	{
+		const float weights[4] = { 1, 1, 1, 1 };
+		float palette[16][4];
+		for (int c = 0; c < 4; c++)
+		{
+			int first = (_endpoints.colors[0][c] << 1) | _endpoints.lowBits[0];
+			int second = (_endpoints.colors[1][c] << 1) | _endpoints.lowBits[1];
+			for (int i = 0; i < 16; i++)
+			{
+				palette[i][c] = (float)(((64 - BC7_WEIGHTS[i]) * first + BC7_WEIGHTS[i] * second + 32) >> 6);
+			}
+		}
+		return FitIndices(_texels, palette, 16, weights, _indices);
+	}
+
+	// Quantizes both endpoints with each pair of low bits, keeping the closest fit
+	float QuantizeBC7(const BlockTexels& _texels, const float* _first, const float* _second, BC7Endpoints& _endpoints, unsigned char* _indices)
+	{
+		float bestError = FLT_MAX;
+		for (int bits = 0; bits < 4; bits++)
+		{
+			BC7Endpoints endpoints;
+			endpoints.lowBits[0] = bits & 1;
+			endpoints.lowBits[1] = bits >> 1;
+			for (int c = 0; c < 4; c++)
+			{
+				endpoints.colors[0][c] = std::min(std::max((int)((_first[c] - endpoints.lowBits[0]) / 2 + 0.5f), 0), 127);
+				endpoints.colors[1][c] = std::min(std::max((int)((_second[c] - endpoints.lowBits[1]) / 2 + 0.5f), 0), 127);
+			}
+
+			unsigned char indices[16];
+			float error = EvaluateBC7(_texels, endpoints, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				_endpoints = endpoints;
+				memcpy(_indices, indices, 16);
+			}
+		}
+		return bestError;
+	}
+
+	void EncodeBC7(const BlockTexels& _texels, unsigned char* _block)
+	{
+		float fractions[16];
+		for (int i = 0; i < 16; i++) fractions[i] = BC7_WEIGHTS[i] / 64.0f;
+
+		float first[4], second[4];
+		FindEndpoints(_texels, 4, first, second);
+
+		BC7Endpoints best;
+		unsigned char bestIndices[16];
+		float bestError = QuantizeBC7(_texels, first, second, best, bestIndices);
+		for (int iteration = 0; iteration < 2 && bestError > 0; iteration++)
+		{
+			if (!SolveEndpoints(_texels, 4, bestIndices, fractions, first, second)) break;
+
+			BC7Endpoints endpoints;
+			unsigned char indices[16];
+			float error = QuantizeBC7(_texels, first, second, endpoints, indices);
+			if (error >= bestError) break;
+			bestError = error;
+			best = endpoints;
+			memcpy(bestIndices, indices, 16);
+		}
+
+		// The first texel's index is stored without its top bit, so it has to be in the first half
+		if (bestIndices[0] >= 8)
+		{
+			for (int c = 0; c < 4; c++) std::swap(best.colors[0][c], best.colors[1][c]);
+			std::swap(best.lowBits[0], best.lowBits[1]);
+			for (int i = 0; i < 16; i++) bestIndices[i] = (unsigned char)(15 - bestIndices[i]);
+		}
+
+		memset(_block, 0, 16);
+		BitWriter writer = { _block, 0 };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.Write(best.colors[0][c], 7);
+			writer.Write(best.colors[1][c], 7);
+		}
+		writer.Write(best.lowBits[0], 1);
+		writer.Write(best.lowBits[1], 1);
+		writer.Write(bestIndices[0], 3);
+		for (int i = 1; i < 16; i++)
+		{
+			writer.Write(bestIndices[i], 4);
+		}
+	}
+
+	void DecodeBC7(const unsigned char* _block, unsigned char* _texels)
+	{
+		if ((_block[0] & 0x7F) != 0x40)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				_texels[i * 4] = 255;
+				_texels[i * 4 + 1] = 0;
+				_texels[i * 4 + 2] = 255;
+				_texels[i * 4 + 3] = 255;
+			}
+			return;
+		}
+
+		BitReader reader = { _block, 7 };
+		int colors[2][4];
+		for (int c = 0; c < 4; c++)
+		{
+			colors[0][c] = (int)reader.Read(7);
+			colors[1][c] = (int)reader.Read(7);
+		}
+		int firstBit = (int)reader.Read(1);
+		int secondBit = (int)reader.Read(1);
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (int)reader.Read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; c++)
+			{
+				int first = (colors[0][c] << 1) | firstBit;
+				int second = (colors[1][c] << 1) | secondBit;
+				_texels[i * 4 + c] = (unsigned char)(((64 - BC7_WEIGHTS[index]) * first + BC7_WEIGHTS[index] * second + 32) >> 6);
+			}
+		}
+	}
+}
+
+TextureCooker::TextureCooker(unsigned int _threads)
+{
+	threads = _threads < 1 ? 1 : _threads;
+}
+
+TextureCooker::~TextureCooker()
+{
+}
+
+void TextureCooker::Cook(const DecodedImage& _image, CookSettings _settings, CookedTexture& _texture, CookStats& _stats)
+{
+	_stats = {};
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<DecodedImage> mips(1, _image);
+	MipStats mipStats;
+	MipGenerator(threads).Generate(mips, _settings.mips, &mipStats);
+	std::chrono::high_resolution_clock::time_point built = std::chrono::high_resolution_clock::now();
+
+	_texture.format = _settings.format;
+	_texture.width = _image.width;
+	_texture.height = _image.height;
+	_texture.mips.assign(mips.size(), std::vector<unsigned char>());
+
+	// Every row of blocks in every mip is one job, so small mips don't leave threads idle
+	struct BlockRow
+	{
+		unsigned int						mip;
+		unsigned int						row;
+	};
+	std::vector<BlockRow> rows;
+	unsigned int blockBytes = GetBlockBytes(_settings.format);
+	unsigned long long texels = 0;
+	for (unsigned int mip = 0; mip < mips.size(); mip++)
+	{
+		unsigned int blocksWide = (mips[mip].width + 3) / 4;
+		unsigned int blocksHigh = (mips[mip].height + 3) / 4;
+		_texture.mips[mip].resize((size_t)blocksWide * blocksHigh * blockBytes);
+		for (unsigned int row = 0; row < blocksHigh; row++) rows.push_back({ mip, row });
+		texels += (unsigned long long)mips[mip].width * mips[mip].height;
+		_stats.uncompressedBytes += mips[mip].pixels.size();
+		_stats.cookedBytes += _texture.mips[mip].size();
+	}
+
+	std::atomic<unsigned int> next(0);
+	auto work = [&]()
+	{
+		unsigned char blockTexels[64];
+		for (unsigned int job = next++; job < rows.size(); job = next++)
+		{
+			const DecodedImage& image = mips[rows[job].mip];
+			unsigned char* block = _texture.mips[rows[job].mip].data() + (size_t)rows[job].row * ((image.width + 3) / 4) * blockBytes;
+			for (unsigned int x = 0; x < image.width; x += 4, block += blockBytes)
+			{
+				for (unsigned int i = 0; i < 16; i++)
+				{
+					unsigned int texelX = std::min(x + i % 4, image.width - 1);
+					unsigned int texelY = std::min(rows[job].row * 4 + i / 4, image.height - 1);
+					memcpy(blockTexels + i * 4, image.pixels.data() + ((size_t)texelY * image.width + texelX) * 4, 4);
+				}
+				EncodeBlock(_settings.format, blockTexels, block);
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned int i = 1; i < std::min(threads, (unsigned int)rows.size()); i++)
+	{
+		pool.push_back(std::thread(work));
+	}
+	work();
+	for (auto& thread : pool)
+	{
+		thread.join();
+	}
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+	DecodedImage decoded;
+	DecodeMip(_settings.format, _texture.mips[0], _image.width, _image.height, decoded);
+	_stats.psnr = GetPSNR(_settings.format, _image, decoded);
+
+	std::chrono::duration<double, std::milli> mipTime = built - start;
+	std::chrono::duration<double, std::milli> encodeTime = end - built;
+	_stats.mipMilliseconds = mipTime.count();
+	_stats.mipMegapixelsPerSecond = mipStats.megapixelsPerSecond;
+	_stats.encodeMilliseconds = encodeTime.count();
+	_stats.megapixelsPerSecond = encodeTime.count() > 0 ? texels / (encodeTime.count() * 1000) : 0;
+}
+
+CookSettings TextureCooker::GetSettings(const std::string& _path)
+{
+	// One channel data becomes BC4 and normals BC5, whatever the file name says about how they were averaged
+	MipSettings mips = MipGenerator::GetSettings(_path);
+	std::string name = _path.substr(_path.find_last_of("/\\") + 1);
+	std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower(c); });
+
+	if (mips.content == MipContent::Normal) return { CookFormat::BC5, mips };
+	if (name.find("roughness") != std::string::npos || name.find("metal") != std::string::npos || name.find("specular") != std::string::npos)
+		return { CookFormat::BC4, mips };
+	return { CookFormat::BC7, mips };
+}
+
+void TextureCooker::EncodeBlock(CookFormat _format, const unsigned char* _texels, unsigned char* _block)
+{
+	BlockTexels texels;
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++) texels.channels[c][i] = _texels[i * 4 + c];
+	}
+
+	BlockTexels channel = {};
+	switch (_format)
+	{
+	case CookFormat::BC1:
+		EncodeBC1(texels, _block);
+		break;
+	case CookFormat::BC3:
+		memcpy(channel.channels[0], texels.channels[3], sizeof(channel.channels[0]));
+		EncodeBC4(channel, _block);
+		EncodeBC1(texels, _block + 8);
+		break;
+	case CookFormat::BC4:
+		EncodeBC4(texels, _block);
+		break;
+	case CookFormat::BC5:
+		EncodeBC4(texels, _block);
+		memcpy(channel.channels[0], texels.channels[1], sizeof(channel.channels[0]));
+		EncodeBC4(channel, _block + 8);
+		break;
+	case CookFormat::BC7:
+		EncodeBC7(texels, _block);
+		break;
+	}
+}
+
+void TextureCooker::DecodeBlock(CookFormat _format, const unsigned char* _block, unsigned char* _texels)
+{
+	memset(_texels, 0, 64);
+	switch (_format)
+	{
+	case CookFormat::BC1:
+		DecodeBC1(_block, _texels, false);
+		break;
+	case CookFormat::BC3:
+		DecodeBC1(_block + 8, _texels, true);
+		DecodeBC4(_block, _texels, 3);
+		break;
+	case CookFormat::BC4:
+		DecodeBC4(_block, _texels, 0);
+		for (int i = 0; i < 16; i++) _texels[i * 4 + 3] = 255;
+		break;
+	case CookFormat::BC5:
+		DecodeBC4(_block, _texels, 0);
+		DecodeBC4(_block + 8, _texels, 1);
+		for (int i = 0; i < 16; i++) _texels[i * 4 + 3] = 255;
+		break;
+	case CookFormat::BC7:
+		DecodeBC7(_block, _texels);
+		break;
+	}
+}
+
+void TextureCooker::DecodeMip(CookFormat _format, const std::vector<unsigned char>& _blocks, unsigned int _width, unsigned int _height, DecodedImage& _image)
+{
+	_image.width = _width;
+	_image.height = _height;
+	_image.pixels.assign((size_t)_width * _height * 4, 0);
+
+	unsigned int blockBytes = GetBlockBytes(_format);
+	unsigned int blocksWide = (_width + 3) / 4;
+	unsigned char texels[64];
+	for (unsigned int y = 0; y < _height; y += 4)
+	{
+		for (unsigned int x = 0; x < _width; x += 4)
+		{
+			DecodeBlock(_format, _blocks.data() + ((size_t)(y / 4) * blocksWide + x / 4) * blockBytes, texels);
+			for (unsigned int i = 0; i < 16; i++)
+			{
+				unsigned int texelX = x + i % 4;
+				unsigned int texelY = y + i / 4;
+				if (texelX >= _width || texelY >= _height) continue;
+				memcpy(_image.pixels.data() + ((size_t)texelY * _width + texelX) * 4, texels + i * 4, 4);
+			}
+		}
+	}
+}
+
+double TextureCooker::GetPSNR(CookFormat _format, const DecodedImage& _source, const DecodedImage& _decoded)
+{
+	unsigned int channels = _format == CookFormat::BC1 ? 3 : _format == CookFormat::BC4 ? 1 : _format == CookFormat::BC5 ? 2 : 4;
+	double squares = 0;
+	for (size_t i = 0; i < _source.pixels.size(); i += 4)
+	{
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			double difference = (double)_source.pixels[i + c] - _decoded.pixels[i + c];
+			squares += difference * difference;
+		}
+	}
+
+	double meanSquare = squares / ((_source.pixels.size() / 4) * channels);
+	if (meanSquare <= 0) return INFINITY;
+	return 10 * log10(255.0 * 255.0 / meanSquare);
+}
+
+unsigned int TextureCooker::GetBlockBytes(CookFormat _format)
+{
+	return _format == CookFormat::BC1 || _format == CookFormat::BC4 ? 8 : 16;
+}
+
+unsigned int TextureCooker::GetDXGIFormat(CookFormat _format)
+{
+	switch (_format)
+	{
+	case CookFormat::BC1: return DDS_DXGI_FORMAT_BC1_UNORM;
+	case CookFormat::BC3: return DDS_DXGI_FORMAT_BC3_UNORM;
+	case CookFormat::BC4: return DDS_DXGI_FORMAT_BC4_UNORM;
+	case CookFormat::BC5: return DDS_DXGI_FORMAT_BC5_UNORM;
+	default: return DDS_DXGI_FORMAT_BC7_UNORM;
+	}
+}
+
+const char* TextureCooker::GetFormatName(CookFormat _format)
+{
+	switch (_format)
+	{
+	case CookFormat::BC1: return "BC1";
+	case CookFormat::BC3: return "BC3";
+	case CookFormat::BC4: return "BC4";
+	case CookFormat::BC5: return "BC5";
+	default: return "BC7";
+	}
+}
+
+bool TextureCooker::WriteDDS(const std::string& _path, const CookedTexture& _texture)
+{
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = _texture.height;
+	header.width = _texture.width;
+	header.pitchOrLinearSize = _texture.mips.empty() ? 0 : (uint32_t)_texture.mips[0].size();
+	header.mipMapCount = (uint32_t)_texture.mips.size();
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = DDS_FOURCC_DX10;
+	header.caps = DDSCAPS_TEXTURE | (_texture.mips.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+	DdsHeaderDX10 extension = {};
+	extension.dxgiFormat = GetDXGIFormat(_texture.format);
+	extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	extension.arraySize = 1;
+
+	std::ofstream file(_path, std::ios::binary);
+	if (!file) return false;
+	uint32_t magic = DDS_MAGIC;
+	file.write((const char*)&magic, sizeof(magic));
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)&extension, sizeof(extension));
+	for (auto& mip : _texture.mips)
+	{
+		file.write((const char*)mip.data(), mip.size());
+	}
+	return (bool)file;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "MipGenerator.h"
+#include "PngDecoder.h"
+
+// Block compressed formats the cooker writes (each 4x4 block of texels becomes 8 or 16 bytes)
+enum class CookFormat
+{
+	BC1,													// RGB, 8 bytes
+	BC3,													// RGB as BC1 plus alpha as BC4, 16 bytes
+	BC4,													// One channel (red), 8 bytes
+	BC5,													// Two channels (red and green), 16 bytes
+	BC7,													// RGBA, 16 bytes
+};
+
+struct CookSettings
+{
+	CookFormat								format;
+	MipSettings								mips;				// How the mips are filtered
+};
+
+// A texture's blocks, one entry per mip from largest to smallest
+struct CookedTexture
+{
+	CookFormat								format;
+	unsigned int							width;
+	unsigned int							height;
+	std::vector<std::vector<unsigned char>>	mips;
+};
+
+struct CookStats
+{
+	double									psnr;				// Of the top mip against the source, over the channels the format keeps (dB)
+	double									mipMilliseconds;	// Building the mip chain
+	double									mipMegapixelsPerSecond;// Texels filtered per second while building it
+	double									encodeMilliseconds;	// Compressing every mip
+	double									megapixelsPerSecond;// Texels compressed (over every mip) per second of encoding
+	unsigned long long						uncompressedBytes;	// The chain as RGBA8
+	unsigned long long						cookedBytes;
+};
+
+// --------------------------------------------------------
+// Compresses textures ahead of time into block compressed
+// formats with their whole mip chains, for .dds files
+//
+// Mips are built by a MipGenerator on the same threads, so
+// color textures are filtered in linear space and normal maps
+// renormalized. Each mip is then cut into 4x4 blocks (edges
+// clamped) and encoded on a pool of threads:
+//  - BC1/BC3 fit the two colors along the principal axis of
+//    the block's colors, then refine them by least squares;
+//  - BC4/BC5 do the same per channel, using the 8 value mode;
+//  - BC7 only writes mode 6 (one RGBA subset, 7 bit endpoints
+//    plus a shared low bit each, 16 weights), trying every
+//    low bit pair, which keeps it simple and still close to
+//    the source on smooth textures.
+// Choosing the closest palette entry for each texel, where
+// the time goes, runs four texels at a time with SSE2 where
+// it's available.
+//
+// Nothing here knows about D3D or threads outside a Cook.
+// Textures are written as UNORM formats (not _SRGB), because
+// the shaders linearize colors themselves.
+// --------------------------------------------------------
+class TextureCooker
+{
+public:
+											/// <summary>
+											/// Makes a cooker
+											/// </summary>
+											/// <param name="_threads">The number of threads to encode blocks on</param>
+	TextureCooker(unsigned int _threads);
+	~TextureCooker();
+
+											/// <summary>
+											/// Builds an image's mips and compresses them
+											/// </summary>
+											/// <param name="_image">The full sized image</param>
+											/// <param name="_settings">The format and content of the texture</param>
+											/// <param name="_texture">Receives the compressed mips</param>
+											/// <param name="_stats">Receives timings, sizes and the error</param>
+	void									Cook(const DecodedImage& _image, CookSettings _settings, CookedTexture& _texture, CookStats& _stats);
+
+											/// <summary>
+											/// Picks the format and mip settings for a texture from its file name (_albedo, _normals, _roughness...)
+											/// </summary>
+	static CookSettings						GetSettings(const std::string& _path);
+											/// <summary>
+											/// Compresses one block
+											/// </summary>
+											/// <param name="_texels">16 RGBA8 texels, row by row</param>
+											/// <param name="_block">Receives GetBlockBytes bytes</param>
+	static void								EncodeBlock(CookFormat _format, const unsigned char* _texels, unsigned char* _block);
+											/// <summary>
+											/// Decompresses one block (BC7 blocks in any mode but 6 come out magenta)
+											/// </summary>
+											/// <param name="_texels">Receives 16 RGBA8 texels, row by row; channels the format doesn't have are 0 (alpha 255)</param>
+	static void								DecodeBlock(CookFormat _format, const unsigned char* _block, unsigned char* _texels);
+											/// <summary>
+											/// Decompresses a whole mip
+											/// </summary>
+	static void								DecodeMip(CookFormat _format, const std::vector<unsigned char>& _blocks, unsigned int _width, unsigned int _height, DecodedImage& _image);
+											/// <summary>
+											/// Gets the peak signal to noise ratio between two images of the same size, over the channels a format keeps
+											/// </summary>
+	static double							GetPSNR(CookFormat _format, const DecodedImage& _source, const DecodedImage& _decoded);
+	static unsigned int						GetBlockBytes(CookFormat _format);
+	static unsigned int						GetDXGIFormat(CookFormat _format);
+	static const char*						GetFormatName(CookFormat _format);
+											/// <summary>
+											/// Writes a texture as a .dds file (with the DX10 header, so D3D11 loads it as is)
+											/// </summary>
+											/// <returns>Whether the file could be written</returns>
+	static bool								WriteDDS(const std::string& _path, const CookedTexture& _texture);
+
+private:
+	unsigned int							threads;
+};
@@ -0,0 +1,184 @@
+#include "TextureLoader.h"
+
+#include <chrono>
+
+TextureLoader::TextureLoader(unsigned int _threads)
+	: results(TEXTURE_LOADER_RESULT_CAPACITY)
+{
+	stopping = false;
+	nextId = 0;
+	pending.store(0);
+	waitingForSpace.store(0);
+
+	if (_threads < 1) _threads = 1;
+	for (unsigned int i = 0; i < _threads; i++)
+	{
+		threads.push_back(std::thread(&TextureLoader::Work, this));
+	}
+}
+
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobReady.notify_all();
+	resultSpace.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+unsigned int TextureLoader::Load(const std::string& _path)
+{
+	LoadJob job = {};
+	job.path = _path;
+	return Queue(job);
+}
+
+unsigned int TextureLoader::LoadPacked(const std::string _paths[ORM_CHANNELS])
+{
+	LoadJob job = {};
+	job.packed = true;
+	for (int c = 0; c < ORM_CHANNELS; c++)
+	{
+		job.sources[c] = _paths[c];
+	}
+	return Queue(job);
+}
+
+bool TextureLoader::Poll(TextureLoadResult& _result)
+{
+	if (!results.Pop(_result)) return false;
+	pending--;
+
+	// Wake a thread waiting on a full queue (the fence pairs with the one in Work, so one can't miss the other)
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (waitingForSpace.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		resultSpace.notify_one();
+	}
+	return true;
+}
+
+unsigned int TextureLoader::GetPending()
+{
+	return pending.load();
+}
+
+unsigned int TextureLoader::GetThreadCount()
+{
+	return (unsigned int)threads.size();
+}
+
+unsigned int TextureLoader::Queue(LoadJob& _job)
+{
+	_job.id = nextId++;
+	pending++;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(std::move(_job));
+	}
+	jobReady.notify_one();
+	return nextId - 1;
+}
+
+void TextureLoader::Work()
+{
+	while (true)
+	{
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		TextureLoadResult result = {};
+		result.id = job.id;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		result.mips.resize(1);
+		if (job.packed)
+		{
+			LoadSources(job, result);
+		}
+		else
+		{
+			std::vector<unsigned char> data;
+			if (ReadResourceFile(job.path, data))
+			{
+				result.contentHash = HashResourceContent(data.data(), data.size());
+				result.contentSize = data.size();
+				result.decoded = PngDecoder::Decode(data.data(), data.size(), result.mips[0]);
+			}
+
+			// One texel says all a file of one color has to say, at any distance
+			unsigned char texel[4];
+			result.uniform = result.decoded && TexturePacker::IsUniform(result.mips[0], texel);
+			if (result.uniform) result.mips[0] = { 1, 1, { texel[0], texel[1], texel[2], texel[3] } };
+			else if (result.decoded) MipGenerator(1).Generate(result.mips, MipGenerator::GetSettings(job.path));
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		result.milliseconds = elapsed.count();
+
+		// A full queue means the main thread is behind on making textures, so wait for Poll to make room rather than piling up pixels
+		if (!results.Push(result))
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			waitingForSpace++;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			resultSpace.wait(lock, [this, &result] { return stopping || results.Push(result); });
+			waitingForSpace--;
+			if (stopping) return;
+		}
+	}
+}
+
+void TextureLoader::LoadSources(const LoadJob& _job, TextureLoadResult& _result)
+{
+	DecodedImage images[ORM_CHANNELS];
+	const DecodedImage* sources[ORM_CHANNELS] = {};
+	unsigned char values[ORM_CHANNELS];
+	unsigned long long hashes[ORM_CHANNELS] = {};
+
+	// A map that's missing or can't be read leaves its channel at the default, like one that was never given
+	_result.decoded = true;
+	for (int c = 0; c < ORM_CHANNELS; c++)
+	{
+		values[c] = ormDefaults[c];
+		_result.uniformChannels |= 1u << c;
+		if (_job.sources[c].empty()) continue;
+
+		std::vector<unsigned char> data;
+		if (!ReadResourceFile(_job.sources[c], data) || !PngDecoder::Decode(data.data(), data.size(), images[c]))
+		{
+			_result.decoded = false;
+			continue;
+		}
+		hashes[c] = HashResourceContent(data.data(), data.size());
+		_result.contentSize += data.size();
+
+		// A map of one value packs as well as a constant, and doesn't make the packed image any larger
+		unsigned char texel[4];
+		if (TexturePacker::IsUniform(images[c], texel))
+		{
+			values[c] = texel[0];
+			continue;
+		}
+		sources[c] = &images[c];
+		_result.uniformChannels &= ~(1u << c);
+	}
+	_result.contentHash = HashResourceContent(hashes, sizeof(hashes));
+
+	TexturePacker::Pack(sources, values, _result.mips[0]);
+
+	_result.uniform = _result.uniformChannels == (1u << ORM_CHANNELS) - 1;
+	if (!_result.uniform) MipGenerator(1).Generate(_result.mips, { MipContent::Linear, MipFilter::Kaiser, true });
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LockFreeQueue.h"
+#include "MipGenerator.h"
+#include "PngDecoder.h"
+#include "ResourceRegistry.h"
+#include "TexturePacker.h"
+
+// How many finished images can wait for the main thread at once
+// - Decoding stalls (without blocking the main thread) when this many are waiting
+constexpr auto TEXTURE_LOADER_RESULT_CAPACITY = 64;
+
+// An image a loader thread has finished with
+struct TextureLoadResult
+{
+	unsigned int							id;					// As returned by TextureLoader::Load
+	bool									decoded;			// False if the file couldn't be read or isn't a PNG the decoder handles
+	unsigned long long						contentHash;		// HashResourceContent of the file's bytes (of each source's hash, when packed)
+	unsigned long long						contentSize;		// The file's size (the sources' summed), or 0 if it couldn't be read
+	bool									uniform;			// Whether every texel was the same, leaving mips a single 1x1 level
+	unsigned int							uniformChannels;	// For packed images, a bit per ORM_{channel} whose source was one color (or missing)
+	std::vector<DecodedImage>				mips;				// The file itself, then each level at half the size down to 1x1
+	double									milliseconds;		// Time spent reading and decoding
+};
+
+// --------------------------------------------------------
+// Reads and decodes image files on a pool of threads
+//
+// Load queues a file and returns right away; the pool's
+// threads take files in the order they were queued, hash and
+// decode them with PngDecoder, build their mip chains with a
+// MipGenerator (set up for each file by its name, on the
+// loader thread alone, since files are already spread over
+// the pool) and push the pixels onto a lock-free queue, which
+// Poll empties from the main thread. An image that's one
+// color throughout skips its chain and comes back as 1x1.
+//
+// LoadPacked reads up to three single-channel maps in one job
+// and packs them into an ORM image with a TexturePacker, so
+// they end up as one texture; sources that are one color are
+// noted, for the streamer to turn into material constants.
+//
+// Queued files wait under a mutex (which is also what idle
+// threads sleep on), but finished images never do, so Poll
+// never has to wait for a thread that's busy decoding. A
+// thread that finds the results full sleeps on the same
+// mutex until Poll makes room.
+// Nothing here knows about D3D; TextureStreamer turns the
+// images into textures.
+// --------------------------------------------------------
+class TextureLoader
+{
+public:
+											/// <summary>
+											/// Starts the pool
+											/// </summary>
+											/// <param name="_threads">The number of threads to decode on</param>
+	TextureLoader(unsigned int _threads);
+											/// <summary>
+											/// Stops the pool, dropping any files that haven't started decoding
+											/// </summary>
+	~TextureLoader();
+
+											/// <summary>
+											/// Queues a file to be decoded
+											/// </summary>
+											/// <param name="_path">The full path of the file</param>
+											/// <returns>The id its result will carry (in the order files are queued, from 0)</returns>
+	unsigned int							Load(const std::string& _path);
+											/// <summary>
+											/// Queues maps to be decoded and packed into the channels of one image
+											/// </summary>
+											/// <param name="_paths">The full path of each ORM_{channel}'s map, or empty for one without (which takes ormDefaults)</param>
+											/// <returns>The id its result will carry, counted along with Load's</returns>
+	unsigned int							LoadPacked(const std::string _paths[ORM_CHANNELS]);
+											/// <summary>
+											/// Takes the next finished image, if there is one
+											/// </summary>
+											/// <param name="_result">Receives the image</param>
+											/// <returns>Whether there was an image to take</returns>
+	bool									Poll(TextureLoadResult& _result);
+											/// <summary>
+											/// Gets the files queued that haven't been taken with Poll yet
+											/// </summary>
+	unsigned int							GetPending();
+	unsigned int							GetThreadCount();
+
+private:
+	struct LoadJob
+	{
+		unsigned int						id;
+		std::string							path;
+		bool								packed;
+		std::string							sources[ORM_CHANNELS];	// For packed jobs, in place of path
+	};
+
+	std::vector<std::thread>				threads;
+	std::mutex								jobMutex;
+	std::condition_variable					jobReady;
+	std::condition_variable					resultSpace;		// Signaled by Poll when a thread is waiting for room in results
+	std::atomic<unsigned int>				waitingForSpace;
+	std::deque<LoadJob>						jobs;
+	bool									stopping;
+
+	LockFreeQueue<TextureLoadResult>		results;
+	unsigned int							nextId;
+	std::atomic<unsigned int>				pending;
+
+	unsigned int							Queue(LoadJob& _job);
+	void									Work();
+											/// <summary>
+											/// Reads, decodes and packs a packed job's maps
+											/// </summary>
+	void									LoadSources(const LoadJob& _job, TextureLoadResult& _result);
+};
@@ -0,0 +1,77 @@
+#include "TexturePacker.h"
+
+#include <cstring>
+
+bool TexturePacker::IsUniform(const DecodedImage& _image, unsigned char _texel[4])
+{
+	size_t count = (size_t)_image.width * _image.height;
+	if (count == 0 || _image.pixels.size() < count * 4) return false;
+
+	const unsigned char* pixels = _image.pixels.data();
+	memcpy(_texel, pixels, 4);
+
+	// Whole texels compared as words, stopping at the first that differs
+	unsigned int first;
+	memcpy(&first, pixels, 4);
+	for (size_t i = 1; i < count; i++)
+	{
+		unsigned int texel;
+		memcpy(&texel, pixels + i * 4, 4);
+		if (texel != first) return false;
+	}
+	return true;
+}
+
+void TexturePacker::Pack(const DecodedImage* const _sources[ORM_CHANNELS], const unsigned char _values[ORM_CHANNELS], DecodedImage& _packed)
+{
+	unsigned int width = 1;
+	unsigned int height = 1;
+	for (int c = 0; c < ORM_CHANNELS; c++)
+	{
+		if (_sources[c] == 0) continue;
+		if (_sources[c]->width > width) width = _sources[c]->width;
+		if (_sources[c]->height > height) height = _sources[c]->height;
+	}
+
+	_packed.width = width;
+	_packed.height = height;
+	_packed.pixels.assign((size_t)width * height * 4, 255);
+
+	for (int c = 0; c < ORM_CHANNELS; c++)
+	{
+		const DecodedImage* source = _sources[c];
+		if (source == 0)
+		{
+			for (size_t i = c; i < _packed.pixels.size(); i += 4)
+			{
+				_packed.pixels[i] = _values[c];
+			}
+			continue;
+		}
+
+		// Columns map the same way on every row, so they're worked out once
+		std::vector<unsigned int> columns(width);
+		for (unsigned int x = 0; x < width; x++)
+		{
+			columns[x] = GetSourceIndex(*source, x, 0, width, height);
+		}
+
+		for (unsigned int y = 0; y < height; y++)
+		{
+			const unsigned char* sourceRow = source->pixels.data() + (size_t)GetSourceIndex(*source, 0, y, width, height) * 4;
+			unsigned char* packedRow = _packed.pixels.data() + (size_t)y * width * 4 + c;
+			for (unsigned int x = 0; x < width; x++)
+			{
+				packedRow[x * 4] = sourceRow[columns[x] * 4];
+			}
+		}
+	}
+}
+
+unsigned int TexturePacker::GetSourceIndex(const DecodedImage& _source, unsigned int _x, unsigned int _y, unsigned int _width, unsigned int _height)
+{
+	// The source texel under the packed texel's center; a whole multiple smaller repeats each texel exactly
+	unsigned int x = (unsigned int)(((unsigned long long)_x * 2 + 1) * _source.width / ((unsigned long long)_width * 2));
+	unsigned int y = (unsigned int)(((unsigned long long)_y * 2 + 1) * _source.height / ((unsigned long long)_height * 2));
+	return y * _source.width + x;
+}
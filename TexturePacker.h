@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include "PngDecoder.h"
+
+// The channel of a packed map each source goes to (R, G and B, as glTF lays them out)
+constexpr auto ORM_OCCLUSION = 0;
+constexpr auto ORM_ROUGHNESS = 1;
+constexpr auto ORM_METALNESS = 2;
+constexpr auto ORM_CHANNELS = 3;
+
+// What a channel holds when it has no map: no occlusion, middling roughness, no metal
+static const unsigned char ormDefaults[ORM_CHANNELS] = { 255, 128, 0 };
+
+// --------------------------------------------------------
+// Finds textures that are one color throughout, and packs
+// single-channel maps into the channels of one image
+//
+// Roughness, metalness and occlusion maps each hold one value
+// per texel (the red channel, which is all a grayscale file
+// spreads its value to), so three of them fit in one RGBA8
+// image and the shader samples it once. A source smaller than
+// the largest is point sampled up to its size, which repeats
+// each texel whole when the sizes are multiples; nothing is
+// filtered, so every packed value is one the source held.
+//
+// Nothing here knows about D3D; TextureLoader packs images on
+// its threads and TextureStreamer turns uniform channels into
+// material constants.
+// --------------------------------------------------------
+class TexturePacker
+{
+public:
+											/// <summary>
+											/// Gets whether every texel of an image is the same
+											/// </summary>
+											/// <param name="_image">The image to check</param>
+											/// <param name="_texel">Receives the first texel (all four channels)</param>
+	static bool								IsUniform(const DecodedImage& _image, unsigned char _texel[4]);
+											/// <summary>
+											/// Packs the red channel of each source into one channel of a new image, with opaque alpha
+											/// </summary>
+											/// <param name="_sources">A source per channel (see ORM_{channels}), or null to fill the channel with its value</param>
+											/// <param name="_values">What each channel without a source holds</param>
+											/// <param name="_packed">Receives the image, as large as the largest source (1x1 if there are none)</param>
+	static void								Pack(const DecodedImage* const _sources[ORM_CHANNELS], const unsigned char _values[ORM_CHANNELS], DecodedImage& _packed);
+
+private:
+											/// <summary>
+											/// Gets the source texel a packed texel reads, point sampling by texel centers
+											/// </summary>
+	static unsigned int						GetSourceIndex(const DecodedImage& _source, unsigned int _x, unsigned int _y, unsigned int _width, unsigned int _height);
+};
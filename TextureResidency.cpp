@@ -0,0 +1,254 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <queue>
+
+TextureResidency::TextureResidency(unsigned long long _budget)
+{
+	budget = _budget;
+	residentBytes = 0;
+	frame = 0;
+	removed = 0;
+	stats = {};
+}
+
+TextureResidency::~TextureResidency()
+{
+}
+
+unsigned int TextureResidency::Add(unsigned int _width, unsigned int _height)
+{
+	ResidentTexture texture = {};
+	texture.width = _width;
+	texture.height = _height;
+
+	unsigned int size = std::max(_width, _height);
+	texture.mipCount = 1;
+	while ((size >> texture.mipCount) > 0 && texture.mipCount < TEXTURE_RESIDENCY_MAX_MIPS) texture.mipCount++;
+
+	texture.tailMip = 0;
+	while ((size >> texture.tailMip) > TEXTURE_RESIDENCY_TAIL_SIZE && texture.tailMip + 1 < texture.mipCount) texture.tailMip++;
+
+	texture.residentMip = texture.tailMip;
+	texture.wantedMip = texture.mipCount;
+	texture.wantedLevel = (float)texture.mipCount;
+	residentBytes += GetResidentBytes(texture);
+
+	textures.push_back(texture);
+	return (unsigned int)textures.size() - 1;
+}
+
+void TextureResidency::Remove(unsigned int _texture)
+{
+	// An empty texture stays in its place: with no mips, nothing loads, evicts or counts it
+	residentBytes -= GetResidentBytes(textures[_texture]);
+	textures[_texture] = {};
+	changed.erase(std::remove(changed.begin(), changed.end(), _texture), changed.end());
+	removed++;
+}
+
+void TextureResidency::SetBudget(unsigned long long _budget)
+{
+	budget = _budget;
+}
+
+void TextureResidency::BeginFrame()
+{
+	frame++;
+	for (auto& texture : textures)
+	{
+		texture.wantedMip = texture.mipCount;
+		texture.wantedLevel = (float)texture.mipCount;
+	}
+}
+
+void TextureResidency::Request(unsigned int _texture, float _uvPerPixel)
+{
+	ResidentTexture& texture = textures[_texture];
+
+	// Mip n is sharp while a pixel covers up to 2^n texels of the top mip; the finer of the two trilinear blends between is the one needed
+	float texelsPerPixel = _uvPerPixel * std::max(texture.width, texture.height);
+	float level = texelsPerPixel > 1 ? std::log2(texelsPerPixel) : 0;
+	if (level < texture.wantedLevel) texture.wantedLevel = level;
+
+	unsigned int mip = std::min((unsigned int)level, texture.mipCount - 1);
+	if (mip < texture.wantedMip) texture.wantedMip = mip;
+	for (unsigned int m = mip; m < texture.mipCount; m++)
+	{
+		texture.lastNeeded[m] = frame;
+	}
+}
+
+void TextureResidency::Update()
+{
+	changed.clear();
+	stats.loads = 0;
+	stats.evictions = 0;
+	stats.neededEvictions = 0;
+	stats.uploadedBytes = 0;
+
+	// A lowered budget gives back the least needed mips first
+	while (residentBytes > budget)
+	{
+		int victim = FindVictim(UINT_MAX, UINT_MAX);
+		if (victim < 0) break;
+		Evict((unsigned int)victim);
+	}
+
+	// Loads go blurriest first; each texture is queued for its next mip only, and goes back in for the one after
+	typedef std::pair<float, unsigned int> Candidate;
+	std::priority_queue<Candidate> candidates;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		ResidentTexture& texture = textures[i];
+		if (texture.wantedMip < texture.residentMip) candidates.push({ texture.residentMip - texture.wantedLevel, i });
+	}
+
+	while (!candidates.empty())
+	{
+		unsigned int index = candidates.top().second;
+		candidates.pop();
+		ResidentTexture& texture = textures[index];
+
+		unsigned int mip = texture.residentMip - 1;
+		unsigned long long bytes = GetMipBytes(texture.width, texture.height, mip);
+		if (stats.uploadedBytes > 0 && stats.uploadedBytes + bytes > TEXTURE_RESIDENCY_UPLOAD_BYTES) break;
+
+		// Make room, or leave this one blurry and see whether anything smaller still fits
+		unsigned int deficit = texture.residentMip - texture.wantedMip;
+		bool fits = true;
+		while (residentBytes + bytes > budget)
+		{
+			int victim = FindVictim(index, deficit);
+			if (victim < 0)
+			{
+				fits = false;
+				break;
+			}
+			Evict((unsigned int)victim);
+		}
+		if (!fits) continue;
+
+		texture.residentMip = mip;
+		residentBytes += bytes;
+		stats.loads++;
+		stats.uploadedBytes += bytes;
+		MarkChanged(index);
+
+		if (texture.wantedMip < texture.residentMip) candidates.push({ texture.residentMip - texture.wantedLevel, index });
+	}
+
+	stats.textures = (unsigned int)textures.size() - removed;
+	stats.requested = 0;
+	stats.satisfied = 0;
+	stats.mipDeficit = 0;
+	stats.wantedBytes = 0;
+	for (auto& texture : textures)
+	{
+		unsigned int wanted = std::min(texture.wantedMip, texture.tailMip);
+		for (unsigned int m = wanted; m < texture.mipCount; m++)
+		{
+			stats.wantedBytes += GetMipBytes(texture.width, texture.height, m);
+		}
+
+		if (texture.wantedMip == texture.mipCount) continue;
+		stats.requested++;
+		if (texture.residentMip <= texture.wantedMip) stats.satisfied++;
+		else stats.mipDeficit += texture.residentMip - texture.wantedMip;
+	}
+	stats.budget = budget;
+	stats.residentBytes = residentBytes;
+}
+
+const ResidentTexture& TextureResidency::GetTexture(unsigned int _texture)
+{
+	return textures[_texture];
+}
+
+const std::vector<unsigned int>& TextureResidency::GetChanged()
+{
+	return changed;
+}
+
+TextureResidencyStats TextureResidency::GetStats()
+{
+	return stats;
+}
+
+float TextureResidency::GetUVPerPixel(float _uvDensity, float _uvScale, float _distance, float _screenHeight, float _tanHalfFovY)
+{
+	// A pixel is (2 * distance * tan(fov / 2) / screen height) world units across at that distance
+	float worldPerPixel = 2 * _distance * _tanHalfFovY / _screenHeight;
+	return _uvDensity * _uvScale * worldPerPixel;
+}
+
+unsigned long long TextureResidency::GetMipBytes(unsigned int _width, unsigned int _height, unsigned int _mip)
+{
+	unsigned long long width = std::max(_width >> _mip, 1u);
+	unsigned long long height = std::max(_height >> _mip, 1u);
+	return width * height * TEXTURE_RESIDENCY_TEXEL_BYTES;
+}
+
+unsigned long long TextureResidency::GetResidentBytes(const ResidentTexture& _texture)
+{
+	unsigned long long bytes = 0;
+	for (unsigned int m = _texture.residentMip; m < _texture.mipCount; m++)
+	{
+		bytes += GetMipBytes(_texture.width, _texture.height, m);
+	}
+	return bytes;
+}
+
+int TextureResidency::FindVictim(unsigned int _loading, unsigned int _deficit)
+{
+	// Only a texture's finest mip can go, and never its tail. Mips nothing asked for this frame go first, least recently needed first
+	int victim = -1;
+	unsigned long long oldest = ULLONG_MAX;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		ResidentTexture& texture = textures[i];
+		if (i == _loading || texture.residentMip >= texture.tailMip) continue;
+
+		unsigned long long needed = texture.lastNeeded[texture.residentMip];
+		if (needed < frame && needed < oldest)
+		{
+			oldest = needed;
+			victim = (int)i;
+		}
+	}
+	if (victim >= 0) return victim;
+
+	// Then a mip in use, but only if its texture ends up strictly less blurry than the loading one was, so the two can't trade back
+	unsigned int smallest = UINT_MAX;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		ResidentTexture& texture = textures[i];
+		if (i == _loading || texture.residentMip >= texture.tailMip) continue;
+
+		unsigned int deficit = texture.residentMip + 1 > texture.wantedMip ? texture.residentMip + 1 - texture.wantedMip : 0;
+		if (_deficit != UINT_MAX && deficit + 1 >= _deficit) continue;
+		if (deficit < smallest)
+		{
+			smallest = deficit;
+			victim = (int)i;
+		}
+	}
+	return victim;
+}
+
+void TextureResidency::Evict(unsigned int _texture)
+{
+	ResidentTexture& texture = textures[_texture];
+	residentBytes -= GetMipBytes(texture.width, texture.height, texture.residentMip);
+	if (texture.lastNeeded[texture.residentMip] == frame) stats.neededEvictions++;
+	texture.residentMip++;
+	stats.evictions++;
+	MarkChanged(_texture);
+}
+
+void TextureResidency::MarkChanged(unsigned int _texture)
+{
+	if (std::find(changed.begin(), changed.end(), _texture) == changed.end()) changed.push_back(_texture);
+}
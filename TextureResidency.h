@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vector>
+
+// Mips this wide and tall or smaller are always resident, so every texture has something to sample
+constexpr auto TEXTURE_RESIDENCY_TAIL_SIZE = 64;
+
+// The most mip levels a texture can have (a 16384 texture has 15)
+constexpr auto TEXTURE_RESIDENCY_MAX_MIPS = 15;
+
+// Bytes of mips that may be loaded in one frame; a single larger mip still goes through on its own
+constexpr auto TEXTURE_RESIDENCY_UPLOAD_BYTES = 8 * 1024 * 1024;
+
+// Bytes per texel of every streamed texture (RGBA8)
+constexpr auto TEXTURE_RESIDENCY_TEXEL_BYTES = 4;
+
+// A texture's size and which of its mips are resident
+struct ResidentTexture
+{
+	unsigned int							width;
+	unsigned int							height;
+	unsigned int							mipCount;			// Down to 1x1
+	unsigned int							tailMip;			// First mip no bigger than TEXTURE_RESIDENCY_TAIL_SIZE
+	unsigned int							residentMip;		// Finest mip resident (every coarser one is too)
+	unsigned int							wantedMip;			// Finest mip asked for this frame, or mipCount if none was
+	float									wantedLevel;		// The exact level behind it, for ordering loads
+	unsigned long long						lastNeeded[TEXTURE_RESIDENCY_MAX_MIPS];	// Frame each mip was last asked for
+};
+
+struct TextureResidencyStats
+{
+	unsigned int							textures;
+	unsigned int							requested;			// Textures asked for this frame
+	unsigned int							satisfied;			// Of those, ones with their wanted mip resident
+	unsigned int							mipDeficit;			// Levels missing over all the asked for textures
+	unsigned int							loads;				// Mips loaded this frame
+	unsigned int							evictions;			// Mips dropped this frame
+	unsigned int							neededEvictions;	// Of those, mips still in use (dropped to make room for blurrier textures)
+	unsigned long long						budget;
+	unsigned long long						residentBytes;
+	unsigned long long						wantedBytes;		// What every asked for mip (and every other texture's tail) would take
+	unsigned long long						uploadedBytes;		// Loaded this frame
+};
+
+// --------------------------------------------------------
+// Decides which mips of each streamed texture stay in
+// memory, under a budget
+//
+// Each frame, whatever draws with a texture asks for the mip
+// its screen size calls for (Request, usually through
+// GetUVPerPixel); a texture keeps the finest mip anything asked
+// for. Update then loads missing mips one level at a time,
+// blurriest texture first (by how many levels it's missing),
+// up to TEXTURE_RESIDENCY_UPLOAD_BYTES a frame.
+//
+// When a load doesn't fit, the least recently needed mip that
+// nothing asked for this frame is evicted. Once only mips in
+// use are left, one is only dropped if its texture would still
+// be less blurry than the one loading, which evens blur out
+// across textures instead of swapping mips back and forth.
+// Mips are always resident from some level down to 1x1, and
+// the tail (TEXTURE_RESIDENCY_TAIL_SIZE and under) never goes.
+//
+// Everything here is deterministic and knows nothing about
+// D3D; TextureStreamer builds the textures it settles on.
+// --------------------------------------------------------
+class TextureResidency
+{
+public:
+											/// <summary>
+											/// Makes an empty residency set
+											/// </summary>
+											/// <param name="_budget">Bytes the resident mips may take</param>
+	TextureResidency(unsigned long long _budget);
+	~TextureResidency();
+
+											/// <summary>
+											/// Starts tracking a texture, with only its tail resident
+											/// </summary>
+											/// <returns>The texture's id (in the order they're added, from 0)</returns>
+	unsigned int							Add(unsigned int _width, unsigned int _height);
+											/// <summary>
+											/// Stops tracking a texture and gives its mips' memory back (other ids don't change)
+											/// </summary>
+	void									Remove(unsigned int _texture);
+	void									SetBudget(unsigned long long _budget);
+
+											/// <summary>
+											/// Forgets last frame's requests
+											/// </summary>
+	void									BeginFrame();
+											/// <summary>
+											/// Asks for the mip a texture needs to be sharp where it's drawn
+											/// </summary>
+											/// <param name="_texture">The texture's id</param>
+											/// <param name="_uvPerPixel">How much UV space one screen pixel covers (see GetUVPerPixel)</param>
+	void									Request(unsigned int _texture, float _uvPerPixel);
+											/// <summary>
+											/// Loads and evicts mips for this frame's requests
+											/// </summary>
+	void									Update();
+
+	const ResidentTexture&					GetTexture(unsigned int _texture);
+											/// <summary>
+											/// Gets the textures whose resident mips changed in the last Update
+											/// </summary>
+	const std::vector<unsigned int>&		GetChanged();
+	TextureResidencyStats					GetStats();
+
+											/// <summary>
+											/// Gets how much UV space a pixel covers on a surface
+											/// </summary>
+											/// <param name="_uvDensity">UV units per world unit on the surface (the mesh's, divided by the entity's scale)</param>
+											/// <param name="_uvScale">The material's UV scale</param>
+											/// <param name="_distance">The surface's distance from the camera</param>
+											/// <param name="_screenHeight">The height of the screen in pixels</param>
+											/// <param name="_tanHalfFovY">Tangent of half the camera's vertical field of view</param>
+	static float							GetUVPerPixel(float _uvDensity, float _uvScale, float _distance, float _screenHeight, float _tanHalfFovY);
+	static unsigned long long				GetMipBytes(unsigned int _width, unsigned int _height, unsigned int _mip);
+
+private:
+	std::vector<ResidentTexture>			textures;
+	std::vector<unsigned int>				changed;
+	unsigned long long						budget;
+	unsigned long long						residentBytes;
+	unsigned long long						frame;
+	unsigned int							removed;
+	TextureResidencyStats					stats;
+
+	unsigned long long						GetResidentBytes(const ResidentTexture& _texture);
+	int										FindVictim(unsigned int _loading, unsigned int _deficit);
+	void									Evict(unsigned int _texture);
+	void									MarkChanged(unsigned int _texture);
+};
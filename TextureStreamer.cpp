@@ -0,0 +1,444 @@
+#include "TextureStreamer.h"
+#include "DXCore.h"
+#include "ContainerTextureLoader.h"
+#include "PathEncoding.h"
+#include "WICTextureLoader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+TextureStreamer::TextureStreamer(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, unsigned long long _budget)
+	: residency(_budget)
+{
+	device = _device;
+	context = _context;
+	stats = {};
+
+	// Leave a core for the main thread
+	unsigned int cores = std::thread::hardware_concurrency();
+	loader = std::make_shared<TextureLoader>(cores > 1 ? cores - 1 : 1);
+	stats.threads = loader->GetThreadCount();
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::Load(std::shared_ptr<Material> _material, const wchar_t* _path, const char* _type)
+{
+	if (stats.requests == 0) firstLoad = std::chrono::high_resolution_clock::now();
+	stats.requests++;
+
+	// The placeholder goes in through PushTexture, so the material's map flags are set just as if the texture were there
+	_material->PushTexture(_type, GetPlaceholder(_type));
+
+	std::wstring path = _path;
+
+	bool created;
+	unsigned int handle = registry.Acquire(WidePathToUTF8(path), created);
+	if (!created)
+	{
+		unsigned int index = registry.Get(handle);
+		textures[index].users.push_back({ _material, _type });
+		materialTextures[_material.get()].push_back(index);
+		Deliver(textures[index], textures[index].users.back());
+		return;
+	}
+
+	unsigned int index = (unsigned int)textures.size();
+	materialTextures[_material.get()].push_back(index);
+
+	StreamedTexture texture = {};
+	texture.path = path;
+	texture.handle = handle;
+	texture.users.push_back({ _material, _type });
+	texture.residentId = -1;
+	stats.files++;
+
+	// A pre-built container is already what the GPU wants, so it goes in now and stays whole
+	std::wstring containerPath = ContainerTextureLoader::FindContainer(DXCore::GetFullPathTo_Wide(path));
+	unsigned long long bytes = 0;
+	if (!containerPath.empty() && ContainerTextureLoader::Load(device.Get(), containerPath, texture.shaderResourceView, &bytes))
+	{
+		registry.Set(handle, index, bytes);
+		_material->SwapTexture(_type, texture.shaderResourceView);
+		textures.push_back(texture);
+		stats.containers++;
+		return;
+	}
+
+	texture.files.push_back(WidePathToUTF8(DXCore::GetFullPathTo_Wide(path)));
+	unsigned int id = loader->Load(texture.files[0]);
+	if (loaderTextures.size() <= id) loaderTextures.resize(id + 1);
+	loaderTextures[id] = index;
+	registry.Set(handle, index, 0);
+	textures.push_back(texture);
+}
+
+void TextureStreamer::LoadORM(std::shared_ptr<Material> _material, const wchar_t* _occlusion, const wchar_t* _roughness, const wchar_t* _metalness)
+{
+	if (stats.requests == 0) firstLoad = std::chrono::high_resolution_clock::now();
+	stats.requests++;
+
+	_material->PushTexture(TEXTYPE_ORM, GetPlaceholder(TEXTYPE_ORM));
+
+	// The maps together name the texture, so materials packing the same ones share it
+	const wchar_t* paths[ORM_CHANNELS] = { _occlusion, _roughness, _metalness };
+	std::string fullPaths[ORM_CHANNELS];
+	std::string key;
+	unsigned int mappedChannels = 0;
+	for (int c = 0; c < ORM_CHANNELS; c++)
+	{
+		if (paths[c] != 0)
+		{
+			fullPaths[c] = WidePathToUTF8(DXCore::GetFullPathTo_Wide(paths[c]));
+			key += NormalizeResourcePath(std::wstring(paths[c]));
+			mappedChannels |= 1u << c;
+		}
+		key += '|';
+	}
+
+	bool created;
+	unsigned int handle = registry.Acquire(key, created);
+	if (!created)
+	{
+		unsigned int index = registry.Get(handle);
+		textures[index].users.push_back({ _material, TEXTYPE_ORM });
+		materialTextures[_material.get()].push_back(index);
+		Deliver(textures[index], textures[index].users.back());
+		return;
+	}
+
+	unsigned int index = (unsigned int)textures.size();
+	materialTextures[_material.get()].push_back(index);
+
+	StreamedTexture texture = {};
+	texture.handle = handle;
+	texture.packed = true;
+	texture.mappedChannels = mappedChannels;
+	texture.users.push_back({ _material, TEXTYPE_ORM });
+	texture.residentId = -1;
+	stats.files++;
+
+	texture.files.assign(fullPaths, fullPaths + ORM_CHANNELS);
+	unsigned int id = loader->LoadPacked(fullPaths);
+	if (loaderTextures.size() <= id) loaderTextures.resize(id + 1);
+	loaderTextures[id] = index;
+	registry.Set(handle, index, 0);
+	textures.push_back(texture);
+}
+
+void TextureStreamer::Release(std::shared_ptr<Material> _material)
+{
+	auto found = materialTextures.find(_material.get());
+	if (found == materialTextures.end()) return;
+
+	// One reference per Load, which is also one index in the material's list
+	for (unsigned int index : found->second)
+	{
+		StreamedTexture& texture = textures[index];
+		for (auto user = texture.users.begin(); user != texture.users.end(); ++user)
+		{
+			if (user->material != _material) continue;
+			texture.users.erase(user);
+			break;
+		}
+
+		unsigned int freed;
+		if (!registry.Release(texture.handle, freed)) continue;
+
+		// A texture still loading is dropped when it arrives
+		texture.released = true;
+		std::vector<DecodedImage>().swap(texture.mips);
+		texture.texture.Reset();
+		texture.shaderResourceView.Reset();
+		if (texture.residentId >= 0) residency.Remove((unsigned int)texture.residentId);
+	}
+	materialTextures.erase(found);
+}
+
+void TextureStreamer::Request(std::shared_ptr<Camera> _camera, float _screenHeight, const std::vector<std::shared_ptr<Entity>>& _entities)
+{
+	BoundingFrustum frustum = _camera->GetFrustum();
+	XMFLOAT3 cameraPosition = _camera->GetTransform()->GetPosition();
+	XMFLOAT4X4 projection = _camera->GetProjectionMatrix();
+	float tanHalfFovY = 1.0f / projection._22;
+
+	for (auto& entity : _entities)
+	{
+		auto found = materialTextures.find(entity->GetMaterial().get());
+		if (found == materialTextures.end()) continue;
+
+		BoundingSphere bounds = entity->GetBounds();
+		if (!frustum.Intersects(bounds)) continue;
+
+		// The closest the surface gets to the camera decides the sharpest mip it needs
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Center) - XMLoadFloat3(&cameraPosition))) - bounds.Radius;
+		distance = std::max(distance, _camera->GetNearClip());
+
+		// Scaling an entity up spreads the same UVs over more of the world
+		XMFLOAT3 scale = entity->GetTransform()->GetScale();
+		float largestScale = std::max(std::max(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));
+		if (largestScale <= 0) continue;
+
+		XMFLOAT2 uvScale = entity->GetMaterial()->GetUVScale();
+		float uvPerPixel = TextureResidency::GetUVPerPixel(entity->GetMesh()->GetUVDensity() / largestScale,
+			std::max(fabsf(uvScale.x), fabsf(uvScale.y)), distance, _screenHeight, tanHalfFovY);
+
+		for (unsigned int index : found->second)
+		{
+			if (textures[index].residentId >= 0) residency.Request((unsigned int)textures[index].residentId, uvPerPixel);
+		}
+	}
+}
+
+void TextureStreamer::Update()
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	bool arrived = loader->GetPending() > 0;
+
+	TextureLoadResult result;
+	for (int i = 0; i < TEXTURE_UPLOADS_PER_FRAME && loader->Poll(result); i++)
+	{
+		unsigned int index = loaderTextures[result.id];
+		StreamedTexture& texture = textures[index];
+		stats.decodeMilliseconds += result.milliseconds;
+		if (texture.released) continue;
+
+		// A copy of a file already in place (under another name) just gets its users moved over
+		if (result.contentSize > 0)
+		{
+			unsigned int handle = registry.Resolve(texture.handle, result.contentHash, result.contentSize,
+				[this, index](unsigned int _original) { return SameFiles(textures[index], textures[registry.Get(_original)]); });
+			if (handle != texture.handle)
+			{
+				Merge(index, registry.Get(handle));
+				continue;
+			}
+		}
+
+		if (texture.packed)
+		{
+			// Channels of one value become constants; if that's all of them, the users drop the map instead
+			texture.uniformChannels = result.uniformChannels;
+			for (int c = 0; c < ORM_CHANNELS; c++)
+			{
+				texture.values[c] = result.mips[0].pixels[c];
+				if (texture.uniformChannels & texture.mappedChannels & (1u << c)) stats.uniform++;
+			}
+			for (auto& user : texture.users)
+			{
+				Deliver(texture, user);
+			}
+			if (result.uniform) continue;
+			stats.packed++;
+		}
+		else if (result.uniform)
+		{
+			// Users whose shader has a constant for the map take its color instead; the 1x1 texture is made for the rest
+			texture.uniform = true;
+			memcpy(texture.texel, result.mips[0].pixels.data(), 4);
+			for (auto& user : texture.users)
+			{
+				Deliver(texture, user);
+			}
+			stats.uniform++;
+		}
+
+		// Packed textures are made from whichever maps could be read, with defaults for the rest
+		if (result.decoded || texture.packed)
+		{
+			// New textures start with just their tail on the GPU; the residency brings the rest in as they're needed
+			unsigned long long bytes = 0;
+			for (auto& mip : result.mips)
+			{
+				bytes += mip.pixels.size();
+			}
+			registry.Set(texture.handle, index, bytes);
+
+			texture.mips = std::move(result.mips);
+			texture.residentId = (int)residency.Add(texture.mips[0].width, texture.mips[0].height);
+			residentTextures.push_back(index);
+			BuildTexture(texture);
+			stats.created++;
+			continue;
+		}
+
+		// A file that failed both ways keeps its placeholder
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+		DirectX::CreateWICTextureFromFile(device.Get(), context.Get(), DXCore::GetFullPathTo_Wide(texture.path).c_str(), 0, shaderResourceView.GetAddressOf());
+		stats.fallbacks++;
+		if (!shaderResourceView) continue;
+		texture.shaderResourceView = shaderResourceView;
+		for (auto& user : texture.users)
+		{
+			user.material->SwapTexture(user.type, shaderResourceView);
+		}
+	}
+
+	residency.Update();
+	stats.rebuilds = 0;
+	for (unsigned int residentId : residency.GetChanged())
+	{
+		BuildTexture(textures[residentTextures[residentId]]);
+		stats.rebuilds++;
+	}
+	stats.residency = residency.GetStats();
+	residency.BeginFrame();
+
+	std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double, std::milli> upload = end - start;
+	stats.uploadMilliseconds += upload.count();
+	if (arrived)
+	{
+		std::chrono::duration<double, std::milli> elapsed = end - firstLoad;
+		stats.elapsedMilliseconds = elapsed.count();
+	}
+}
+
+void TextureStreamer::SetBudget(unsigned long long _budget)
+{
+	residency.SetBudget(_budget);
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureStreamer::GetPlaceholder(const char* _type)
+{
+	std::string type = _type;
+	auto found = placeholders.find(type);
+	if (found != placeholders.end()) return found->second;
+
+	// Values that leave a material looking plain rather than wrong: no tint, no bumps, no glow, no metal
+	unsigned char texel[4] = { 128, 128, 128, 255 };
+	if (type == TEXTYPE_ALBEDO) texel[0] = texel[1] = texel[2] = 255;
+	else if (type == TEXTYPE_NORMAL) texel[2] = 255;
+	else if (type == TEXTYPE_EMISSIVE || type == TEXTYPE_METALNESS) texel[0] = texel[1] = texel[2] = 0;
+	else if (type == TEXTYPE_ORM) memcpy(texel, ormDefaults, ORM_CHANNELS);
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = 1;
+	textureDesc.Height = 1;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = texel;
+	data.SysMemPitch = sizeof(texel);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+	device->CreateTexture2D(&textureDesc, &data, texture.GetAddressOf());
+	device->CreateShaderResourceView(texture.Get(), 0, shaderResourceView.GetAddressOf());
+
+	placeholders.insert({ type, shaderResourceView });
+	return shaderResourceView;
+}
+
+TextureStreamerStats TextureStreamer::GetStats()
+{
+	TextureStreamerStats current = stats;
+	current.pending = loader->GetPending();
+	current.registry = registry.GetStats();
+	if (current.pending > 0 && current.requests > 0)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - firstLoad;
+		current.elapsedMilliseconds = elapsed.count();
+	}
+	return current;
+}
+
+void TextureStreamer::BuildTexture(StreamedTexture& _texture)
+{
+	const ResidentTexture& resident = residency.GetTexture((unsigned int)_texture.residentId);
+	unsigned int firstMip = resident.residentMip;
+
+	// Same layout WIC gave these files, but only from the first resident mip down
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = _texture.mips[firstMip].width;
+	textureDesc.Height = _texture.mips[firstMip].height;
+	textureDesc.MipLevels = resident.mipCount - firstMip;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+	if (FAILED(device->CreateTexture2D(&textureDesc, 0, texture.GetAddressOf()))) return;
+	device->CreateShaderResourceView(texture.Get(), 0, shaderResourceView.GetAddressOf());
+
+	// Mips the old texture had are copied across on the GPU; only the new ones come from system memory
+	for (unsigned int mip = firstMip; mip < resident.mipCount; mip++)
+	{
+		if (_texture.texture && mip >= _texture.textureMip)
+		{
+			context->CopySubresourceRegion(texture.Get(), mip - firstMip, 0, 0, 0, _texture.texture.Get(), mip - _texture.textureMip, 0);
+			continue;
+		}
+
+		const DecodedImage& image = _texture.mips[mip];
+		context->UpdateSubresource(texture.Get(), mip - firstMip, 0, image.pixels.data(), image.width * 4, 0);
+	}
+
+	_texture.texture = texture;
+	_texture.textureMip = firstMip;
+	_texture.shaderResourceView = shaderResourceView;
+	for (auto& user : _texture.users)
+	{
+		if (!user.constant) user.material->SwapTexture(user.type, shaderResourceView);
+	}
+}
+
+void TextureStreamer::Merge(unsigned int _duplicate, unsigned int _original)
+{
+	StreamedTexture& duplicate = textures[_duplicate];
+	StreamedTexture& original = textures[_original];
+	for (auto& user : duplicate.users)
+	{
+		std::vector<unsigned int>& indices = materialTextures[user.material.get()];
+		std::replace(indices.begin(), indices.end(), _duplicate, _original);
+		Deliver(original, user);
+		original.users.push_back(user);
+	}
+	duplicate.users.clear();
+	duplicate.released = true;
+}
+
+bool TextureStreamer::SameFiles(const StreamedTexture& _a, const StreamedTexture& _b)
+{
+	// Only reached when the hashes and sizes already match, so this reads files that are almost always copies
+	if (_a.packed != _b.packed || _a.files.size() != _b.files.size()) return false;
+	for (size_t i = 0; i < _a.files.size(); i++)
+	{
+		if (_a.files[i].empty() != _b.files[i].empty()) return false;
+		if (!_a.files[i].empty() && !ResourceFilesMatch(_a.files[i], _b.files[i])) return false;
+	}
+	return true;
+}
+
+void TextureStreamer::Deliver(StreamedTexture& _texture, TextureUser& _user)
+{
+	// A file of one color is a constant for every user whose shader has one, and those users never bind the texture
+	if (_texture.uniform && !_user.constant) _user.constant = _user.material->ReplaceTextureWithConstant(_user.type, _texture.texel);
+	if (_user.constant) return;
+
+	// A packed texture's one-color maps are constants, which the shader reads wherever the material has no ORM map
+	if (_texture.uniformChannels & (1u << ORM_OCCLUSION)) _user.material->SetOcclusion(_texture.values[ORM_OCCLUSION] / 255.f);
+	if (_texture.uniformChannels & (1u << ORM_ROUGHNESS)) _user.material->SetRoughness(_texture.values[ORM_ROUGHNESS] / 255.f);
+	if (_texture.uniformChannels & (1u << ORM_METALNESS)) _user.material->SetMetalness(_texture.values[ORM_METALNESS] / 255.f);
+	if (_texture.packed && _texture.uniformChannels == (1u << ORM_CHANNELS) - 1)
+	{
+		_user.material->RemoveTexture(_user.type);
+		return;
+	}
+
+	if (_texture.shaderResourceView) _user.material->SwapTexture(_user.type, _texture.shaderResourceView);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+#include "Entity.h"
+#include "Material.h"
+#include "ResourceRegistry.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+
+// The most decoded images turned into textures in one frame, so a burst of finished loads doesn't hitch
+constexpr auto TEXTURE_UPLOADS_PER_FRAME = 4;
+
+// Video memory streamed textures may take to begin with (see TextureStreamer::SetBudget)
+constexpr auto TEXTURE_STREAMING_BUDGET = 128ull * 1024 * 1024;
+
+struct TextureStreamerStats
+{
+	unsigned int							requests;			// Load calls
+	unsigned int							files;				// Distinct paths among them, each read and decoded once
+	unsigned int							created;			// Textures made from decoded images
+	unsigned int							fallbacks;			// Files the decoder couldn't handle, loaded with WIC on the main thread instead
+	unsigned int							containers;			// Files with a pre-built .dds/.ktx2 next to them, made straight from it
+	unsigned int							packed;				// ORM textures packed from separate maps
+	unsigned int							uniform;			// Maps of one color, made material constants where the shader has one (or else kept as a single texel)
+	unsigned int							pending;			// Files not in place yet
+	unsigned int							threads;
+	unsigned int							rebuilds;			// Textures remade this frame for a change in resident mips
+	double									decodeMilliseconds;	// Summed over the loader threads
+	double									uploadMilliseconds;	// Spent on the main thread making textures
+	double									elapsedMilliseconds;// From the first Load until the last texture was in place (or until now)
+	TextureResidencyStats					residency;			// For the last frame's mip streaming
+	ResourceRegistryStats					registry;			// Files shared by path and by contents (bytes are of whole mip chains)
+};
+
+// --------------------------------------------------------
+// Loads material textures without holding up the main thread,
+// and streams their mips in and out under a memory budget
+//
+// Load hands the file to a TextureLoader and gives the
+// material a 1x1 placeholder of a neutral value for the
+// texture's type (white albedo, a flat normal, no metal...)
+// straight away, so its map flags and shader permutation are
+// settled and it can draw. A ResourceRegistry keeps one
+// texture per file, however many materials use it or however
+// its path is written, and once a file is read, one per set
+// of contents: a copy under another name is merged into the
+// texture already made from it. Release drops a material's
+// references, and a texture nothing uses any more is freed.
+//
+// Decoded files keep their whole mip chain in system memory,
+// but only the mips a TextureResidency settles on are on the
+// GPU: every frame, Request works out the mip each visible
+// entity's textures need from its mesh's UV density, its scale
+// and its distance, and Update makes the residency's changes,
+// rebuilding each changed texture from the mips it already has
+// plus the new ones, then swapping it into every material
+// that uses the file.
+//
+// LoadORM packs a material's occlusion, roughness and
+// metalness maps into one texture on the loader threads. Maps
+// that turn out to be one color become material constants;
+// if all of them are, the material loses its ORM map (and its
+// shader variant with it) and no texture is made at all.
+// Other files of one color go the same way: an albedo, specular
+// or emissive map becomes the material's constant for it, if
+// its shader has one, and only materials without keep the
+// map (as a 1x1 texture).
+//
+// Files the portable decoder can't read fall back to WIC,
+// which has to run on the main thread, and aren't streamed.
+// Neither are files with a pre-built container next to them
+// (see ContainerTextureLoader): it's mapped and made into a
+// texture, mips and all, as soon as it's asked for, since
+// that's quicker than a placeholder round trip would be.
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, unsigned long long _budget);
+	~TextureStreamer();
+
+											/// <summary>
+											/// Gives the material a placeholder now and queues the real texture to replace it
+											/// </summary>
+											/// <param name="_material">The material the texture is for</param>
+											/// <param name="_path">The path of the texture relative to the root where the executable is located</param>
+											/// <param name="_type">The type of texture this is (see TEXTYPE_{types}; should match shader Texture2D buffers)</param>
+	void									Load(std::shared_ptr<Material> _material, const wchar_t* _path, const char* _type);
+											/// <summary>
+											/// Gives the material a placeholder ORM map now and queues its maps to be packed into the real one
+											/// </summary>
+											/// <param name="_material">The material the maps are for</param>
+											/// <param name="_occlusion">The path of the ambient occlusion map, or null for none</param>
+											/// <param name="_roughness">The path of the roughness map, or null for none</param>
+											/// <param name="_metalness">The path of the metalness map, or null for none</param>
+	void									LoadORM(std::shared_ptr<Material> _material, const wchar_t* _occlusion, const wchar_t* _roughness, const wchar_t* _metalness);
+											/// <summary>
+											/// Drops every texture reference the material took with Load, freeing textures nothing else uses
+											/// </summary>
+											/// <param name="_material">The material, which keeps whatever textures it has bound</param>
+	void									Release(std::shared_ptr<Material> _material);
+											/// <summary>
+											/// Asks for the mips the visible entities' textures need this frame (can be called for several lists)
+											/// </summary>
+											/// <param name="_camera">The camera rendering this frame</param>
+											/// <param name="_screenHeight">The height of the screen in pixels</param>
+											/// <param name="_entities">Entities that might be drawn</param>
+	void									Request(std::shared_ptr<Camera> _camera, float _screenHeight, const std::vector<std::shared_ptr<Entity>>& _entities);
+											/// <summary>
+											/// Makes textures from images the loader has finished (up to TEXTURE_UPLOADS_PER_FRAME),
+											/// then loads and evicts mips for this frame's requests
+											/// </summary>
+	void									Update();
+											/// <summary>
+											/// Changes how much video memory streamed mips may take (mips over it go on the next Update)
+											/// </summary>
+	void									SetBudget(unsigned long long _budget);
+											/// <summary>
+											/// Gets the 1x1 texture materials use for a type until theirs has loaded
+											/// </summary>
+											/// <param name="_type">The type of texture (see TEXTYPE_{types})</param>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	GetPlaceholder(const char* _type);
+
+	TextureStreamerStats					GetStats();
+
+private:
+	struct TextureUser
+	{
+		std::shared_ptr<Material>			material;
+		std::string							type;
+		bool								constant;			// Took a file of one color as a material constant rather than binding it
+	};
+
+	struct StreamedTexture
+	{
+		std::wstring						path;
+		std::vector<std::string>			files;				// The full paths it's read from (in UTF-8): path's, or each ORM_{channel}'s map (empty for one without)
+		std::vector<TextureUser>			users;
+		unsigned int						handle;				// Into the registry
+		bool								released;			// Freed, or merged into a texture with the same contents
+		bool								packed;				// Packed from maps by LoadORM, rather than loaded from path
+		unsigned int						mappedChannels;		// A bit per ORM_{channel} LoadORM was given a map for
+		unsigned int						uniformChannels;	// Once packed, a bit per ORM_{channel} that's a material constant
+		unsigned char						values[ORM_CHANNELS];	// The constants
+		bool								uniform;			// Loaded from path and one color throughout, so users take texel as a constant where they can
+		unsigned char						texel[4];
+		int									residentId;			// Into the residency, or -1 until decoded
+		std::vector<DecodedImage>			mips;				// The whole chain, for uploading mips as they come in
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>	texture;
+		unsigned int						textureMip;			// The mip the GPU texture's first level holds
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	shaderResourceView;	// What the users have bound, once it's in place
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device>		device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
+
+	std::shared_ptr<TextureLoader>			loader;
+	TextureResidency						residency;
+	std::vector<StreamedTexture>			textures;
+	std::vector<unsigned int>				loaderTextures;		// Index into textures of each loader id
+	std::vector<unsigned int>				residentTextures;	// Index into textures of each residency id
+	ResourceRegistry<unsigned int>			registry;			// Index into textures of each file
+	std::unordered_map<Material*, std::vector<unsigned int>>	materialTextures;
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>	placeholders;
+
+	TextureStreamerStats					stats;
+	std::chrono::high_resolution_clock::time_point	firstLoad;
+
+											/// <summary>
+											/// Remakes a texture with the mips the residency has for it, keeping whichever the old one had
+											/// </summary>
+	void									BuildTexture(StreamedTexture& _texture);
+											/// <summary>
+											/// Moves a texture's users onto one loaded from the same contents
+											/// </summary>
+	void									Merge(unsigned int _duplicate, unsigned int _original);
+											/// <summary>
+											/// Checks, byte for byte, that two textures were read from files with the same contents
+											/// </summary>
+	static bool								SameFiles(const StreamedTexture& _a, const StreamedTexture& _b);
+											/// <summary>
+											/// Gives a user what the texture has so far: its constants, its view, or neither while it's loading
+											/// </summary>
+	void									Deliver(StreamedTexture& _texture, TextureUser& _user);
+};
@@ -0,0 +1,99 @@
+// --------------------------------------------------------
+// Benchmark for ClusterGrid's binning: 1k, 10k and 50k point
+// lights scattered around the camera, binned on one thread
+// and on every hardware thread (best of several frames, so
+// the pool is already running), next to the brute force test
+// of every light against every cluster
+//
+// Not part of the game's project. Build it on its own, e.g.
+//   cl /O2 /EHsc /DNDEBUG /I.. BenchClusterGrid.cpp ..\ClusterGrid.cpp
+// --------------------------------------------------------
+#include "../ClusterGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+using namespace DirectX;
+
+// A left-handed perspective projection, as Camera makes
+static XMFLOAT4X4 Projection(float _fov, float _aspect, float _nearClip, float _farClip)
+{
+	XMFLOAT4X4 projection = {};
+	float height = 1.0f / tanf(_fov / 2);
+	projection._11 = height / _aspect;
+	projection._22 = height;
+	projection._33 = _farClip / (_farClip - _nearClip);
+	projection._34 = 1;
+	projection._43 = -_nearClip * _farClip / (_farClip - _nearClip);
+	return projection;
+}
+
+// The view from a camera at a position, turned about y
+static XMFLOAT4X4 View(float _yaw, XMFLOAT3 _position)
+{
+	XMFLOAT4X4 view = {};
+	float c = cosf(_yaw);
+	float s = sinf(_yaw);
+	view._11 = c;
+	view._13 = s;
+	view._22 = 1;
+	view._31 = -s;
+	view._33 = c;
+	view._44 = 1;
+	view._41 = -(_position.x * view._11 + _position.y * view._21 + _position.z * view._31);
+	view._42 = -(_position.x * view._12 + _position.y * view._22 + _position.z * view._32);
+	view._43 = -(_position.x * view._13 + _position.y * view._23 + _position.z * view._33);
+	return view;
+}
+
+static std::vector<Light> MakeLights(unsigned int _count, unsigned int _seed)
+{
+	std::mt19937 random(_seed);
+	std::uniform_real_distribution<float> unit(0, 1);
+	std::vector<Light> lights;
+	for (unsigned int i = 0; i < _count; i++)
+	{
+		XMFLOAT3 position(unit(random) * 400 - 200, unit(random) * 60 - 10, unit(random) * 400 - 200);
+		lights.push_back(Light::Point(position, XMFLOAT3(1, 1, 1), 1, 0.5f + unit(random) * 15));
+	}
+	return lights;
+}
+
+int main()
+{
+	const int frames = 20;
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	ClusterGrid grid;
+	grid.SetProjection(Projection(1.0472f, 16.0f / 9.0f, 0.01f, 1000.0f), 0.01f, 1000.0f);
+	XMFLOAT4X4 view = View(0.7f, XMFLOAT3(3, 5, -20));
+
+	printf("Binning into %d clusters (ms, best of %d frames)\n", CLUSTER_COUNT, frames);
+	printf("  lights   1 thread   %2u threads   brute force   visible   references\n", hardwareThreads);
+	unsigned int counts[] = { 1000, 10000, 50000 };
+	for (unsigned int count : counts)
+	{
+		std::vector<Light> lights = MakeLights(count, 99);
+
+		double best[2] = { 1e9, 1e9 };
+		unsigned int threads[2] = { 1, hardwareThreads };
+		for (int t = 0; t < 2; t++)
+		{
+			for (int f = 0; f < frames; f++)
+			{
+				grid.Assign(view, lights, threads[t]);
+				best[t] = std::min(best[t], grid.GetStats().milliseconds);
+			}
+		}
+		ClusterStats stats = grid.GetStats();
+
+		grid.AssignBruteForce(view, lights);
+		double bruteForce = grid.GetStats().milliseconds;
+
+		printf("  %6u   %8.3f   %10.3f   %11.1f   %7u   %10u\n", count, best[0], best[1], bruteForce, stats.visibleLights, stats.references);
+	}
+	return 0;
+}
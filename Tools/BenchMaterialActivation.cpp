@@ -0,0 +1,127 @@
+// --------------------------------------------------------
+// Benchmark for activating a toon material per draw: the old
+// way (every parameter set by name, then the whole buffer
+// copied up) against Material::ActivateMaterial, with the
+// material's block unchanged and with it dirtied every draw
+//
+// Two materials alternate so every activation really binds.
+//
+// Not part of the game's project, and Windows only (it needs
+// a device). Build it on its own from a Visual Studio command
+// prompt after the game has restored its packages, e.g.
+//   set TK=..\packages\directxtk_desktop_2017.2022.3.24.2
+//   cl /O2 /EHsc /DNDEBUG /I.. /I%TK%\include BenchMaterialActivation.cpp ..\Material.cpp
+//      ..\SimpleShader.cpp ..\ConstantBufferRing.cpp ..\ShaderReflectionCache.cpp ..\ShaderReflectionData.cpp ..\StateCache.cpp
+//      ..\ContainerTextureLoader.cpp ..\TextureContainer.cpp ..\MappedFile.cpp ..\DXCore.cpp
+//      ..\Input.cpp ..\Transform.cpp ..\Camera.cpp d3d11.lib d3dcompiler.lib dxguid.lib
+//      user32.lib %TK%\native\lib\x64\Release\DirectXTK.lib
+// and run it on the folder the game's .cso files are built to:
+//   benchmaterialactivation ..\x64\Release
+// --------------------------------------------------------
+#include "../Material.h"
+#include "../StateCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+
+static double Nanoseconds(std::chrono::high_resolution_clock::time_point _start, unsigned int _count)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - _start).count() / _count;
+}
+
+// What the toon path did per draw before materials kept their own block
+static void ActivateByName(SimplePixelShader& _shader, Material& _material)
+{
+	_shader.SetFloat("roughness", _material.GetRoughness());
+	_shader.SetFloat("normalIntensity", _material.GetNormalIntensity());
+	_shader.SetFloat("alpha", _material.GetAlpha());
+	_shader.SetFloat("cutoff", _material.GetCutoff());
+	_shader.SetFloat2("scale", _material.GetUVScale());
+	_shader.SetFloat2("offset", _material.GetUVOffset());
+	_shader.SetFloat3("emitAmount", _material.GetEmitAmount());
+	_shader.SetFloat3("tint", _material.GetTint());
+	_shader.SetFloat3("rimTint", _material.GetRimTint());
+	_shader.SetFloat3("outlineTint", _material.GetOutlineTint());
+	_shader.SetFloat("outlineThickness", _material.GetOutlineThickness());
+	_shader.SetFloat("rimCutoff", _material.GetRimCutoff());
+	_shader.SetInt("hasAlbedoMap", (int)_material.hasAlbedoMap);
+	_shader.SetInt("hasEmissiveMap", (int)_material.hasEmissiveMap);
+	_shader.SetInt("hasSpecularMap", (int)_material.hasSpecularMap);
+	_shader.SetInt("hasNormalMap", (int)_material.hasNormalMap);
+	_shader.SetInt("hasRampDiffuse", (int)_material.hasRampDiffuse);
+	_shader.SetInt("hasRampSpecular", (int)_material.hasRampSpecular);
+	_shader.CopyBufferData("PerMaterial");
+}
+
+int main(int argc, char* argv[])
+{
+	std::string folder = argc > 1 ? argv[1] : ".";
+	const unsigned int draws = 200000;
+
+	// No window or swap chain; WARP stands in if there's no hardware device
+	ComPtr<ID3D11Device> device;
+	ComPtr<ID3D11DeviceContext> context;
+	HRESULT hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf());
+	if (FAILED(hr)) hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_WARP, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf());
+	if (FAILED(hr))
+	{
+		printf("Couldn't create a device\n");
+		return 1;
+	}
+	ComPtr<ID3D11DeviceContext1> context1;
+	if (FAILED(context.As(&context1)))
+	{
+		printf("Needs an 11.1 device context\n");
+		return 1;
+	}
+	StateCache::GetInstance().Initialize(context.Get(), context1.Get());
+
+	std::wstring path(folder.begin(), folder.end());
+	std::shared_ptr<SimpleVertexShader> vertexShader = std::make_shared<SimpleVertexShader>(device, context, (path + L"\\VertexShader.cso").c_str());
+	std::shared_ptr<SimplePixelShader> pixelShader = std::make_shared<SimplePixelShader>(device, context, (path + L"\\ToonShader.cso").c_str());
+	if (!vertexShader->IsShaderValid() || !pixelShader->IsShaderValid())
+	{
+		printf("Couldn't load VertexShader.cso and ToonShader.cso from %s\n", folder.c_str());
+		return 1;
+	}
+
+	Material first(0, XMFLOAT3(1, 0.5f, 0.25f), 0.4f, vertexShader, pixelShader);
+	Material second(0, XMFLOAT3(0.25f, 0.5f, 1), 0.8f, vertexShader, pixelShader);
+	Material* materials[2] = { &first, &second };
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < draws; i++)
+	{
+		ActivateByName(*pixelShader, *materials[i & 1]);
+	}
+	context->Flush();
+	double byName = Nanoseconds(start, draws);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < draws; i++)
+	{
+		materials[i & 1]->ActivateMaterial();
+	}
+	context->Flush();
+	double unchanged = Nanoseconds(start, draws);
+
+	// The worst case: a setter ran since the last activation, so the block goes up again
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < draws; i++)
+	{
+		materials[i & 1]->SetRoughness((float)(i & 255) / 255.0f);
+		materials[i & 1]->ActivateMaterial();
+	}
+	context->Flush();
+	double dirty = Nanoseconds(start, draws);
+
+	printf("%u toon material activations (ns per draw)\n", draws);
+	printf("  set by name + copy:      %8.1f\n", byName);
+	printf("  parameter block:         %8.1f\n", unchanged);
+	printf("  parameter block, dirty:  %8.1f\n", dirty);
+	return 0;
+}
@@ -0,0 +1,167 @@
+// --------------------------------------------------------
+// Benchmark for the render queue's keys and sorts: a scene
+// of draws spread over shaders, materials and meshes, counted
+// for state changes in add order and in key order, and timed
+// for a full radix sort and for the frame-to-frame insertion
+// sort over last frame's order (checked against a stable sort
+// from add order, so ties are covered too)
+//
+// Not part of the game's project. Build it on its own, e.g.
+//   g++ -std=c++14 -O2 -I.. BenchRenderQueue.cpp ../RenderKeys.cpp -o benchrenderqueue
+// and run it with an optional draw count:
+//   benchrenderqueue [draws]
+// --------------------------------------------------------
+#include "../RenderKeys.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// What the queue knows about a draw when building its key
+struct BenchDraw
+{
+	int				pass;
+	unsigned int	program;
+	unsigned int	material;
+	unsigned int	mesh;
+	float			distance;
+};
+
+struct StateChanges
+{
+	unsigned int	programs;
+	unsigned int	materials;
+	unsigned int	meshes;
+};
+
+// Counts binds the way RenderQueue::Submit skips them, with each pass starting from nothing bound
+static StateChanges CountChanges(const std::vector<BenchDraw>& _draws, const std::vector<RenderKey>& _order)
+{
+	StateChanges changes = {};
+	const BenchDraw* last = 0;
+	for (auto& key : _order)
+	{
+		const BenchDraw& draw = _draws[key.index];
+		bool passChanged = last == 0 || last->pass != draw.pass;
+		if (passChanged || last->program != draw.program) changes.programs++;
+		if (passChanged || last->material != draw.material) changes.materials++;
+		if (passChanged || last->mesh != draw.mesh) changes.meshes++;
+		last = &draw;
+	}
+	return changes;
+}
+
+static void BuildKeys(const std::vector<BenchDraw>& _draws, std::vector<RenderKey>& _keys)
+{
+	_keys.resize(_draws.size());
+	for (size_t i = 0; i < _draws.size(); i++)
+	{
+		const BenchDraw& draw = _draws[i];
+		_keys[i].key = RenderKeys::Make(draw.pass, draw.program, draw.material, draw.mesh, RenderKeys::QuantizeDepth(draw.distance, 1000.0f));
+		_keys[i].index = (unsigned int)i;
+	}
+}
+
+static double Milliseconds(std::chrono::high_resolution_clock::time_point _start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 100000;
+	const int frames = 50;
+	const unsigned int programs = 8;
+	const unsigned int materials = 256;
+	const unsigned int meshes = 512;
+
+	// Draws are added in creation order, the way Game::Draw walks its entities
+	std::mt19937 random(27);
+	std::vector<BenchDraw> draws(count);
+	for (auto& draw : draws)
+	{
+		draw.material = random() % materials;
+		draw.program = draw.material % programs;
+		draw.mesh = random() % meshes;
+		draw.pass = (random() % 10) == 0 ? RENDERPASS_TRANSPARENT : RENDERPASS_OPAQUE;
+		draw.distance = (float)(random() % 100000) / 100.0f;
+	}
+
+	std::vector<RenderKey> keys;
+	std::vector<RenderKey> scratch;
+	BuildKeys(draws, keys);
+	StateChanges unsorted = CountChanges(draws, keys);
+
+	// Full sorts from add order
+	double radixTotal = 0;
+	double stdTotal = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		BuildKeys(draws, keys);
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		RenderKeys::RadixSort(keys, scratch);
+		radixTotal += Milliseconds(start);
+
+		std::vector<RenderKey> reference;
+		BuildKeys(draws, reference);
+		start = std::chrono::high_resolution_clock::now();
+		std::stable_sort(reference.begin(), reference.end(), [](const RenderKey& _a, const RenderKey& _b) { return _a.key < _b.key; });
+		stdTotal += Milliseconds(start);
+	}
+	StateChanges sorted = CountChanges(draws, keys);
+
+	// Frame to frame: the camera drifts, so depths shift a little and last frame's order is nearly right
+	double coherentTotal = 0;
+	unsigned long long moves = 0;
+	int coherentFrames = 0;
+	unsigned int mismatches = 0;
+	std::vector<unsigned int> previousOrder(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		previousOrder[i] = keys[i].index;
+	}
+	for (int f = 0; f < frames; f++)
+	{
+		for (auto& draw : draws)
+		{
+			draw.distance += (float)((int)(random() % 201) - 100) / 1000.0f;
+		}
+		BuildKeys(draws, keys);
+
+		std::vector<RenderKey> reference = keys;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		unsigned int frameMoves = 0;
+		if (RenderKeys::CoherentSort(keys, previousOrder, scratch, count * 4, frameMoves))
+			coherentFrames++;
+		coherentTotal += Milliseconds(start);
+		moves += frameMoves;
+
+		// Whichever way it went, the order has to match a stable sort from add order
+		std::stable_sort(reference.begin(), reference.end(), [](const RenderKey& _a, const RenderKey& _b) { return _a.key < _b.key; });
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (keys[i].index != reference[i].index) mismatches++;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			previousOrder[i] = keys[i].index;
+		}
+	}
+
+	printf("%u draws (%u programs, %u materials, %u meshes)\n", count, programs, materials, meshes);
+	printf("  state changes in add order:  %7u programs %7u materials %7u meshes\n", unsorted.programs, unsorted.materials, unsorted.meshes);
+	printf("  state changes in key order:  %7u programs %7u materials %7u meshes\n", sorted.programs, sorted.materials, sorted.meshes);
+	printf("  radix sort:           %8.3f ms\n", radixTotal / frames);
+	printf("  std::stable_sort:     %8.3f ms\n", stdTotal / frames);
+	printf("  coherent sort:        %8.3f ms (%d/%d frames finished by insertion, %llu moves/frame)\n", coherentTotal / frames, coherentFrames, frames, moves / frames);
+	if (mismatches > 0)
+	{
+		printf("  coherent sort order differed from add order for %u draws\n", mismatches);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,112 @@
+// --------------------------------------------------------
+// Benchmark for SimpleShader's handle API: a million sets of
+// a variable, an SRV and a sampler on the toon pixel shader,
+// by name and by handle resolved once up front
+//
+// Not part of the game's project, and Windows only (it needs
+// a device to load the shader). Build it on its own from a
+// Visual Studio command prompt, e.g.
+//   cl /O2 /EHsc /DNDEBUG /I.. BenchShaderHandles.cpp ..\SimpleShader.cpp ..\ConstantBufferRing.cpp
+//      ..\ShaderReflectionCache.cpp ..\ShaderReflectionData.cpp ..\StateCache.cpp d3d11.lib d3dcompiler.lib dxguid.lib
+// and run it on the folder the game's .cso files are built to:
+//   benchshaderhandles ..\x64\Release
+// --------------------------------------------------------
+#include "../SimpleShader.h"
+#include "../StateCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using namespace Microsoft::WRL;
+
+static double Nanoseconds(std::chrono::high_resolution_clock::time_point _start, unsigned int _count)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - _start).count() / _count;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string folder = argc > 1 ? argv[1] : ".";
+	const unsigned int count = 1000000;
+
+	// No window or swap chain; WARP stands in if there's no hardware device
+	ComPtr<ID3D11Device> device;
+	ComPtr<ID3D11DeviceContext> context;
+	HRESULT hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_HARDWARE, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf());
+	if (FAILED(hr)) hr = D3D11CreateDevice(0, D3D_DRIVER_TYPE_WARP, 0, 0, 0, 0, D3D11_SDK_VERSION, device.GetAddressOf(), 0, context.GetAddressOf());
+	if (FAILED(hr))
+	{
+		printf("Couldn't create a device\n");
+		return 1;
+	}
+	ComPtr<ID3D11DeviceContext1> context1;
+	if (FAILED(context.As(&context1)))
+	{
+		printf("Needs an 11.1 device context\n");
+		return 1;
+	}
+	StateCache::GetInstance().Initialize(context.Get(), context1.Get());
+
+	std::wstring path(folder.begin(), folder.end());
+	SimplePixelShader shader(device, context, (path + L"\\ToonShader.cso").c_str());
+	if (!shader.IsShaderValid())
+	{
+		printf("Couldn't load ToonShader.cso from %s\n", folder.c_str());
+		return 1;
+	}
+
+	SimpleShaderHandle roughness = shader.GetVariableHandle("roughness");
+	SimpleShaderHandle albedo = shader.GetShaderResourceViewHandle("Albedo");
+	SimpleShaderHandle sampler = shader.GetSamplerHandle("BasicSampler");
+
+	// Null views and samplers are fine to bind, and what's timed is the lookup, not the resource
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shader.SetFloat("roughness", (float)i);
+	}
+	double variableByName = Nanoseconds(start, count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shader.SetFloat(roughness, (float)i);
+	}
+	double variableByHandle = Nanoseconds(start, count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shader.SetShaderResourceView("Albedo", nullptr);
+	}
+	double srvByName = Nanoseconds(start, count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shader.SetShaderResourceView(albedo, nullptr);
+	}
+	double srvByHandle = Nanoseconds(start, count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shader.SetSamplerState("BasicSampler", nullptr);
+	}
+	double samplerByName = Nanoseconds(start, count);
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shader.SetSamplerState(sampler, nullptr);
+	}
+	double samplerByHandle = Nanoseconds(start, count);
+
+	printf("%u sets each (ns per set)\n", count);
+	printf("             by name   by handle\n");
+	printf("  variable   %7.1f   %7.1f\n", variableByName, variableByHandle);
+	printf("  SRV        %7.1f   %7.1f\n", srvByName, srvByHandle);
+	printf("  sampler    %7.1f   %7.1f\n", samplerByName, samplerByHandle);
+	return 0;
+}
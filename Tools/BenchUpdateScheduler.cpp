@@ -0,0 +1,97 @@
+// --------------------------------------------------------
+// Benchmark for UpdateScheduler: a million animated entities
+// spread over a large area, with the camera flying through
+// them, timed against updating every entity every frame
+//
+// Not part of the game's project. Build it on its own, e.g.
+//   cl /O2 /EHsc /I.. BenchUpdateScheduler.cpp
+// (or g++ -std=c++14 -O2 with a DirectXMath checkout on the
+// include path) and run it with an optional entity count:
+//   benchupdatescheduler [entities]
+// Each run prints the average and worst time per frame for
+// both, and how many updates the scheduler ran per frame.
+// --------------------------------------------------------
+#include "../UpdateScheduler.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace DirectX;
+
+// Stands in for Entity: bounds and the little state the scene updates touch
+struct BenchEntity
+{
+	BoundingSphere		bounds;
+	float				baseY;
+	float				phase;
+
+	BoundingSphere		GetBounds() { return bounds; }
+};
+
+// Roughly what UpdateScene1 does to each entity
+static void Animate(BenchEntity* _entity, float _deltaTime, float _totalTime)
+{
+	_entity->bounds.Center.y = _entity->baseY + sinf(_totalTime + _entity->phase) * 0.5f;
+	_entity->phase += _deltaTime * 0.01f;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int count = argc > 1 ? (unsigned int)atoi(argv[1]) : 1000000;
+	const int frames = 300;
+	const float frameTime = 1.0f / 60.0f;
+
+	std::mt19937 random(26);
+	std::uniform_real_distribution<float> spread(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<std::shared_ptr<BenchEntity>> entities(count);
+	UpdateSchedulerT<BenchEntity> scheduler(4096, 4096);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		std::shared_ptr<BenchEntity> entity = std::make_shared<BenchEntity>();
+		entity->bounds = BoundingSphere(XMFLOAT3(spread(random), 0, spread(random)), 0.5f + unit(random));
+		entity->baseY = entity->bounds.Center.y;
+		entity->phase = unit(random) * XM_2PI;
+		entities[i] = entity;
+		scheduler.Add(entity, Animate);
+	}
+
+	// A camera looking down +Z, moved along its path each frame
+	BoundingFrustum localFrustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.01f, 1000.0f));
+
+	double everyTotal = 0, everyWorst = 0;
+	double scheduledTotal = 0, scheduledWorst = 0;
+	unsigned long long updates = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		float totalTime = f * frameTime;
+		XMFLOAT3 cameraPosition(0, 2, -1000.0f + f * 5.0f);
+		BoundingFrustum frustum = localFrustum;
+		frustum.Origin = cameraPosition;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Animate(entities[i].get(), frameTime, totalTime);
+		}
+		double every = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		everyTotal += every;
+		if (every > everyWorst) everyWorst = every;
+
+		scheduler.Update(cameraPosition, frustum, totalTime);
+		double scheduled = scheduler.GetUpdateMillisecondsLastFrame();
+		scheduledTotal += scheduled;
+		if (scheduled > scheduledWorst) scheduledWorst = scheduled;
+		updates += scheduler.GetUpdatesLastFrame();
+	}
+
+	printf("%u entities, %d frames\n", count, frames);
+	printf("  every entity:  %8.3f ms/frame avg, %8.3f ms worst\n", everyTotal / frames, everyWorst);
+	printf("  scheduled:     %8.3f ms/frame avg, %8.3f ms worst, %llu updates/frame\n", scheduledTotal / frames, scheduledWorst, updates / frames);
+	printf("  tiers:         %u / %u / %u / %u\n", scheduler.GetTierCount(0), scheduler.GetTierCount(1), scheduler.GetTierCount(2), scheduler.GetTierCount(3));
+	return 0;
+}
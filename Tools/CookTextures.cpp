@@ -0,0 +1,107 @@
+// --------------------------------------------------------
+// Offline texture cooker: turns PNGs into block compressed
+// .dds files (with every mip) next to the source images
+//
+// Not part of the game's project. Build it on its own, e.g.
+//   g++ -std=c++14 -O2 -msse2 -pthread -I.. CookTextures.cpp ../TextureCooker.cpp ../MipGenerator.cpp ../PngDecoder.cpp -o cooktextures
+// and run it with the images to cook:
+//   cooktextures [-threads N] [-format bc1|bc3|bc4|bc5|bc7] [-filter box|kaiser|lanczos] file.png...
+// The format and how mips are filtered default to what the
+// file name suggests (see TextureCooker::GetSettings). Each
+// file's size, format, error and mip and encoding speeds are
+// reported as it's written.
+// --------------------------------------------------------
+#include "TextureCooker.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+int main(int argc, char* argv[])
+{
+	unsigned int threads = std::thread::hardware_concurrency();
+	bool forced = false;
+	CookFormat format = CookFormat::BC7;
+	bool filtered = false;
+	MipFilter filter = MipFilter::Kaiser;
+	int failures = 0;
+	double totalMegapixels = 0;
+	double totalSeconds = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+		{
+			threads = (unsigned int)atoi(argv[++i]);
+			continue;
+		}
+		if (strcmp(argv[i], "-format") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			const char* names[] = { "bc1", "bc3", "bc4", "bc5", "bc7" };
+			const CookFormat formats[] = { CookFormat::BC1, CookFormat::BC3, CookFormat::BC4, CookFormat::BC5, CookFormat::BC7 };
+			forced = false;
+			for (int f = 0; f < 5; f++)
+			{
+				if (strcmp(name, names[f]) != 0) continue;
+				format = formats[f];
+				forced = true;
+			}
+			if (!forced) printf("Unknown format %s, going by file names\n", name);
+			continue;
+		}
+		if (strcmp(argv[i], "-filter") == 0 && i + 1 < argc)
+		{
+			const char* name = argv[++i];
+			const char* names[] = { "box", "kaiser", "lanczos" };
+			const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos };
+			filtered = false;
+			for (int f = 0; f < 3; f++)
+			{
+				if (strcmp(name, names[f]) != 0) continue;
+				filter = filters[f];
+				filtered = true;
+			}
+			if (!filtered) printf("Unknown filter %s, using Kaiser\n", name);
+			continue;
+		}
+
+		std::string path = argv[i];
+		DecodedImage image;
+		if (!PngDecoder::DecodeFile(path, image))
+		{
+			printf("%s: couldn't read it as a PNG\n", path.c_str());
+			failures++;
+			continue;
+		}
+
+		CookSettings settings = TextureCooker::GetSettings(path);
+		if (forced) settings.format = format;
+		if (filtered) settings.mips.filter = filter;
+
+		TextureCooker cooker(threads);
+		CookedTexture texture;
+		CookStats stats;
+		cooker.Cook(image, settings, texture, stats);
+
+		std::string output = path.substr(0, path.find_last_of('.')) + ".dds";
+		if (!TextureCooker::WriteDDS(output, texture))
+		{
+			printf("%s: couldn't write %s\n", path.c_str(), output.c_str());
+			failures++;
+			continue;
+		}
+
+		printf("%s: %ux%u %s, %u %s mips, %.2f dB, %.1fms mips (%.1f MPix/s) + %.1fms encoding (%.1f MPix/s), %.0f KB -> %.0f KB\n",
+			output.c_str(), texture.width, texture.height, TextureCooker::GetFormatName(texture.format), (unsigned int)texture.mips.size(),
+			MipGenerator::GetFilterName(settings.mips.filter), stats.psnr, stats.mipMilliseconds, stats.mipMegapixelsPerSecond, stats.encodeMilliseconds, stats.megapixelsPerSecond,
+			stats.uncompressedBytes / 1024.0, stats.cookedBytes / 1024.0);
+		totalMegapixels += stats.megapixelsPerSecond * stats.encodeMilliseconds / 1000;
+		totalSeconds += stats.encodeMilliseconds / 1000;
+	}
+
+	if (totalSeconds > 0) printf("Encoded %.1f MPix at %.1f MPix/s on %u threads\n", totalMegapixels, totalMegapixels / totalSeconds, threads);
+	return failures > 0 ? 1 : 0;
+}
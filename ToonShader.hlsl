@@ -1,20 +1,16 @@
 #include "Defines.hlsli"
 #include "Helpers.hlsli"
 #include "Lights.hlsli"
+#include "ConstantBuffers.hlsli"
+#include "Clusters.hlsli"
+#include "Shadows.hlsli"
+#include "Permutations.hlsli"
 
-#define MAX_LIGHTS 128
-
-cbuffer ExternalData : register(b0)
+cbuffer PerMaterial : register(b1)
 {
-	float3 cameraPosition;
-	int hasNormalMap;
-
 	float2 offset;
 	float2 scale;
 
-	float3 ambient;
-	float lightCount;
-
 	float3 tint;
 	int hasAlbedoMap;
 
@@ -32,11 +28,13 @@ cbuffer ExternalData : register(b0)
 	float3 rimTint;
 	float rimCutoff;
 
+	int hasNormalMap;
 	int hasSpecularMap;
 	int hasRampDiffuse;
 	int hasRampSpecular;
 
-	Light lights[MAX_LIGHTS];
+	float3 emitColor;
+	float specularAmount;
 }
 
 Texture2D Albedo : register(t0);
@@ -76,7 +74,7 @@ float4 main(VertexToPixel input) : SV_TARGET
 	// get alpha from exposed alpha value, multiply it by albedo alpha if there is one
 	float3 surface = tint;
 	float alphaValue = alpha;
-	if (hasAlbedoMap)
+	if (USE_ALBEDO_MAP)
 	{
 		float4 sampledAlbedo = Albedo.Sample(BasicSampler, input.uv);
 		// discard if the alpha of the texture is less than the cutoff point
@@ -90,52 +88,56 @@ float4 main(VertexToPixel input) : SV_TARGET
 
 	// gets normal map if there is one
 	float3 normal = input.normal;
-	if (hasNormalMap > 0)
+	if (USE_NORMAL_MAP)
 		normal = getNormal(BasicSampler, Normal, input.uv, input.normal, input.tangent, normalIntensity);
 
 	// gets specular value; if there is a specular map, use that instead
-	float specularValue = 1;
-	if (hasSpecularMap > 0)
+	float specularValue = specularAmount;
+	if (USE_SPECULAR_MAP)
 		specularValue = Specular.Sample(BasicSampler, input.uv).r;
 
 	// pre-calculate view
 	float3 view = getView(cameraPosition, input.worldPosition);
 
 	// calculate lighting
-	float3 light = ambient * surface;
-	for (int i = 0; i < lightCount; i++)
+	float3 light = (ambient + getIrradianceSH(lightIrradiance, normal)) * surface;
+	uint2 clusterRange = getClusterRange(input.screenPosition, input.worldPosition);
+	float shadow = getShadow(input.worldPosition);
+	for (uint i = 0; i < (uint)lightCount + clusterRange.y; i++)
 	{
+		Light source = getLight(i, clusterRange);
 		float3 toLight = float3(0, 0, 0);
 		float attenuate = 1;
-		switch (lights[i].Type)
+		switch (source.Type)
 		{
 		case LIGHT_TYPE_DIRECTIONAL:
-			toLight = normalize(lights[i].Direction);
+			toLight = normalize(source.Direction);
+			attenuate = lerp(1, shadow, source.Shadowed);
 			break;
 		case LIGHT_TYPE_POINT:
-			toLight = normalize(lights[i].Position - input.worldPosition);
-			attenuate = getAttenuation(lights[i].Position, input.worldPosition, lights[i].Range);
+			toLight = normalize(source.Position - input.worldPosition);
+			attenuate = getAttenuation(source.Position, input.worldPosition, source.Range) * getPointShadow(source, input.worldPosition);
 			break;
 		}
 
 		// applies the step-like effect of toon shading to the diffuse/specular of the lighting
 		float diffuse = 0;
 		float specular = 0;
-		if (hasRampDiffuse > 0)
+		if (USE_RAMP_DIFFUSE)
 			diffuse = RampDiffuse.Sample(ClampSampler, float2(getDiffuse(normal, toLight), 0)).r;
 		else
 			diffuse = GetRampDiffuse(getDiffuse(normal, toLight));
-		if (hasRampSpecular > 0)
+		if (USE_RAMP_SPECULAR)
 			specular = RampSpecular.Sample(ClampSampler, float2(calculateSpecular(normal, toLight, view, specularValue, diffuse) * roughness, 0));
 		else
 			specular = GetRampSpecular(calculateSpecular(normal, toLight, view, specularValue, diffuse) * roughness);
 
-		light += (diffuse * surface.rgb + specular) * attenuate * lights[i].Intensity * lights[i].Color;
+		light += (diffuse * surface.rgb + specular) * attenuate * source.Intensity * source.Color;
 	}
 
 	// get emission; use emissive map if there is one
-	float3 emit = float3(1, 1, 1);
-	if (hasEmissiveMap > 0)
+	float3 emit = emitColor;
+	if (USE_EMISSIVE_MAP)
 		emit = Emissive.Sample(BasicSampler, input.uv).rgb;
 
 	// calculate rim/outline value (i.e. whether there is any at this pixel)
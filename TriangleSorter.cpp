@@ -0,0 +1,115 @@
+#include "TriangleSorter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace DirectX;
+
+TriangleSorter::TriangleSorter(const XMFLOAT3* _positions, unsigned int _stride, const unsigned int* _indices, unsigned int _indexCount)
+{
+	stats = {};
+
+	const unsigned char* bytes = (const unsigned char*)_positions;
+	unsigned int triangleCount = _indexCount / 3;
+	indices.assign(_indices, _indices + triangleCount * 3);
+	centroids.resize(triangleCount);
+
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const XMFLOAT3& a = *(const XMFLOAT3*)(bytes + (size_t)_indices[t * 3 + 0] * _stride);
+		const XMFLOAT3& b = *(const XMFLOAT3*)(bytes + (size_t)_indices[t * 3 + 1] * _stride);
+		const XMFLOAT3& c = *(const XMFLOAT3*)(bytes + (size_t)_indices[t * 3 + 2] * _stride);
+		centroids[t] = XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+	}
+}
+
+const std::vector<unsigned int>& TriangleSorter::GetIndices(int _bucket)
+{
+	stats.lookups++;
+	auto found = orders.find(_bucket);
+	if (found != orders.end())
+		return found->second;
+
+	// Make room by dropping the order that was sorted longest ago
+	if (orderAge.size() >= TRIANGLESORT_MAX_CACHED_ORDERS)
+	{
+		orders.erase(orderAge.front());
+		orderAge.pop_front();
+		stats.evictions++;
+	}
+
+	stats.sorts++;
+	std::vector<unsigned int>& sorted = orders[_bucket];
+	SortTriangles(centroids, indices, GetBucketDirection(_bucket), sorted);
+	orderAge.push_back(_bucket);
+	return sorted;
+}
+
+TriangleSortStats TriangleSorter::GetStats()
+{
+	stats.cachedOrders = (unsigned int)orders.size();
+	return stats;
+}
+
+int TriangleSorter::GetBucket(XMFLOAT3 _direction)
+{
+	float components[3] = { _direction.x, _direction.y, _direction.z };
+
+	// The largest component picks the cube face
+	int axis = 0;
+	if (fabsf(components[1]) > fabsf(components[axis])) axis = 1;
+	if (fabsf(components[2]) > fabsf(components[axis])) axis = 2;
+	float major = fabsf(components[axis]);
+	if (major == 0) return 0;
+
+	int face = axis * 2 + (components[axis] < 0 ? 1 : 0);
+	int cell[2];
+	for (int i = 0; i < 2; i++)
+	{
+		// The other two components, projected onto the face, land in [-1, 1]
+		float coordinate = components[(axis + 1 + i) % 3] / major;
+		int c = (int)((coordinate + 1.0f) * 0.5f * TRIANGLESORT_CELLS_PER_FACE_AXIS);
+		cell[i] = std::min(std::max(c, 0), TRIANGLESORT_CELLS_PER_FACE_AXIS - 1);
+	}
+
+	return (face * TRIANGLESORT_CELLS_PER_FACE_AXIS + cell[0]) * TRIANGLESORT_CELLS_PER_FACE_AXIS + cell[1];
+}
+
+XMFLOAT3 TriangleSorter::GetBucketDirection(int _bucket)
+{
+	int cell1 = _bucket % TRIANGLESORT_CELLS_PER_FACE_AXIS;
+	int cell0 = (_bucket / TRIANGLESORT_CELLS_PER_FACE_AXIS) % TRIANGLESORT_CELLS_PER_FACE_AXIS;
+	int face = _bucket / (TRIANGLESORT_CELLS_PER_FACE_AXIS * TRIANGLESORT_CELLS_PER_FACE_AXIS);
+	int axis = face / 2;
+
+	float components[3];
+	components[axis] = (face % 2) ? -1.0f : 1.0f;
+	components[(axis + 1) % 3] = (cell0 + 0.5f) / TRIANGLESORT_CELLS_PER_FACE_AXIS * 2.0f - 1.0f;
+	components[(axis + 2) % 3] = (cell1 + 0.5f) / TRIANGLESORT_CELLS_PER_FACE_AXIS * 2.0f - 1.0f;
+
+	float length = sqrtf(components[0] * components[0] + components[1] * components[1] + components[2] * components[2]);
+	return XMFLOAT3(components[0] / length, components[1] / length, components[2] / length);
+}
+
+void TriangleSorter::SortTriangles(const std::vector<XMFLOAT3>& _centroids, const std::vector<unsigned int>& _indices, XMFLOAT3 _direction, std::vector<unsigned int>& _sorted)
+{
+	// Distance along the direction towards the camera: the smallest is furthest away, so it draws first
+	std::vector<std::pair<float, unsigned int>> depths(_centroids.size());
+	for (unsigned int t = 0; t < _centroids.size(); t++)
+	{
+		const XMFLOAT3& c = _centroids[t];
+		depths[t] = std::make_pair(c.x * _direction.x + c.y * _direction.y + c.z * _direction.z, t);
+	}
+	std::stable_sort(depths.begin(), depths.end(),
+		[](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first < b.first; });
+
+	_sorted.resize(depths.size() * 3);
+	for (size_t i = 0; i < depths.size(); i++)
+	{
+		unsigned int t = depths[i].second;
+		_sorted[i * 3 + 0] = _indices[t * 3 + 0];
+		_sorted[i * 3 + 1] = _indices[t * 3 + 1];
+		_sorted[i * 3 + 2] = _indices[t * 3 + 2];
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+// View directions are snapped to a grid on each face of a cube, so every
+// direction inside one cell shares a triangle order
+constexpr auto TRIANGLESORT_CELLS_PER_FACE_AXIS = 8;
+constexpr auto TRIANGLESORT_BUCKET_COUNT = 6 * TRIANGLESORT_CELLS_PER_FACE_AXIS * TRIANGLESORT_CELLS_PER_FACE_AXIS;
+
+// How many bucket orders one mesh keeps before dropping the oldest
+constexpr auto TRIANGLESORT_MAX_CACHED_ORDERS = 32;
+
+struct TriangleSortStats
+{
+	unsigned int							lookups;
+	unsigned int							sorts;			// Lookups that missed the cache and had to sort
+	unsigned int							evictions;
+	unsigned int							cachedOrders;
+};
+
+// --------------------------------------------------------
+// Orders a mesh's triangles back-to-front for a view direction
+//
+// Only triangle centroids are kept, in the mesh's local space.
+// Directions are quantized into buckets and each bucket's order
+// is sorted once (against the bucket's center direction) and then
+// cached, so a slowly turning camera only re-sorts when it
+// crosses into a new bucket.
+//
+// Nothing here knows about D3D; Mesh uploads the orders into a
+// dynamic index buffer.
+// --------------------------------------------------------
+class TriangleSorter
+{
+public:
+											/// <summary>
+											/// Builds the triangle centroids for a mesh
+											/// </summary>
+											/// <param name="_positions">The first vertex position (local space)</param>
+											/// <param name="_stride">Bytes from one position to the next</param>
+											/// <param name="_indices">The mesh's triangle list indices</param>
+											/// <param name="_indexCount">The number of indices (a multiple of three)</param>
+	TriangleSorter(const DirectX::XMFLOAT3* _positions, unsigned int _stride, const unsigned int* _indices, unsigned int _indexCount);
+
+											/// <summary>
+											/// Gets the triangle list indices ordered back-to-front for a view direction bucket
+											/// </summary>
+											/// <param name="_bucket">The bucket (see GetBucket)</param>
+											/// <returns>The sorted indices (valid until the order is evicted)</returns>
+	const std::vector<unsigned int>&		GetIndices(int _bucket);
+	TriangleSortStats						GetStats();
+
+											/// <summary>
+											/// Finds the bucket a direction falls in
+											/// </summary>
+											/// <param name="_direction">Direction from the mesh towards the camera, in the mesh's local space (needn't be normalized)</param>
+											/// <returns>The bucket, in [0, TRIANGLESORT_BUCKET_COUNT)</returns>
+	static int								GetBucket(DirectX::XMFLOAT3 _direction);
+											/// <summary>
+											/// Gets the (normalized) direction through the center of a bucket
+											/// </summary>
+	static DirectX::XMFLOAT3				GetBucketDirection(int _bucket);
+											/// <summary>
+											/// Sorts triangle list indices so triangles further along the view direction come last
+											/// </summary>
+											/// <param name="_centroids">One centroid per triangle</param>
+											/// <param name="_indices">The unsorted indices, three per centroid</param>
+											/// <param name="_direction">Direction towards the camera</param>
+											/// <param name="_sorted">Receives the sorted indices</param>
+	static void								SortTriangles(const std::vector<DirectX::XMFLOAT3>& _centroids, const std::vector<unsigned int>& _indices, DirectX::XMFLOAT3 _direction, std::vector<unsigned int>& _sorted);
+
+private:
+	std::vector<DirectX::XMFLOAT3>			centroids;
+	std::vector<unsigned int>				indices;
+
+	std::unordered_map<int, std::vector<unsigned int>>	orders;
+	std::deque<int>							orderAge;		// Cached buckets, oldest first
+
+	TriangleSortStats						stats;
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+constexpr auto UPDATE_TIER_COUNT = 4;
+
+class Entity;
+
+// --------------------------------------------------------
+// Spreads animated entity updates across frames
+//
+// Each entity is sorted into a tier by camera distance and visibility.
+// Tier 0 updates every frame, and each tier after that updates half as often,
+// with the entities of a tier split round-robin across the frames in between.
+// Both updates and re-tiering are capped per frame, so the cost of a frame
+// stays bounded no matter how many entities are registered.
+//
+// The entity type only needs GetBounds(), so the scheduling
+// can be exercised without a device.
+// --------------------------------------------------------
+template <typename TEntity>
+class UpdateSchedulerT
+{
+public:
+	// Callback for an entity update: the entity, time since *its* last update, and total time
+	typedef std::function<void(TEntity*, float, float)> EntityUpdate;
+
+	UpdateSchedulerT(
+		unsigned int					_maxUpdatesPerFrame,
+		unsigned int					_maxClassificationsPerFrame)
+	{
+		maxUpdatesPerFrame = _maxUpdatesPerFrame;
+		maxClassificationsPerFrame = _maxClassificationsPerFrame;
+		classifyCursor = 0;
+		updatesLastFrame = 0;
+		classificationsLastFrame = 0;
+		updateMillisecondsLastFrame = 0;
+
+		for (int i = 0; i < UPDATE_TIER_COUNT; i++)
+		{
+			tierCursors[i] = 0;
+		}
+		SetTierDistances(25.0f, 60.0f, 150.0f);
+	}
+
+									/// <summary>
+									/// Registers an entity to be updated by the scheduler
+									/// </summary>
+									/// <param name="_entity">The entity to update</param>
+									/// <param name="_update">The update to run on the entity (receives its own delta time)</param>
+	void							Add(std::shared_ptr<TEntity> _entity, EntityUpdate _update)
+	{
+		// New entities start in the closest tier until they are classified
+		ScheduledEntity item = {};
+		item.entity = _entity;
+		item.update = _update;
+		item.lastUpdateTime = -1;
+		item.tier = 0;
+		item.slot = (unsigned int)tiers[0].size();
+
+		tiers[0].push_back((unsigned int)items.size());
+		items.push_back(item);
+	}
+
+									/// <summary>
+									/// Removes all registered entities (e.g. when a scene is unloaded)
+									/// </summary>
+	void							Clear()
+	{
+		items.clear();
+		for (int i = 0; i < UPDATE_TIER_COUNT; i++)
+		{
+			tiers[i].clear();
+			tierCursors[i] = 0;
+		}
+		classifyCursor = 0;
+	}
+
+									/// <summary>
+									/// Re-tiers a slice of entities, then runs this frame's share of updates
+									/// </summary>
+									/// <param name="_cameraPosition">Where distances are measured from</param>
+									/// <param name="_frustum">The camera's frustum, for visibility checks</param>
+									/// <param name="_totalTime">The total time elapsed</param>
+	void							Update(DirectX::XMFLOAT3 _cameraPosition, const DirectX::BoundingFrustum& _frustum, float _totalTime)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		// Re-tier a bounded slice of the entities, continuing where the last frame left off
+		classificationsLastFrame = 0;
+		if (items.size() > 0)
+		{
+			unsigned int count = (std::min)(maxClassificationsPerFrame, (unsigned int)items.size());
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (classifyCursor >= items.size()) classifyCursor = 0;
+				Classify(items[classifyCursor], classifyCursor, _cameraPosition, _frustum);
+				classifyCursor++;
+			}
+			classificationsLastFrame = count;
+		}
+
+		// Each tier wants 1/2^tier of its entities this frame; closer tiers get first claim on the budget
+		unsigned int budget = maxUpdatesPerFrame;
+		updatesLastFrame = 0;
+		for (int t = 0; t < UPDATE_TIER_COUNT && budget > 0; t++)
+		{
+			unsigned int interval = 1 << t;
+			unsigned int wanted = ((unsigned int)tiers[t].size() + interval - 1) / interval;
+			unsigned int ran = RunTier(t, (std::min)(wanted, budget), _totalTime);
+			budget -= ran;
+			updatesLastFrame += ran;
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		updateMillisecondsLastFrame = elapsed.count();
+	}
+
+	void							SetTierDistances(float _tier1, float _tier2, float _tier3)
+	{
+		tierDistances[0] = 0;
+		tierDistances[1] = _tier1;
+		tierDistances[2] = _tier2;
+		tierDistances[3] = _tier3;
+	}
+
+	void							SetMaxUpdatesPerFrame(unsigned int _max) { maxUpdatesPerFrame = _max; }
+
+	unsigned int					GetEntityCount() { return (unsigned int)items.size(); }
+	unsigned int					GetTierCount(int _tier)
+	{
+		if (_tier < 0 || _tier >= UPDATE_TIER_COUNT) return 0;
+		return (unsigned int)tiers[_tier].size();
+	}
+	unsigned int					GetUpdatesLastFrame() { return updatesLastFrame; }
+	unsigned int					GetClassificationsLastFrame() { return classificationsLastFrame; }
+	double							GetUpdateMillisecondsLastFrame() { return updateMillisecondsLastFrame; }
+
+private:
+	struct ScheduledEntity
+	{
+		std::shared_ptr<TEntity>	entity;
+		EntityUpdate				update;
+		float						lastUpdateTime;
+		int							tier;
+		unsigned int				slot; // position in its tier's list
+	};
+
+	void							Classify(ScheduledEntity& _item, unsigned int _index, DirectX::XMFLOAT3 _cameraPosition, const DirectX::BoundingFrustum& _frustum)
+	{
+		DirectX::BoundingSphere bounds = _item.entity->GetBounds();
+
+		// Entities the camera can't see only need the occasional catch-up
+		int tier = UPDATE_TIER_COUNT - 1;
+		if (_frustum.Intersects(bounds))
+		{
+			// Distance to the surface of the bounds, so large entities aren't demoted while the camera is inside them
+			DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&bounds.Center), DirectX::XMLoadFloat3(&_cameraPosition));
+			float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(offset)) - bounds.Radius;
+			tier = 0;
+			while (tier < UPDATE_TIER_COUNT - 1 && distance >= tierDistances[tier + 1])
+			{
+				tier++;
+			}
+		}
+
+		if (tier != _item.tier)
+		{
+			MoveToTier(_index, tier);
+		}
+	}
+
+	void							MoveToTier(unsigned int _index, int _tier)
+	{
+		ScheduledEntity& item = items[_index];
+		std::vector<unsigned int>& oldTier = tiers[item.tier];
+
+		// Swap-remove from the old tier, patching the slot of whichever entity filled the gap
+		unsigned int last = oldTier.back();
+		oldTier[item.slot] = last;
+		items[last].slot = item.slot;
+		oldTier.pop_back();
+		if (tierCursors[item.tier] >= oldTier.size()) tierCursors[item.tier] = 0;
+
+		item.tier = _tier;
+		item.slot = (unsigned int)tiers[_tier].size();
+		tiers[_tier].push_back(_index);
+	}
+
+	unsigned int					RunTier(int _tier, unsigned int _count, float _totalTime)
+	{
+		std::vector<unsigned int>& tier = tiers[_tier];
+		if (tier.size() == 0) return 0;
+
+		_count = (std::min)(_count, (unsigned int)tier.size());
+		for (unsigned int i = 0; i < _count; i++)
+		{
+			// Round-robin through the tier so every entity gets its turn
+			if (tierCursors[_tier] >= tier.size()) tierCursors[_tier] = 0;
+			ScheduledEntity& item = items[tier[tierCursors[_tier]++]];
+
+			float deltaTime = item.lastUpdateTime < 0 ? 0 : _totalTime - item.lastUpdateTime;
+			item.update(item.entity.get(), deltaTime, _totalTime);
+			item.lastUpdateTime = _totalTime;
+		}
+		return _count;
+	}
+
+	std::vector<ScheduledEntity>	items;
+	std::vector<unsigned int>		tiers[UPDATE_TIER_COUNT];
+	unsigned int					tierCursors[UPDATE_TIER_COUNT];
+	float							tierDistances[UPDATE_TIER_COUNT];
+	unsigned int					classifyCursor;
+	unsigned int					maxUpdatesPerFrame;
+	unsigned int					maxClassificationsPerFrame;
+
+	unsigned int					updatesLastFrame;
+	unsigned int					classificationsLastFrame;
+	double							updateMillisecondsLastFrame;
+};
+
+typedef UpdateSchedulerT<Entity> UpdateScheduler;
+typedef UpdateScheduler::EntityUpdate EntityUpdate;
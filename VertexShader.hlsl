@@ -1,12 +1,5 @@
 #include "Defines.hlsli"
-
-cbuffer ExternalData : register(b0)
-{
-	matrix world;
-	matrix worldInvTranspose;
-	matrix view;
-	matrix projection;
-}
+#include "ConstantBuffers.hlsli"
 
 // --------------------------------------------------------
 // The entry point (main method) for our vertex shader